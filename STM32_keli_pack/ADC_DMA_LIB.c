@@ -6,21 +6,39 @@
  *  ADC_DMA_LIB.c – ADC1 Scan + DMA2 Stream0 Circular Transfer
  *
  *  Hardware path:
- *    PA0-PA3 (analog) → ADC1 scan (4 channels, continuous)
- *    → DMA2 Stream0 Ch0 → g_adc_buf[4] (circular, 16-bit)
+ *    ADC_SCAN_TABLE inputs → ADC1 scan (N channels, continuous
+ *    or one scan per TIM2 update with ADC_TRIG_TIMER)
+ *    → DMA2 Stream0 Ch0 → g_adc_buf[N] (circular, 16-bit)
  *    → TC interrupt → Greenhouse_OnAdcReady()
  *
- *  DMA Transfer Complete fires every time all 4 channels
- *  have been sampled.  The callback processes the data
- *  (filter → alarm → actuators → SPI packet) entirely
- *  within ISR context at priority 1 (highest).
+ *  TIM5 runs free at TS_CLOCK_HZ (32-bit); the TC ISR latches
+ *  its count into g_adc_ts_us as the sample time of the scan.
+ *
+ *  The ADON → SWSTART stabilisation gap is timed by TIM11 in
+ *  one-pulse mode, so boot continues (SPI frame ready, SysTick
+ *  running) while the ADC settles instead of spinning.  With
+ *  ADC_TRIG_TIMER its update starts TIM2 instead, whose TRGO
+ *  then starts every scan ADC_SCAN_TICKS clocks apart.
+ *
+ *  DMA Transfer Complete fires every time all N channels
+ *  have been sampled.  The callback only latches the scan and
+ *  releases the SAMPLE task (board.h Section 11), at
+ *  priority 1.
+ *
+ *  With AWD_ENABLE the analog watchdog watches one input at a
+ *  time (ADC1_Awd_Guard, moved per scan by awd.c); a raw value
+ *  over HTR raises ADC_IRQn at priority 0 → Awd_OnTrip().
  *============================================================*/
 
-/* DMA destination buffer — 4 × uint16, written by DMA hardware */
+/* DMA destination buffer — N × uint16, written by DMA hardware */
 volatile uint16_t g_adc_buf[ADC_NUM_CHANNELS];
 
-/* Small busy-wait for ADC ADON stabilization (~10 µs @ 16 MHz) */
-static inline void small_delay(volatile uint32_t t) { while (t--) __NOP(); }
+/* TIM5->CNT at the TC of the scan now in g_adc_buf */
+volatile uint32_t g_adc_ts_us;
+
+/* Conversion sequence (board.h Section 3) */
+static const uint8_t k_scan_table[ADC_NUM_CHANNELS] = ADC_SCAN_TABLE;
+
 
 /*------------------------------------------------------------
  *  DMA2_Stream0_Init — Peripheral-to-memory, circular
@@ -51,7 +69,7 @@ static void DMA2_Stream0_Init(void)
     /* Source: ADC1 data register (0x4C offset from ADC1 base) */
     DMA2_Stream0->PAR  = (uint32_t)&ADC1->DR;
 
-    /* Destination: RAM buffer for 4 sensor readings */
+    /* Destination: RAM buffer, ADC_NUM_CHANNELS readings per scan */
     DMA2_Stream0->M0AR = (uint32_t)g_adc_buf;
 
     /* Number of data items = number of ADC channels */
@@ -80,17 +98,170 @@ static void DMA2_Stream0_Init(void)
 }
 
 /*------------------------------------------------------------
- *  ADC1_Init_Scan_DMA — 4-channel scan, continuous, DMA
+ *  ADC1_Program_Sequence — SMPRx + SQRx from k_scan_table
+ *
+ *  Sample time: 3 bits per input; SMPR2 holds IN0-IN9,
+ *  SMPR1 holds IN10-IN18.
+ *  Sequence:    5 bits per slot; SQR3 = slots 1-6,
+ *  SQR2 = slots 7-12, SQR1 = slots 13-16 + L[23:20].
+ *------------------------------------------------------------*/
+static void ADC1_Program_Sequence(void)
+{
+    uint32_t sqr[3] = { 0, 0, 0 };      /* SQR3, SQR2, SQR1 */
+    uint8_t  k;
+    uint8_t  ch;
+
+    for (k = 0; k < ADC_NUM_CHANNELS; k++)
+    {
+        ch = k_scan_table[k];
+
+        if (ch < 10U)
+        {
+            ADC1->SMPR2 &= ~(7U << (ch * 3U));
+            ADC1->SMPR2 |=  (ADC_SAMPLE_TIME_SEL << (ch * 3U));
+        }
+        else
+        {
+            ADC1->SMPR1 &= ~(7U << ((ch - 10U) * 3U));
+            ADC1->SMPR1 |=  (ADC_SAMPLE_TIME_SEL << ((ch - 10U) * 3U));
+        }
+
+        /* Internal channels need the temp-sensor / Vrefint path */
+        if (ch >= 16U)
+            ADC->CCR |= (1U << 23);     /* TSVREFE */
+
+        sqr[k / 6U] |= (uint32_t)ch << ((k % 6U) * 5U);
+    }
+
+    ADC1->SQR3 = sqr[0];
+    ADC1->SQR2 = sqr[1];
+    ADC1->SQR1 = sqr[2] | ((uint32_t)(ADC_NUM_CHANNELS - 1U) << 20);
+}
+
+/*------------------------------------------------------------
+ *  ADC1_Timestamp_Init — TIM5 free-running sample clock
+ *
+ *  PSC = SYS_CLOCK_HZ/TS_CLOCK_HZ - 1, ARR = 0xFFFFFFFF, no
+ *  interrupt: the count simply wraps every 2^32 ticks.
+ *------------------------------------------------------------*/
+static void ADC1_Timestamp_Init(void)
+{
+    TIM5->CR1 = 0;
+    TIM5->PSC = (SYS_CLOCK_HZ / TS_CLOCK_HZ) - 1U;
+    TIM5->ARR = 0xFFFFFFFFUL;
+    TIM5->CNT = 0;
+    TIM5->EGR = TIM_EGR_UG;              /* load PSC now          */
+    TIM5->SR  = 0;
+    TIM5->CR1 = TIM_CR1_CEN;
+}
+
+/*------------------------------------------------------------
+ *  ADC1_Start_Timer — TIM11 one-pulse, ADC_STAB_US long
+ *
+ *  1 MHz tick (PSC = SYS_CLOCK_HZ/1 MHz - 1), ARR = tSTAB.
+ *  The update IRQ issues SWSTART and then switches itself off.
+ *------------------------------------------------------------*/
+static void ADC1_Start_Timer(void)
+{
+    TIM11->CR1  = 0;
+    TIM11->PSC  = (SYS_CLOCK_HZ / 1000000UL) - 1U;
+    TIM11->ARR  = ADC_STAB_US - 1U;
+    TIM11->EGR  = TIM_EGR_UG;            /* load PSC/ARR now     */
+    TIM11->SR   = 0;                     /* drop the UG flag     */
+    TIM11->DIER = TIM_DIER_UIE;
+
+    NVIC_SetPriority(TIM1_TRG_COM_TIM11_IRQn, IRQ_PRIO_ADC_START);
+    NVIC_EnableIRQ(TIM1_TRG_COM_TIM11_IRQn);
+
+    TIM11->CR1  = TIM_CR1_OPM | TIM_CR1_CEN;
+}
+
+#if ADC_TRIG_TIMER
+/*------------------------------------------------------------
+ *  ADC1_Trigger_Init — TIM2 scan clock, stopped
+ *
+ *    PSC = 0, ARR = ADC_SCAN_TICKS - 1  → update every scan period
+ *    CR2.MMS = 010                      → update event is TRGO
+ *
+ *  The first TRGO comes one period after CEN, i.e. after the
+ *  TIM11 stabilisation gap.
+ *------------------------------------------------------------*/
+static void ADC1_Trigger_Init(void)
+{
+    TIM2->CR1 = 0;
+    TIM2->PSC = 0;
+    TIM2->ARR = ADC_SCAN_TICKS - 1U;
+    TIM2->CNT = 0;
+    TIM2->CR2 = TIM_CR2_MMS_1;           /* TRGO = update        */
+    TIM2->EGR = TIM_EGR_UG;              /* load ARR now         */
+    TIM2->SR  = 0;
+}
+#endif
+
+#if AWD_ENABLE
+/*------------------------------------------------------------
+ *  ADC1_Awd_Init — Single-channel analog watchdog, high only
+ *
+ *    CR1.AWDSGL/AWDEN/AWDIE = 1 → one regular input, IRQ
+ *    HTR = full scale           → cannot trip until guarded
+ *    LTR = 0                    → no low limit
+ *------------------------------------------------------------*/
+static void ADC1_Awd_Init(void)
+{
+    ADC1->HTR = ADC_RESOLUTION;
+    ADC1->LTR = 0;
+    ADC1->CR1 |= ADC_CR1_AWDSGL | ADC_CR1_AWDEN | ADC_CR1_AWDIE;
+
+    NVIC_SetPriority(ADC_IRQn, IRQ_PRIO_ADC_AWD);
+    NVIC_EnableIRQ(ADC_IRQn);
+}
+
+/*------------------------------------------------------------
+ *  ADC1_Awd_Guard — Watch scan slot idx against high
+ *
+ *  Called from the DMA TC ISR while the ADC keeps converting.
+ *  HTR goes to full scale first, so no conversion is ever
+ *  compared with the new channel and the old limit (or the
+ *  reverse).  CR1 is only written here after init.
+ *------------------------------------------------------------*/
+void ADC1_Awd_Guard(uint8_t idx, uint16_t high)
+{
+    ADC1->HTR = ADC_RESOLUTION;
+    ADC1->CR1 = (ADC1->CR1 & ~ADC_CR1_AWDCH)
+              | ((uint32_t)k_scan_table[idx] << ADC_CR1_AWDCH_Pos);
+    ADC1->HTR = high;
+}
+
+/*------------------------------------------------------------
+ *  ADC1_Awd_Arm — Re-enable the one-shot watchdog IRQ
+ *
+ *  SR.AWD is rc_w0: writing ~AWD clears only that flag.  The
+ *  NVIC pending bit latched while disabled is dropped too, so
+ *  only a conversion after this call can trip again.
+ *------------------------------------------------------------*/
+void ADC1_Awd_Arm(void)
+{
+    ADC1->SR = ~ADC_SR_AWD;
+    NVIC_ClearPendingIRQ(ADC_IRQn);
+    NVIC_EnableIRQ(ADC_IRQn);
+}
+#endif /* AWD_ENABLE */
+
+/*------------------------------------------------------------
+ *  ADC1_Init_Scan_DMA — N-channel scan, continuous, DMA
  *
  *  Key register settings:
  *    CCR.ADCPRE   = 00  → PCLK2/2 = 8 MHz ADC clock
  *    CR1.SCAN     = 1   → Scan mode (convert all channels)
  *    CR2.DMA      = 1   → DMA request on each conversion
  *    CR2.DDS      = 1   → DMA requests continue in circular
- *    CR2.CONT     = 1   → Continuous conversion mode
- *    SMPR2        = ADC_SAMPLE_TIME_SEL per channel (board.h)
+ *    CR2.CONT     = 1   → Continuous conversion mode, or
+ *    CR2.EXTEN    = 01  → scan on TIM2 TRGO rising edge
+ *    CR2.EXTSEL   = 1011  (ADC_TRIG_TIMER)
+ *    SMPR1/SMPR2  = ADC_SAMPLE_TIME_SEL per channel (board.h)
  *    SQR1.L       = ADC_NUM_CHANNELS - 1
- *    SQR3         = Channel sequence order (board.h defines)
+ *    SQR1..SQR3   = ADC_SCAN_TABLE order (board.h)
+ *    CR1.AWD*     = analog watchdog (AWD_ENABLE, Section 12)
  *------------------------------------------------------------*/
 static void ADC1_Init_Scan_DMA(void)
 {
@@ -100,38 +271,40 @@ static void ADC1_Init_Scan_DMA(void)
     /* CR1: Enable scan mode */
     ADC1->CR1 = ADC_CR1_SCAN;
 
+#if ADC_TRIG_TIMER
+    /* CR2: DMA enable + DDS + one scan per TIM2 TRGO edge */
+    ADC1_Trigger_Init();
+    ADC1->CR2 = ADC_CR2_DMA | ADC_CR2_DDS | ADC_CR2_EXTEN_0
+              | (11U << ADC_CR2_EXTSEL_Pos);
+#else
     /* CR2: DMA enable + DDS (keep issuing DMA) + Continuous */
     ADC1->CR2 = ADC_CR2_DMA | ADC_CR2_DDS | ADC_CR2_CONT;
+#endif
+
+    /* Sample times, sequence length and conversion order */
+    ADC1_Program_Sequence();
 
-    /* Sample time: ADC_SAMPLE_TIME_SEL (84 cycles) for ch0-ch3
-     * SMPR2 has 3 bits per channel, channels 0-9 */
-    ADC1->SMPR2 &= ~( (7U << (ADC_CH_LM35 * 3))
-                    | (7U << (ADC_CH_GAS  * 3))
-                    | (7U << (ADC_CH_S3   * 3))
-                    | (7U << (ADC_CH_S4   * 3)) );
-    ADC1->SMPR2 |=  ( (ADC_SAMPLE_TIME_SEL << (ADC_CH_LM35 * 3))
-                    | (ADC_SAMPLE_TIME_SEL << (ADC_CH_GAS  * 3))
-                    | (ADC_SAMPLE_TIME_SEL << (ADC_CH_S3   * 3))
-                    | (ADC_SAMPLE_TIME_SEL << (ADC_CH_S4   * 3)) );
-
-    /* Number of conversions: L = ADC_NUM_CHANNELS - 1 = 3
-     * SQR1 bits [23:20] */
-    ADC1->SQR1 &= ~(0xFU << 20);
-    ADC1->SQR1 |=  ((ADC_NUM_CHANNELS - 1U) << 20);
-
-    /* Conversion sequence: ch0 → ch1 → ch2 → ch3
-     * SQR3: 5 bits per slot, slots 1-4 (bits [0:19]) */
-    ADC1->SQR3 = (ADC_CH_LM35 << 0)
-               | (ADC_CH_GAS  << 5)
-               | (ADC_CH_S3   << 10)
-               | (ADC_CH_S4   << 15);
-
-    /* Turn on ADC (ADON bit) and wait for stabilization */
+#if AWD_ENABLE
+    /* Emergency limits in hardware, disarmed until awd.c guards */
+    ADC1_Awd_Init();
+#endif
+
+    /* Turn on ADC (ADON bit); the first scan follows tSTAB */
     ADC1->CR2 |= ADC_CR2_ADON;
-    small_delay(10000);   /* ~625 µs @ 16 MHz — well above Tstab */
+    ADC1_Start_Timer();
+}
 
-    /* Start first conversion (SWSTART bit) */
+/* TIM11 update: ADC has stabilised → first conversion, or
+ * the scan clock that triggers every conversion             */
+void TIM1_TRG_COM_TIM11_IRQHandler(void)
+{
+    TIM11->SR = 0;
+    NVIC_DisableIRQ(TIM1_TRG_COM_TIM11_IRQn);
+#if ADC_TRIG_TIMER
+    TIM2->CR1 = TIM_CR1_CEN;
+#else
     ADC1->CR2 |= ADC_CR2_SWSTART;
+#endif
 }
 
 /*------------------------------------------------------------
@@ -143,13 +316,14 @@ static void ADC1_Init_Scan_DMA(void)
  *------------------------------------------------------------*/
 void ADC1_DMA2_Stream0_InitStart(void)
 {
+    ADC1_Timestamp_Init();   /* sample clock before 1st scan */
     DMA2_Stream0_Init();     /* configure & enable DMA first */
     ADC1_Init_Scan_DMA();    /* then start ADC conversions   */
 }
 
 /* ═══════════ DMA2 Stream 0 Transfer-Complete ISR ═══════════
  *
- * Fires every time 4 ADC samples have been transferred into
+ * Fires every time N ADC samples have been transferred into
  * g_adc_buf[].  Calls into the Service Layer (greenhouse.c)
  * which processes the data and builds the SPI packet.
  *
@@ -164,7 +338,31 @@ void DMA2_Stream0_IRQHandler(void)
         /* Clear TC flag (write-1-to-clear in LIFCR) */
         DMA2->LIFCR = DMA_LIFCR_CTCIF0;
 
-        /* Process: filter → alarm → actuators → SPI packet */
+        /* Sample time of this scan, before any processing */
+        g_adc_ts_us = TIM5->CNT;
+
+        /* Latch the scan, release the SAMPLE task (sched.c) */
         Greenhouse_OnAdcReady();
     }
 }
+
+#if AWD_ENABLE
+/* ═══════════ ADC1 Analog-Watchdog ISR ═══════════
+ *
+ * Priority 0: preempts the DMA TC and SysTick, so motor and
+ * buzzer switch within the IRQ latency of the conversion end.
+ * One-shot: the input stays over the limit for many
+ * conversions, so the IRQ is disabled until awd.c re-arms it.
+ */
+extern void Awd_OnTrip(void);
+
+void ADC_IRQHandler(void)
+{
+    if (ADC1->SR & ADC_SR_AWD)
+    {
+        ADC1->SR = ~ADC_SR_AWD;
+        NVIC_DisableIRQ(ADC_IRQn);
+        Awd_OnTrip();
+    }
+}
+#endif /* AWD_ENABLE */
@@ -2,6 +2,7 @@
 #define _DMA_H_
 
 #include <stdint.h>
+#include "board.h"       /* ADC_NUM_CHANNELS */
 
 /* DMA base address (STM32F411) */
 #define DMA1_BASE_ADDR   (0x40026000UL)
@@ -57,8 +58,15 @@ typedef struct
 #define DMA2_STREAM6   (&(DMA2_REG->S6))
 #define DMA2_STREAM7   (&(DMA2_REG->S7))
 //ADC_DMA -> interrupt 
-extern volatile uint16_t g_adc_buf[4];
+extern volatile uint16_t g_adc_buf[ADC_NUM_CHANNELS];
+/* TIM5 count (TS_CLOCK_HZ) latched when g_adc_buf was filled */
+extern volatile uint32_t g_adc_ts_us;
 
 void ADC1_DMA2_Stream0_InitStart(void);
 
+/* Analog watchdog (board.h Section 12): guard scan slot idx
+ * with a raw high limit; re-enable the one-shot IRQ */
+void ADC1_Awd_Guard(uint8_t idx, uint16_t high);
+void ADC1_Awd_Arm(void);
+
 #endif /* _DMA_H_ */
\ No newline at end of file
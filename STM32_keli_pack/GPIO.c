@@ -2,24 +2,37 @@
 #include "board.h"   /* PIN_xxx defines from Section 2 */
 
 /*============================================================
- *  GPIO_Config_ADC_PA0_PA3_Analog
+ *  GPIO_Config_ADC_Scan_Analog
  *
- *  Configure PA0-PA3 as analog inputs for ADC1 channels.
+ *  Configure every input in ADC_SCAN_TABLE (board.h §3) as
+ *  an analog pin.
  *  MODER = 11 (analog), PUPDR = 00 (no pull — required for ADC)
+ *
+ *  ADC1 input → pin (STM32F411 datasheet, Table 9):
+ *    IN0-IN7   → PA0-PA7
+ *    IN8-IN9   → PB0-PB1
+ *    IN10-IN15 → PC0-PC5
+ *    IN16-IN18 → internal, no pin
+ *  PA4-PA7 (SPI1) and PB0-PB1 (buzzer/motor) are never switched
+ *  to analog even if listed by mistake.
  *============================================================*/
-void GPIO_Config_ADC_PA0_PA3_Analog(void)
+void GPIO_Config_ADC_Scan_Analog(void)
 {
-    /* MODER bits [7:0] → set pairs to 0b11 (analog) for pins 0-3 */
-    GPIOA->MODER |= (3U << (PIN_ADC_LM35 * 2))
-                  | (3U << (PIN_ADC_GAS  * 2))
-                  | (3U << (PIN_ADC_S3   * 2))
-                  | (3U << (PIN_ADC_S4   * 2));
+    static const uint8_t scan[ADC_NUM_CHANNELS] = ADC_SCAN_TABLE;
+    GPIO_TypeDef_Mini *port;
+    uint8_t k, ch, pin;
+
+    for (k = 0; k < ADC_NUM_CHANNELS; k++)
+    {
+        ch = scan[k];
+
+        if (ch <= 3U)                      { port = GPIOA; pin = ch;       }
+        else if (ch >= 10U && ch <= 15U)   { port = GPIOC; pin = ch - 10U; }
+        else continue;      /* SPI / actuator pin, or internal channel */
 
-    /* No pull-up / pull-down (PUPDR = 00 for each pin) */
-    GPIOA->PUPDR &= ~( (3U << (PIN_ADC_LM35 * 2))
-                     | (3U << (PIN_ADC_GAS  * 2))
-                     | (3U << (PIN_ADC_S3   * 2))
-                     | (3U << (PIN_ADC_S4   * 2)) );
+        port->MODER |=  (3U << (pin * 2));     /* 11 = analog   */
+        port->PUPDR &= ~(3U << (pin * 2));     /* 00 = no pull  */
+    }
 }
 
 /*============================================================
@@ -104,3 +117,21 @@ void GPIO_Config_Motor_PB1_Output(void)
     GPIOB->PUPDR  &= ~(3U << (PIN_MOTOR * 2));    /* 00 = no pull  */
     GPIOB->ODR    &= ~(1U << PIN_MOTOR);           /* start OFF     */
 }
+
+/*============================================================
+ *  GPIO_Config_Drdy_PB2_Output
+ *
+ *  PB2 → General-purpose output, push-pull, no pull, default LOW.
+ *  Data-ready / alarm line to the Pi (board.h Section 10).
+ *  Medium speed: the Pi waits on its edge, so it should be clean.
+ *============================================================*/
+void GPIO_Config_Drdy_PB2_Output(void)
+{
+    GPIOB->MODER   &= ~(3U << (PIN_DRDY * 2));
+    GPIOB->MODER   |=  (1U << (PIN_DRDY * 2));   /* 01 = output   */
+    GPIOB->OTYPER  &= ~(1U << PIN_DRDY);          /* 0  = push-pull*/
+    GPIOB->OSPEEDR &= ~(3U << (PIN_DRDY * 2));
+    GPIOB->OSPEEDR |=  (1U << (PIN_DRDY * 2));   /* 01 = medium   */
+    GPIOB->PUPDR   &= ~(3U << (PIN_DRDY * 2));   /* 00 = no pull  */
+    GPIOB->ODR     &= ~(1U << PIN_DRDY);          /* start LOW     */
+}
@@ -62,8 +62,12 @@ typedef struct
  * board.h Section 2 (Pin Map).  Call AFTER RCC enable.
  */
 
-/* PA0-PA3 → Analog mode (ADC input, no pull) */
-void GPIO_Config_ADC_PA0_PA3_Analog(void);
+/* Every ADC_SCAN_TABLE input → Analog mode (ADC input, no pull)
+ * IN0-3 → PA0-3, IN10-15 → PC0-5; internal channels skipped. */
+void GPIO_Config_ADC_Scan_Analog(void);
+
+/* Legacy name (4-channel PA0-PA3 build) */
+#define GPIO_Config_ADC_PA0_PA3_Analog   GPIO_Config_ADC_Scan_Analog
 
 /* PA4-PA7 → AF5 (SPI1: NSS, SCK, MISO, MOSI) */
 void GPIO_Config_SPI1_PA4_PA7_AF5(void);
@@ -74,4 +78,7 @@ void GPIO_Config_Buzzer_PB0_Output(void);
 /* PB1 → Push-pull output (Motor / Fan control) */
 void GPIO_Config_Motor_PB1_Output(void);
 
+/* PB2 → Push-pull output (DRDY line to the Pi) */
+void GPIO_Config_Drdy_PB2_Output(void);
+
 #endif /* _GPIO_H */
@@ -9,21 +9,68 @@
  *
  *  AHB1ENR (offset 0x30):
  *    Bit  0 : GPIOAEN  – PA0-PA7 (ADC + SPI pins)
- *    Bit  1 : GPIOBEN  – PB0-PB1 (Buzzer + Motor)
+ *    Bit  1 : GPIOBEN  – PB0-PB2 (Buzzer, Motor, DRDY)
+ *    Bit  2 : GPIOCEN  – PC0-PC5 (ADC IN10-IN15, optional)
  *    Bit 22 : DMA2EN   – DMA2 for ADC1 circular transfer
  *
+ *  APB1ENR (offset 0x40):
+ *    Bit  0 : TIM2EN   – ADC scan trigger (ADC_TRIG_TIMER)
+ *    Bit  3 : TIM5EN   – 32-bit sample timestamp clock
+ *
  *  APB2ENR (offset 0x44):
- *    Bit  8 : ADC1EN   – ADC1 (4-channel scan)
+ *    Bit  8 : ADC1EN   – ADC1 (N-channel scan)
  *    Bit 12 : SPI1EN   – SPI1 slave (data → Raspberry Pi)
+ *    Bit 14 : SYSCFGEN – EXTI4 ← PA4 (NSS edge, SPI_NSS_ALIGN)
+ *    Bit 18 : TIM11EN  – one-shot ADC stabilisation timer
  *============================================================*/
 void RCC_Enable_For_GPIO_ADC_SPI_DMA(void)
 {
-    /* AHB1: GPIOA (PA0-PA7), GPIOB (PB0-PB1), DMA2 */
+    /* AHB1: GPIOA (PA0-PA7), GPIOB (PB0-PB2), GPIOC (PC0-PC5), DMA2 */
     RCC->AHB1ENR |= RCC_AHB1ENR_GPIOAEN
                   | RCC_AHB1ENR_GPIOBEN
+                  | RCC_AHB1ENR_GPIOCEN
                   | RCC_AHB1ENR_DMA2EN;
 
-    /* APB2: ADC1 + SPI1 */
+    /* APB1: TIM2 (scan trigger) + TIM5 (TS_US sample clock) */
+    RCC->APB1ENR |= RCC_APB1ENR_TIM2EN
+                  | RCC_APB1ENR_TIM5EN;
+
+    /* APB2: ADC1 + SPI1 + SYSCFG + TIM11 */
     RCC->APB2ENR |= RCC_APB2ENR_ADC1EN
-                  | RCC_APB2ENR_SPI1EN;
+                  | RCC_APB2ENR_SPI1EN
+                  | RCC_APB2ENR_SYSCFGEN
+                  | RCC_APB2ENR_TIM11EN;
+}
+
+/*============================================================
+ *  RCC_Enable_BackupSRAM
+ *
+ *  BKPSRAM (0x40024000, 4 KB) keeps its content through every
+ *  system reset (NRST, watchdog, software, brown-out) as long
+ *  as VDD or VBAT stays up.  Writes need the backup-domain
+ *  protection lifted (PWR_CR.DBP), which needs the PWR clock.
+ *
+ *    APB1ENR bit 28 : PWREN
+ *    PWR_CR  bit  8 : DBP
+ *    AHB1ENR bit 18 : BKPSRAMEN
+ *============================================================*/
+void *RCC_Enable_BackupSRAM(void)
+{
+    RCC->APB1ENR |= RCC_APB1ENR_PWREN;
+    PWR->CR      |= PWR_CR_DBP;
+    RCC->AHB1ENR |= RCC_AHB1ENR_BKPSRAMEN;
+    return (void *)BKPSRAM_BASE;
+}
+
+/*============================================================
+ *  RCC_TakeResetFlags
+ *
+ *  RCC_CSR bits 25..31 (RCC_RST_*) latch every reset source
+ *  until RMVF clears them, so read once at boot.
+ *============================================================*/
+uint32_t RCC_TakeResetFlags(void)
+{
+    uint32_t csr = RCC->CSR;
+    RCC->CSR |= RCC_CSR_RMVF;
+    return csr & 0xFE000000UL;
 }
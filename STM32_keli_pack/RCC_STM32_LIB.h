@@ -9,6 +9,20 @@
 #define RCC_BASE     0x40023800U
 
 void RCC_Enable_For_GPIO_ADC_SPI_DMA(void);
+
+/* Backup SRAM (4 KB): clock on, write-protect off, base address */
+void    *RCC_Enable_BackupSRAM(void);
+
+/* RCC_CSR reset flags since the last call (read, then cleared) */
+uint32_t RCC_TakeResetFlags(void);
+
+#define RCC_RST_BOR      (1UL << 25)   /* POR/PDR or brown-out     */
+#define RCC_RST_PIN      (1UL << 26)   /* NRST pin                 */
+#define RCC_RST_POR      (1UL << 27)   /* POR/PDR only             */
+#define RCC_RST_SFT      (1UL << 28)   /* NVIC_SystemReset         */
+#define RCC_RST_IWDG     (1UL << 29)   /* independent watchdog     */
+#define RCC_RST_WWDG     (1UL << 30)   /* window watchdog          */
+#define RCC_RST_LPWR     (1UL << 31)   /* low-power management     */
  
 /* =========================
  * RCC register map (reference manual)
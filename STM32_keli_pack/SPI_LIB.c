@@ -1,14 +1,54 @@
 #include "SPI_LIB.h"
+#include "board.h"
 
+/*
+ * TX bookkeeping.  With SPI_NSS_ALIGN (board.h Section 7) the
+ * producer only sets the pending buffer; the ISR latches it as
+ * the active one at the start of each transaction, so a frame
+ * never changes while the Pi is clocking it out.
+ */
 static volatile uint8_t  *g_tx = 0;
 static volatile uint16_t  g_len = 0;
 static volatile uint16_t  g_idx = 0;
+static volatile uint32_t  g_tx_count = 0;   /* frames started on MISO */
+
+#if SPI_NSS_ALIGN
+static volatile uint8_t  *g_pend_tx  = 0;
+static volatile uint16_t  g_pend_len = 0;
+static volatile uint8_t   g_latch    = 0;   /* next RXNE = byte 0 done */
+
+/* One-shot reply: replaces the pending frame for one transaction */
+static volatile uint8_t  *g_reply_tx  = 0;
+static volatile uint16_t  g_reply_len = 0;
+
+/* First CMD_LEN MOSI bytes of the transaction (board.h Section 7) */
+static uint8_t            g_rx[CMD_LEN];
+static volatile uint8_t   g_rx_n = 0;
+
+/* greenhouse.c: command received (EXTI4 context) */
+extern void Greenhouse_OnCommand(const uint8_t cmd[CMD_LEN]);
+#endif
 
 void SPI1_Slave_SetTxBuffer(volatile uint8_t *buf, uint16_t len)
 {
+#if SPI_NSS_ALIGN
+    g_pend_tx  = buf;
+    g_pend_len = len;
+#else
     g_tx = buf;
     g_len = len;
     g_idx = 0;
+#endif
+}
+
+void SPI1_Slave_SetReply(volatile uint8_t *buf, uint16_t len)
+{
+#if SPI_NSS_ALIGN
+    g_reply_tx  = buf;
+    g_reply_len = len;
+#else
+    SPI1_Slave_SetTxBuffer(buf, len);
+#endif
 }
 
 void SPI1_Slave_ResetIndex(void)
@@ -16,7 +56,18 @@ void SPI1_Slave_ResetIndex(void)
     g_idx = 0;
 }
 
-void SPI1_Slave_Init(void)
+volatile uint8_t *SPI1_Slave_GetActive(void)
+{
+    return g_tx;
+}
+
+uint32_t SPI1_Slave_GetTxCount(void)
+{
+    return g_tx_count;
+}
+
+/* slave, mode0, 8-bit, HW NSS (SSM=0), RXNE interrupt */
+static void spi1_config(void)
 {
     /* disable */
     SPI1->CR1 &= ~SPI_CR1_SPE;
@@ -27,10 +78,86 @@ void SPI1_Slave_Init(void)
     /* RXNE interrupt */
     SPI1->CR2 = SPI_CR2_RXNEIE;
 
-    NVIC_SetPriority(SPI1_IRQn, 2);
+    SPI1->CR1 |= SPI_CR1_SPE;
+}
+
+#if SPI_NSS_ALIGN
+/*
+ * Arm the next transaction: only called while NSS is high.
+ * RCC reset is the one way to drop the byte the last RXNE left
+ * in the TX path; then byte 0 of the pending frame goes into DR.
+ * Byte 0 is FRAME_MAGIC_0 in every frame, so it does not matter
+ * if a newer frame is published before the first RXNE latches.
+ */
+static void spi1_arm(void)
+{
+    RCC->APB2RSTR |=  RCC_APB2RSTR_SPI1RST;
+    RCC->APB2RSTR &= ~RCC_APB2RSTR_SPI1RST;
+    spi1_config();
+
+    g_idx   = 0;
+    g_latch = 1;
+    g_rx_n  = 0;
+    if (g_pend_tx && g_pend_len)
+    {
+        SPI1->DR = g_pend_tx[0];
+        g_idx = 1;
+    }
+}
+
+/*
+ * EXTI4 on PA4 (NSS), rising edge only = transaction finished.
+ * Unlike the old falling-edge preload (README: all-0xAA bug)
+ * nothing is touched unless NSS really is high and the SPI is
+ * idle, so a glitch between bytes is ignored.  A transaction
+ * that opened with CMD_MAGIC hands its first CMD_LEN MOSI
+ * bytes to greenhouse.c before the re-arm.
+ */
+static void nss_exti_init(void)
+{
+    SYSCFG->EXTICR[1] &= ~SYSCFG_EXTICR2_EXTI4;   /* EXTI4 <- PA4 */
+    SYSCFG->EXTICR[1] |=  SYSCFG_EXTICR2_EXTI4_PA;
+    EXTI->FTSR &= ~EXTI_FTSR_TR4;
+    EXTI->RTSR |=  EXTI_RTSR_TR4;
+    EXTI->PR    =  EXTI_PR_PR4;
+    EXTI->IMR  |=  EXTI_IMR_MR4;
+
+    /* same level as SPI1: never splits an RXNE refill */
+    NVIC_SetPriority(EXTI4_IRQn, IRQ_PRIO_SPI);
+    NVIC_EnableIRQ(EXTI4_IRQn);
+}
+
+void EXTI4_IRQHandler(void)
+{
+    EXTI->PR = EXTI_PR_PR4;
+
+    if ((GPIOA->IDR & (1U << PIN_SPI_NSS)) && !(SPI1->SR & SPI_SR_BSY))
+    {
+        if (g_rx_n == CMD_LEN && g_rx[0] == CMD_MAGIC)
+            Greenhouse_OnCommand(g_rx);
+        spi1_arm();
+    }
+}
+#else
+/* Pending bit from an older firmware image must not Hard Fault */
+void EXTI4_IRQHandler(void)
+{
+    EXTI->PR = EXTI_PR_PR4;
+}
+#endif
+
+void SPI1_Slave_Init(void)
+{
+    NVIC_SetPriority(SPI1_IRQn, IRQ_PRIO_SPI);
     NVIC_EnableIRQ(SPI1_IRQn);
 
-    SPI1->CR1 |= SPI_CR1_SPE;
+#if SPI_NSS_ALIGN
+    /* NSS is high at boot (Pi idle): arm the first frame now */
+    spi1_arm();
+    nss_exti_init();
+#else
+    spi1_config();
+#endif
 }
 
 /* master clock -> RXNE set -> read DR -> write next byte */
@@ -38,14 +165,41 @@ void SPI1_IRQHandler(void)
 {
     if (SPI1->SR & SPI_SR_RXNE)
     {
-        volatile uint8_t dummy = (uint8_t)SPI1->DR;
-        (void)dummy;
+        uint8_t rx = (uint8_t)SPI1->DR;
+
+#if SPI_NSS_ALIGN
+        if (g_rx_n < CMD_LEN)
+            g_rx[g_rx_n++] = rx;
 
+        /* first byte of a transaction done: take the reply, if
+         * one is waiting, else the newest frame */
+        if (g_latch)
+        {
+            g_latch = 0;
+            if (g_reply_tx)
+            {
+                g_tx  = g_reply_tx;
+                g_len = g_reply_len;
+                g_reply_tx = 0;
+            }
+            else
+            {
+                g_tx  = g_pend_tx;
+                g_len = g_pend_len;
+            }
+            g_tx_count++;
+        }
+#else
+        (void)rx;
+#endif
         if (g_tx && g_len)
         {
             /* wait TXE just in case */
             if (SPI1->SR & SPI_SR_TXE)
             {
+#if !SPI_NSS_ALIGN
+                if (g_idx == 0) g_tx_count++;   /* byte 0 queued */
+#endif
                 SPI1->DR = g_tx[g_idx++];
                 if (g_idx >= g_len) g_idx = 0;
             }
@@ -31,4 +31,20 @@ void SPI1_Slave_Init(void);
 /* link v?i greenhouse packet */
 void SPI1_Slave_SetTxBuffer(volatile uint8_t *buf, uint16_t len);
 void SPI1_Slave_ResetIndex(void);
+
+/* One-shot reply to a MOSI command (board.h Section 7): sent
+ * by the next transaction only, then SetTxBuffer()'s frame
+ * again.  Commands themselves arrive through
+ * Greenhouse_OnCommand() from the EXTI4 (NSS rise) ISR. */
+void SPI1_Slave_SetReply(volatile uint8_t *buf, uint16_t len);
+
+/* Buffer the current transaction is clocking out (SPI_NSS_ALIGN):
+ * producers must not rewrite it, nor the one last passed to
+ * SPI1_Slave_SetTxBuffer(). */
+volatile uint8_t *SPI1_Slave_GetActive(void);
+
+/* Frames that started going out: with SPI_NSS_ALIGN one per
+ * transaction (first-byte latch), otherwise one per byte 0
+ * queued.  Consumers compare it to spot "the Pi read a frame". */
+uint32_t SPI1_Slave_GetTxCount(void);
 #endif /* _SPI_H_ */
\ No newline at end of file
@@ -6,16 +6,21 @@
  *
  *  Buzzer dùng GPIO push-pull (PB0), không phải PWM.
  *  Pattern beep được tạo bằng software timer:
- *    - Actuator_SetState() set target (gọi từ DMA IRQ)
+ *    - Actuator_SetState() set target (gọi từ ALARM task)
  *    - Actuator_Tick1ms()  chạy pattern (gọi từ SysTick 1ms)
  *
  *  Motor dùng GPIO push-pull (PB1), ON/OFF theo state.
  *
  *  Dùng BSRR thay vì ODR để atomic set/reset (an toàn ISR).
+ *
+ *  Actuator_Emergency(1) chạy trong ADC watchdog IRQ (prio 0)
+ *  và có thể chen vào giữa Actuator_SetState(), nên SetState
+ *  mask IRQ khi đọc g_emerg và ghi g_state.
  *============================================================*/
 
 static FireState g_state = FIRE_STATE_NORMAL;
 static uint16_t  g_tick  = 0;   /* ms counter cho buzzer pattern */
+static volatile uint8_t g_emerg = 0;   /* watchdog: giữ ALARM    */
 
 /* ═══════════ Low-level GPIO ═══════════ */
 
@@ -54,6 +59,7 @@ void Actuator_Init(void)
 {
     g_state = FIRE_STATE_NORMAL;
     g_tick  = 0;
+    g_emerg = 0;
     Buzzer_Set(0);
     Motor_Set(0);
 }
@@ -61,16 +67,41 @@ void Actuator_Init(void)
 /*------------------------------------------------------------
  *  Actuator_SetState – Cập nhật target state
  *
- *  Gọi từ Greenhouse_OnAdcReady() (DMA IRQ context).
+ *  Gọi từ ALARM task (greenhouse.c, thread context).
  *  Khi state đổi → reset tick counter để pattern bắt đầu lại.
+ *  Trong emergency: luôn ALARM, fire_logic không hạ được.
  *------------------------------------------------------------*/
 void Actuator_SetState(FireState st)
 {
+    __disable_irq();
+    if (g_emerg)
+        st = FIRE_STATE_ALARM;
     if (st != g_state)
     {
         g_state = st;
         g_tick  = 0;    /* reset pattern timing khi đổi state */
     }
+    __enable_irq();
+}
+
+/*------------------------------------------------------------
+ *  Actuator_Emergency – Analog watchdog fast path
+ *
+ *  on=1: ADC_IRQHandler → Awd_OnTrip() (prio 0).  Motor và
+ *  buzzer bật ngay, không chờ SysTick; pattern ALARM bắt đầu
+ *  từ tick tiếp theo (g_tick = 0 → buzzer ON 50 ms đầu).
+ *  on=0: ALARM task (Awd_Task) — lần SetState sau quyết định.
+ *------------------------------------------------------------*/
+void Actuator_Emergency(uint8_t on)
+{
+    if (on)
+    {
+        Motor_Set(1);
+        Buzzer_Set(1);
+        g_state = FIRE_STATE_ALARM;
+        g_tick  = 0;
+    }
+    g_emerg = on;
 }
 
 /*------------------------------------------------------------
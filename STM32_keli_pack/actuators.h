@@ -27,6 +27,11 @@ void    Actuator_Init(void);
 /* Set target state (gọi từ greenhouse logic trong DMA IRQ) */
 void    Actuator_SetState(FireState st);
 
+/* Emergency (analog watchdog, awd.c): on=1 bật motor + buzzer
+ * ngay bằng BSRR và giữ state ALARM; on=0 trả lại cho
+ * Actuator_SetState() */
+void    Actuator_Emergency(uint8_t on);
+
 /* Tick 1ms (gọi từ SysTick_Handler → chạy pattern beep) */
 void    Actuator_Tick1ms(void);
 
@@ -1,7 +1,8 @@
 #include "adc_mgr.h"
+#include "cal_lut.h"
 
 /*============================================================
- *  adc_mgr.c  B? l?c Moving-Average cho 4 knh ADC
+ *  adc_mgr.c  B? l?c Moving-Average cho N knh ADC
  *
  *  M?i knh luu ADC_FILTER_SAMPLES (m?c d?nh 8) m?u g?n nh?t
  *  trong ring buffer. GetFiltered() tr? trung bnh c?ng ?
@@ -11,47 +12,87 @@
  *    - Duy tr t?ng tch lu? (g_sum[ch])
  *    - Khi thm m?u m?i: sum -= m?u_cu, sum += m?u_m?i
  *    - GetFiltered() = sum / N  (khng c?n duy?t l?i)
+ *
+ *  Layout (board.h Section 4): the ring is [sample][pair],
+ *  channels 2p / 2p+1 in the low / high halfword of one word,
+ *  so a scan is one contiguous row (8 bytes for N = 4).  The
+ *  sums use the same packing; a window sum fits 16 bits, so
+ *  lane arithmetic modulo 2^16 is exact and one USUB16 +
+ *  UADD16 updates two channels.  An odd last channel has its
+ *  high lane 0 in the ring, so that sum lane stays 0 too.
  *============================================================*/
 
-/* Ring buffer: [channel][sample_index] */
-static uint16_t g_ring[ADC_NUM_CHANNELS][ADC_FILTER_SAMPLES];
+#define ADC_MGR_PAIRS   ((ADC_NUM_CHANNELS + 1U) / 2U)
+
+/* Ring buffer: [sample_index][channel pair] */
+static uint32_t g_ring[ADC_FILTER_SAMPLES][ADC_MGR_PAIRS];
 static uint8_t  g_idx    = 0;    /* ch? s? hi?n t?i trong ring     */
 static uint8_t  g_filled = 0;    /* =1 khi ring d d?y = 1 vng   */
 
-/* T?ng tch lu? cho t?ng knh (trnh tnh l?i m?i l?n d?c) */
-static uint32_t g_sum[ADC_NUM_CHANNELS];
+/* T?ng tch lu?, 2 knh / word (trnh tnh l?i m?i l?n d?c) */
+static uint32_t g_sum[ADC_MGR_PAIRS];
+
+/* Channel ch out of a pair-packed array */
+#define LANE(w, ch)   ((uint16_t)((w)[(ch) >> 1] >> (((ch) & 1U) * 16U)))
+
+#if ADC_MGR_SIMD && defined(__CORTEX_M) && (__CORTEX_M >= 4U)
+/* Cortex-M4 DSP (CMSIS intrinsics), one cycle each */
+#define PACK2(lo, hi)         __PKHBT((lo), (hi), 16)
+#define SUM2(s, old, nw)      __UADD16(__USUB16((s), (old)), (nw))
+#else
+/* Portable: same modulo-2^16 lanes in plain C (host HIL build) */
+#define PACK2(lo, hi)         ((uint32_t)(lo) | ((uint32_t)(hi) << 16))
+#define SUM2(s, old, nw)      sum2_c((s), (old), (nw))
+
+static uint32_t sum2_c(uint32_t s, uint32_t old, uint32_t nw)
+{
+    uint32_t lo = (s - old + nw) & 0xFFFFU;
+    uint32_t hi = ((s >> 16) - (old >> 16) + (nw >> 16)) & 0xFFFFU;
+    return lo | (hi << 16);
+}
+#endif
 
 /*------------------------------------------------------------
  *  ADC_Mgr_Init  Reset ton b? ring buffer & t?ng
  *------------------------------------------------------------*/
 void ADC_Mgr_Init(void)
 {
-    uint8_t ch, s;
-    for (ch = 0; ch < ADC_NUM_CHANNELS; ch++)
+    uint8_t p, s;
+    for (p = 0; p < ADC_MGR_PAIRS; p++)
     {
-        g_sum[ch] = 0;
+        g_sum[p] = 0;
         for (s = 0; s < ADC_FILTER_SAMPLES; s++)
-            g_ring[ch][s] = 0;
+            g_ring[s][p] = 0;
     }
     g_idx    = 0;
     g_filled = 0;
 }
 
 /*------------------------------------------------------------
- *  ADC_Mgr_FeedSample  ?y 4 m?u ADC m?i vo ring buffer
+ *  ADC_Mgr_FeedSample  ?y N m?u ADC m?i vo ring buffer
  *
- *  G?i t? DMA2 Stream0 TC IRQ (qua Greenhouse_OnAdcReady).
+ *  G?i t? SAMPLE task (greenhouse.c) v?i scan d latch.
  *  C?p nh?t O(1): tr? m?u cu nh?t, c?ng m?u m?i.
+ *  Two channels per step: PKHBT packs the new pair, USUB16 /
+ *  UADD16 swap the oldest pair for it in both sum lanes.
  *------------------------------------------------------------*/
 void ADC_Mgr_FeedSample(const volatile uint16_t raw[ADC_NUM_CHANNELS])
 {
-    uint8_t ch;
-    for (ch = 0; ch < ADC_NUM_CHANNELS; ch++)
+    uint32_t *row = g_ring[g_idx];  /* oldest scan, overwritten */
+    uint32_t  nw;
+    uint8_t   p;
+
+    for (p = 0; p < ADC_NUM_CHANNELS / 2U; p++)
     {
-        g_sum[ch]          -= g_ring[ch][g_idx];   /* tr? m?u cu */
-        g_ring[ch][g_idx]   = raw[ch];              /* ghi m?u m?i */
-        g_sum[ch]          += raw[ch];              /* c?ng m?u m?i */
+        nw       = PACK2(raw[2U * p], raw[2U * p + 1U]);
+        g_sum[p] = SUM2(g_sum[p], row[p], nw);
+        row[p]   = nw;
     }
+#if (ADC_NUM_CHANNELS & 1)
+    nw       = raw[ADC_NUM_CHANNELS - 1U];
+    g_sum[p] = SUM2(g_sum[p], row[p], nw);
+    row[p]   = nw;
+#endif
 
     g_idx++;
     if (g_idx >= ADC_FILTER_SAMPLES)
@@ -71,24 +112,19 @@ uint16_t ADC_Mgr_GetFiltered(uint8_t ch)
     uint8_t n;
     if (ch >= ADC_NUM_CHANNELS) return 0;
     n = g_filled ? ADC_FILTER_SAMPLES : (g_idx ? g_idx : 1);
-    return (uint16_t)(g_sum[ch] / n);
+    return (uint16_t)(LANE(g_sum, ch) / n);
 }
 
 /*------------------------------------------------------------
- *  ADC_Mgr_GetTempX10  Nhi?t d? LM35 (don v? 0.1C)
- *
- *  Cng th?c:
- *    voltage_mV = adc_filtered  3300 / 4095
- *    temp_x10   = voltage_mV
+ *  ADC_Mgr_GetTempX10  LM35 temperature (unit 0.1C)
  *
- *  Gi?i thch: LM35 = 10 mV/C ? 1 mV = 0.1C
- *  Nn gi tr? mV chnh l nhi?t d?  10.
- *  V d?: ADC = 620 ? 6203300/4095  499 mV ? 49.9C
+ *  One flash load: g_cal_lut[ADC_IDX_LM35] holds the two-point
+ *  calibrated temp_x10 for every raw code (cal_lut.c, default
+ *  raw  3300 / 4095 rounded, i.e. 10 mV/C on 3.3 V Vref).
  *------------------------------------------------------------*/
 uint16_t ADC_Mgr_GetTempX10(void)
 {
-    uint32_t raw = ADC_Mgr_GetFiltered(ADC_IDX_LM35);
-    return (uint16_t)((raw * ADC_VREF_MV) / ADC_RESOLUTION);
+    return g_cal_lut[ADC_IDX_LM35][ADC_Mgr_GetFiltered(ADC_IDX_LM35)];
 }
 
 /*------------------------------------------------------------
@@ -98,3 +134,65 @@ uint16_t ADC_Mgr_GetGasRaw(void)
 {
     return ADC_Mgr_GetFiltered(ADC_IDX_GAS);
 }
+
+/*------------------------------------------------------------
+ *  ADC_Mgr_GetEng  Calibrated value of channel ch
+ *
+ *  g_cal_lut[ch][filtered] in the channel's table units
+ *  (cal_lut.h lists unit and scale per slot).  The Pi applies
+ *  the same tables to the raw samples in the SPI frame.
+ *------------------------------------------------------------*/
+uint16_t ADC_Mgr_GetEng(uint8_t ch)
+{
+    if (ch >= ADC_NUM_CHANNELS) return 0;
+    return g_cal_lut[ch][ADC_Mgr_GetFiltered(ch)];
+}
+
+/*------------------------------------------------------------
+ *  ADC_Mgr_Export  Snapshot of the ring for warm start
+ *------------------------------------------------------------*/
+void ADC_Mgr_Export(AdcMgrSnapshot *out)
+{
+    uint8_t p, s;
+    for (s = 0; s < ADC_FILTER_SAMPLES; s++)
+        for (p = 0; p < ADC_MGR_PAIRS; p++)
+            out->ring[s][p] = g_ring[s][p];
+    out->idx    = g_idx;
+    out->filled = g_filled;
+}
+
+/*------------------------------------------------------------
+ *  ADC_Mgr_Import  Restore a ring saved before a reset
+ *
+ *  Every field is range-checked before anything is touched
+ *  (12-bit lanes, unused high lane of an odd N zero), then
+ *  g_sum[] is rebuilt so GetFiltered() is exact at once.
+ *------------------------------------------------------------*/
+uint8_t ADC_Mgr_Import(const AdcMgrSnapshot *in)
+{
+    uint8_t p, s;
+
+    if (in->idx >= ADC_FILTER_SAMPLES || in->filled > 1U) return 0;
+    for (s = 0; s < ADC_FILTER_SAMPLES; s++)
+    {
+        for (p = 0; p < ADC_MGR_PAIRS; p++)
+            if ((in->ring[s][p] & 0xF000F000UL) != 0) return 0;
+#if (ADC_NUM_CHANNELS & 1)
+        if ((in->ring[s][ADC_MGR_PAIRS - 1U] >> 16) != 0) return 0;
+#endif
+    }
+
+    for (p = 0; p < ADC_MGR_PAIRS; p++)
+        g_sum[p] = 0;
+    for (s = 0; s < ADC_FILTER_SAMPLES; s++)
+    {
+        for (p = 0; p < ADC_MGR_PAIRS; p++)
+        {
+            g_ring[s][p] = in->ring[s][p];
+            g_sum[p]    += in->ring[s][p];  /* lanes never carry */
+        }
+    }
+    g_idx    = in->idx;
+    g_filled = in->filled;
+    return 1;
+}
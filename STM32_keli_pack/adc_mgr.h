@@ -12,17 +12,17 @@
  *  d?c gi tr? d l?c + tnh nhi?t d? LM35.
  *
  *  Lu?ng:
- *    DMA TC IRQ ? ADC_Mgr_FeedSample(g_adc_buf)
+ *    SAMPLE task ? ADC_Mgr_FeedSample(scan)
  *               ? GetFiltered() / GetTempX10() / GetGasRaw()
  *============================================================*/
 
 /* Kh?i t?o b? l?c, reset ring buffer */
 void     ADC_Mgr_Init(void);
 
-/* ?y 4 m?u ADC th m?i vo ring buffer (g?i t? DMA TC IRQ) */
+/* ?y N m?u ADC th m?i vo ring buffer (g?i t? SAMPLE task) */
 void     ADC_Mgr_FeedSample(const volatile uint16_t raw[ADC_NUM_CHANNELS]);
 
-/* Tr? gi tr? ADC trung bnh (d l?c) cho knh ch (0..3) */
+/* Tr? gi tr? ADC trung bnh (d l?c) cho knh ch (0..N-1) */
 uint16_t ADC_Mgr_GetFiltered(uint8_t ch);
 
 /* Tr? nhi?t d? LM35  10 (don v? 0.1C), v d? 325 = 32.5C */
@@ -31,4 +31,24 @@ uint16_t ADC_Mgr_GetTempX10(void);
 /* Tr? gas ADC (d l?c) */
 uint16_t ADC_Mgr_GetGasRaw(void);
 
+/* Calibrated value of channel ch (cal_lut.h units), one LUT load */
+uint16_t ADC_Mgr_GetEng(uint8_t ch);
+
+/* Filter state for warm start (warm_start.c keeps it in backup SRAM) */
+/* ring is adc_mgr.c's own [sample][channel pair] layout:
+ * channel 2p in the low halfword of ring[s][p], 2p+1 high   */
+typedef struct {
+    uint32_t ring[ADC_FILTER_SAMPLES][(ADC_NUM_CHANNELS + 1U) / 2U];
+    uint8_t  idx;
+    uint8_t  filled;
+} AdcMgrSnapshot;
+
+/* Copy the ring out.  Call from a scheduler task (WARM):
+ * tasks run to completion one at a time, so SAMPLE cannot
+ * feed a scan mid-copy and no IRQ masking is needed.       */
+void     ADC_Mgr_Export(AdcMgrSnapshot *out);
+
+/* Load a saved ring and rebuild the sums; 0 = rejected */
+uint8_t  ADC_Mgr_Import(const AdcMgrSnapshot *in);
+
 #endif /* _ADC_MGR_H_ */
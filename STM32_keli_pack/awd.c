@@ -0,0 +1,119 @@
+#include "awd.h"
+#include "DMA_LIB.h"        /* ADC1_Awd_Guard / ADC1_Awd_Arm    */
+#include "actuators.h"      /* Actuator_Emergency()             */
+
+/*============================================================
+ *  awd.c – Emergency fast path on the ADC analog watchdog
+ *
+ *  Contexts:
+ *    Awd_OnTrip  ADC IRQ, priority 0 (preempts everything)
+ *    Awd_OnScan  DMA TC IRQ, priority 1
+ *    Awd_Task    ALARM task, thread mode
+ *
+ *  The IRQ is disabled by the handler itself and only
+ *  re-enabled by Awd_Task() after s_active is cleared, so
+ *  while s_active is set nothing else writes the state below.
+ *============================================================*/
+
+#if AWD_ENABLE
+
+typedef struct { uint8_t idx; uint16_t high; } AwdGuard;
+
+/* Guarded inputs, round-robin one per scan (§12) */
+static const AwdGuard k_guard[] = {
+    { ADC_IDX_GAS,  AWD_GAS_ADC  },
+    { ADC_IDX_LM35, AWD_TEMP_ADC },
+};
+#define AWD_NGUARD  (sizeof(k_guard) / sizeof(k_guard[0]))
+
+static uint8_t           s_cur    = 0;  /* guard now in HTR/AWDCH   */
+static volatile uint8_t  s_active = 0;  /* emergency latched        */
+static volatile uint8_t  s_new    = 0;  /* trip not published yet   */
+static uint16_t          s_hold   = 0;  /* ALARM runs left to hold  */
+static volatile uint16_t s_trips  = 0;
+
+/* Hardware starts with HTR at full scale (nothing guarded);
+ * the first DMA TC moves the watchdog onto k_guard[0].      */
+void Awd_Init(void)
+{
+    s_cur    = (uint8_t)(AWD_NGUARD - 1U);
+    s_active = 0;
+    s_new    = 0;
+    s_hold   = 0;
+    s_trips  = 0;
+}
+
+/*------------------------------------------------------------
+ *  Awd_OnScan – DMA TC IRQ, every scan
+ *
+ *  The guard set here applies from the conversions the ADC is
+ *  doing right now on, i.e. to the scan after this TC.
+ *------------------------------------------------------------*/
+uint8_t Awd_OnScan(void)
+{
+    if (s_new)
+    {
+        s_new = 0;
+        return 1;
+    }
+    if (!s_active)
+    {
+        s_cur = (uint8_t)((s_cur + 1U) % AWD_NGUARD);
+        ADC1_Awd_Guard(k_guard[s_cur].idx, k_guard[s_cur].high);
+    }
+    return 0;
+}
+
+/*------------------------------------------------------------
+ *  Awd_OnTrip – ADC_IRQHandler, AWD flag already cleared
+ *------------------------------------------------------------*/
+void Awd_OnTrip(void)
+{
+    Actuator_Emergency(1);              /* motor + buzzer now       */
+    s_active = 1;
+    s_new    = 1;
+    s_hold   = (uint16_t)(AWD_HOLD_MS / SCHED_ALARM_MS);
+    s_trips++;
+}
+
+/*------------------------------------------------------------
+ *  Awd_Task – ALARM task, every SCHED_ALARM_MS
+ *
+ *  Release needs both filtered inputs back under the §5
+ *  ALARM_OFF levels, whichever input tripped: the DMA ISR may
+ *  have moved the guard between the trip and this task.
+ *------------------------------------------------------------*/
+void Awd_Task(uint16_t temp_x10, uint16_t gas_raw)
+{
+    if (!s_active)
+        return;
+    if (s_hold > 0)
+    {
+        s_hold--;
+        return;
+    }
+    if (temp_x10 > TEMP_ALARM_OFF_X10 || gas_raw > GAS_ALARM_OFF_ADC)
+        return;
+
+    s_active = 0;
+    Actuator_Emergency(0);
+    ADC1_Awd_Arm();
+}
+
+uint8_t  Awd_IsActive(void) { return s_active; }
+uint16_t Awd_GetTrips(void) { return s_trips; }
+
+#else  /* !AWD_ENABLE: watchdog never configured, fire_logic only */
+
+void     Awd_Init(void)                                   { }
+uint8_t  Awd_OnScan(void)                                 { return 0; }
+void     Awd_OnTrip(void)                                 { }
+void     Awd_Task(uint16_t temp_x10, uint16_t gas_raw)
+{
+    (void)temp_x10;
+    (void)gas_raw;
+}
+uint8_t  Awd_IsActive(void)                               { return 0; }
+uint16_t Awd_GetTrips(void)                               { return 0; }
+
+#endif /* AWD_ENABLE */
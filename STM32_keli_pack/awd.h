@@ -0,0 +1,40 @@
+#ifndef _AWD_H_
+#define _AWD_H_
+
+#include <stdint.h>
+#include "board.h"
+
+/*============================================================
+ *  awd – Analog-watchdog emergency fast path (board.h §12)
+ *
+ *  A raw conversion over AWD_GAS_ADC / AWD_TEMP_ADC trips the
+ *  ADC watchdog; motor and buzzer go on inside that IRQ, ahead
+ *  of the moving average and the ALARM task period.
+ *
+ *  Flow:
+ *    ADC_IRQHandler  → Awd_OnTrip()        (prio 0, one-shot)
+ *    DMA TC IRQ      → Awd_OnScan()        (next guarded input)
+ *    ALARM task      → Awd_Task()          (release + re-arm)
+ *============================================================*/
+
+/* Emergency off; the first scan guards the first input */
+void     Awd_Init(void);
+
+/* DMA TC IRQ: move the watchdog to the next guarded input.
+ * Returns 1 once after a trip, so the caller publishes it. */
+uint8_t  Awd_OnScan(void);
+
+/* ADC_IRQHandler: watchdog fired (IRQ already disabled) */
+void     Awd_OnTrip(void);
+
+/* ALARM task: filtered inputs of fire_logic; releases the
+ * emergency after AWD_HOLD_MS once both are below ALARM_OFF */
+void     Awd_Task(uint16_t temp_x10, uint16_t gas_raw);
+
+/* STATUS bit 5 */
+uint8_t  Awd_IsActive(void);
+
+/* Trips since Awd_Init() */
+uint16_t Awd_GetTrips(void);
+
+#endif /* _AWD_H_ */
@@ -13,7 +13,7 @@
  *║  Every magic number, pin assignment, threshold, and SPI   ║
  *║  protocol constant lives HERE.  The Python GUI on the     ║
  *║  Raspberry Pi mirrors these values — change here first,   ║
- *║  then update gui_spi_greenhouse.py to match.              ║
+ *║  then update greenhouse_protocol.py to match.             ║
  *║                                                           ║
  *║  Sections:                                                ║
  *║   1. System Clock                                         ║
@@ -24,6 +24,11 @@
  *║   6. Buzzer Beep Patterns                                 ║
  *║   7. SPI Protocol Specification  ← SHARED WITH PYTHON    ║
  *║   8. NVIC Interrupt Priorities                            ║
+ *║   9. Warm Start (backup SRAM)                             ║
+ *║  10. Data-Ready / Alarm Line to the Pi                    ║
+ *║  11. Task Scheduler                                       ║
+ *║  12. Analog Watchdog (emergency fast path)                ║
+ *║  13. Waveform Capture (raw scans at full ADC rate)        ║
  *╚═══════════════════════════════════════════════════════════╝*/
 
 /* ╔═══════════════════════════════════════════════════════╗
@@ -50,6 +55,7 @@
  * ║  PA7  │ SPI1_MOSI (AF5) │ SPI1        │ Pi → STM32    ║
  * ║  PB0  │ GPIO OUT PP     │ —           │ Buzzer        ║
  * ║  PB1  │ GPIO OUT PP     │ —           │ Motor / Fan   ║
+ * ║  PB2  │ GPIO OUT PP     │ —           │ DRDY → Pi     ║
  * ╚═══════════════════════════════════════════════════════╝
  *
  * Raspberry Pi 4 SPI0 wiring:
@@ -57,6 +63,7 @@
  *   GPIO11 (SCLK) ↔ PA5 (SCK)     3.3V logic, direct connect
  *   GPIO9  (MISO) ↔ PA6 (MISO)    3.3V logic, direct connect
  *   GPIO10 (MOSI) ↔ PA7 (MOSI)    3.3V logic, direct connect
+ *   GPIO25        ↔ PB2 (DRDY)    Pi input, rising edge (§10)
  *   GND           ↔ GND           common ground REQUIRED
  */
 
@@ -71,6 +78,7 @@
 #define PIN_SPI_MOSI          7U   /* PA7 */
 #define PIN_BUZZER            0U   /* PB0 */
 #define PIN_MOTOR             1U   /* PB1 */
+#define PIN_DRDY              2U   /* PB2 */
 
 /* SPI1 Alternate Function index on STM32F411 */
 #define SPI1_AF               5U   /* AF5 for PA4-PA7 */
@@ -79,7 +87,14 @@
  * ║  3. ADC CHANNEL MAP & CONVERSION                      ║
  * ╚═══════════════════════════════════════════════════════╝*/
 
+/* Number of scanned channels = length of ADC_SCAN_TABLE below.
+ * ADC1 supports a regular sequence of up to 16 conversions.   */
 #define ADC_NUM_CHANNELS      4
+#define ADC_MAX_CHANNELS      16
+
+#if (ADC_NUM_CHANNELS < 1) || (ADC_NUM_CHANNELS > ADC_MAX_CHANNELS)
+#error "ADC_NUM_CHANNELS must be 1..16 (ADC1 regular sequence length)"
+#endif
 
 /* Index into g_adc_buf[] (DMA scan sequence order) */
 #define ADC_IDX_LM35          0
@@ -93,6 +108,23 @@
 #define ADC_CH_S3             2    /* PA2 = IN2 */
 #define ADC_CH_S4             3    /* PA3 = IN3 */
 
+/* Scan table — ADC1 input (INx) for each sequence slot, in
+ * conversion order.  Slot k lands in g_adc_buf[k] and in
+ * payload sample k of the SPI frame.
+ *
+ *   IN0–IN3   → PA0–PA3      free analog pins
+ *   IN4–IN7   → PA4–PA7      TAKEN by SPI1 — do not list
+ *   IN8–IN9   → PB0–PB1      TAKEN by buzzer / motor
+ *   IN10–IN15 → PC0–PC5      free analog pins
+ *   IN16/17/18               internal (temp sensor / Vrefint / Vbat)
+ *
+ * Example 10-channel node:
+ *   { ADC_CH_LM35, ADC_CH_GAS, ADC_CH_S3, ADC_CH_S4,
+ *     10, 11, 12, 13, 14, 15 }      + ADC_NUM_CHANNELS = 10
+ */
+#define ADC_SCAN_TABLE        { ADC_CH_LM35, ADC_CH_GAS, \
+                                ADC_CH_S3,   ADC_CH_S4 }
+
 /* ADC sample time selection (written to SMPR2)
  * STM32F411 options:  0→3cy  1→15cy  2→28cy  3→56cy
  *                     4→84cy 5→112cy 6→144cy 7→480cy
@@ -100,6 +132,50 @@
  */
 #define ADC_SAMPLE_TIME_SEL   4U   /* 84 cycles per channel   */
 
+/* Scan timing: ADCCLK = PCLK2 / 2 (ADC_DMA_LIB.c, ADCPRE = 00)
+ * and one conversion = sample time + 12 ADCCLK cycles.
+ *   N = 4, 84 cy → 4 × 96 / 8 MHz = 48 µs to convert a scan
+ *
+ * Scan trigger.  ADC_TRIG_TIMER = 1: TIM2's update event (TRGO)
+ * starts each scan every ADC_SCAN_TICKS system clocks.  The
+ * rate no longer drifts with N or the sample time, and a §4
+ * mains window holds a whole number of scans.  0: continuous
+ * conversion, each scan right after the previous one
+ * (ADC_CONV_NS apart, ~20.8 kHz for N = 4).
+ *
+ * ADC_SCAN_TICKS is the shortest period of 50 / 100 / 250 /
+ * 500 µs that the scan fits in; each gives whole 50 Hz and
+ * 60 Hz windows with a multiple of 4 scans.
+ *   N = 4  →  800 ticks, 50 µs per scan (20 kHz), idles 2 µs
+ *   N = 8  → 1600 ticks, 100 µs (10 kHz)
+ *   N = 16 → 4000 ticks, 250 µs (4 kHz)                      */
+#define ADC_TRIG_TIMER        1
+#define ADC_SCAN_TICKS        (ADC_CONV_NS <  50000UL ?  800U : \
+                               ADC_CONV_NS < 100000UL ? 1600U : \
+                               ADC_CONV_NS < 250000UL ? 4000U : 8000U)
+#define ADC_CLOCK_HZ          (SYS_CLOCK_HZ / 2U)
+#define ADC_SAMPLE_CYCLES     ((ADC_SAMPLE_TIME_SEL) == 0U ?   3U : \
+                               (ADC_SAMPLE_TIME_SEL) == 1U ?  15U : \
+                               (ADC_SAMPLE_TIME_SEL) == 2U ?  28U : \
+                               (ADC_SAMPLE_TIME_SEL) == 3U ?  56U : \
+                               (ADC_SAMPLE_TIME_SEL) == 4U ?  84U : \
+                               (ADC_SAMPLE_TIME_SEL) == 5U ? 112U : \
+                               (ADC_SAMPLE_TIME_SEL) == 6U ? 144U : 480U)
+#define ADC_CONV_NS           (ADC_NUM_CHANNELS * (ADC_SAMPLE_CYCLES + 12UL) \
+                               * 1000UL / (ADC_CLOCK_HZ / 1000000UL))
+#define ADC_SCAN_RATE_HZ      (SYS_CLOCK_HZ / ADC_SCAN_TICKS)
+#define ADC_SCAN_NS           (ADC_TRIG_TIMER ? ADC_SCAN_TICKS * 1000UL \
+                               / (SYS_CLOCK_HZ / 1000000UL) : ADC_CONV_NS)
+
+#if ADC_TRIG_TIMER && \
+    (ADC_CONV_NS * (SYS_CLOCK_HZ / 1000000UL) >= ADC_SCAN_TICKS * 1000UL)
+#error "ADC_SCAN_TICKS must be longer than one scan conversion (ADC_CONV_NS)"
+#endif
+
+/* ADON → first SWSTART.  tSTAB is 3 µs max (F411 datasheet);
+ * TIM11 one-pulse mode times it, so boot does not spin.     */
+#define ADC_STAB_US           10U
+
 /* LM35 temperature conversion:
  *   voltage_mV = adc_raw × Vref_mV / (2^12 - 1)
  *   LM35: 10 mV/°C → 1 mV = 0.1°C → voltage_mV = temp_x10
@@ -108,13 +184,130 @@
 #define ADC_VREF_MV           3300U
 #define ADC_RESOLUTION        4095U  /* 12-bit: 2^12 - 1       */
 
+/* Calibration — one const uint16_t table of ADC_RESOLUTION + 1
+ * entries per slot in cal_lut.c (8 KB flash each), so any
+ * engineering value is g_cal_lut[ch][raw], a single load.
+ *   slot 0  LM35   two-point offset/gain   → 0.1 °C
+ *   slot 1  MQ-2   Rs/R0 power-law curve    → ppm
+ *   slot 2  soil   two-point dry/wet        → 0.1 %
+ *   slot 3  light  two-point                → 0.1 %
+ * cal_lut.c/.h are GENERATED from CAL_CHANNELS in
+ * gui_spi_greenhouse.py (--gen-cal-lut --channels N); the Pi
+ * builds the same tables, and CAL_LUT_CRC32 lets it detect a
+ * stale firmware table.  Alarm thresholds (§5) stay in raw /
+ * temp_x10 units.
+ */
+
 /* ╔═══════════════════════════════════════════════════════╗
  * ║  4. ADC FILTER                                        ║
  * ╚═══════════════════════════════════════════════════════╝
  * Moving-average window size.  Larger → smoother but slower.
  * 8 is a good balance for analog sensor noise.
+ *
+ * adc_mgr.c keeps the ring as [sample][channel] with two
+ * channels per 32-bit word, and each channel sum in a 16-bit
+ * lane, so one scan is a contiguous row and a pair of sums
+ * is updated by one USUB16 + UADD16 (Cortex-M4 DSP).  A
+ * window sum must fit 16 bits: ≤ 16 samples of 12 bits.
+ * ADC_MGR_SIMD 0 (and the host HIL build, which has no DSP
+ * intrinsics) does the same lane arithmetic in plain C.
  */
 #define ADC_FILTER_SAMPLES    8
+#define ADC_MGR_SIMD          1
+
+#if (ADC_FILTER_SAMPLES * ADC_RESOLUTION) > 0xFFFF
+#error "ADC_FILTER_SAMPLES too large for 16-bit sum lanes (max 16)"
+#endif
+
+/* Optional Kalman estimator (kalman.c), one 2-state filter
+ * (value, slope) per channel, single-precision on the FPU.
+ *
+ * The DMA ISR sums EST_DECIMATE scans; their mean is one
+ * measurement, so the filter runs at ~1.3 kHz instead of the
+ * scan rate.  With EST_ENABLE = 1 its value estimate replaces
+ * the moving average for fire_logic, TEMP_X10 and the frame
+ * payload, and the slope drives the TREND status bit.
+ *
+ *   EST_R_LSB2  : single-scan ADC noise variance (LSB²); the
+ *                 measurement variance is EST_R_LSB2 / EST_DECIMATE
+ *   EST_Q_LSB2  : process noise, white slope-rate density
+ *                 (LSB²/s³).  Larger → faster, noisier.
+ *
+ * Trend alarm (STATUS bit 4) when the estimated slope of either
+ * channel stays over its limit (LSB/s, ≈ 0.8 mV/s per LSB/s).
+ * An up/down counter debounces it: ON after EST_TREND_HOLD net
+ * updates over the limit (~0.2 s on a clean ramp), OFF when the
+ * count drains back to 0.
+ */
+#define EST_ENABLE            0      /* 1 = Kalman replaces the MA */
+#define EST_DECIMATE          16     /* scans per update (≤ 255)   */
+#define EST_DT_S              ((float)EST_DECIMATE * (float)ADC_SCAN_NS * 1e-9f)
+#define EST_R_LSB2            4.0f
+#define EST_Q_LSB2            1.0e3f
+#define EST_TEMP_TREND_LSB_S  12.0f  /* ≈ 1 °C/s LM35 rise      */
+#define EST_GAS_TREND_LSB_S   200.0f /* gas rising fast          */
+#define EST_TREND_HOLD        256    /* net updates over limit   */
+
+/* Optional windowed statistics (win_stats.c) over RAW scans,
+ * for Pis that poll slowly.  Per channel: min, max, Σx, Σx²
+ * and the number of rising WARN crossings (§5 thresholds with
+ * hysteresis, judged on every scan rather than the filtered
+ * value, so short spikes count).  The window restarts on the
+ * first scan after the Pi starts clocking out a frame, so each
+ * read covers exactly the scans since the previous one.  Sent in
+ * the snapshot frame (§7 WSTAT block); the Pi derives mean and
+ * variance.  Σ and Σx² stop at WSTAT_MAX_SCANS (~50 s); min,
+ * max and crossings keep counting.
+ */
+#define WSTAT_ENABLE          0      /* 1 = WSTAT block in frame   */
+#define WSTAT_MAX_SCANS       0xFFFFFUL  /* Σx < 2^32, Σx² < 2^44   */
+
+/* Optional mains-synchronous averaging (mains.c), needs the
+ * timer-triggered scan rate of Section 3.
+ *
+ * A box average over exactly MAINS_CYCLES periods of the mains
+ * frequency has a null at MAINS_HZ and at every harmonic, so
+ * it removes 50/60 Hz hum and its rectifier harmonics that the
+ * 8-tap MA (0.4 ms) passes untouched.  MAINS_WINDOW_SCANS
+ * scans (20 ms at 50 Hz, 50 ms at 60 Hz) is also the group
+ * delay it adds to the alarm path; the analog watchdog
+ * (Section 12) sees raw scans and is not slowed.  With
+ * MAINS_ENABLE = 1 the window mean replaces the moving average
+ * for fire_logic, TEMP_X10 and the frame payload once the
+ * first window has filled.
+ *
+ * Per window and channel the node also measures the scan
+ * variance (NOISE) and the power of the mains bin (HUM, from
+ * a single-bin DFT at MAINS_HZ), both in LSB², and sends them
+ * in the snapshot frame (§7 NOISE block).  NOISE − HUM is the
+ * broadband noise floor.  The HSI (±1 %) and the grid (±0.2 %)
+ * move the real null off MAINS_HZ; the residue is still ~40 dB
+ * below the hum the MA lets through.
+ *
+ * Off by default: the 20 ms window would double the software
+ * gas-step → motor latency (Section 12) and the NOISE block
+ * grows the frame from 29 to 54 B (N = 4).  Enable it, and
+ * run the Pi with --noise, where hum matters more than speed.
+ */
+#define MAINS_ENABLE          0      /* 1 = sync average + NOISE   */
+#define MAINS_HZ              50     /* 50 or 60                   */
+#define MAINS_CYCLES          ((MAINS_HZ) == 60 ? 3 : 1)
+#define MAINS_WINDOW_SCANS    (ADC_SCAN_RATE_HZ * MAINS_CYCLES / MAINS_HZ)
+
+#if MAINS_ENABLE
+#if !ADC_TRIG_TIMER
+#error "MAINS_ENABLE needs ADC_TRIG_TIMER (a fixed scan rate)"
+#endif
+#if (ADC_SCAN_RATE_HZ * MAINS_CYCLES) % MAINS_HZ
+#error "MAINS window is not a whole number of scans"
+#endif
+#if (MAINS_WINDOW_SCANS % 4) || (MAINS_WINDOW_SCANS > 65535)
+#error "MAINS_WINDOW_SCANS must be a multiple of 4, at most 65535"
+#endif
+#if EST_ENABLE
+#error "MAINS_ENABLE and EST_ENABLE both replace the moving average"
+#endif
+#endif
 
 /* ╔═══════════════════════════════════════════════════════╗
  * ║  5. ALARM THRESHOLDS (Hysteresis)                     ║
@@ -179,86 +372,496 @@
  *   Bit     : MSB first
  *   Word    : 8-bit
  *   NSS     : Hardware, active-low
- *   Transfer: Full-duplex; Pi sends 16× 0x00, STM32 returns frame
- *
- * ┌──────┬────────────────┬──────┬──────────────────────────────┐
- * │ Byte │ Field          │ Size │ Description                  │
- * ├──────┼────────────────┼──────┼──────────────────────────────┤
- * │  [0] │ MAGIC_0        │  1   │ 0xAA  start-of-frame        │
- * │  [1] │ MAGIC_1        │  1   │ 0x55  start-of-frame        │
- * │  [2] │ SEQ            │  1   │ Sequence counter (0–255)     │
- * │  [3] │ STATUS         │  1   │ Bit-field (see below)        │
- * │ [4-5]│ ADC0 (LM35)    │  2   │ uint16 LE – raw ADC         │
- * │ [6-7]│ ADC1 (Gas)     │  2   │ uint16 LE – raw ADC         │
- * │ [8-9]│ ADC2 (Soil)    │  2   │ uint16 LE – raw ADC         │
- * │[10-11│ ADC3 (Light)   │  2   │ uint16 LE – raw ADC         │
- * │[12-13│ TEMP_X10       │  2   │ uint16 LE – temp × 10       │
- * │ [14] │ XOR_CHECKSUM   │  1   │ XOR of bytes [0..13]        │
- * │ [15] │ END_MARKER     │  1   │ 0x0D  end-of-frame          │
- * └──────┴────────────────┴──────┴──────────────────────────────┘
+ *   Transfer: Full-duplex; Pi sends PACKET_LEN× 0x00, STM32 returns frame
+ *   Align   : SPI_NSS_ALIGN = 1 → every NSS-low transaction starts
+ *             at byte 0 of the newest frame (EXTI4 on the NSS rising
+ *             edge re-arms SPI1, the first RXNE latches the frame).
+ *             An aborted or partial read no longer shifts later frames.
+ *
+ * N = ADC_NUM_CHANNELS,  P = FRAME_ADC_PAYLOAD_LEN = ceil(N × 12 / 8)
+ *
+ * ┌───────┬────────────────┬──────┬─────────────────────────────┐
+ * │ Byte  │ Field          │ Size │ Description                 │
+ * ├───────┼────────────────┼──────┼─────────────────────────────┤
+ * │  [0]  │ MAGIC_0        │  1   │ 0xAA  start-of-frame       │
+ * │  [1]  │ MAGIC_1        │  1   │ 0x55  start-of-frame       │
+ * │  [2]  │ SEQ            │  1   │ PUB_CNT low byte (0–255)    │
+ * │  [3]  │ STATUS         │  1   │ Bit-field (see below)       │
+ * │  [4]  │ NCH            │  1   │ N, channels in payload      │
+ * │ [5..] │ ADC payload    │  P   │ N × 12-bit, packed (below)  │
+ * │ +0..1 │ TEMP_X10       │  2   │ uint16 LE – temp × 10      │
+ * │ +2..5 │ TS_US          │  4   │ uint32 LE – scan time, µs   │
+ * │ +6..9 │ PUB_CNT        │  4   │ uint32 LE – frames published│
+ * │+10..13│ SCAN_CNT       │  4   │ uint32 LE – scans fed       │
+ * │+14..15│ FOLD           │  2   │ uint16 LE – scans this frame│
+ * │ +16   │ XOR_CHECKSUM   │  1   │ XOR of all preceding bytes │
+ * │ +17   │ END_MARKER     │  1   │ 0x0D  end-of-frame         │
+ * └───────┴────────────────┴──────┴─────────────────────────────┘
+ *
+ *   N =  4 → P =  6 → PACKET_LEN = 29 bytes  (232 µs @ 1 MHz)
+ *   N = 16 → P = 24 → PACKET_LEN = 47 bytes  (376 µs @ 1 MHz)
+ *
+ * SEQ is the low byte of PUB_CNT.  At 8 bits it wraps after 256
+ * publications, so the Pi cannot tell a repeat read from a lap
+ * of missed frames by SEQ alone; PUB_CNT (frames published since
+ * reset) can, and does not wrap in practice.  SCAN_CNT counts the
+ * scans the SAMPLE task fed to the filters since reset, and FOLD
+ * how many of them came in since the previous frame (saturating
+ * at 0xFFFF).  A jump of d in PUB_CNT between two reads means
+ * d − 1 frames were overwritten unread, carrying
+ * SCAN_CNT − FOLD − SCAN_CNT(previous read) scans.  All three
+ * restart at 0 on every reset.
+ *
+ * With WSTAT_ENABLE (§4) a statistics block of WSTAT_LEN bytes
+ * sits between FOLD and XOR_CHECKSUM (XOR and END move back
+ * by WSTAT_LEN):
+ *
+ * ┌───────┬────────────────┬──────┬─────────────────────────────┐
+ * │ +0..2 │ WS_N           │  3   │ uint24 LE – scans in window │
+ * │ then per channel k (WSTAT_CH_LEN = 14 bytes):              │
+ * │ +0..2 │ MIN, MAX       │  3   │ 2 × 12-bit, packed as pair  │
+ * │ +3..6 │ SUM            │  4   │ uint32 LE – Σx              │
+ * │ +7..12│ SUMSQ          │  6   │ uint48 LE – Σx²             │
+ * │ +13   │ XCNT           │  1   │ rising WARN crossings (≤255)│
+ * └───────┴────────────────┴──────┴─────────────────────────────┘
+ *
+ *   N = 4 → WSTAT_LEN = 59 → PACKET_LEN = 88 bytes (704 µs)
+ *
+ * With MAINS_ENABLE (§4) a noise block of NOISE_LEN bytes
+ * follows (after WSTAT when both are on):
+ *
+ * ┌───────┬────────────────┬──────┬─────────────────────────────┐
+ * │ +0    │ NZ_SEQ         │  1   │ mains windows done (0–255)  │
+ * │ then per channel k (NOISE_CH_LEN = 6 bytes):               │
+ * │ +0..2 │ NOISE          │  3   │ uint24 LE – scan variance   │
+ * │ +3..5 │ HUM            │  3   │ uint24 LE – mains-bin power │
+ * └───────┴────────────────┴──────┴─────────────────────────────┘
+ *
+ * Both in LSB² × 256 over the last complete window, saturating
+ * at 0xFFFFFF (≈ 256 LSB rms).  NZ_SEQ tells the Pi whether a
+ * new window closed since the previous frame.
+ *
+ *   N = 4 → NOISE_LEN = 25 → PACKET_LEN = 54 bytes (432 µs)
+ *
+ * TS_US is TIM5->CNT (32-bit, free-running at TS_CLOCK_HZ)
+ * latched in the DMA TC ISR of the scan the frame was built
+ * from.  It wraps every 2^32 µs ≈ 71.6 min and restarts at 0
+ * on every reset; the Pi unwraps it and estimates the offset
+ * and rate of this clock against its own.
+ *
+ * ADC payload packing — little-endian bit stream of 12-bit
+ * samples, sample k occupies bits [12k .. 12k+11]:
+ *   pair (a, b) → a[7:0] | b[3:0]a[11:8] | b[11:4]   (3 bytes)
+ *   odd tail  a → a[7:0] | 0000a[11:8]              (2 bytes)
+ * So the Pi can read the whole payload as one LE integer and
+ * take (v >> 12k) & 0xFFF.
  *
  * STATUS byte bit-field:
  *   Bit 0 : BUZZER     1 = buzzer currently ON
  *   Bit 1 : MOTOR      1 = motor / fan currently ON
  *   Bit 2 : GAS_ALARM  1 = gas level in WARN or ALARM
  *   Bit 3 : TEMP_ALARM 1 = temperature in WARN or ALARM
- *   Bit 4-7: reserved (0)
+ *   Bit 4 : TREND      1 = temp or gas rising faster than
+ *                          EST_*_TREND_LSB_S (EST_ENABLE only)
+ *   Bit 5 : EMERGENCY  1 = analog watchdog tripped on a raw
+ *                          scan over AWD_* (Section 12); motor
+ *                          and buzzer forced on
+ *   Bit 6 : CAPTURE    1 = a waveform record is complete and
+ *                          waiting to be read (Section 13)
+ *   Bit 7 : reserved (0)
  *
  * Checksum algorithm:
- *   cs = 0; for (i=0; i<14; i++) cs ^= frame[i]; frame[14] = cs;
+ *   cs = 0; for (i=0; i<OFF_XOR; i++) cs ^= frame[i]; frame[OFF_XOR] = cs;
  */
 
 /* Frame geometry */
-#define PACKET_LEN            16
+#define FRAME_ADC_PAYLOAD_LEN ((3 * ADC_NUM_CHANNELS + 1) / 2)
+#define PACKET_LEN            (FRAME_OFF_END + 1)
+#define PACKET_MAX_LEN        (23 + (3 * ADC_MAX_CHANNELS + 1) / 2 \
+                               + WSTAT_LEN_FOR(ADC_MAX_CHANNELS) \
+                               + NOISE_LEN_FOR(ADC_MAX_CHANNELS))
+#define WSTAT_CH_LEN          14
+#define WSTAT_LEN_FOR(n)      (WSTAT_ENABLE ? 3 + WSTAT_CH_LEN * (n) : 0)
+#define WSTAT_LEN             WSTAT_LEN_FOR(ADC_NUM_CHANNELS)
+#define NOISE_CH_LEN          6
+#define NOISE_LEN_FOR(n)      (MAINS_ENABLE ? 1 + NOISE_CH_LEN * (n) : 0)
+#define NOISE_LEN             NOISE_LEN_FOR(ADC_NUM_CHANNELS)
 
 /* Magic bytes (start-of-frame) */
 #define FRAME_MAGIC_0         0xAAU
 #define FRAME_MAGIC_1         0x55U
 #define FRAME_END_MARKER      0x0DU
 
-/* Byte offsets inside the 16-byte frame */
+/* Byte offsets inside the frame */
 #define FRAME_OFF_MAGIC0      0
 #define FRAME_OFF_MAGIC1      1
 #define FRAME_OFF_SEQ         2
 #define FRAME_OFF_STATUS      3
-#define FRAME_OFF_ADC0_L      4
-#define FRAME_OFF_ADC0_H      5
-#define FRAME_OFF_ADC1_L      6
-#define FRAME_OFF_ADC1_H      7
-#define FRAME_OFF_ADC2_L      8
-#define FRAME_OFF_ADC2_H      9
-#define FRAME_OFF_ADC3_L      10
-#define FRAME_OFF_ADC3_H      11
-#define FRAME_OFF_TEMP_L      12
-#define FRAME_OFF_TEMP_H      13
-#define FRAME_OFF_XOR         14
-#define FRAME_OFF_END         15
+#define FRAME_OFF_NCH         4
+#define FRAME_OFF_ADC         5
+#define FRAME_OFF_TEMP_L      (FRAME_OFF_ADC + FRAME_ADC_PAYLOAD_LEN)
+#define FRAME_OFF_TEMP_H      (FRAME_OFF_TEMP_L + 1)
+#define FRAME_OFF_TS          (FRAME_OFF_TEMP_L + 2)   /* 4 bytes LE */
+#define FRAME_OFF_PUB         (FRAME_OFF_TEMP_L + 6)   /* 4 bytes LE */
+#define FRAME_OFF_SCAN        (FRAME_OFF_TEMP_L + 10)  /* 4 bytes LE */
+#define FRAME_OFF_FOLD        (FRAME_OFF_TEMP_L + 14)  /* 2 bytes LE */
+#define FRAME_OFF_WSTAT       (FRAME_OFF_TEMP_L + 16)  /* WSTAT_LEN  */
+#define FRAME_OFF_NOISE       (FRAME_OFF_WSTAT + WSTAT_LEN)   /* NOISE_LEN */
+#define FRAME_OFF_XOR         (FRAME_OFF_NOISE + NOISE_LEN)
+#define FRAME_OFF_END         (FRAME_OFF_XOR + 1)
+
+/* ── Compressed stream packet (optional, STREAM_ENABLE = 1) ──
+ *
+ * Instead of one filtered snapshot per poll, the node records
+ * raw scans (every STREAM_DECIMATE-th DMA scan) into blocks of
+ * STREAM_BLOCK_SCANS and publishes each block compressed:
+ *
+ * ┌───────┬────────────────┬──────┬─────────────────────────────┐
+ * │ Byte  │ Field          │ Size │ Description                 │
+ * ├───────┼────────────────┼──────┼─────────────────────────────┤
+ * │  [0]  │ MAGIC_0        │  1   │ 0xAA                        │
+ * │  [1]  │ STREAM_MAGIC_1 │  1   │ 0x56  (0x55 = snapshot)     │
+ * │  [2]  │ SEQ            │  1   │ Block counter (0–255)       │
+ * │  [3]  │ STATUS         │  1   │ Same bits as snapshot frame │
+ * │  [4]  │ NCH            │  1   │ N channels                  │
+ * │  [5]  │ NSCANS         │  1   │ Scans in this block         │
+ * │  [6]  │ DECIM          │  1   │ DMA scans per stored scan   │
+ * │ [7-8] │ TEMP_X10       │  2   │ uint16 LE – latest filtered │
+ * │ [9-10]│ BODY_LEN       │  2   │ uint16 LE – bytes of body   │
+ * │[11-14]│ TS_US          │  4   │ uint32 LE – last scan, µs   │
+ * │ [15..]│ BODY           │ LEN  │ Rice bit stream (below)     │
+ * │ +0    │ XOR_CHECKSUM   │  1   │ XOR of all preceding bytes │
+ * │ +1    │ END_MARKER     │  1   │ 0x0D                        │
+ * └───────┴────────────────┴──────┴─────────────────────────────┘
+ *
+ * BODY, MSB-first bit stream, one section per channel:
+ *   k      4 bits   Rice parameter 0–11, or 15 = raw section
+ *   first 12 bits   absolute sample of scan 0
+ *   then NSCANS-1 codes for d = x[i] - x[i-1]:
+ *     z = zig-zag(d) = 2d (d ≥ 0) or -2d-1 (d < 0)
+ *     q = z >> k:  q ones, one zero, then k low bits of z
+ *     q ≥ 16    :  16 ones, then z as 13 raw bits (escape)
+ *   k = 15     :  NSCANS-1 raw 12-bit samples instead
+ * The encoder picks the k with the fewest bits and falls back
+ * to raw when coding would not help, so BODY never exceeds the
+ * packed raw size (STREAM_BODY_MAX_LEN).
+ *
+ * The packet is variable length: the Pi reads the 15-byte
+ * header, then BODY_LEN + 2 more bytes.  SPI TX wraps at the
+ * packet's actual length, so bytes clocked = bytes needed.
+ */
+#define STREAM_ENABLE         0      /* 1 = publish stream blocks */
+#define STREAM_BLOCK_SCANS    64     /* scans per block (≤ 255)   */
+#define STREAM_DECIMATE       32     /* keep 1 of every N scans   */
+
+#define FRAME_STREAM_MAGIC_1  0x56U
+#define STREAM_HDR_LEN        15
+#define STREAM_OFF_NSCANS     5
+#define STREAM_OFF_DECIM      6
+#define STREAM_OFF_TEMP_L     7
+#define STREAM_OFF_TEMP_H     8
+#define STREAM_OFF_BODYLEN_L  9
+#define STREAM_OFF_BODYLEN_H  10
+#define STREAM_OFF_TS         11     /* 4 bytes LE               */
+#define STREAM_OFF_BODY       15
+
+#define STREAM_RICE_K_MAX     11
+#define STREAM_RICE_RAW       15     /* section is raw 12-bit     */
+#define STREAM_RICE_ESCAPE_Q  16     /* q ≥ 16 → 13-bit literal   */
+#define STREAM_BODY_MAX_LEN   \
+    ((ADC_NUM_CHANNELS * (16 + 12 * (STREAM_BLOCK_SCANS - 1)) + 7) / 8)
+#define STREAM_PACKET_MAX_LEN (STREAM_HDR_LEN + STREAM_BODY_MAX_LEN + 2)
+
+#if (STREAM_BLOCK_SCANS < 2) || (STREAM_BLOCK_SCANS > 255)
+#error "STREAM_BLOCK_SCANS must be 2..255 (NSCANS is one byte)"
+#endif
+
+#if STREAM_ENABLE && WSTAT_ENABLE
+#error "WSTAT_ENABLE needs snapshot frames (stream blocks carry raw scans)"
+#endif
+
+#if STREAM_ENABLE && MAINS_ENABLE
+#error "MAINS_ENABLE needs snapshot frames (NOISE block)"
+#endif
+
+/* ── Commands (Pi → STM32 on MOSI, SPI_NSS_ALIGN only) ──
+ *
+ * The Pi normally clocks 0x00.  A transaction whose first
+ * CMD_LEN MOSI bytes are
+ *
+ *   [0] CMD_MAGIC  [1] OP  [2..6] ARG (5 bytes)  [7] XOR of [0..6]
+ *
+ * is handed over when NSS rises (EXTI4) and runs as the
+ * CAPTURE task.  Every command is answered once: the reply
+ * goes out on the Pi's NEXT transaction only (one-shot), the
+ * one after gets snapshot / stream frames again.  A bad XOR
+ * or unknown OP is ignored (no reply).
+ *
+ *   OP                  ARG
+ *   ──────────────────  ──────────────────────────────────────
+ *   CMD_OP_CAP_ARM      PRE u16 LE, CH u8, LEVEL u16 LE
+ *                       (bit 15 = falling edge, CH 0xFF = no
+ *                       threshold: command trigger only)
+ *   CMD_OP_CAP_FORCE    –  trigger an armed capture now
+ *   CMD_OP_CAP_READ     FIRST u16 LE – reply carries scans
+ *                       FIRST.. (≤ CAP_CHUNK_SCANS) once DONE;
+ *                       FIRST ≥ TOTAL asks for the state only
+ *   CMD_OP_CAP_STOP     –  disarm / free the record
+ *
+ * The Pi may put the next command in the MOSI of the
+ * transaction that clocks out the previous reply.
+ *
+ * ── Capture reply packet (answer to every command) ──
+ *
+ * ┌───────┬────────────────┬──────┬─────────────────────────────┐
+ * │ Byte  │ Field          │ Size │ Description                 │
+ * ├───────┼────────────────┼──────┼─────────────────────────────┤
+ * │  [0]  │ MAGIC_0        │  1   │ 0xAA                        │
+ * │  [1]  │ CAP_MAGIC_1    │  1   │ 0x57                        │
+ * │  [2]  │ REC            │  1   │ Record counter (0–255)      │
+ * │  [3]  │ STATUS         │  1   │ Same bits as snapshot frame │
+ * │  [4]  │ NCH            │  1   │ N channels                  │
+ * │  [5]  │ STATE          │  1   │ CAP_STATE_*                 │
+ * │  [6]  │ SRC            │  1   │ CAP_SRC_* (what triggered)  │
+ * │ [7-8] │ TOTAL          │  2   │ uint16 LE – scans in record │
+ * │ [9-10]│ PRE            │  2   │ uint16 LE – trigger scan    │
+ * │[11-12]│ FIRST          │  2   │ uint16 LE – first scan here │
+ * │[13-14]│ NSCANS         │  2   │ uint16 LE – 0 = state only  │
+ * │[15-18]│ TS_US          │  4   │ uint32 LE – trigger scan, µs│
+ * │[19-22]│ SCAN_NS        │  4   │ uint32 LE – scan period, ns │
+ * │ [23..]│ BODY           │ NS×P │ raw scans, 12-bit packed    │
+ * │ +0    │ XOR_CHECKSUM   │  1   │ XOR of all preceding bytes │
+ * │ +1    │ END_MARKER     │  1   │ 0x0D                        │
+ * └───────┴────────────────┴──────┴─────────────────────────────┘
+ *
+ * Record scan i was converted at TS_US + (i − PRE) × SCAN_NS.
+ * BODY rows use the snapshot payload packing (P bytes each).
+ *   N = 4, 128 scans → 793 bytes (6.3 ms @ 1 MHz)
+ */
+#define CMD_MAGIC             0xC3U
+#define CMD_LEN               8
+#define CMD_OFF_OP            1
+#define CMD_OFF_ARG           2
+#define CMD_OFF_XOR           7
+
+#define CMD_OP_CAP_ARM        0x01U
+#define CMD_OP_CAP_FORCE      0x02U
+#define CMD_OP_CAP_READ       0x03U
+#define CMD_OP_CAP_STOP       0x04U
+
+#define FRAME_CAP_MAGIC_1     0x57U
+#define CAP_HDR_LEN           23
+#define CAP_OFF_REC           2
+#define CAP_OFF_STATE         5
+#define CAP_OFF_SRC           6
+#define CAP_OFF_TOTAL         7
+#define CAP_OFF_PRE           9
+#define CAP_OFF_FIRST         11
+#define CAP_OFF_NSCANS        13
+#define CAP_OFF_TS            15     /* 4 bytes LE               */
+#define CAP_OFF_SCAN_NS       19     /* 4 bytes LE               */
+#define CAP_OFF_BODY          23
+#define CAP_PACKET_MAX_LEN    (CAP_HDR_LEN \
+                               + CAP_CHUNK_SCANS * FRAME_ADC_PAYLOAD_LEN + 2)
 
 /* STATUS byte bit positions */
 #define STATUS_BIT_BUZZER     0
 #define STATUS_BIT_MOTOR      1
 #define STATUS_BIT_GAS_ALARM  2
 #define STATUS_BIT_TEMP_ALARM 3
+#define STATUS_BIT_TREND      4
+#define STATUS_BIT_EMERG      5
+#define STATUS_BIT_CAPTURE    6
 
 /* SPI bus parameters (must match Python spidev config) */
+#define SPI_NSS_ALIGN         1          /* 0 = free-running index  */
 #define SPI_CLOCK_HZ          1000000UL  /* 1 MHz                  */
 #define SPI_CPOL              0          /* clock polarity          */
 #define SPI_CPHA              0          /* clock phase             */
 
+/* Sample timestamps (TS_US): TIM5, 32-bit up-counter */
+#define TS_CLOCK_HZ           1000000UL  /* 1 µs per count         */
+
 /* ╔═══════════════════════════════════════════════════════╗
  * ║  8. NVIC INTERRUPT PRIORITIES                         ║
  * ╠═══════════════════════════════════════════════════════╣
  * ║  Lower number = higher priority (0 = highest, Cortex-M4)    ║
  * ║                                                       ║
- * ║  DMA (ADC data ready) : prio 1 (highest, packet fresh)║
+ * ║  ADC (analog watchdog): prio 0 (highest, motor+buzzer)║
+ * ║  DMA (ADC data ready) : prio 1 (latch scan)           ║
  * ║  SPI (slave TX/RX)    : prio 2 (middle)               ║
- * ║  SysTick (1ms tick)   : prio 3 (lowest, buzzer only)  ║
+ * ║  EXTI4 (NSS rise)     : prio 2 (same as SPI), takes   ║
+ * ║                         MOSI commands (Section 7)     ║
+ * ║  SysTick (1ms tick)   : prio 3 (lowest, buzzer+ticks) ║
+ * ║  TIM11 (ADC start)    : prio 1 (fires once at boot)   ║
  * ║                                                       ║
- * ║  DMA > SPI ensures build_packet() completes before    ║
- * ║  SPI can send any byte → no partial frame.            ║
+ * ║  ISRs only latch data and release tasks (Section 11); ║
+ * ║  build_packet() runs in thread mode on a row SPI is   ║
+ * ║  not clocking out → no partial frame.                 ║
  * ╚═══════════════════════════════════════════════════════╝*/
 #define IRQ_PRIO_DMA_ADC      1
 #define IRQ_PRIO_SPI          2
 #define IRQ_PRIO_SYSTICK      3
+#define IRQ_PRIO_ADC_START    1
+#define IRQ_PRIO_ADC_AWD      0
+
+/* ╔═══════════════════════════════════════════════════════╗
+ * ║  9. WARM START (backup SRAM)                          ║
+ * ╚═══════════════════════════════════════════════════════╝
+ * A scheduler task (Section 11) snapshots the filter rings,
+ * the Kalman state (EST_ENABLE) and the FireStates into one
+ * of two backup-SRAM slots every WARM_SAVE_MS, alternating,
+ * each with magic + layout word + Fletcher-32.  After any
+ * reset that is not a power-on (watchdog, NRST, software,
+ * brown-out) the newest valid slot is loaded before SPI
+ * starts, so the first frame already carries the pre-reset
+ * filtered values.  A layout change (N, filter length,
+ * EST_ENABLE) invalidates old slots.
+ *
+ * A snapshot costs ~550 cycles (N = 4, copy + Fletcher-32),
+ * so 20 ms keeps the task under 0.2 % of the CPU.  A reset
+ * loses at most the last 20 ms of state, one publication
+ * period; the 8-tap ring refills in 0.4 ms anyway.
+ */
+#define WARM_ENABLE           1
+#define WARM_SAVE_MS          20U    /* snapshot task period     */
+#define WARM_MAGIC            0x47485753UL   /* "GHWS"           */
+
+/* ╔═══════════════════════════════════════════════════════╗
+ * ║  10. DATA-READY / ALARM LINE (PB2 → Pi GPIO25)        ║
+ * ╚═══════════════════════════════════════════════════════╝
+ * PB2 goes high when the Pi should read:
+ *   data ready – on every frame publication (SCHED_PUBLISH_MS,
+ *                Section 11), the poll rate the Pi used to run
+ *                blind
+ *   urgent     – at once when a published STATUS differs in
+ *                DRDY_URGENT_MASK bits from the last frame the
+ *                Pi started reading (the alarm task publishes
+ *                out of turn on such a change)
+ * It drops again on the first scan after a transaction starts
+ * (SPI1_Slave_GetTxCount() moved), ≤ one scan into the read,
+ * so each request is a fresh rising edge.  The Pi waits for it
+ * on the GPIO character device and keeps a slow timeout poll
+ * in case the wire is missing.  The buzzer bit is left out of
+ * the mask: it toggles with the beep pattern, not on events.
+ */
+#define DRDY_ENABLE           1
+#define DRDY_URGENT_MASK      ((1U << STATUS_BIT_MOTOR)     \
+                             | (1U << STATUS_BIT_GAS_ALARM) \
+                             | (1U << STATUS_BIT_TEMP_ALARM) \
+                             | (1U << STATUS_BIT_EMERG)   \
+                             | (1U << STATUS_BIT_CAPTURE))
+
+/* ╔═══════════════════════════════════════════════════════╗
+ * ║  11. TASK SCHEDULER (sched.c)                         ║
+ * ╚═══════════════════════════════════════════════════════╝
+ * Work runs at three rates instead of all of it per scan in
+ * the DMA ISR.  ISRs only release tasks; the main loop runs
+ * the released ones to completion in this priority order:
+ *
+ *   Task     Released by      Rate              Work
+ *   -------  ---------------  ----------------  ------------------
+ *   SAMPLE   DMA TC IRQ       every scan        filters, window,
+ *                             (1/ADC_SCAN_NS)   estimator, DRDY drop
+ *   ALARM    SysTick          SCHED_ALARM_MS    fire_logic,
+ *                                               actuator targets
+ *   PUBLISH  SysTick (+ALARM) SCHED_PUBLISH_MS  SPI frame, DRDY raise
+ *   WARM     SysTick          WARM_SAVE_MS      backup-SRAM snapshot
+ *   CAPTURE  EXTI4 (+itself)  on a command      capture reply, in
+ *                                               CAP_SLICE_SCANS steps
+ *
+ * PUBLISH is released out of turn when ALARM changes a
+ * DRDY_URGENT_MASK bit, and in stream mode when a block is
+ * full, so neither waits for the next period.
+ *
+ * Per task the scheduler keeps runs, overruns (released again
+ * before the previous release ran: that release is lost) and
+ * DWT cycle counts for release→start lateness and run time.
+ * A SAMPLE overrun is a scan the filters never saw.
+ */
+#define SCHED_ALARM_MS        10U    /* alarm logic: 100 Hz      */
+#define SCHED_PUBLISH_MS      20U    /* frame rate = Pi poll     */
+#define SCHED_MAX_TASKS       8U     /* table size limit         */
+
+/* ╔═══════════════════════════════════════════════════════╗
+ * ║  12. ANALOG WATCHDOG (awd.c)                          ║
+ * ╚═══════════════════════════════════════════════════════╝
+ * Emergency fast path beside the filtered state machine (§5).
+ * The ADC compares every conversion of the guarded input with
+ * HTR in hardware; a raw value over it raises ADC_IRQn, whose
+ * handler drives motor and buzzer on with BSRR at once — no
+ * moving average, no ALARM task period in between.  The next
+ * DMA TC publishes the frame with STATUS bit 5 (EMERGENCY).
+ *
+ * The F411 has one watchdog with one channel/threshold pair,
+ * so the DMA ISR moves it to the next guarded input every
+ * scan: each input is watched every other scan (2 inputs →
+ * ≤ 2 × ADC_SCAN_NS blind).  The interrupt is one-shot; the
+ * ALARM task releases the emergency and re-arms once it has
+ * held AWD_HOLD_MS and the filtered values are back under the
+ * §5 ALARM_OFF levels.  WARN and hysteresis stay in fire_logic.
+ *
+ * Limits are raw ADC counts, above the software ALARM_ON
+ * levels.  The temperature limit is nominal LM35 (10 mV/°C,
+ * no cal_lut offset/gain).
+ */
+#define AWD_ENABLE            1
+#define AWD_GAS_ADC           3200U   /* raw gas, ALARM_ON 2500   */
+#define AWD_TEMP_X10          700U    /* 70.0 °C, ALARM_ON 50.0   */
+#define AWD_TEMP_ADC          (AWD_TEMP_X10 * ADC_RESOLUTION / ADC_VREF_MV)
+#define AWD_HOLD_MS           1000U   /* min emergency duration   */
+
+#if AWD_ENABLE && ((AWD_GAS_ADC <= GAS_ALARM_ON_ADC) || \
+                   (AWD_TEMP_X10 <= TEMP_ALARM_ON_X10))
+#error "AWD limits must sit above the software ALARM_ON levels"
+#endif
+
+/* ╔═══════════════════════════════════════════════════════╗
+ * ║  13. WAVEFORM CAPTURE (capture.c)                     ║
+ * ╚═══════════════════════════════════════════════════════╝
+ * Diagnostics for a misbehaving sensor: a block of RAW scans
+ * at the full ADC rate (every DMA TC, 1/ADC_SCAN_NS), not the
+ * filtered 50 Hz snapshots.  Commands (§7) arm it with a
+ * pre-trigger length and an optional threshold:
+ *
+ *   ARMED      every scan goes into a CAP_SCANS ring
+ *   TRIGGERED  FORCE command, or raw CH crossing LEVEL
+ *              (rising, or falling with bit 15); then
+ *              CAP_SCANS − PRE − 1 more scans
+ *   DONE       recording stops, STATUS bit 6 set (urgent,
+ *              §10) until the Pi sends STOP or re-arms
+ *
+ * A trigger before PRE scans were recorded keeps what there
+ * is (PRE in the reply is the real count).  The DMA ISR only
+ * copies the scan and checks the level — alarm logic, the
+ * watchdog and snapshot frames carry on throughout.  Replies
+ * are packed by the lowest-priority CAPTURE task, at most
+ * CAP_SLICE_SCANS scans per run, so SAMPLE always gets the
+ * CPU within one scan period.
+ *
+ * CAP_SCANS fills a fixed RAM budget:
+ *   N = 4 → 2048 scans = 102 ms @ 50 µs, 16 KB
+ */
+#define CAP_ENABLE            1
+#define CAP_RAM_BYTES         16384U
+#define CAP_SCANS             (CAP_RAM_BYTES / (2U * ADC_NUM_CHANNELS))
+#define CAP_CHUNK_SCANS       128U   /* scans per READ reply      */
+#define CAP_SLICE_SCANS       8U     /* scans packed per task run */
+
+#define CAP_STATE_IDLE        0U
+#define CAP_STATE_ARMED       1U
+#define CAP_STATE_TRIGGERED   2U
+#define CAP_STATE_DONE        3U
+
+#define CAP_SRC_NONE          0U
+#define CAP_SRC_COMMAND       1U
+#define CAP_SRC_LEVEL         2U
+
+#define CAP_CH_NONE           0xFFU  /* ARM: no threshold trigger */
+#define CAP_LEVEL_FALLING     0x8000U
+
+#if CAP_ENABLE && !SPI_NSS_ALIGN
+#error "CAP_ENABLE needs SPI_NSS_ALIGN (commands end at the NSS rise)"
+#endif
 
 #endif /* _BOARD_H_ */
@@ -0,0 +1,29 @@
+#ifndef _CAL_LUT_H_
+#define _CAL_LUT_H_
+
+#include <stdint.h>
+#include "board.h"
+
+/*============================================================
+ *  cal_lut – ADC calibration lookup tables
+ *
+ *  GENERATED by gui_spi_greenhouse.py --gen-cal-lut from
+ *  CAL_CHANNELS.  Do not edit; change the Python list and
+ *  regenerate so the Pi and the MCU keep identical tables.
+ *============================================================*/
+
+/* Engineering value = g_cal_lut[ch][raw] / scale:
+ *   ch0  linear, °C × 10
+ *   ch1  mq, ppm × 1
+ *   ch2  linear, % × 10
+ *   ch3  linear, % × 10   */
+#define CAL_LUT_CHANNELS      4
+#define CAL_LUT_CRC32         0x2A412F32UL
+
+#if CAL_LUT_CHANNELS != ADC_NUM_CHANNELS
+#error "cal_lut.c is stale: rerun gui_spi_greenhouse.py --gen-cal-lut --channels N"
+#endif
+
+extern const uint16_t g_cal_lut[CAL_LUT_CHANNELS][ADC_RESOLUTION + 1];
+
+#endif /* _CAL_LUT_H_ */
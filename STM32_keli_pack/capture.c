@@ -0,0 +1,176 @@
+#include "capture.h"
+
+/*============================================================
+ *  capture.c – Pre-trigger ring of raw scans (board.h §13)
+ *
+ *  Contexts:
+ *    Capture_OnScan           DMA TC IRQ, priority 1
+ *    everything else          CAPTURE task, thread mode
+ *
+ *  The ISR owns the ring while the state is ARMED or
+ *  TRIGGERED; the task rewrites the trigger setup only with
+ *  interrupts masked, and reads rows only once it is DONE,
+ *  when the ISR no longer writes anything.
+ *============================================================*/
+
+#if CAP_ENABLE
+
+static uint16_t s_ring[CAP_SCANS][ADC_NUM_CHANNELS];
+static volatile uint8_t s_state = CAP_STATE_IDLE;
+static volatile uint8_t s_force = 0;
+static uint16_t s_wr     = 0;       /* next ring row (oldest once DONE) */
+static uint16_t s_filled = 0;       /* rows since arming, ≤ CAP_SCANS   */
+static uint16_t s_left   = 0;       /* rows still to record (TRIGGERED) */
+static uint16_t s_pre    = 0;       /* requested, then actual pre       */
+static uint8_t  s_ch     = CAP_CH_NONE;
+static uint16_t s_level  = 0;
+static uint8_t  s_fall   = 0;
+static uint8_t  s_over   = 1;       /* last scan was past the level     */
+static uint8_t  s_src    = CAP_SRC_NONE;
+static uint8_t  s_rec    = 0;
+static uint32_t s_trig_ts = 0;
+
+/* Record complete: the ISR stops writing */
+static void finish(void)
+{
+    s_rec++;
+    s_state = CAP_STATE_DONE;
+}
+
+void Capture_Init(void)
+{
+    s_state = CAP_STATE_IDLE;
+    s_force = 0;
+    s_src   = CAP_SRC_NONE;
+    s_rec   = 0;
+}
+
+void Capture_Arm(uint16_t pre, uint8_t ch, uint16_t level)
+{
+    __disable_irq();
+    s_pre    = (pre < CAP_SCANS) ? pre : (uint16_t)(CAP_SCANS - 1U);
+    s_ch     = (ch < ADC_NUM_CHANNELS) ? ch : CAP_CH_NONE;
+    s_level  = (uint16_t)(level & 0x0FFFU);
+    s_fall   = (level & CAP_LEVEL_FALLING) ? 1U : 0U;
+    s_over   = 1U;                  /* a level already past waits */
+    s_wr     = 0;
+    s_filled = 0;
+    s_force  = 0;
+    s_src    = CAP_SRC_NONE;
+    s_state  = CAP_STATE_ARMED;
+    __enable_irq();
+}
+
+void Capture_Force(void)
+{
+    s_force = 1U;
+}
+
+void Capture_Stop(void)
+{
+    s_state = CAP_STATE_IDLE;
+}
+
+/*------------------------------------------------------------
+ *  Capture_OnScan – DMA TC IRQ, every scan
+ *
+ *  Idle / done: one compare.  Recording: N halfword copies,
+ *  and while armed one level compare.  The trigger scan is
+ *  record index s_pre; the record is the last CAP_SCANS rows.
+ *------------------------------------------------------------*/
+void Capture_OnScan(const uint16_t raw[ADC_NUM_CHANNELS], uint32_t ts_us)
+{
+    uint8_t ch, over, hit;
+
+    if (s_state != CAP_STATE_ARMED && s_state != CAP_STATE_TRIGGERED)
+        return;
+
+    for (ch = 0; ch < ADC_NUM_CHANNELS; ch++)
+        s_ring[s_wr][ch] = raw[ch];
+    if (++s_wr >= CAP_SCANS) s_wr = 0;
+
+    if (s_state == CAP_STATE_TRIGGERED)
+    {
+        if (--s_left == 0) finish();
+        return;
+    }
+
+    hit = 0;
+    if (s_force)
+    {
+        hit     = CAP_SRC_COMMAND;
+        s_force = 0;
+    }
+    else if (s_ch != CAP_CH_NONE)
+    {
+        over = s_fall ? (raw[s_ch] <= s_level) : (raw[s_ch] >= s_level);
+        if (over && !s_over) hit = CAP_SRC_LEVEL;
+        s_over = over;
+    }
+
+    if (!hit)
+    {
+        if (s_filled < CAP_SCANS) s_filled++;
+        return;
+    }
+
+    /* Trigger: keep what pre-trigger there is */
+    if (s_filled < s_pre) s_pre = s_filled;
+    s_left    = (uint16_t)(CAP_SCANS - 1U - s_pre);
+    s_src     = hit;
+    s_trig_ts = ts_us;
+    s_state   = CAP_STATE_TRIGGERED;
+    if (s_left == 0) finish();
+}
+
+uint8_t Capture_GetState(void)
+{
+    return s_state;
+}
+
+void Capture_GetInfo(CaptureInfo *info)
+{
+    __disable_irq();
+    info->state   = s_state;
+    info->src     = s_src;
+    info->rec     = s_rec;
+    info->pre     = s_pre;
+    info->trig_ts = s_trig_ts;
+    __enable_irq();
+}
+
+const uint16_t *Capture_Row(uint16_t i)
+{
+    uint32_t r = (uint32_t)s_wr + i;
+
+    if (r >= CAP_SCANS) r -= CAP_SCANS;
+    return s_ring[r];
+}
+
+#else  /* !CAP_ENABLE */
+
+static const uint16_t s_zero[ADC_NUM_CHANNELS];
+
+void    Capture_Init(void)                              { }
+void    Capture_Arm(uint16_t pre, uint8_t ch, uint16_t level)
+{
+    (void)pre; (void)ch; (void)level;
+}
+void    Capture_Force(void)                             { }
+void    Capture_Stop(void)                              { }
+void    Capture_OnScan(const uint16_t raw[ADC_NUM_CHANNELS], uint32_t ts_us)
+{
+    (void)raw; (void)ts_us;
+}
+uint8_t Capture_GetState(void)                          { return CAP_STATE_IDLE; }
+void    Capture_GetInfo(CaptureInfo *info)
+{
+    info->state   = CAP_STATE_IDLE;
+    info->src     = CAP_SRC_NONE;
+    info->rec     = 0;
+    info->pre     = 0;
+    info->trig_ts = 0;
+}
+const uint16_t *Capture_Row(uint16_t i)                 { (void)i; return s_zero; }
+
+#endif /* CAP_ENABLE */
@@ -0,0 +1,52 @@
+#ifndef _CAPTURE_H_
+#define _CAPTURE_H_
+
+#include <stdint.h>
+#include "board.h"
+
+/*============================================================
+ *  capture – Raw waveform recorder at the full ADC rate
+ *
+ *  A CAP_SCANS ring of unfiltered scans with a pre-trigger
+ *  (board.h Section 13).  The Pi arms and reads it with MOSI
+ *  commands (Section 7); greenhouse.c packs the replies.
+ *
+ *  Flow:
+ *    CAPTURE task → Capture_Arm() / _Force() / _Stop()
+ *    DMA TC IRQ   → Capture_OnScan()         (every scan)
+ *    CAPTURE task → Capture_GetInfo(), Capture_Row()  (DONE)
+ *============================================================*/
+
+typedef struct
+{
+    uint8_t  state;     /* CAP_STATE_*                          */
+    uint8_t  src;       /* CAP_SRC_* of the last trigger        */
+    uint8_t  rec;       /* records completed since init (wraps) */
+    uint16_t pre;       /* record index of the trigger scan     */
+    uint32_t trig_ts;   /* TS_US of the trigger scan            */
+} CaptureInfo;
+
+/* Idle, nothing recorded */
+void    Capture_Init(void);
+
+/* Start recording; pre-trigger of `pre` scans (clamped to
+ * CAP_SCANS - 1), threshold on raw channel `ch` (CAP_CH_NONE =
+ * command only) at `level` (| CAP_LEVEL_FALLING = falling)  */
+void    Capture_Arm(uint16_t pre, uint8_t ch, uint16_t level);
+
+/* Trigger an armed capture on the next scan */
+void    Capture_Force(void);
+
+/* Back to idle, record dropped */
+void    Capture_Stop(void);
+
+/* DMA TC IRQ: record one raw scan, check the trigger */
+void    Capture_OnScan(const uint16_t raw[ADC_NUM_CHANNELS], uint32_t ts_us);
+
+uint8_t Capture_GetState(void);
+void    Capture_GetInfo(CaptureInfo *info);
+
+/* Scan i (0..CAP_SCANS-1) of a DONE record, oldest first */
+const uint16_t *Capture_Row(uint16_t i);
+
+#endif /* _CAPTURE_H_ */
@@ -0,0 +1,89 @@
+#include "drdy.h"
+#include "SPI_LIB.h"        /* SPI1_Slave_GetTxCount()          */
+
+/*============================================================
+ *  drdy.c – PB2 data-ready / alarm line
+ *
+ *  Both calls come from scheduler tasks (sched.c), so they
+ *  never preempt each other: every publication raises the
+ *  line, the first check after a transaction started drops it.
+ *
+ *  Urgent STATUS changes need nothing special here: the ALARM
+ *  task publishes them out of turn.  A frame published while
+ *  the Pi is still reading the previous one drops the line and
+ *  raises it one scan later, so the Pi gets a full-width edge
+ *  rather than a set right behind the reset.
+ *============================================================*/
+
+#define DRDY_SET()    (GPIOB->BSRR = (1U << PIN_DRDY))
+#define DRDY_CLR()    (GPIOB->BSRR = (1U << (PIN_DRDY + 16U)))
+
+#if DRDY_ENABLE
+
+static uint32_t s_tx_seen   = 0;    /* SPI TX count last checked    */
+static uint8_t  s_owed      = 0;    /* raise on the next scan       */
+
+void Drdy_Init(void)
+{
+    DRDY_CLR();
+    s_tx_seen = SPI1_Slave_GetTxCount();
+    s_owed    = 0;
+}
+
+/* A transaction started since the last check */
+static uint8_t read_started(void)
+{
+    uint32_t tx = SPI1_Slave_GetTxCount();
+
+    if (tx == s_tx_seen)
+        return 0;
+    s_tx_seen = tx;
+    return 1;
+}
+
+/*------------------------------------------------------------
+ *  Drdy_OnScan – SAMPLE task, every scan
+ *------------------------------------------------------------*/
+void Drdy_OnScan(void)
+{
+    if (read_started())
+    {
+        DRDY_CLR();
+        s_owed = 0;                 /* that read got the new frame  */
+    }
+    else if (s_owed)
+    {
+        DRDY_SET();
+        s_owed = 0;
+    }
+}
+
+/*------------------------------------------------------------
+ *  Drdy_OnPublish – PUBLISH task, after SPI1_Slave_SetTxBuffer
+ *------------------------------------------------------------*/
+void Drdy_OnPublish(void)
+{
+    if (read_started())
+    {
+        DRDY_CLR();                 /* that read got the old frame  */
+        s_owed = 1;
+    }
+    else
+    {
+        DRDY_SET();
+    }
+}
+
+uint8_t Drdy_Get(void)
+{
+    return (uint8_t)((GPIOB->ODR >> PIN_DRDY) & 1U);
+}
+
+#else  /* !DRDY_ENABLE: line stays low, the Pi falls back to polling */
+
+void    Drdy_Init(void)               { }
+void    Drdy_OnScan(void)             { }
+void    Drdy_OnPublish(void)          { }
+uint8_t Drdy_Get(void)                { return 0; }
+
+#endif /* DRDY_ENABLE */
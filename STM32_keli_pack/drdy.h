@@ -0,0 +1,32 @@
+#ifndef _DRDY_H_
+#define _DRDY_H_
+
+#include <stdint.h>
+#include "board.h"
+
+/*============================================================
+ *  drdy – Data-ready / urgent-event line to the Pi (PB2)
+ *
+ *  The Pi waits for a rising edge instead of polling blind
+ *  (board.h Section 10).  The line is raised with every frame
+ *  publication (alarm-relevant STATUS changes are published
+ *  at once) and dropped as soon as the Pi starts reading.
+ *
+ *  Flow (scheduler tasks, board.h Section 11):
+ *    SAMPLE  → Drdy_OnScan()            (every scan)
+ *    PUBLISH → Drdy_OnPublish()         (after each publish)
+ *============================================================*/
+
+/* Line low, nothing pending (PB2 already an output) */
+void    Drdy_Init(void);
+
+/* Drop the line once a read has started */
+void    Drdy_OnScan(void);
+
+/* A new frame is pending: data ready */
+void    Drdy_OnPublish(void);
+
+/* Current line level (0/1) */
+uint8_t Drdy_Get(void);
+
+#endif /* _DRDY_H_ */
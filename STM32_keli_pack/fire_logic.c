@@ -100,3 +100,15 @@ FireState FireLogic_GetState(void)
 
 FireState FireLogic_GetTempState(void) { return g_temp_state; }
 FireState FireLogic_GetGasState(void)  { return g_gas_state;  }
+
+/*------------------------------------------------------------
+ *  FireLogic_Restore  Warm start (warm_start.c)
+ *
+ *  An alarm that was active before a watchdog or brown-out
+ *  reset stays active; hysteresis continues from there.
+ *------------------------------------------------------------*/
+void FireLogic_Restore(FireState temp, FireState gas)
+{
+    g_temp_state = (temp <= FIRE_STATE_ALARM) ? temp : FIRE_STATE_NORMAL;
+    g_gas_state  = (gas  <= FIRE_STATE_ALARM) ? gas  : FIRE_STATE_NORMAL;
+}
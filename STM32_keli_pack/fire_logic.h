@@ -39,4 +39,7 @@ FireState FireLogic_GetState(void);
 FireState FireLogic_GetTempState(void);
 FireState FireLogic_GetGasState(void);
 
+/* Warm start: resume the states saved before a reset */
+void      FireLogic_Restore(FireState temp, FireState gas);
+
 #endif /* _FIRE_LOGIC_H_ */
@@ -0,0 +1,135 @@
+#ifndef _FRAME_PACK_H_
+#define _FRAME_PACK_H_
+
+#include <stdint.h>
+#include "board.h"
+#include "win_stats.h"      /* WinStats_Pack (WSTAT block)      */
+#include "mains.h"          /* Mains_Pack (NOISE block)         */
+
+/*============================================================
+ *  frame_pack – snapshot frame packer (board.h Section 7)
+ *
+ *  GENERATED by gui_spi_greenhouse.py --gen-frame-pack from
+ *  FRAME_SCHEMA.  Do not edit; change the schema and regenerate
+ *  so the MCU packer and the Pi decoder share one layout.
+ *
+ *  Specialised for N = 4: constant offsets, every byte
+ *  stored and folded into the XOR as it is produced, with no
+ *  loops and no per-byte branches.  Block bytes are written
+ *  by their module and folded back in, unrolled.
+ *============================================================*/
+
+#define FRAME_PACK_CHANNELS   4
+#define FRAME_SCHEMA_CRC32    0x3EC08332UL
+
+#if FRAME_PACK_CHANNELS != ADC_NUM_CHANNELS
+#error "frame_pack.h is stale: rerun gui_spi_greenhouse.py --gen-frame-pack --channels N"
+#endif
+
+/* Schema offsets of this build */
+#if WSTAT_ENABLE && MAINS_ENABLE
+#define FRAME_PACK_OFF_WSTAT  27
+#define FRAME_PACK_OFF_NOISE  86
+#define FRAME_PACK_OFF_XOR    111
+#define FRAME_PACK_LEN        113
+#elif WSTAT_ENABLE && !MAINS_ENABLE
+#define FRAME_PACK_OFF_WSTAT  27
+#define FRAME_PACK_OFF_XOR    86
+#define FRAME_PACK_LEN        88
+#elif !WSTAT_ENABLE && MAINS_ENABLE
+#define FRAME_PACK_OFF_NOISE  27
+#define FRAME_PACK_OFF_XOR    52
+#define FRAME_PACK_LEN        54
+#elif !WSTAT_ENABLE && !MAINS_ENABLE
+#define FRAME_PACK_OFF_XOR    27
+#define FRAME_PACK_LEN        29
+#endif
+
+/* board.h Section 7 must agree with the schema */
+#if FRAME_OFF_MAGIC0 != 0 || FRAME_OFF_MAGIC1 != 1 \
+    || FRAME_OFF_SEQ != 2 || FRAME_OFF_STATUS != 3 \
+    || FRAME_OFF_NCH != 4 || FRAME_OFF_ADC != 5 \
+    || FRAME_OFF_TEMP_L != 11 || FRAME_OFF_TS != 13 \
+    || FRAME_OFF_PUB != 17 || FRAME_OFF_SCAN != 21 \
+    || FRAME_OFF_FOLD != 25 || FRAME_OFF_XOR != FRAME_PACK_OFF_XOR \
+    || PACKET_LEN != FRAME_PACK_LEN || FRAME_ADC_PAYLOAD_LEN != 6 \
+    || WSTAT_CH_LEN != 14 || NOISE_CH_LEN != 6 \
+    || FRAME_MAGIC_0 != 0xAAU || FRAME_MAGIC_1 != 0x55U \
+    || FRAME_END_MARKER != 0x0DU \
+    || (WSTAT_ENABLE && FRAME_OFF_WSTAT != FRAME_PACK_OFF_WSTAT) \
+    || (MAINS_ENABLE && FRAME_OFF_NOISE != FRAME_PACK_OFF_NOISE)
+#error "board.h Section 7 disagrees with FRAME_SCHEMA (frame_pack.h)"
+#endif
+
+/*------------------------------------------------------------
+ *  Frame_Pack – Write one snapshot frame, p[0 .. PACKET_LEN-1]
+ *------------------------------------------------------------*/
+static void Frame_Pack(volatile uint8_t *p, uint8_t seq, uint8_t status,
+                       const uint16_t adc[ADC_NUM_CHANNELS],
+                       uint16_t temp_x10, uint32_t ts_us, uint32_t pub_cnt,
+                       uint32_t scan_cnt, uint16_t fold)
+{
+    uint8_t cs = 0xFBU;                                     /* MAGIC0 ^ MAGIC1 ^ NCH */
+    uint8_t b;
+
+    p[0] = 0xAAU;                                                               /* MAGIC0 */
+    p[1] = 0x55U;                                                               /* MAGIC1 */
+    b = seq;                                                p[2] = b;  cs ^= b;  /* SEQ */
+    b = status;                                             p[3] = b;  cs ^= b;  /* STATUS */
+    p[4] = 4U;                                                                  /* NCH, N */
+    b = (uint8_t)adc[0];                                    p[5] = b;  cs ^= b;  /* ADC0 7..0 */
+    b = (uint8_t)(((adc[0] >> 8) & 0x0FU) | (adc[1] << 4)); p[6] = b;  cs ^= b;  /* ADC1 3..0, ADC0 11..8 */
+    b = (uint8_t)(adc[1] >> 4);                             p[7] = b;  cs ^= b;  /* ADC1 11..4 */
+    b = (uint8_t)adc[2];                                    p[8] = b;  cs ^= b;  /* ADC2 7..0 */
+    b = (uint8_t)(((adc[2] >> 8) & 0x0FU) | (adc[3] << 4)); p[9] = b;  cs ^= b;  /* ADC3 3..0, ADC2 11..8 */
+    b = (uint8_t)(adc[3] >> 4);                             p[10] = b; cs ^= b;  /* ADC3 11..4 */
+    b = (uint8_t)temp_x10;                                  p[11] = b; cs ^= b;  /* TEMP_X10 byte 0 */
+    b = (uint8_t)(temp_x10 >> 8);                           p[12] = b; cs ^= b;  /* TEMP_X10 byte 1 */
+    b = (uint8_t)ts_us;                                     p[13] = b; cs ^= b;  /* TS_US byte 0 */
+    b = (uint8_t)(ts_us >> 8);                              p[14] = b; cs ^= b;  /* TS_US byte 1 */
+    b = (uint8_t)(ts_us >> 16);                             p[15] = b; cs ^= b;  /* TS_US byte 2 */
+    b = (uint8_t)(ts_us >> 24);                             p[16] = b; cs ^= b;  /* TS_US byte 3 */
+    b = (uint8_t)pub_cnt;                                   p[17] = b; cs ^= b;  /* PUB_CNT byte 0 */
+    b = (uint8_t)(pub_cnt >> 8);                            p[18] = b; cs ^= b;  /* PUB_CNT byte 1 */
+    b = (uint8_t)(pub_cnt >> 16);                           p[19] = b; cs ^= b;  /* PUB_CNT byte 2 */
+    b = (uint8_t)(pub_cnt >> 24);                           p[20] = b; cs ^= b;  /* PUB_CNT byte 3 */
+    b = (uint8_t)scan_cnt;                                  p[21] = b; cs ^= b;  /* SCAN_CNT byte 0 */
+    b = (uint8_t)(scan_cnt >> 8);                           p[22] = b; cs ^= b;  /* SCAN_CNT byte 1 */
+    b = (uint8_t)(scan_cnt >> 16);                          p[23] = b; cs ^= b;  /* SCAN_CNT byte 2 */
+    b = (uint8_t)(scan_cnt >> 24);                          p[24] = b; cs ^= b;  /* SCAN_CNT byte 3 */
+    b = (uint8_t)fold;                                      p[25] = b; cs ^= b;  /* FOLD byte 0 */
+    b = (uint8_t)(fold >> 8);                               p[26] = b; cs ^= b;  /* FOLD byte 1 */
+
+#if WSTAT_ENABLE
+    {
+        volatile uint8_t *q = &p[FRAME_PACK_OFF_WSTAT];
+
+        (void)WinStats_Pack(q);
+        cs ^= (uint8_t)(q[0] ^ q[1] ^ q[2] ^ q[3] ^ q[4] ^ q[5] ^ q[6] ^ q[7]);
+        cs ^= (uint8_t)(q[8] ^ q[9] ^ q[10] ^ q[11] ^ q[12] ^ q[13] ^ q[14] ^ q[15]);
+        cs ^= (uint8_t)(q[16] ^ q[17] ^ q[18] ^ q[19] ^ q[20] ^ q[21] ^ q[22] ^ q[23]);
+        cs ^= (uint8_t)(q[24] ^ q[25] ^ q[26] ^ q[27] ^ q[28] ^ q[29] ^ q[30] ^ q[31]);
+        cs ^= (uint8_t)(q[32] ^ q[33] ^ q[34] ^ q[35] ^ q[36] ^ q[37] ^ q[38] ^ q[39]);
+        cs ^= (uint8_t)(q[40] ^ q[41] ^ q[42] ^ q[43] ^ q[44] ^ q[45] ^ q[46] ^ q[47]);
+        cs ^= (uint8_t)(q[48] ^ q[49] ^ q[50] ^ q[51] ^ q[52] ^ q[53] ^ q[54] ^ q[55]);
+        cs ^= (uint8_t)(q[56] ^ q[57] ^ q[58]);
+    }
+#endif
+
+#if MAINS_ENABLE
+    {
+        volatile uint8_t *q = &p[FRAME_PACK_OFF_NOISE];
+
+        (void)Mains_Pack(q);
+        cs ^= (uint8_t)(q[0] ^ q[1] ^ q[2] ^ q[3] ^ q[4] ^ q[5] ^ q[6] ^ q[7]);
+        cs ^= (uint8_t)(q[8] ^ q[9] ^ q[10] ^ q[11] ^ q[12] ^ q[13] ^ q[14] ^ q[15]);
+        cs ^= (uint8_t)(q[16] ^ q[17] ^ q[18] ^ q[19] ^ q[20] ^ q[21] ^ q[22] ^ q[23]);
+        cs ^= q[24];
+    }
+#endif
+
+    p[FRAME_PACK_OFF_XOR]      = cs;
+    p[FRAME_PACK_OFF_XOR + 1U] = 0x0DU;                                         /* END */
+}
+
+#endif /* _FRAME_PACK_H_ */
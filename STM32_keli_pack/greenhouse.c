@@ -4,96 +4,561 @@
 #include "fire_logic.h"     /* state machine + hysteresis       */
 #include "actuators.h"      /* buzzer / motor control           */
 #include "SPI_LIB.h"        /* SPI1_Slave_SetTxBuffer/Reset    */
+#include "stream_codec.h"   /* Rice block encoder (stream mode) */
+#include "kalman.h"         /* value+slope estimator (EST_ENABLE) */
+#include "cal_lut.h"        /* g_cal_lut[ch][raw]              */
+#include "warm_start.h"     /* state restored across resets     */
+#include "win_stats.h"      /* min/max/sums between reads       */
+#include "drdy.h"           /* PB2 data-ready / alarm line      */
+#include "sched.h"          /* Sched_OnScan / Sched_Trigger     */
+#include "awd.h"            /* analog-watchdog emergency path   */
+#include "capture.h"        /* raw waveform recorder            */
+#include "mains.h"          /* mains-synchronous average, noise */
+#if !STREAM_ENABLE
+#include "frame_pack.h"     /* Frame_Pack, generated from schema */
+#endif
 
 /*============================================================
  *  greenhouse.c  Logic trung tm: ADC ? Alarm ? Actuator ? SPI
  *
- *  Lu?ng x? l (trong DMA2 TC IRQ):
+ *  Lu?ng x? l (scheduler tasks, board.h Section 11):
  *
- *    g_adc_buf[4]  (raw from DMA)
- *         
+ *    g_adc_buf[N]  (raw from DMA)
+ *             DMA2 TC IRQ: copy to s_scan[], release SAMPLE
  *         ?
+ *  SAMPLE (every scan)
  *    ADC_Mgr_FeedSample()      ? d?y vo b? l?c
  *         
  *         +-? ADC_Mgr_GetTempX10()  ? nhi?t d? d l?c
  *         +-? ADC_Mgr_GetGasRaw()   ? gas d l?c
  *                   
  *                   ?
+ *  ALARM (SCHED_ALARM_MS)
  *    FireLogic_Update()        ? state machine (hysteresis)
  *         
  *         +-? FireLogic_GetState()   ? NORMAL/WARN/ALARM
  *         +-? Actuator_SetState()    ? set target cho buzzer/motor
- *         
+ *             urgent STATUS change: release PUBLISH now
  *         ?
- *    build_packet()            ? dng gi 16-byte SPI frame
+ *  PUBLISH (SCHED_PUBLISH_MS)
+ *    build_packet()            ? dng gi PACKET_LEN-byte SPI frame
  *         
  *         ?
- *    SPI1_Slave_ResetIndex()   ? Pi d?c frame m?i t? byte 0
+ *    SPI1_Slave_SetTxBuffer()  ? frame m?i, SPI latch ? byte 0
  *
  *  AN TON ISR:
- *  DMA IRQ priority (1) > SPI IRQ priority (2), nn SPI IRQ
- *  b? block trong lc build_packet ? khng c race condition.
+ *  Tasks run in thread mode, one at a time, so they share the
+ *  filter and alarm state freely.  build_packet() writes a row
+ *  SPI is not clocking out (next_frame), and the TX pointer
+ *  swap is masked, so SPI never sends a partial frame.
  *============================================================*/
 
-volatile uint8_t g_spi_packet[PACKET_LEN];
-static volatile uint8_t seq = 0;
-
-/*------------------------------------------------------------
- *  build_packet  ng gi 16-byte SPI frame
- *
- *  Byte   Field             M t?
- *  -----  ----------------  --------------------------
- *  [0]    MAGIC_0           0xAA (start-of-frame)
- *  [1]    MAGIC_1           0x55 (start-of-frame)
- *  [2]    SEQ               Sequence counter (0255)
- *  [3]    STATUS            Bit-field tr?ng thi
- *  [4-5]  ADC0 (LM35)       uint16_t little-endian
- *  [6-7]  ADC1 (Gas)        uint16_t little-endian
- *  [8-9]  ADC2 (Sensor3)    uint16_t little-endian
- *  [10-11] ADC3 (Sensor4)   uint16_t little-endian
- *  [12-13] TEMP_X10         uint16_t little-endian
- *  [14]   XOR_CHECKSUM      XOR bytes [0..13]
- *  [15]   END_MARKER        0x0D (end-of-frame)
- *------------------------------------------------------------*/
-static void build_packet(uint8_t status,
-                          uint16_t adc[4],
-                          uint16_t temp_x10)
-{
-    int i;
-    uint8_t cs;
-
-    /* Header */
-    g_spi_packet[0]  = 0xAA;             /* magic byte 0          */
-    g_spi_packet[1]  = 0x55;             /* magic byte 1          */
-    g_spi_packet[2]  = seq++;            /* sequence number       */
-    g_spi_packet[3]  = status;           /* status flags          */
-
-    /* 4 knh ADC, little-endian (low byte tru?c, high byte sau) */
-    g_spi_packet[4]  = (uint8_t)(adc[0] & 0xFF);
-    g_spi_packet[5]  = (uint8_t)(adc[0] >> 8);
-    g_spi_packet[6]  = (uint8_t)(adc[1] & 0xFF);
-    g_spi_packet[7]  = (uint8_t)(adc[1] >> 8);
-    g_spi_packet[8]  = (uint8_t)(adc[2] & 0xFF);
-    g_spi_packet[9]  = (uint8_t)(adc[2] >> 8);
-    g_spi_packet[10] = (uint8_t)(adc[3] & 0xFF);
-    g_spi_packet[11] = (uint8_t)(adc[3] >> 8);
-
-    /* Nhi?t d?  10 (0.1C), little-endian */
-    g_spi_packet[12] = (uint8_t)(temp_x10 & 0xFF);
-    g_spi_packet[13] = (uint8_t)(temp_x10 >> 8);
-
-    /* XOR checksum: XOR t?t c? bytes [0..13] */
+volatile uint8_t g_spi_packet[GH_TX_BUFS][PACKET_LEN];
+
+#if !STREAM_ENABLE
+static uint8_t s_frame = 0;             /* row last published       */
+static uint32_t s_pub_cnt  = 0;         /* frames published (PUB_CNT) */
+static uint32_t s_scan_cnt = 0;         /* scans fed (SCAN_CNT)       */
+static uint32_t s_pub_scan = 0;         /* s_scan_cnt at the last one */
+
+/*------------------------------------------------------------
+ *  next_frame - Row that is neither pending nor on the wire
+ *
+ *  Skipping the published row and the one SPI latched leaves
+ *  at least one free row out of GH_TX_BUFS = 3, so a frame
+ *  the Pi is clocking out is never rewritten underneath it.
+ *------------------------------------------------------------*/
+static volatile uint8_t *next_frame(void)
+{
+    volatile uint8_t *active = SPI1_Slave_GetActive();
+
+    do {
+        s_frame = (uint8_t)((s_frame + 1U) % GH_TX_BUFS);
+    } while (g_spi_packet[s_frame] == active);
+    return g_spi_packet[s_frame];
+}
+#endif
+
+#if CAP_ENABLE
+/*------------------------------------------------------------
+ *  pack_adc12 - Pack N 12-bit samples, 2 per 3 bytes
+ *
+ *  Little-endian bit stream (board.h Section 7):
+ *    pair (a, b) -> [a7..a0] [b3..b0 a11..a8] [b11..b4]
+ *    odd tail  a -> [a7..a0] [0000 a11..a8]
+ *  Returns number of bytes written (= FRAME_ADC_PAYLOAD_LEN).
+ *  Capture replies only: snapshot frames are packed by
+ *  Frame_Pack() with the same layout.
+ *------------------------------------------------------------*/
+static uint8_t pack_adc12(volatile uint8_t *dst,
+                          const uint16_t adc[ADC_NUM_CHANNELS])
+{
+    uint8_t  k = 0;
+    uint8_t  ch;
+    uint16_t a, b;
+
+    for (ch = 0; (uint8_t)(ch + 1U) < ADC_NUM_CHANNELS; ch += 2U)
+    {
+        a = adc[ch]      & 0x0FFFU;
+        b = adc[ch + 1U] & 0x0FFFU;
+        dst[k++] = (uint8_t)(a & 0xFFU);
+        dst[k++] = (uint8_t)((a >> 8) | ((b & 0x0FU) << 4));
+        dst[k++] = (uint8_t)(b >> 4);
+    }
+#if (ADC_NUM_CHANNELS & 1)
+    a = adc[ADC_NUM_CHANNELS - 1] & 0x0FFFU;
+    dst[k++] = (uint8_t)(a & 0xFFU);
+    dst[k++] = (uint8_t)(a >> 8);
+#endif
+    return k;
+}
+#endif /* CAP_ENABLE */
+
+#if !STREAM_ENABLE
+/*------------------------------------------------------------
+ *  build_packet - Pack the SPI frame (board.h Section 7)
+ *
+ *  Byte     Field             Description
+ *  -------  ----------------  --------------------------
+ *  [0]      MAGIC_0           0xAA (start-of-frame)
+ *  [1]      MAGIC_1           0x55 (start-of-frame)
+ *  [2]      SEQ               PUB_CNT low byte (0-255)
+ *  [3]      STATUS            Status bit-field
+ *  [4]      NCH               ADC_NUM_CHANNELS
+ *  [5..]    ADC payload       N x 12-bit packed, 2 per 3 bytes
+ *  +0..1    TEMP_X10          uint16_t little-endian
+ *  +2..5    TS_US             uint32_t little-endian, scan time
+ *  +6..9    PUB_CNT           uint32_t little-endian, frames published
+ *  +10..13  SCAN_CNT          uint32_t little-endian, scans fed
+ *  +14..15  FOLD              uint16_t little-endian, scans fed since
+ *                             the previous frame (saturating)
+ *  +16..    WSTAT             W = WSTAT_LEN bytes (0 unless WSTAT_ENABLE)
+ *  +16+W..  NOISE             Z = NOISE_LEN bytes (0 unless MAINS_ENABLE)
+ *  +16+W+Z  XOR_CHECKSUM      XOR of all preceding bytes
+ *  +17+W+Z  END_MARKER        0x0D (end-of-frame)
+ *
+ *  The bytes are written by Frame_Pack() (frame_pack.h), which
+ *  gui_spi_greenhouse.py --gen-frame-pack generates from the
+ *  same FRAME_SCHEMA its decoder is compiled from.
+ *
+ *  PUB_CNT and SCAN_CNT let the Pi count the frames, and the
+ *  scans folded into them, that were overwritten before it
+ *  read them (board.h Section 7); the 8-bit SEQ cannot.
+ *------------------------------------------------------------*/
+static void build_packet(volatile uint8_t *p, uint8_t status,
+                          const uint16_t adc[ADC_NUM_CHANNELS],
+                          uint16_t temp_x10, uint32_t ts_us)
+{
+    uint32_t fold = s_scan_cnt - s_pub_scan;
+
+    Frame_Pack(p, (uint8_t)s_pub_cnt, status, adc, temp_x10, ts_us,
+               s_pub_cnt, s_scan_cnt,
+               (uint16_t)(fold > 0xFFFFUL ? 0xFFFFUL : fold));
+    s_pub_cnt++;
+    s_pub_scan = s_scan_cnt;
+}
+#endif /* !STREAM_ENABLE */
+
+/*============ Shared task state (board.h Section 11) ============
+ *
+ *  The DMA ISR copies each scan into the row SAMPLE is not
+ *  reading; everything below it is thread-mode only.
+ */
+static uint16_t s_scan[2][ADC_NUM_CHANNELS];
+static uint32_t s_scan_ts[2];
+static volatile uint8_t s_scan_rd = 0;  /* row with the newest scan */
+static uint32_t s_fed_ts  = 0;          /* TS_US of the last scan fed */
+static uint8_t  s_pub_st  = 0;          /* STATUS last published     */
+
+/*------------------------------------------------------------
+ *  filtered - Filtered value of channel ch: Kalman when
+ *  EST_ENABLE, mains-window mean when MAINS_ENABLE (moving
+ *  average until the first window is full), else the MA
+ *------------------------------------------------------------*/
+static uint16_t filtered(uint8_t ch)
+{
+#if EST_ENABLE
+    return Kalman_GetValue(ch);
+#elif MAINS_ENABLE
+    return Mains_Ready() ? Mains_GetValue(ch) : ADC_Mgr_GetFiltered(ch);
+#else
+    return ADC_Mgr_GetFiltered(ch);
+#endif
+}
+
+/*------------------------------------------------------------
+ *  read_temp_gas - Filtered inputs of the alarm logic
+ *  (Kalman value or mains-window mean when enabled, moving
+ *  average otherwise)
+ *------------------------------------------------------------*/
+static void read_temp_gas(uint16_t *temp_x10, uint16_t *gas_raw)
+{
+    *temp_x10 = g_cal_lut[ADC_IDX_LM35][filtered(ADC_IDX_LM35)]; /* 0.1C, v d? 325 = 32.5C */
+    *gas_raw  = filtered(ADC_IDX_GAS);                           /* raw ADC 04095 */
+}
+
+/*------------------------------------------------------------
+ *  make_status - STATUS byte
+ *    Bit 0: Buzzer dang ON?
+ *    Bit 1: Motor dang ON?
+ *    Bit 2: Gas alarm flag (WARN ho?c ALARM)
+ *    Bit 3: Temperature alarm flag (WARN ho?c ALARM)
+ *    Bit 4: Rising trend (EST_ENABLE)
+ *    Bit 5: Analog-watchdog emergency (AWD_ENABLE)
+ *    Bit 6: Waveform record ready (CAP_ENABLE)
+ *------------------------------------------------------------*/
+static uint8_t make_status(void)
+{
+    uint8_t status = 0;
+
+    status |= (Actuator_IsBuzzerOn() ? 1U : 0U) << 0;
+    status |= (Actuator_IsMotorOn()  ? 1U : 0U) << 1;
+    status |= (FireLogic_GetGasState()  >= FIRE_STATE_WARN ? 1U : 0U) << 2;
+    status |= (FireLogic_GetTempState() >= FIRE_STATE_WARN ? 1U : 0U) << 3;
+#if EST_ENABLE
+    status |= Kalman_GetTrend() << STATUS_BIT_TREND;
+#endif
+    status |= Awd_IsActive() << STATUS_BIT_EMERG;
+    status |= (Capture_GetState() == CAP_STATE_DONE ? 1U : 0U)
+              << STATUS_BIT_CAPTURE;
+    return status;
+}
+
+#if STREAM_ENABLE
+/*============ Compressed stream blocks (board.h Section 7) ============
+ *
+ *  DMA ISR: stream_collect() copies every STREAM_DECIMATE-th raw
+ *           scan into the fill block.  A full block is handed to
+ *           PUBLISH through s_blk_ready, and PUBLISH released.
+ *  PUBLISH: stream_publish() Rice-encodes it into the back
+ *           packet and swaps that packet onto SPI.
+ *
+ *  Encoding costs far more than one scan period.  Collecting in
+ *  the ISR, like Capture_OnScan(), keeps every block evenly
+ *  spaced at STREAM_DECIMATE scans while it runs; only SAMPLE
+ *  overruns, and those are counted by the scheduler.  The ISR
+ *  writes only the fill block, PUBLISH reads only the ready one.
+ */
+#define BLK_NONE    0xFFU
+
+static uint16_t s_blk[2][STREAM_BLOCK_SCANS][ADC_NUM_CHANNELS];
+static uint32_t s_blk_ts[2];                      /* TS_US of last scan   */
+static volatile uint8_t  s_blk_fill  = 0;         /* block SAMPLE fills   */
+static volatile uint8_t  s_blk_ready = BLK_NONE;  /* block to encode      */
+static uint8_t  s_blk_n = 0;                      /* scans in fill block  */
+static uint8_t  s_decim = 0;
+
+static uint8_t  s_pkt[GH_TX_BUFS][STREAM_PACKET_MAX_LEN];
+static uint8_t  s_pkt_pub    = 0;                 /* row on SPI pending   */
+static uint8_t  s_stream_seq = 0;
+
+static volatile uint16_t s_blk_dropped = 0;       /* PUBLISH too slow     */
+
+/*------------------------------------------------------------
+ *  stream_collect - DMA TC ISR side, O(N) per kept scan
+ *------------------------------------------------------------*/
+static void stream_collect(const uint16_t raw[ADC_NUM_CHANNELS],
+                           uint32_t ts_us)
+{
+    uint8_t ch;
+
+    if (++s_decim < STREAM_DECIMATE) return;
+    s_decim = 0;
+
+    for (ch = 0; ch < ADC_NUM_CHANNELS; ch++)
+        s_blk[s_blk_fill][s_blk_n][ch] = raw[ch];
+    s_blk_ts[s_blk_fill] = ts_us;
+
+    if (++s_blk_n < STREAM_BLOCK_SCANS) return;
+    s_blk_n = 0;
+
+    if (s_blk_ready != BLK_NONE)
+    {
+        /* Previous block not encoded yet: refill this one */
+        s_blk_dropped++;
+        return;
+    }
+    s_blk_ready = s_blk_fill;
+    s_blk_fill ^= 1U;
+    Sched_Trigger(GH_TASK_PUBLISH);
+}
+
+/*------------------------------------------------------------
+ *  build_stream_packet - Header + Rice body + XOR + END
+ *  ts_us is the TS_US of the block's last scan.
+ *  Returns total packet length (STREAM_HDR_LEN + BODY_LEN + 2).
+ *------------------------------------------------------------*/
+static uint16_t build_stream_packet(uint8_t *p,
+                                    const uint16_t scans[][ADC_NUM_CHANNELS],
+                                    uint32_t ts_us)
+{
+    uint16_t body, len, i;
+    uint16_t temp_x10, gas_raw;
+    uint8_t  cs;
+
+    read_temp_gas(&temp_x10, &gas_raw);
+
+    p[FRAME_OFF_MAGIC0]     = FRAME_MAGIC_0;
+    p[FRAME_OFF_MAGIC1]     = FRAME_STREAM_MAGIC_1;
+    p[FRAME_OFF_SEQ]        = s_stream_seq++;
+    p[FRAME_OFF_STATUS]     = make_status();
+    p[FRAME_OFF_NCH]        = ADC_NUM_CHANNELS;
+    p[STREAM_OFF_NSCANS]    = STREAM_BLOCK_SCANS;
+    p[STREAM_OFF_DECIM]     = STREAM_DECIMATE;
+    p[STREAM_OFF_TEMP_L]    = (uint8_t)(temp_x10 & 0xFF);
+    p[STREAM_OFF_TEMP_H]    = (uint8_t)(temp_x10 >> 8);
+    p[STREAM_OFF_TS]        = (uint8_t)(ts_us & 0xFF);
+    p[STREAM_OFF_TS + 1]    = (uint8_t)(ts_us >> 8);
+    p[STREAM_OFF_TS + 2]    = (uint8_t)(ts_us >> 16);
+    p[STREAM_OFF_TS + 3]    = (uint8_t)(ts_us >> 24);
+
+    body = StreamCodec_EncodeBlock(scans, STREAM_BLOCK_SCANS,
+                                   &p[STREAM_OFF_BODY]);
+    p[STREAM_OFF_BODYLEN_L] = (uint8_t)(body & 0xFF);
+    p[STREAM_OFF_BODYLEN_H] = (uint8_t)(body >> 8);
+
+    len = (uint16_t)(STREAM_OFF_BODY + body);
     cs = 0;
-    for (i = 0; i <= 13; i++)
-        cs ^= g_spi_packet[i];
-    g_spi_packet[14] = cs;
+    for (i = 0; i < len; i++)
+        cs ^= p[i];
+    p[len]      = cs;
+    p[len + 1U] = FRAME_END_MARKER;
+    return (uint16_t)(len + 2U);
+}
+
+/*------------------------------------------------------------
+ *  stream_publish - PUBLISH task in stream mode
+ *
+ *  SPI TX is pointed at the new packet with its real length,
+ *  so the slave wraps there and the Pi clocks only the bytes
+ *  this block needs.  The pointer swap is the only critical
+ *  section (SPI ISR must not see g_tx/g_len half-updated).
+ *------------------------------------------------------------*/
+static void stream_publish(void)
+{
+    uint8_t  blk = s_blk_ready;
+    uint8_t  back;
+    uint16_t len;
+
+    if (blk == BLK_NONE) return;
 
-    /* End-of-frame marker */
-    g_spi_packet[15] = 0x0D;
+    /* Not the pending packet, not the one being clocked out */
+    back = s_pkt_pub;
+    do {
+        back = (uint8_t)((back + 1U) % GH_TX_BUFS);
+    } while (s_pkt[back] == (uint8_t *)SPI1_Slave_GetActive());
+
+    len = build_stream_packet(s_pkt[back], s_blk[blk], s_blk_ts[blk]);
+    s_blk_ready = BLK_NONE;
+
+    __disable_irq();
+    SPI1_Slave_SetTxBuffer(s_pkt[back], len);
+    __enable_irq();
+
+    s_pkt_pub = back;
+    s_pub_st  = s_pkt[back][FRAME_OFF_STATUS];
+    Drdy_OnPublish();
+}
+#endif /* STREAM_ENABLE */
+
+#if CAP_ENABLE
+/*============ Command replies (board.h Sections 7, 13) ============
+ *
+ *  EXTI4  : Greenhouse_OnCommand() copies the command and
+ *           releases CAPTURE.
+ *  CAPTURE: runs it, then packs the reply into the row SPI is
+ *           not clocking out, CAP_SLICE_SCANS scans per run
+ *           (releasing itself again), and hands the finished
+ *           packet to SPI as a one-shot reply.
+ *
+ *  A slice costs well under one scan period, so SAMPLE, which
+ *  outranks CAPTURE, never loses a scan while a reply is built.
+ *  A new command abandons the reply in progress.
+ */
+static uint8_t  s_cmd[CMD_LEN];
+static volatile uint8_t s_cmd_new = 0;
+
+static uint8_t  s_rep[2][CAP_PACKET_MAX_LEN];
+static uint8_t  s_rep_row  = 0;         /* row being packed          */
+static uint8_t  s_rep_busy = 0;         /* slices left to pack       */
+static uint16_t s_rep_next = 0;         /* next record scan          */
+static uint16_t s_rep_end  = 0;         /* one past the last scan    */
+static uint16_t s_rep_off  = 0;         /* write offset in the row   */
+static uint8_t  s_rep_cs   = 0;         /* XOR of bytes written      */
+
+/* n little-endian bytes of v */
+static void put_le(uint8_t *p, uint32_t v, uint8_t n)
+{
+    while (n--)
+    {
+        *p++ = (uint8_t)(v & 0xFFU);
+        v >>= 8;
+    }
 }
 
 /*------------------------------------------------------------
- *  Greenhouse_InitPacket  T?o frame kh?i t?o (data = 0)
+ *  reply_begin - Header of the reply to one command
+ *
+ *  Scans FIRST.. go into the body only for READ of a DONE
+ *  record.  A reply still waiting for SPI is withdrawn first,
+ *  so the row chosen here is never latched half-written.
+ *------------------------------------------------------------*/
+static void reply_begin(uint8_t read, uint16_t first)
+{
+    CaptureInfo ci;
+    uint8_t    *p;
+    uint16_t    n = 0, i;
+
+    __disable_irq();
+    SPI1_Slave_SetReply(0, 0);
+    __enable_irq();
+    if (s_rep[s_rep_row] == (uint8_t *)SPI1_Slave_GetActive())
+        s_rep_row ^= 1U;
+    p = s_rep[s_rep_row];
+
+    Capture_GetInfo(&ci);
+    if (read && ci.state == CAP_STATE_DONE && first < CAP_SCANS)
+    {
+        n = (uint16_t)(CAP_SCANS - first);
+        if (n > CAP_CHUNK_SCANS) n = CAP_CHUNK_SCANS;
+    }
+
+    p[FRAME_OFF_MAGIC0] = FRAME_MAGIC_0;
+    p[FRAME_OFF_MAGIC1] = FRAME_CAP_MAGIC_1;
+    p[CAP_OFF_REC]      = ci.rec;
+    p[FRAME_OFF_STATUS] = make_status();
+    p[FRAME_OFF_NCH]    = ADC_NUM_CHANNELS;
+    p[CAP_OFF_STATE]    = ci.state;
+    p[CAP_OFF_SRC]      = ci.src;
+    put_le(&p[CAP_OFF_TOTAL],   CAP_SCANS, 2);
+    put_le(&p[CAP_OFF_PRE],     ci.pre, 2);
+    put_le(&p[CAP_OFF_FIRST],   n ? first : 0U, 2);
+    put_le(&p[CAP_OFF_NSCANS],  n, 2);
+    put_le(&p[CAP_OFF_TS],      ci.trig_ts, 4);
+    put_le(&p[CAP_OFF_SCAN_NS], ADC_SCAN_NS, 4);
+
+    s_rep_cs = 0;
+    for (i = 0; i < CAP_OFF_BODY; i++)
+        s_rep_cs ^= p[i];
+    s_rep_off  = CAP_OFF_BODY;
+    s_rep_next = first;
+    s_rep_end  = (uint16_t)(first + n);
+    s_rep_busy = 1U;
+}
+
+/*------------------------------------------------------------
+ *  reply_slice - Pack up to CAP_SLICE_SCANS rows; on the last
+ *  one close the packet and queue it.  Returns 1 when done.
+ *------------------------------------------------------------*/
+static uint8_t reply_slice(void)
+{
+    uint8_t *p = s_rep[s_rep_row];
+    uint8_t  k, j, len;
+
+    for (k = 0; k < CAP_SLICE_SCANS && s_rep_next < s_rep_end; k++)
+    {
+        len = pack_adc12(&p[s_rep_off], Capture_Row(s_rep_next++));
+        for (j = 0; j < len; j++)
+            s_rep_cs ^= p[s_rep_off + j];
+        s_rep_off = (uint16_t)(s_rep_off + len);
+    }
+    if (s_rep_next < s_rep_end)
+        return 0;
+
+    p[s_rep_off]      = s_rep_cs;
+    p[s_rep_off + 1U] = FRAME_END_MARKER;
+
+    __disable_irq();
+    SPI1_Slave_SetReply(p, (uint16_t)(s_rep_off + 2U));
+    __enable_irq();
+
+    s_rep_busy = 0;
+    Drdy_OnPublish();
+    return 1;
+}
+
+/*------------------------------------------------------------
+ *  run_command - Check XOR, apply, start the reply
+ *------------------------------------------------------------*/
+static void run_command(const uint8_t *c)
+{
+    const uint8_t *a = &c[CMD_OFF_ARG];
+    uint16_t a01 = (uint16_t)(a[0] | (a[1] << 8));
+    uint8_t  cs = 0;
+    uint8_t  i;
+
+    for (i = 0; i < CMD_OFF_XOR; i++)
+        cs ^= c[i];
+    if (cs != c[CMD_OFF_XOR])
+        return;
+
+    switch (c[CMD_OFF_OP])
+    {
+    case CMD_OP_CAP_ARM:
+        Capture_Arm(a01, a[2], (uint16_t)(a[3] | (a[4] << 8)));
+        break;
+    case CMD_OP_CAP_FORCE:
+        Capture_Force();
+        break;
+    case CMD_OP_CAP_READ:
+        reply_begin(1U, a01);
+        return;
+    case CMD_OP_CAP_STOP:
+        Capture_Stop();
+        break;
+    default:
+        return;
+    }
+    reply_begin(0U, 0U);
+}
+
+/*------------------------------------------------------------
+ *  capture_task - CAPTURE, on a command and then once per slice
+ *------------------------------------------------------------*/
+static void capture_task(void)
+{
+    uint8_t c[CMD_LEN];
+    uint8_t i;
+
+    if (s_cmd_new)
+    {
+        __disable_irq();
+        for (i = 0; i < CMD_LEN; i++)
+            c[i] = s_cmd[i];
+        s_cmd_new = 0;
+        __enable_irq();
+        s_rep_busy = 0;
+        run_command(c);
+    }
+    if (s_rep_busy && !reply_slice())
+        Sched_Trigger(GH_TASK_CAPTURE);
+}
+#endif /* CAP_ENABLE */
+
+/*------------------------------------------------------------
+ *  Greenhouse_OnCommand - Callback from EXTI4 (NSS rise)
+ *
+ *  Priority 2: only copies the CMD_LEN bytes and releases
+ *  CAPTURE.  Without CAP_ENABLE commands are ignored.
+ *------------------------------------------------------------*/
+void Greenhouse_OnCommand(const uint8_t cmd[CMD_LEN])
+{
+#if CAP_ENABLE
+    uint8_t i;
+
+    for (i = 0; i < CMD_LEN; i++)
+        s_cmd[i] = cmd[i];
+    s_cmd_new = 1U;
+    Sched_Trigger(GH_TASK_CAPTURE);
+#else
+    (void)cmd;
+#endif
+}
+
+
+/*------------------------------------------------------------
+ *  Greenhouse_InitPacket  T?o frame kh?i t?o (data = 0,
+ *  or the restored filter/alarm state after a warm start)
  *
  *  G?i 1 l?n t? main() TRU?C khi b?t ADC.
  *  ?m b?o SPI lun c frame h?p l? d? g?i cho Pi,
@@ -101,73 +566,185 @@ static void build_packet(uint8_t status,
  *------------------------------------------------------------*/
 void Greenhouse_InitPacket(void)
 {
-    uint16_t zeros[4] = {0, 0, 0, 0};
-    build_packet(0, zeros, 0);
-    SPI1_Slave_SetTxBuffer(g_spi_packet, PACKET_LEN);
+#if STREAM_ENABLE
+    uint16_t len;
+    /* Before ADC start, so no scan is collected into s_blk[1]
+     * yet: publish it as one zero block */
+    len = build_stream_packet(s_pkt[0], s_blk[1], 0);
+    SPI1_Slave_SetTxBuffer(s_pkt[0], len);
+#else
+    uint16_t adc[ADC_NUM_CHANNELS] = {0};
+    uint16_t temp_x10 = 0;
+    uint16_t gas_raw;
+    uint8_t  ch;
+
+    /* Counters restart on every reset, warm or cold (already 0
+     * from .bss on the MCU; the HIL reset reuses the statics) */
+    s_pub_cnt  = 0;
+    s_scan_cnt = 0;
+    s_pub_scan = 0;
+
+    /* Warm start: the restored ring is already a full window,
+     * so the very first frame carries the pre-reset values
+     * and alarm flags instead of zeros. */
+    if (WarmStart_WasWarm())
+    {
+        for (ch = 0; ch < ADC_NUM_CHANNELS; ch++)
+            adc[ch] = filtered(ch);
+        read_temp_gas(&temp_x10, &gas_raw);
+        Actuator_SetState(FireLogic_GetState());
+    }
+    s_pub_st = make_status();
+    build_packet(g_spi_packet[s_frame], s_pub_st, adc, temp_x10, 0);
+    SPI1_Slave_SetTxBuffer(g_spi_packet[s_frame], PACKET_LEN);
+#endif
 }
 
 /*------------------------------------------------------------
  *  Greenhouse_OnAdcReady  Callback t? DMA2 Stream0 TC IRQ
  *
  *  y l hm ch?y trong ISR context (DMA IRQ priority 1).
- *  Ph?i th?c thi nhanh, khng blocking.
- *
- *  Lu?ng:
- *    1. Feed 4 m?u ADC th vo b? l?c moving-average
- *    2. ?c temperature & gas d l?c
- *    3. C?p nh?t fire logic state machine (hysteresis)
- *    4. Set target state cho actuator (pattern ch?y trong SysTick)
- *    5. Build STATUS byte cho SPI frame
- *    6. L?y 4 gi tr? ADC d l?c
- *    7. Build SPI packet 16 bytes
- *    8. Reset SPI TX index ? Pi d?c frame m?i t? byte 0
+ *  Only latches the scan and releases SAMPLE: g_adc_buf is
+ *  overwritten by the next scan, s_scan[] is not.  Moves the
+ *  analog watchdog on, and publishes a trip at once.  Raw
+ *  scans go to the waveform recorder and the stream blocks
+ *  here, not in SAMPLE, so neither has gaps when SAMPLE
+ *  overruns (e.g. while PUBLISH Rice-encodes a block).
  *------------------------------------------------------------*/
 void Greenhouse_OnAdcReady(void)
 {
-    uint16_t temp_x10;
-    uint16_t gas_raw;
-    FireState st;
-    uint8_t  gas_flag, temp_flag;
-    uint8_t  status;
-    uint16_t adc[4];
-    uint8_t  ch;
+    uint8_t w = (uint8_t)(s_scan_rd ^ 1U);
+    uint8_t ch;
+
+    for (ch = 0; ch < ADC_NUM_CHANNELS; ch++)
+        s_scan[w][ch] = g_adc_buf[ch];
+    s_scan_ts[w] = g_adc_ts_us;
+    s_scan_rd    = w;
+    Capture_OnScan(s_scan[w], s_scan_ts[w]);
+#if STREAM_ENABLE
+    stream_collect(s_scan[w], s_scan_ts[w]);
+#endif
+
+    if (Awd_OnScan())
+        Sched_Trigger(GH_TASK_PUBLISH);
+    Sched_OnScan();
+}
+
+/*------------------------------------------------------------
+ *  sample_task  SAMPLE, every scan
+ *
+ *    1. Feed N m?u ADC th vo b? l?c moving-average
+ *    2. Raw scan into the read-to-read window (WSTAT_ENABLE)
+ *    3. Kalman + trend debounce (EST_ENABLE, kalman.c)
+ *    4. Mains-window mean + noise meters (MAINS_ENABLE)
+ *    5. DRDY: drop once the Pi has started a read
+ *------------------------------------------------------------*/
+static void sample_task(void)
+{
+    uint8_t r = s_scan_rd;
+    const uint16_t *raw = s_scan[r];
 
     /* 1. ?y m?u ADC th vo b? l?c */
-    ADC_Mgr_FeedSample(g_adc_buf);
+    ADC_Mgr_FeedSample(raw);
+    s_fed_ts = s_scan_ts[r];
+#if !STREAM_ENABLE
+    s_scan_cnt++;
+#endif
+
+#if WSTAT_ENABLE
+    /* 2. Raw scan into the read-to-read window */
+    WinStats_Feed(raw);
+#endif
+
+#if EST_ENABLE
+    /* 3. Kalman: integer sum per scan, FPU update every
+     *    EST_DECIMATE scans (value replaces the moving average),
+     *    trend debounced after each update */
+    (void)Kalman_Feed(raw);
+#endif
 
-    /* 2. ?c gi tr? d l?c */
-    temp_x10 = ADC_Mgr_GetTempX10();    /* 0.1C, v d? 325 = 32.5C */
-    gas_raw  = ADC_Mgr_GetGasRaw();     /* raw ADC 04095            */
+#if MAINS_ENABLE
+    /* 4. Sliding mains-period sum; NOISE / HUM per window */
+    (void)Mains_Feed(raw);
+#endif
 
-    /* 3. C?p nh?t state machine (c hysteresis ch?ng nh?p nhy) */
+    /* 5. DRDY low after a read started */
+    Drdy_OnScan();
+}
+
+/*------------------------------------------------------------
+ *  alarm_task  ALARM, every SCHED_ALARM_MS
+ *
+ *  Hysteresis has no per-call debounce, so 100 Hz only adds
+ *  up to SCHED_ALARM_MS to the filter delay.  A change in a
+ *  DRDY_URGENT_MASK bit is published at once instead of at
+ *  the next SCHED_PUBLISH_MS.
+ *------------------------------------------------------------*/
+static void alarm_task(void)
+{
+    uint16_t temp_x10, gas_raw;
+
+    read_temp_gas(&temp_x10, &gas_raw);
+
+    /* C?p nh?t state machine (c hysteresis ch?ng nh?p nhy) */
     FireLogic_Update(temp_x10, gas_raw);
-    st = FireLogic_GetState();           /* NORMAL / WARN / ALARM     */
 
-    /* 4. Set actuator target state
-     *    (buzzer beep pattern ch?y trong SysTick_Handler m?i 1ms) */
-    Actuator_SetState(st);
+    /* Analog-watchdog emergency: release below ALARM_OFF */
+    Awd_Task(temp_x10, gas_raw);
 
-    /* 5. Build STATUS byte
-     *    Bit 0: Buzzer dang ON?
-     *    Bit 1: Motor dang ON?
-     *    Bit 2: Gas alarm flag (WARN ho?c ALARM)
-     *    Bit 3: Temperature alarm flag (WARN ho?c ALARM) */
-    gas_flag  = (FireLogic_GetGasState()  >= FIRE_STATE_WARN) ? 1U : 0U;
-    temp_flag = (FireLogic_GetTempState() >= FIRE_STATE_WARN) ? 1U : 0U;
+    /* Set actuator target state
+     * (buzzer beep pattern ch?y trong SysTick_Handler m?i 1ms) */
+    Actuator_SetState(FireLogic_GetState());
 
-    status = 0;
-    status |= (Actuator_IsBuzzerOn() ? 1U : 0U) << 0;
-    status |= (Actuator_IsMotorOn()  ? 1U : 0U) << 1;
-    status |= gas_flag  << 2;
-    status |= temp_flag << 3;
+    if ((make_status() ^ s_pub_st) & DRDY_URGENT_MASK)
+        Sched_Trigger(GH_TASK_PUBLISH);
+}
+
+/*------------------------------------------------------------
+ *  publish_task  PUBLISH, every SCHED_PUBLISH_MS
+ *
+ *  Snapshot mode: filtered values of the latest scan fed, with
+ *  its TS_US, into a free row; SPI_NSS_ALIGN latches it at the
+ *  next transaction start.  Stream mode: the next full block,
+ *  if any.  Either way DRDY goes high.
+ *------------------------------------------------------------*/
+static void publish_task(void)
+{
+#if STREAM_ENABLE
+    stream_publish();
+#else
+    uint16_t adc[ADC_NUM_CHANNELS];
+    uint16_t temp_x10, gas_raw;
+    uint8_t  ch;
+    volatile uint8_t *p;
+
+    /* L?y N gi tr? ADC d l?c (cho payload) */
+    for (ch = 0; ch < ADC_NUM_CHANNELS; ch++)
+        adc[ch] = filtered(ch);
+    read_temp_gas(&temp_x10, &gas_raw);
+    s_pub_st = make_status();
 
-    /* 6. L?y 4 gi tr? ADC d l?c (cho payload) */
-    for (ch = 0; ch < 4; ch++)
-        adc[ch] = ADC_Mgr_GetFiltered(ch);
+    /* ng gi SPI frame PACKET_LEN bytes (free row) */
+    p = next_frame();
+    build_packet(p, s_pub_st, adc, temp_x10, s_fed_ts);
 
-    /* 7. ng gi SPI frame 16 bytes */
-    build_packet(status, adc, temp_x10);
+    __disable_irq();
+    SPI1_Slave_SetTxBuffer(p, PACKET_LEN);
+    __enable_irq();
 
-    /* 8. Reset SPI TX pointer ? l?n poll ti?p theo Pi nh?n frame m?i */
-    SPI1_Slave_ResetIndex();
+    Drdy_OnPublish();
+#endif
 }
+
+#if !CAP_ENABLE
+static void capture_task(void) { }
+#endif
+
+/* Priority order = row order; ids in greenhouse.h */
+const SchedTask g_gh_tasks[GH_TASK_COUNT] = {
+    { sample_task,    SCHED_SRC_SCAN, 1U               },  /* GH_TASK_SAMPLE  */
+    { alarm_task,     SCHED_SRC_MS,   SCHED_ALARM_MS   },  /* GH_TASK_ALARM   */
+    { publish_task,   SCHED_SRC_MS,   SCHED_PUBLISH_MS },  /* GH_TASK_PUBLISH */
+    { WarmStart_Task, SCHED_SRC_MS,   WARM_SAVE_MS     },  /* GH_TASK_WARM    */
+    { capture_task,   SCHED_SRC_EVENT, 0U              },  /* GH_TASK_CAPTURE */
+};
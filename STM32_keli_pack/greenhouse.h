@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include "board.h"
+#include "sched.h"
 
 /*============================================================
  *  greenhouse  Logic trung tm h? th?ng
@@ -11,16 +12,30 @@
  *    ADC data (adc_mgr) ? Alarm logic (fire_logic)
  *    ? Actuator control ? SPI packet (cho Raspberry Pi)
  *
- *  u?c g?i t? DMA2 TC IRQ m?i khi 4 knh ADC hon t?t scan.
+ *  The DMA2 TC IRQ hands each scan over; the work runs as
+ *  scheduler tasks at three rates (board.h Section 11).
  *============================================================*/
 
 /* SPI TX buffer  chia s? v?i SPI_LIB qua SetTxBuffer() */
-extern volatile uint8_t g_spi_packet[PACKET_LEN];
+#define GH_TX_BUFS  3   /* pending + on the wire + being built */
+extern volatile uint8_t g_spi_packet[GH_TX_BUFS][PACKET_LEN];
 
 /* T?o frame kh?i t?o (all zeros), load vo SPI TX buffer */
 void Greenhouse_InitPacket(void);
 
-/* Callback t? DMA2 TC IRQ ? x? l logic + build frame m?i */
+/* Callback t? DMA2 TC IRQ ? latch scan, release SAMPLE */
 void Greenhouse_OnAdcReady(void);
 
+/* EXTI4 (NSS rise): MOSI command, released to CAPTURE */
+void Greenhouse_OnCommand(const uint8_t cmd[CMD_LEN]);
+
+/* Task table for Sched_Init(): row = id = priority */
+#define GH_TASK_SAMPLE   0U     /* filters, every scan            */
+#define GH_TASK_ALARM    1U     /* fire_logic, SCHED_ALARM_MS     */
+#define GH_TASK_PUBLISH  2U     /* SPI frame, SCHED_PUBLISH_MS    */
+#define GH_TASK_WARM     3U     /* backup SRAM, WARM_SAVE_MS      */
+#define GH_TASK_CAPTURE  4U     /* commands + capture replies     */
+#define GH_TASK_COUNT    5U
+extern const SchedTask g_gh_tasks[GH_TASK_COUNT];
+
 #endif /* _GREENHOUSE_H_ */
@@ -0,0 +1,468 @@
+#include <math.h>
+#include <string.h>
+#include "hil.h"
+#include "DMA_LIB.h"        /* g_adc_buf[] extern                 */
+#include "SPI_LIB.h"        /* SPI1_Slave_SetTxBuffer/Reset       */
+#include "adc_mgr.h"
+#include "fire_logic.h"
+#include "actuators.h"
+#include "kalman.h"
+#include "greenhouse.h"
+#include "warm_start.h"
+#include "win_stats.h"
+#include "drdy.h"
+#include "sched.h"
+#include "awd.h"
+#include "capture.h"
+#include "mains.h"
+#include "frame_pack.h"     /* Frame_Pack (--check-protocol)      */
+#include "RCC_STM32_LIB.h"  /* RCC_RST_* flags                    */
+
+/*============================================================
+ *  hil.c – Host BSP for the virtual STM32 (see hil.h)
+ *
+ *  Build (done by gui_spi_greenhouse.py --hil):
+ *    gcc -shared -fPIC -O2 -Wall -Wextra -Ihil -I. hil/hil.c \
+ *        adc_mgr.c fire_logic.c actuators.c greenhouse.c \
+ *        stream_codec.c cal_lut.c kalman.c warm_start.c \
+ *        win_stats.c drdy.c sched.c awd.c capture.c mains.c -lm
+ *  (-Werror is added for --check-protocol and the benches)
+ *
+ *  Event order inside HIL_Advance() follows NVIC priorities:
+ *  when a scan and a SysTick fall on the same instant, the DMA
+ *  TC (priority 1) runs before SysTick (priority 3).  After
+ *  each of them, one pass of main()'s loop runs the released
+ *  scheduler tasks.  An analog-watchdog trip (priority 0) is
+ *  handled at the scan instant, ahead of its DMA TC.
+ *
+ *  Backup SRAM is a static array that HIL_Reset() keeps and
+ *  HIL_PowerCycle() wipes, so both warm and cold boots of
+ *  warm_start.c run unmodified.
+ *============================================================*/
+
+/* Scan period comes from board.h ADC_SCAN_NS (§3) */
+#define HIL_SYSTICK_NS      1000000UL
+
+/* ═══════════ BSP stand-ins ═══════════ */
+
+volatile uint16_t g_adc_buf[ADC_NUM_CHANNELS];   /* ADC_DMA_LIB.c */
+volatile uint32_t g_adc_ts_us;                   /* TIM5 at the TC */
+
+static GPIO_TypeDef s_gpiob;
+
+GPIO_TypeDef *HIL_GpioB(void)
+{
+    uint32_t bsrr = s_gpiob.BSRR;
+
+    if (bsrr)
+    {
+        /* BSy wins over BRy, as on the real port */
+        s_gpiob.ODR  = (s_gpiob.ODR & ~(bsrr >> 16)) | (bsrr & 0xFFFFU);
+        s_gpiob.BSRR = 0;
+    }
+    return &s_gpiob;
+}
+
+/* SPI1 slave — same TX bookkeeping as SPI_LIB.c */
+static volatile uint8_t  *g_tx  = 0;
+static volatile uint16_t  g_len = 0;
+static volatile uint16_t  g_idx = 0;
+static uint8_t            s_dr  = 0;   /* byte waiting in SPI1->DR */
+static volatile uint8_t  *g_pend_tx  = 0;
+static volatile uint16_t  g_pend_len = 0;
+static uint8_t            g_latch    = 0;
+static uint32_t           g_tx_count = 0;
+static volatile uint8_t  *g_reply_tx  = 0;
+static volatile uint16_t  g_reply_len = 0;
+static uint8_t            g_rx[CMD_LEN];  /* first MOSI bytes      */
+static uint8_t            g_rx_n = 0;
+
+void SPI1_Slave_SetTxBuffer(volatile uint8_t *buf, uint16_t len)
+{
+#if SPI_NSS_ALIGN
+    g_pend_tx  = buf;
+    g_pend_len = len;
+#else
+    g_tx  = buf;
+    g_len = len;
+    g_idx = 0;
+#endif
+}
+
+void SPI1_Slave_SetReply(volatile uint8_t *buf, uint16_t len)
+{
+    g_reply_tx  = buf;
+    g_reply_len = len;
+}
+
+void SPI1_Slave_ResetIndex(void)
+{
+    g_idx = 0;
+}
+
+volatile uint8_t *SPI1_Slave_GetActive(void)
+{
+    return g_tx;
+}
+
+uint32_t SPI1_Slave_GetTxCount(void)
+{
+    return g_tx_count;
+}
+
+/* SPI1_IRQHandler body: keep the MOSI byte, next TX byte
+ * (wrapping at g_len) */
+static uint8_t spi_rxne(uint8_t mosi)
+{
+    uint8_t b;
+
+    if (g_rx_n < CMD_LEN)
+        g_rx[g_rx_n++] = mosi;
+
+    if (g_latch)
+    {
+        g_latch = 0;
+        if (g_reply_tx)
+        {
+            g_tx  = g_reply_tx;
+            g_len = g_reply_len;
+            g_reply_tx = 0;
+        }
+        else
+        {
+            g_tx  = g_pend_tx;
+            g_len = g_pend_len;
+        }
+        g_tx_count++;
+    }
+    if (!(g_tx && g_len)) return 0x00;
+#if !SPI_NSS_ALIGN
+    if (g_idx == 0) g_tx_count++;
+#endif
+    b = g_tx[g_idx++];
+    if (g_idx >= g_len) g_idx = 0;
+    return b;
+}
+
+/* EXTI4 on NSS rise: hand over a command (main()'s loop then
+ * runs CAPTURE), then spi1_arm(): SPI1 reset, byte 0 into DR */
+static void spi_nss_rise(void)
+{
+#if SPI_NSS_ALIGN
+    if (g_rx_n == CMD_LEN && g_rx[0] == CMD_MAGIC)
+    {
+        Greenhouse_OnCommand(g_rx);
+        Sched_Run();
+        (void)HIL_GpioB();
+    }
+    g_rx_n  = 0;
+    g_idx   = 0;
+    g_latch = 1;
+    s_dr    = 0;
+    if (g_pend_tx && g_pend_len)
+    {
+        s_dr  = g_pend_tx[0];
+        g_idx = 1;
+    }
+#endif
+}
+
+/* Backup SRAM + RCC_CSR reset flags (RCC_STM32_LIB.c) */
+static uint32_t s_bkpsram[4096 / 4];
+static uint32_t s_rst_flags = RCC_RST_POR | RCC_RST_BOR | RCC_RST_PIN;
+
+void *RCC_Enable_BackupSRAM(void)
+{
+    return s_bkpsram;
+}
+
+uint32_t RCC_TakeResetFlags(void)
+{
+    uint32_t f = s_rst_flags;
+    s_rst_flags = 0;
+    return f;
+}
+
+/* ADC1 analog watchdog (ADC_DMA_LIB.c): guarded scan slot,
+ * HTR, and the NVIC enable of the one-shot ADC_IRQn         */
+static uint8_t  s_awd_idx     = 0;
+static uint16_t s_awd_high    = ADC_RESOLUTION;
+static uint8_t  s_awd_irq     = 0;
+static uint64_t s_awd_trip_ns = 0;
+
+void ADC1_Awd_Guard(uint8_t idx, uint16_t high)
+{
+    s_awd_idx  = idx;
+    s_awd_high = high;
+}
+
+void ADC1_Awd_Arm(void)
+{
+    s_awd_irq = 1;
+}
+
+/* ═══════════ Virtual time ═══════════ */
+
+static uint16_t s_inputs[ADC_NUM_CHANNELS];
+static uint16_t s_hum_amp;              /* HIL_SetHum, LSB peak  */
+static double   s_hum_w;                /* rad per ns            */
+static uint64_t s_now_ns;
+static uint64_t s_next_scan_ns;
+static uint64_t s_next_tick_ns;
+static uint32_t s_scan_ns;
+static uint32_t s_scans;
+
+static DWT_Type       s_dwt;
+static CoreDebug_Type s_coredebug;
+
+DWT_Type *HIL_Dwt(void)
+{
+    s_dwt.CYCCNT = (uint32_t)(s_now_ns * (SYS_CLOCK_HZ / 1000000UL) / 1000ULL);
+    return &s_dwt;
+}
+
+CoreDebug_Type *HIL_CoreDebug(void)
+{
+    return &s_coredebug;
+}
+
+/* What a conversion at s_now_ns reads: the held input plus the
+ * injected hum, clamped to 12 bits                          */
+static uint16_t convert(uint8_t ch)
+{
+    double v = s_inputs[ch];
+
+    if (s_hum_amp)
+        v += s_hum_amp * sin(s_hum_w * (double)s_now_ns);
+    if (v <= 0.0) return 0;
+    if (v >= ADC_RESOLUTION) return ADC_RESOLUTION;
+    return (uint16_t)(v + 0.5);
+}
+
+static void run_until(uint64_t t_ns)
+{
+    uint8_t ch;
+
+    for (;;)
+    {
+        if (s_next_scan_ns <= s_next_tick_ns)
+        {
+            if (s_next_scan_ns > t_ns) break;
+            s_now_ns = s_next_scan_ns;
+
+            /* ADC_IRQHandler: the guarded slot converted over HTR.
+             * Handled here, but timestamped at that slot's EOC
+             * inside the scan (HIL_AwdTripNs) */
+            if (s_awd_irq && s_inputs[s_awd_idx] > s_awd_high)
+            {
+                s_awd_irq     = 0;
+                s_awd_trip_ns = s_now_ns - s_scan_ns
+                              + (uint64_t)s_scan_ns * (s_awd_idx + 1U)
+                                / ADC_NUM_CHANNELS;
+                Awd_OnTrip();
+                (void)HIL_GpioB();
+            }
+
+            /* DMA2_Stream0_IRQHandler: scan landed in g_adc_buf */
+            for (ch = 0; ch < ADC_NUM_CHANNELS; ch++)
+                g_adc_buf[ch] = convert(ch);
+            g_adc_ts_us = (uint32_t)(s_now_ns * TS_CLOCK_HZ / 1000000000ULL);
+            Greenhouse_OnAdcReady();
+            Sched_Run();
+
+            s_next_scan_ns += s_scan_ns;
+            s_scans++;
+        }
+        else
+        {
+            if (s_next_tick_ns > t_ns) break;
+            s_now_ns = s_next_tick_ns;
+
+            /* SysTick_Handler, then one pass of main()'s loop */
+            Actuator_Tick1ms();
+            Sched_Tick1ms();
+            (void)HIL_GpioB();
+            Sched_Run();
+
+            s_next_tick_ns += HIL_SYSTICK_NS;
+        }
+    }
+    s_now_ns = t_ns;
+}
+
+/* ═══════════ API ═══════════ */
+
+void HIL_Reset(void)
+{
+    /* What a reset leaves in RCC_CSR when none was reported yet */
+    if (s_rst_flags == 0)
+        s_rst_flags = RCC_RST_PIN;
+
+    memset(&s_gpiob, 0, sizeof(s_gpiob));
+    memset(s_inputs, 0, sizeof(s_inputs));
+    s_hum_amp = 0;
+    g_tx  = 0;
+    g_len = 0;
+    g_idx = 0;
+    s_dr  = 0;
+    g_pend_tx  = 0;
+    g_pend_len = 0;
+    g_latch    = 0;
+    g_reply_tx = 0;
+    g_rx_n     = 0;
+
+    s_scan_ns = (uint32_t)ADC_SCAN_NS;
+    s_now_ns       = 0;
+    /* ADON → TIM11 (ADC_STAB_US) → SWSTART / TIM2 → first scan */
+    s_next_scan_ns = (uint64_t)ADC_STAB_US * 1000ULL + s_scan_ns;
+    s_next_tick_ns = HIL_SYSTICK_NS;
+    s_scans        = 0;
+    g_adc_ts_us    = 0;                 /* TIM5 restarts at reset */
+    s_awd_idx      = 0;                 /* ADC1_Awd_Init()        */
+    s_awd_high     = ADC_RESOLUTION;
+    s_awd_irq      = AWD_ENABLE;
+    s_awd_trip_ns  = 0;
+
+    /* Same order as main() */
+    ADC_Mgr_Init();
+    Kalman_Init();
+    WinStats_Init();
+    FireLogic_Init();
+    Actuator_Init();
+    Awd_Init();
+    Capture_Init();
+    Mains_Init();
+    WarmStart_Restore();
+    (void)HIL_GpioB();
+    Greenhouse_InitPacket();
+    spi_nss_rise();                     /* SPI1_Slave_Init()    */
+    Drdy_Init();
+    Sched_Init(g_gh_tasks, GH_TASK_COUNT);
+}
+
+void HIL_PowerCycle(void)
+{
+    /* Backup domain loses power too: content is garbage */
+    memset(s_bkpsram, 0xA5, sizeof(s_bkpsram));
+    s_rst_flags = RCC_RST_POR | RCC_RST_BOR | RCC_RST_PIN;
+    HIL_Reset();
+}
+
+uint8_t  HIL_WarmStarted(void)   { return WarmStart_WasWarm(); }
+
+uint8_t  HIL_NumChannels(void)   { return ADC_NUM_CHANNELS; }
+uint8_t  HIL_StreamEnabled(void) { return STREAM_ENABLE; }
+uint8_t  HIL_WstatEnabled(void)  { return WSTAT_ENABLE; }
+uint8_t  HIL_MainsEnabled(void)  { return MAINS_ENABLE; }
+uint32_t HIL_ScanPeriodNs(void)  { return s_scan_ns; }
+uint64_t HIL_NowNs(void)         { return s_now_ns; }
+uint32_t HIL_ScanCount(void)     { return s_scans; }
+
+void HIL_SetAdc(const uint16_t *adc)
+{
+    uint8_t ch;
+    for (ch = 0; ch < ADC_NUM_CHANNELS; ch++)
+        s_inputs[ch] = (uint16_t)(adc[ch] & 0x0FFFU);
+}
+
+void HIL_SetHum(uint16_t amp_lsb, uint32_t freq_mhz)
+{
+    s_hum_amp = amp_lsb;
+    s_hum_w   = 2.0 * 3.14159265358979 * freq_mhz * 1e-12;
+}
+
+void HIL_Advance(uint32_t us)
+{
+    run_until(s_now_ns + (uint64_t)us * 1000ULL);
+}
+
+/*------------------------------------------------------------
+ *  HIL_SpiXfer – One NSS-low transaction from the master
+ *
+ *  IDEAL: bytes come straight from the TX buffer, firmware is
+ *         frozen for the duration (useful for logic tests).
+ *  WIRE : each byte takes 8/hz s of virtual time, so DMA TC
+ *         ISRs (and their frame publishes) land between bytes,
+ *         and the byte on MISO is the one the previous RXNE ISR
+ *         (or the NSS-rise re-arm) wrote to DR — the alignment
+ *         the Pi really sees.
+ *
+ *  Full duplex: buf holds the MOSI bytes on entry (zeros, or
+ *  a command, board.h §7) and the MISO bytes on return.
+ *  With SPI_NSS_ALIGN both models end with the NSS rising edge.
+ *------------------------------------------------------------*/
+void HIL_SpiXfer(uint8_t *buf, uint16_t n, uint32_t hz, uint8_t model)
+{
+    uint64_t byte_ns;
+    uint16_t i;
+
+    if (model != HIL_SPI_WIRE)
+    {
+#if SPI_NSS_ALIGN
+        /* byte 0 comes from the armed DR, the rest from the latch */
+        if (n > 0 && g_latch)
+        {
+            uint8_t mosi = buf[0];
+
+            buf[0] = s_dr;
+            for (i = 1; i < n; i++)
+            {
+                uint8_t next = buf[i];
+
+                buf[i] = spi_rxne(mosi);
+                mosi   = next;
+            }
+            (void)spi_rxne(mosi);
+            spi_nss_rise();
+            return;
+        }
+#endif
+        for (i = 0; i < n; i++)
+            buf[i] = spi_rxne(buf[i]);
+        return;
+    }
+
+    byte_ns = 8000000000ULL / (hz ? hz : SPI_CLOCK_HZ);
+    for (i = 0; i < n; i++)
+    {
+        uint8_t mosi = buf[i];
+
+        run_until(s_now_ns + byte_ns);
+        buf[i] = s_dr;                  /* shifted out this byte  */
+        s_dr   = spi_rxne(mosi);        /* RXNE ISR refills DR    */
+    }
+    spi_nss_rise();
+}
+
+void HIL_PackFrame(uint8_t *dst, uint8_t seq, uint8_t status,
+                   const uint16_t *adc, uint16_t temp_x10, uint32_t ts_us,
+                   uint32_t pub_cnt, uint32_t scan_cnt, uint16_t fold)
+{
+    Frame_Pack(dst, seq, status, adc, temp_x10, ts_us,
+               pub_cnt, scan_cnt, fold);
+}
+
+uint8_t HIL_BuzzerOn(void)  { return Actuator_IsBuzzerOn(); }
+uint8_t HIL_MotorOn(void)   { return Actuator_IsMotorOn(); }
+uint8_t HIL_FireState(void) { return (uint8_t)FireLogic_GetState(); }
+uint8_t HIL_DrdyLevel(void) { return Drdy_Get(); }
+
+uint8_t  HIL_Emergency(void)   { return Awd_IsActive(); }
+uint16_t HIL_AwdTrips(void)    { return Awd_GetTrips(); }
+uint64_t HIL_AwdTripNs(void)   { return s_awd_trip_ns; }
+
+uint8_t HIL_SchedTasks(void) { return GH_TASK_COUNT; }
+
+void HIL_SchedStats(uint8_t id, uint32_t out[HIL_SCHED_STATS])
+{
+    const SchedStats *st = Sched_GetStats(id);
+
+    memset(out, 0, HIL_SCHED_STATS * sizeof(uint32_t));
+    if (st == 0)
+        return;
+    out[0] = st->runs;
+    out[1] = st->overruns;
+    out[2] = st->last_cyc;
+    out[3] = st->max_cyc;
+    out[4] = st->max_late;
+}
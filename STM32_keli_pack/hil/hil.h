@@ -0,0 +1,99 @@
+#ifndef _HIL_H_
+#define _HIL_H_
+
+#include <stdint.h>
+#include "board.h"
+
+/*============================================================
+ *  hil – Virtual STM32 for hardware-in-the-loop tests on a PC
+ *
+ *  The real service layer (adc_mgr, fire_logic, actuators,
+ *  greenhouse, stream_codec) is compiled for the host together
+ *  with hil.c into a shared library.  hil.c replaces the BSP:
+ *
+ *    ADC + DMA  → HIL_SetAdc() inputs, one "DMA TC" per scan
+ *                 period (same timing as ADC1 at 8 MHz ADCCLK)
+ *    ADC AWD    → guarded input over HTR → Awd_OnTrip() just
+ *                 before that scan's TC
+ *    TIM5       → g_adc_ts_us = virtual time in µs at each TC
+ *    SysTick    → Actuator_Tick1ms() + Sched_Tick1ms() every
+ *                 virtual 1 ms
+ *    main loop  → Sched_Run() after every DMA TC and SysTick
+ *    DWT        → CYCCNT = virtual time in SYS_CLOCK_HZ cycles
+ *    SPI1 slave → HIL_SpiXfer() clocks bytes out of the buffer
+ *                 set by SPI1_Slave_SetTxBuffer() (or a one-
+ *                 shot reply), MOSI commands at the NSS rise
+ *    GPIOB      → static port; PB0/PB1 actuators, PB2 DRDY
+ *
+ *  Time is virtual (HIL_Advance); the host decides how it maps
+ *  to the wall clock.  Python side: greenhouse_hil.py,
+ *  class HilSpiDev.
+ *============================================================*/
+
+/* SPI timing models for HIL_SpiXfer() */
+#define HIL_SPI_IDEAL    0   /* transfer is atomic, no DR latch lag */
+#define HIL_SPI_WIRE     1   /* ISRs interleave per byte at bus
+                                speed, DR holds the byte loaded on
+                                the previous RXNE (as on silicon)   */
+
+/* System reset (NRST / watchdog): same init order as main(),
+ * virtual time = 0, backup SRAM kept → warm start.  The first
+ * call after loading the library is a power-on.              */
+void     HIL_Reset(void);
+
+/* Power-on reset: backup SRAM lost → cold start */
+void     HIL_PowerCycle(void);
+
+/* 1 if the last reset restored state from backup SRAM */
+uint8_t  HIL_WarmStarted(void);
+
+/* Build-time facts of this firmware image */
+uint8_t  HIL_NumChannels(void);
+uint8_t  HIL_StreamEnabled(void);
+uint8_t  HIL_WstatEnabled(void);
+uint8_t  HIL_MainsEnabled(void);
+uint32_t HIL_ScanPeriodNs(void);
+
+/* Analog inputs (raw 0..4095, ADC_NUM_CHANNELS values),
+ * held until changed — what every following scan converts */
+void     HIL_SetAdc(const uint16_t *adc);
+
+/* Mains hum on every input: amp_lsb · sin(2π f t) added to
+ * each conversion, f in mHz (50 Hz = 50000).  0 = off.       */
+void     HIL_SetHum(uint16_t amp_lsb, uint32_t freq_mhz);
+
+/* Run firmware for us microseconds of virtual time */
+void     HIL_Advance(uint32_t us);
+uint64_t HIL_NowNs(void);
+
+/* Master transfer of n bytes at hz, full duplex: buf holds
+ * the MOSI bytes (commands, board.h §7), MISO bytes → buf   */
+void     HIL_SpiXfer(uint8_t *buf, uint16_t n, uint32_t hz, uint8_t model);
+
+/* Generated packer (frame_pack.h) on caller fields: PACKET_LEN
+ * bytes → dst, blocks from the modules' current state       */
+void     HIL_PackFrame(uint8_t *dst, uint8_t seq, uint8_t status,
+                       const uint16_t *adc, uint16_t temp_x10,
+                       uint32_t ts_us, uint32_t pub_cnt,
+                       uint32_t scan_cnt, uint16_t fold);
+
+/* Observability */
+uint8_t  HIL_BuzzerOn(void);
+uint8_t  HIL_MotorOn(void);
+uint8_t  HIL_FireState(void);
+uint8_t  HIL_DrdyLevel(void);      /* PB2, data-ready line to the Pi */
+uint32_t HIL_ScanCount(void);
+
+/* Analog watchdog (board.h §12): STATUS bit 5 now, trips since
+ * reset, virtual time of the last trip (guarded slot's EOC)  */
+uint8_t  HIL_Emergency(void);
+uint16_t HIL_AwdTrips(void);
+uint64_t HIL_AwdTripNs(void);
+
+/* Scheduler: number of tasks (greenhouse.h GH_TASK_*), and per
+ * task id runs, overruns, last / max run cycles, max lateness */
+#define HIL_SCHED_STATS  5
+uint8_t  HIL_SchedTasks(void);
+void     HIL_SchedStats(uint8_t id, uint32_t out[HIL_SCHED_STATS]);
+
+#endif /* _HIL_H_ */
@@ -0,0 +1,57 @@
+#ifndef _HIL_STM32F4XX_H_
+#define _HIL_STM32F4XX_H_
+
+#include <stdint.h>
+
+/*============================================================
+ *  hil/stm32f4xx.h – Host stand-in for the CMSIS device header
+ *
+ *  Only for the host HIL library (see hil.h).  Provides just
+ *  what the service-layer sources touch: GPIOB for the
+ *  actuators and DRDY, the DWT cycle counter for sched.c, and
+ *  the interrupt-mask / sleep intrinsics.
+ *  Never put this directory on the Keil include path.
+ *============================================================*/
+
+typedef struct
+{
+    volatile uint32_t ODR;
+    volatile uint32_t BSRR;
+} GPIO_TypeDef;
+
+/* Every GPIOB access goes through HIL_GpioB(), which first
+ * commits the previous BSRR write into ODR.  That gives the
+ * real port's one-write-at-a-time set/reset behaviour even
+ * though a host struct cannot react to a store.              */
+GPIO_TypeDef *HIL_GpioB(void);
+#define GPIOB                 (HIL_GpioB())
+
+/* DWT cycle counter: CYCCNT reads virtual time in SYS_CLOCK_HZ
+ * cycles.  Firmware code takes no virtual time, so task run
+ * times come out 0 and lateness counts only whole events.    */
+typedef struct
+{
+    volatile uint32_t CTRL;
+    volatile uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct
+{
+    volatile uint32_t DEMCR;
+} CoreDebug_Type;
+
+DWT_Type       *HIL_Dwt(void);
+CoreDebug_Type *HIL_CoreDebug(void);
+#define DWT                        (HIL_Dwt())
+#define CoreDebug                  (HIL_CoreDebug())
+#define DWT_CTRL_CYCCNTENA_Msk     (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+
+/* Single-threaded host: ISRs never preempt, masking is a no-op */
+static inline void __disable_irq(void) { }
+static inline void __enable_irq(void)  { }
+
+/* HIL_Advance() is the "interrupt": nothing to wait for here */
+static inline void __WFI(void)         { }
+
+#endif /* _HIL_STM32F4XX_H_ */
@@ -0,0 +1,236 @@
+#include "kalman.h"
+
+/*============================================================
+ *  kalman.c – Per-channel value + slope Kalman filter
+ *
+ *  State x = [v, s]  (LSB, LSB/s),  F = [1 dt; 0 1],  H = [1 0]
+ *  Q = q · [dt³/3  dt²/2; dt²/2  dt]   (white slope-rate noise)
+ *  R = EST_R_LSB2 / EST_DECIMATE       (variance of a scan mean)
+ *
+ *  P is symmetric, so only p00, p01, p11 are kept.  One update
+ *  is ~25 single-precision FLOPs per channel, so the whole
+ *  filter bank costs a few µs per EST_DECIMATE scans.
+ *
+ *  The TREND debounce lives here too, so that the estimator
+ *  state warm_start.c saves is complete.
+ *============================================================*/
+
+static KalmanCh s_k[ADC_NUM_CHANNELS];
+static uint32_t s_acc[ADC_NUM_CHANNELS];   /* sum of raw scans     */
+static uint8_t  s_cnt    = 0;              /* scans in s_acc       */
+static uint8_t  s_primed = 0;              /* first update done    */
+static uint16_t s_trend_cnt = 0;           /* up/down debounce     */
+static uint8_t  s_trend     = 0;           /* STATUS_BIT_TREND     */
+
+#define EST_R          (EST_R_LSB2 / (float)EST_DECIMATE)
+#define EST_Q00        (EST_Q_LSB2 * EST_DT_S * EST_DT_S * EST_DT_S / 3.0f)
+#define EST_Q01        (EST_Q_LSB2 * EST_DT_S * EST_DT_S / 2.0f)
+#define EST_Q11        (EST_Q_LSB2 * EST_DT_S)
+#define EST_P11_INIT   1.0e6f              /* slope unknown at start */
+
+#if (EST_DECIMATE < 1) || (EST_DECIMATE > 255)
+#error "EST_DECIMATE must be 1..255"
+#endif
+
+/*------------------------------------------------------------
+ *  Kalman_Init
+ *------------------------------------------------------------*/
+void Kalman_Init(void)
+{
+    uint8_t ch;
+    for (ch = 0; ch < ADC_NUM_CHANNELS; ch++)
+    {
+        s_acc[ch]   = 0;
+        s_k[ch].v   = 0.0f;
+        s_k[ch].s   = 0.0f;
+        s_k[ch].p00 = 0.0f;
+        s_k[ch].p01 = 0.0f;
+        s_k[ch].p11 = 0.0f;
+    }
+    s_cnt       = 0;
+    s_primed    = 0;
+    s_trend_cnt = 0;
+    s_trend     = 0;
+}
+
+/*------------------------------------------------------------
+ *  step – Predict + update one channel with measurement z
+ *------------------------------------------------------------*/
+static void step(KalmanCh *k, float z)
+{
+    const float dt = EST_DT_S;
+    float inv, k0, k1, y;
+
+    /* Predict: x = F x,  P = F P Fᵀ + Q */
+    k->v   += k->s * dt;
+    k->p00 += dt * (2.0f * k->p01 + dt * k->p11) + EST_Q00;
+    k->p01 += dt * k->p11 + EST_Q01;
+    k->p11 += EST_Q11;
+
+    /* Update: K = P Hᵀ / (H P Hᵀ + R) */
+    inv = 1.0f / (k->p00 + EST_R);
+    k0  = k->p00 * inv;
+    k1  = k->p01 * inv;
+    y   = z - k->v;
+
+    k->v   += k0 * y;
+    k->s   += k1 * y;
+    k->p11 -= k1 * k->p01;
+    k->p01 *= 1.0f - k0;
+    k->p00 *= 1.0f - k0;
+}
+
+/*------------------------------------------------------------
+ *  trend_update – After each update: count up while either
+ *  slope is over its limit, down otherwise; ON at
+ *  EST_TREND_HOLD, OFF back at 0
+ *------------------------------------------------------------*/
+static void trend_update(void)
+{
+    if (s_k[ADC_IDX_LM35].s >= EST_TEMP_TREND_LSB_S ||
+        s_k[ADC_IDX_GAS].s  >= EST_GAS_TREND_LSB_S)
+    {
+        if (s_trend_cnt < EST_TREND_HOLD) s_trend_cnt++;
+    }
+    else if (s_trend_cnt > 0)
+    {
+        s_trend_cnt--;
+    }
+    if (s_trend_cnt >= EST_TREND_HOLD) s_trend = 1U;
+    if (s_trend_cnt == 0)              s_trend = 0U;
+}
+
+/*------------------------------------------------------------
+ *  Kalman_Feed – Called from the SAMPLE task on every scan
+ *
+ *  Integer accumulation per scan; the float work happens once
+ *  per EST_DECIMATE scans.
+ *------------------------------------------------------------*/
+uint8_t Kalman_Feed(const volatile uint16_t raw[ADC_NUM_CHANNELS])
+{
+    uint8_t ch;
+    float   z;
+
+    for (ch = 0; ch < ADC_NUM_CHANNELS; ch++)
+        s_acc[ch] += raw[ch];
+
+    if (++s_cnt < EST_DECIMATE) return 0;
+    s_cnt = 0;
+
+    for (ch = 0; ch < ADC_NUM_CHANNELS; ch++)
+    {
+        z = (float)s_acc[ch] * (1.0f / (float)EST_DECIMATE);
+        s_acc[ch] = 0;
+
+        if (!s_primed)
+        {
+            s_k[ch].v   = z;
+            s_k[ch].s   = 0.0f;
+            s_k[ch].p00 = EST_R;
+            s_k[ch].p01 = 0.0f;
+            s_k[ch].p11 = EST_P11_INIT;
+        }
+        else
+        {
+            step(&s_k[ch], z);
+        }
+    }
+    s_primed = 1;
+    trend_update();
+    return 1;
+}
+
+/*------------------------------------------------------------
+ *  Kalman_GetValue – Rounded, clamped to the 12-bit range
+ *------------------------------------------------------------*/
+uint16_t Kalman_GetValue(uint8_t ch)
+{
+    float v;
+    if (ch >= ADC_NUM_CHANNELS) return 0;
+    v = s_k[ch].v + 0.5f;
+    if (v <= 0.0f) return 0;
+    if (v >= (float)ADC_RESOLUTION) return (uint16_t)ADC_RESOLUTION;
+    return (uint16_t)v;
+}
+
+/*------------------------------------------------------------
+ *  Kalman_GetValueF – Unrounded, unclamped value estimate
+ *------------------------------------------------------------*/
+float Kalman_GetValueF(uint8_t ch)
+{
+    if (ch >= ADC_NUM_CHANNELS) return 0.0f;
+    return s_k[ch].v;
+}
+
+/*------------------------------------------------------------
+ *  Kalman_GetSlope – LSB per second
+ *------------------------------------------------------------*/
+float Kalman_GetSlope(uint8_t ch)
+{
+    if (ch >= ADC_NUM_CHANNELS) return 0.0f;
+    return s_k[ch].s;
+}
+
+/*------------------------------------------------------------
+ *  Kalman_GetTrend
+ *------------------------------------------------------------*/
+uint8_t Kalman_GetTrend(void)
+{
+    return s_trend;
+}
+
+/*------------------------------------------------------------
+ *  Kalman_Export – WARM task; SAMPLE cannot preempt it
+ *------------------------------------------------------------*/
+void Kalman_Export(KalmanSnapshot *out)
+{
+    uint8_t ch;
+    for (ch = 0; ch < ADC_NUM_CHANNELS; ch++)
+        out->ch[ch] = s_k[ch];
+    out->trend_cnt = s_trend_cnt;
+    out->trend     = s_trend;
+    out->primed    = s_primed;
+}
+
+/*------------------------------------------------------------
+ *  in_range – Not NaN/Inf and inside a sane range
+ *------------------------------------------------------------*/
+static uint8_t in_range(float x)
+{
+    return (uint8_t)(x > -1.0e30f && x < 1.0e30f);
+}
+
+/*------------------------------------------------------------
+ *  Kalman_Import – Boot, before the ADC starts
+ *
+ *  The slot checksum already guards the bytes; this only
+ *  refuses values no running filter can produce.
+ *------------------------------------------------------------*/
+uint8_t Kalman_Import(const KalmanSnapshot *in)
+{
+    uint8_t ch;
+    const KalmanCh *k;
+
+    if (in->primed > 1U || in->trend > 1U ||
+        in->trend_cnt > EST_TREND_HOLD)
+        return 0;
+    for (ch = 0; ch < ADC_NUM_CHANNELS; ch++)
+    {
+        k = &in->ch[ch];
+        if (!in_range(k->v) || !in_range(k->s) || !in_range(k->p01) ||
+            !in_range(k->p00) || k->p00 < 0.0f ||
+            !in_range(k->p11) || k->p11 < 0.0f)
+            return 0;
+    }
+
+    for (ch = 0; ch < ADC_NUM_CHANNELS; ch++)
+    {
+        s_k[ch]   = in->ch[ch];
+        s_acc[ch] = 0;
+    }
+    s_cnt       = 0;
+    s_primed    = in->primed;
+    s_trend_cnt = in->trend_cnt;
+    s_trend     = in->trend;
+    return 1;
+}
@@ -0,0 +1,66 @@
+#ifndef _KALMAN_H_
+#define _KALMAN_H_
+
+#include <stdint.h>
+#include "board.h"
+
+/*============================================================
+ *  kalman – 2-state (value, slope) estimator per ADC channel
+ *
+ *  Constant-velocity model on the Cortex-M4F FPU, fed with the
+ *  mean of every EST_DECIMATE raw scans (board.h Section 4).
+ *  Against a box filter of equal output noise it follows a
+ *  ramp without lag (a box lags by half its length) and
+ *  settles a step in similar time; the slope state gives a
+ *  rate-of-rise for trend alarms.
+ *
+ *  Flow:
+ *    SAMPLE task → Kalman_Feed(scan)        (every scan)
+ *                → Kalman_GetValue() / GetSlope() / GetTrend()
+ *    WARM task   → Kalman_Export()          (warm_start.c)
+ *============================================================*/
+
+/* One channel: value, slope and the symmetric covariance */
+typedef struct {
+    float v;        /* value estimate, LSB       */
+    float s;        /* slope estimate, LSB/s     */
+    float p00, p01, p11;
+} KalmanCh;
+
+/* Estimator state for warm start (warm_start.c keeps it in
+ * backup SRAM).  The partial EST_DECIMATE sum is not kept:
+ * the first update after a restore simply waits for a full
+ * set of new scans.                                          */
+typedef struct {
+    KalmanCh ch[ADC_NUM_CHANNELS];
+    uint16_t trend_cnt;
+    uint8_t  trend;
+    uint8_t  primed;
+} KalmanSnapshot;
+
+/* Reset all channels; the next measurement re-primes them */
+void     Kalman_Init(void);
+
+/* Accumulate one raw scan.  Every EST_DECIMATE-th call runs
+ * predict + update for all channels and returns 1, else 0.   */
+uint8_t  Kalman_Feed(const volatile uint16_t raw[ADC_NUM_CHANNELS]);
+
+/* Value estimate of channel ch, rounded to 0..4095 */
+uint16_t Kalman_GetValue(uint8_t ch);
+
+/* Unrounded value estimate, LSB */
+float    Kalman_GetValueF(uint8_t ch);
+
+/* Slope estimate of channel ch, LSB per second */
+float    Kalman_GetSlope(uint8_t ch);
+
+/* Debounced rising trend (STATUS_BIT_TREND), 0 or 1 */
+uint8_t  Kalman_GetTrend(void);
+
+/* Copy the estimator state out */
+void     Kalman_Export(KalmanSnapshot *out);
+
+/* Load a saved state; 0 = rejected (state left as it was) */
+uint8_t  Kalman_Import(const KalmanSnapshot *in);
+
+#endif /* _KALMAN_H_ */
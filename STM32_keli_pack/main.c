@@ -8,6 +8,14 @@
 #include "adc_mgr.h"
 #include "fire_logic.h"
 #include "actuators.h"
+#include "kalman.h"
+#include "warm_start.h"
+#include "win_stats.h"
+#include "drdy.h"
+#include "sched.h"
+#include "awd.h"
+#include "capture.h"
+#include "mains.h"
 
 /*============================================================
  *  main.c  Entry Point
@@ -20,18 +28,23 @@
  *
  *  +-----------------------------------------------------+
  *    APP LAYER (main.c)                                 
- *      Init all ? sleep (WFI)                           
+ *      Init all ? run released tasks, sleep (WFI)       
  *  +-----------------------------------------------------
  *    SERVICE LAYER                                      
  *      adc_mgr.c    : ADC filtering (moving average)    
  *      fire_logic.c : State machine (hysteresis)        
  *      actuators.c  : Buzzer pattern + motor control    
  *      greenhouse.c : Central logic + SPI packet build  
+ *      sched.c      : Multi-rate cooperative tasks      
+ *      awd.c        : Analog-watchdog emergency path    
+ *      capture.c    : Raw waveform capture, pre-trigger 
+ *      mains.c      : Mains-sync average + noise meter  
  *  +-----------------------------------------------------
  *    BSP LAYER (bare-metal register-level)              
  *      RCC_STM32_LIB.c : Clock enable                   
  *      GPIO.c          : Pin configuration               
  *      ADC_DMA_LIB.c   : ADC1 scan + DMA2 circular      
+ *                        (TIM2-triggered, 3)           
  *      SPI_LIB.c       : SPI1 slave + RXNE IRQ          
  *  +-----------------------------------------------------+
  *
@@ -39,25 +52,35 @@
  *
  *  ISR                    Priority   Ch?c nang
  *  ---------------------  --------   ----------------------
- *  DMA2_Stream0_IRQn      1 (cao)   ADC data ? logic ? packet
+ *  ADC_IRQn               0          Analog watchdog: motor +
+ *                                    buzzer ON at once (12)
+ *  DMA2_Stream0_IRQn      1 (cao)   Latch scan ? SAMPLE task
  *  SPI1_IRQn              2 (gi?a)  Tr? byte cho Raspberry Pi
+ *  EXTI4_IRQn             2          NSS rise ? frame t? byte 0
+ *                                    + MOSI commands (7, 13)
  *  SysTick_IRQn           3 (th?p)  Buzzer beep pattern 1ms
+ *                                    + release ALARM / PUBLISH /
+ *                                    WARM tasks (board.h 11)
+ *  TIM1_TRG_COM_TIM11     1          ADC SWSTART (or TIM2 scan
+ *                                    clock start) after tSTAB
  *
  *  -- Lu?ng d? li?u --
  *
- *  Sensors ? ADC1 ? DMA2 ? [IRQ] ? adc_mgr ? fire_logic
- *     ? actuators ? greenhouse (packet) ? SPI1 ? Raspberry Pi
+ *  Sensors ? ADC1 ? DMA2 ? [IRQ] ? SAMPLE: adc_mgr
+ *     ? ALARM: fire_logic ? actuators
+ *     ? PUBLISH: greenhouse (packet) ? SPI1 ? Raspberry Pi
  *============================================================*/
 
 /*------------------------------------------------------------
  *  SysTick_Handler  1 ms periodic interrupt
  *
- *  Ch?c nang: c?p nh?t buzzer beep pattern.
+ *  Ch?c nang: c?p nh?t buzzer beep pattern, release ms tasks.
  *  Priority 3 (th?p nh?t) ? khng block DMA hay SPI.
  *------------------------------------------------------------*/
 void SysTick_Handler(void)
 {
     Actuator_Tick1ms();
+    Sched_Tick1ms();                    /* ALARM / PUBLISH / WARM */
 }
 
 /*------------------------------------------------------------
@@ -95,8 +118,9 @@ static void SysTick_Init(void)
  *    2. GPIO ph?i config tru?c khi dng ADC/SPI
  *    3. Module SW init tru?c khi c data
  *    4. SPI init + packet tru?c khi Pi b?t d?u poll
- *    5. ADC+DMA b?t cu?i cng (b?t d?u t?o IRQ)
- *    6. SysTick b?t sau cng
+ *    5. Task table tru?c khi c IRQ release task
+ *    6. ADC+DMA b?t cu?i cng (b?t d?u t?o IRQ)
+ *    7. SysTick b?t sau cng
  *------------------------------------------------------------*/
 int main(void)
 {
@@ -106,34 +130,49 @@ int main(void)
      *   APB2: ADC1, SPI1                                */
 
     /* -- 2. C?u hnh GPIO pins -- */
-    GPIO_Config_ADC_PA0_PA3_Analog();   /* PA0-PA3: analog input    */
+    GPIO_Config_ADC_Scan_Analog();      /* ADC_SCAN_TABLE: analog   */
     GPIO_Config_SPI1_PA4_PA7_AF5();     /* PA4-PA7: SPI1 AF5       */
     GPIO_Config_Buzzer_PB0_Output();    /* PB0: push-pull output    */
     GPIO_Config_Motor_PB1_Output();     /* PB1: push-pull output    */
+    GPIO_Config_Drdy_PB2_Output();      /* PB2: DRDY line to the Pi */
 
     /* -- 3. Kh?i t?o module ph?n m?m (Service Layer) -- */
     ADC_Mgr_Init();                     /* Reset b? l?c ADC         */
+    Kalman_Init();                      /* Estimator (EST_ENABLE)   */
+    WinStats_Init();                    /* Window (WSTAT_ENABLE)    */
     FireLogic_Init();                   /* State ? NORMAL           */
     Actuator_Init();                    /* Buzzer OFF, Motor OFF    */
+    Awd_Init();                         /* Emergency off (12)      */
+    Capture_Init();                     /* Recorder idle (13)      */
+    Mains_Init();                       /* Window (MAINS_ENABLE)    */
+    WarmStart_Restore();                /* Non-POR reset: reload    */
+    /*   ring + FireState from backup SRAM (board.h Section 9)   */
 
     /* -- 4. SPI1 slave + frame kh?i t?o -- */
-    SPI1_Slave_Init();                  /* SPI1 slave, RXNE IRQ     */
     Greenhouse_InitPacket();            /* Build frame zero ? TX    */
+    SPI1_Slave_Init();                  /* SPI1 slave, RXNE IRQ     */
+    Drdy_Init();                        /* PB2 low, nothing pending */
+    /*   SPI_NSS_ALIGN: Init arms byte 0 of that frame, then
+     *   EXTI4 (NSS rise) re-arms it after every transaction      */
+
+    /* -- 5. Task table: nothing runs until ADC / SysTick -- */
+    Sched_Init(g_gh_tasks, GH_TASK_COUNT);
 
-    /* -- 5. ADC1 scan + DMA2 circular (b?t d?u convert) -- */
-    ADC1_DMA2_Stream0_InitStart();      /* B?t d?u convert 4 knh  */
+    /* -- 6. ADC1 scan + DMA2 circular (b?t d?u convert) -- */
+    ADC1_DMA2_Stream0_InitStart();      /* B?t d?u convert N knh  */
     /*   T? dy DMA TC IRQ s? fire lin t?c,
      *   g?i Greenhouse_OnAdcReady() m?i l?n                     */
 
-    /* -- 6. SysTick 1 ms (cho buzzer beep pattern) -- */
+    /* -- 7. SysTick 1 ms (buzzer pattern + task releases) -- */
     SysTick_Init();
 
-    /* -- 7. Main loop: ng?, t?t c? x? l b?ng interrupt -- */
+    /* -- 8. Main loop: ch?y task d release, r?i ng? -- */
     /*   __WFI() = Wait For Interrupt: CPU ng? cho d?n khi
-     *   c b?t k? IRQ no (DMA, SPI, SysTick).
-     *   Ti?t ki?m di?n, ph h?p cho h? th?ng interrupt-driven. */
+     *   c b?t k? IRQ no (DMA, SPI, SysTick).  ISRs only
+     *   release tasks; every task runs here, one at a time.  */
     while (1)
     {
-        __WFI();
+        Sched_Run();
+        Sched_Idle();
     }
 }
@@ -0,0 +1,199 @@
+#include <math.h>
+#include "mains.h"
+
+/*============================================================
+ *  mains.c – Sliding mains-period average, variance, hum bin
+ *
+ *  W = MAINS_WINDOW_SCANS, C = MAINS_CYCLES.  Per channel:
+ *
+ *    avg   = Σ of the last W scans / W   (ring of W scans)
+ *    NOISE = Σx²/W − (Σx/W)²             over one fixed window
+ *    HUM   = 2 (I² + Q²) / W²            I, Q = Σ x·cos, Σ x·sin
+ *
+ *  with the phase of scan k at k·C/W mains periods, so I and Q
+ *  are the DFT bin of MAINS_HZ and a sine of amplitude A gives
+ *  HUM = A²/2, its power.  Over whole periods Σ cos = Σ sin = 0
+ *  and the DC level drops out of I and Q.
+ *
+ *  Per scan the work is integer only (one MAC each for Σx², I
+ *  and Q); the float maths runs once per closed window.  The
+ *  variance is formed as (W·Σx² − (Σx)²) / W² in 64-bit
+ *  integers first, so a 1 LSB noise floor under a 2000 LSB
+ *  level does not vanish in float cancellation.
+ *============================================================*/
+
+#define MAINS_W        ((uint32_t)MAINS_WINDOW_SCANS)
+#define MAINS_Q15      32767.0f
+#define MAINS_PI       3.14159265f
+#define MAINS_U24_MAX  0xFFFFFFUL
+
+typedef struct {
+    uint64_t sumsq;  /* Σx²  this window      */
+    int64_t  i, q;   /* Σx·cos, Σx·sin (Q15)  */
+    uint32_t sum;    /* Σx   this window      */
+    uint32_t noise;  /* last window, LSB² Q8  */
+    uint32_t hum;    /* last window, LSB² Q8  */
+} MainsCh;
+
+static uint16_t s_ring[MAINS_WINDOW_SCANS][ADC_NUM_CHANNELS];
+static int16_t  s_cos[MAINS_WINDOW_SCANS];  /* cos(2π j / W), Q15 */
+static uint32_t s_avg[ADC_NUM_CHANNELS];    /* Σ over the ring    */
+static MainsCh  s_m[ADC_NUM_CHANNELS];
+static uint16_t s_pos    = 0;   /* ring slot of the next scan      */
+static uint16_t s_k      = 0;   /* scan index in the noise window  */
+static uint16_t s_phase  = 0;   /* (s_k · C) mod W, cos table index */
+static uint8_t  s_full   = 0;   /* ring has wrapped once           */
+static uint8_t  s_nz_seq = 0;   /* noise windows closed            */
+
+/*------------------------------------------------------------
+ *  Mains_Init
+ *------------------------------------------------------------*/
+void Mains_Init(void)
+{
+    uint32_t j;
+    uint8_t  ch;
+    float    c;
+
+    for (j = 0; j < MAINS_W; j++)
+    {
+        c = MAINS_Q15 * cosf(2.0f * MAINS_PI * (float)j / (float)MAINS_W);
+        s_cos[j] = (int16_t)(c >= 0.0f ? c + 0.5f : c - 0.5f);
+        for (ch = 0; ch < ADC_NUM_CHANNELS; ch++)
+            s_ring[j][ch] = 0;
+    }
+    for (ch = 0; ch < ADC_NUM_CHANNELS; ch++)
+    {
+        s_avg[ch]     = 0;
+        s_m[ch].sumsq = 0;
+        s_m[ch].i     = 0;
+        s_m[ch].q     = 0;
+        s_m[ch].sum   = 0;
+        s_m[ch].noise = 0;
+        s_m[ch].hum   = 0;
+    }
+    s_pos    = 0;
+    s_k      = 0;
+    s_phase  = 0;
+    s_full   = 0;
+    s_nz_seq = 0;
+}
+
+/*------------------------------------------------------------
+ *  to_q8 – LSB² (float) → saturating uint24, LSB² × 256
+ *------------------------------------------------------------*/
+static uint32_t to_q8(float v)
+{
+    v = v * 256.0f + 0.5f;
+    if (v <= 0.0f) return 0;
+    if (v >= (float)MAINS_U24_MAX) return MAINS_U24_MAX;
+    return (uint32_t)v;
+}
+
+/*------------------------------------------------------------
+ *  close_window – NOISE / HUM of every channel, then restart
+ *------------------------------------------------------------*/
+static void close_window(void)
+{
+    const float inv_w = 1.0f / (float)MAINS_W;
+    const float inv_q = 1.0f / MAINS_Q15;
+    MainsCh *m;
+    uint64_t var;
+    float    i, q;
+    uint8_t  ch;
+
+    for (ch = 0; ch < ADC_NUM_CHANNELS; ch++)
+    {
+        m   = &s_m[ch];
+        var = MAINS_W * m->sumsq - (uint64_t)m->sum * m->sum;
+        i   = (float)m->i * inv_q * inv_w;
+        q   = (float)m->q * inv_q * inv_w;
+
+        m->noise = to_q8((float)var * inv_w * inv_w);
+        m->hum   = to_q8(2.0f * (i * i + q * q));
+
+        m->sumsq = 0;
+        m->i     = 0;
+        m->q     = 0;
+        m->sum   = 0;
+    }
+    s_nz_seq++;
+}
+
+/*------------------------------------------------------------
+ *  Mains_Feed – Called from the SAMPLE task on every scan
+ *------------------------------------------------------------*/
+uint8_t Mains_Feed(const volatile uint16_t raw[ADC_NUM_CHANNELS])
+{
+    uint16_t *slot = s_ring[s_pos];
+    uint16_t  sp   = (uint16_t)(s_phase + 3U * MAINS_W / 4U);
+    int32_t   c    = s_cos[s_phase];
+    int32_t   s;
+    uint32_t  x;
+    uint8_t   ch;
+
+    /* sin θ = cos(θ − π/2) = T[(j + 3W/4) mod W] */
+    if (sp >= MAINS_W) sp = (uint16_t)(sp - MAINS_W);
+    s = s_cos[sp];
+
+    for (ch = 0; ch < ADC_NUM_CHANNELS; ch++)
+    {
+        x = raw[ch];
+        s_avg[ch] += x - slot[ch];
+        slot[ch]   = (uint16_t)x;
+
+        s_m[ch].sum   += x;
+        s_m[ch].sumsq += (uint64_t)(x * x);
+        s_m[ch].i     += (int32_t)x * c;
+        s_m[ch].q     += (int32_t)x * s;
+    }
+
+    if (++s_pos >= MAINS_W)
+    {
+        s_pos  = 0;
+        s_full = 1;
+    }
+
+    s_phase = (uint16_t)(s_phase + MAINS_CYCLES);
+    if (s_phase >= MAINS_W) s_phase = (uint16_t)(s_phase - MAINS_W);
+
+    if (++s_k < MAINS_W) return 0;
+    s_k = 0;
+    close_window();
+    return 1;
+}
+
+/*------------------------------------------------------------
+ *  Mains_Ready
+ *------------------------------------------------------------*/
+uint8_t Mains_Ready(void)
+{
+    return s_full;
+}
+
+/*------------------------------------------------------------
+ *  Mains_GetValue – Rounded window mean (12-bit by construction)
+ *------------------------------------------------------------*/
+uint16_t Mains_GetValue(uint8_t ch)
+{
+    if (ch >= ADC_NUM_CHANNELS) return 0;
+    return (uint16_t)((s_avg[ch] + MAINS_W / 2U) / MAINS_W);
+}
+
+/*------------------------------------------------------------
+ *  Mains_Pack – NOISE block, little-endian (board.h §7)
+ *------------------------------------------------------------*/
+uint8_t Mains_Pack(volatile uint8_t *dst)
+{
+    uint8_t k = 0;
+    uint8_t ch, i;
+
+    dst[k++] = s_nz_seq;
+    for (ch = 0; ch < ADC_NUM_CHANNELS; ch++)
+    {
+        for (i = 0; i < 3U; i++)
+            dst[k++] = (uint8_t)(s_m[ch].noise >> (8U * i));
+        for (i = 0; i < 3U; i++)
+            dst[k++] = (uint8_t)(s_m[ch].hum >> (8U * i));
+    }
+    return k;
+}
@@ -0,0 +1,40 @@
+#ifndef _MAINS_H_
+#define _MAINS_H_
+
+#include <stdint.h>
+#include "board.h"
+
+/*============================================================
+ *  mains – Mains-synchronous average + noise meter per channel
+ *
+ *  A sliding box average over MAINS_WINDOW_SCANS raw scans,
+ *  which at the timer-triggered scan rate (board.h Section 3)
+ *  spans exactly MAINS_CYCLES mains periods: 50/60 Hz and all
+ *  its harmonics fall in the nulls.  Alongside, each closed
+ *  window yields the scan variance and the power of the
+ *  MAINS_HZ bin for the frame's NOISE block (Section 7).
+ *
+ *  Flow:
+ *    SAMPLE task  → Mains_Feed(scan)            (every scan)
+ *                 → Mains_GetValue()
+ *    PUBLISH task → Mains_Pack(&frame[FRAME_OFF_NOISE])
+ *============================================================*/
+
+/* Empty window and meters; builds the cos table (FPU) */
+void     Mains_Init(void);
+
+/* Add one raw scan.  Returns 1 when it closed a noise window
+ * (NOISE / HUM updated), else 0.                             */
+uint8_t  Mains_Feed(const volatile uint16_t raw[ADC_NUM_CHANNELS]);
+
+/* 1 once the first MAINS_WINDOW_SCANS scans have arrived */
+uint8_t  Mains_Ready(void);
+
+/* Window mean of channel ch, rounded to 0..4095 */
+uint16_t Mains_GetValue(uint8_t ch);
+
+/* Write the NOISE block (board.h Section 7), NOISE_LEN bytes.
+ * Returns the number of bytes written.                       */
+uint8_t  Mains_Pack(volatile uint8_t *dst);
+
+#endif /* _MAINS_H_ */
@@ -0,0 +1,175 @@
+#include "sched.h"
+
+/*============================================================
+ *  sched.c – Release bits set in ISRs, tasks run in thread mode
+ *
+ *  s_pending has one bit per task.  Releases come from two
+ *  interrupt priorities (DMA 1, SysTick 3) and the main loop
+ *  clears bits, so every read-modify-write of it outside the
+ *  DMA ISR runs with interrupts masked.
+ *
+ *  Timing uses the DWT cycle counter (1 count = 1/SYS_CLOCK_HZ);
+ *  differences stay correct across its 32-bit wrap.
+ *============================================================*/
+
+#define SCHED_NOW()   (DWT->CYCCNT)
+
+static const SchedTask *s_tasks = 0;
+static uint8_t  s_n = 0;
+static uint16_t s_left[SCHED_MAX_TASKS];      /* releases to go       */
+static uint32_t s_rel[SCHED_MAX_TASKS];       /* CYCCNT at release    */
+static volatile uint32_t s_pending = 0;       /* bit id = released    */
+static SchedStats s_stats[SCHED_MAX_TASKS];
+
+/*------------------------------------------------------------
+ *  release – caller is an ISR or has interrupts masked
+ *
+ *  A task still pending keeps its first release time, so the
+ *  lateness it reports covers the whole wait.
+ *------------------------------------------------------------*/
+static void release(uint8_t id)
+{
+    uint32_t bit = 1UL << id;
+
+    if (s_pending & bit)
+    {
+        s_stats[id].overruns++;
+        return;
+    }
+    s_rel[id]  = SCHED_NOW();
+    s_pending |= bit;
+}
+
+/* Count down every task of one source, release those at zero */
+static void tick(uint8_t src)
+{
+    uint8_t id;
+
+    for (id = 0; id < s_n; id++)
+    {
+        if (s_tasks[id].src != src) continue;
+        if (--s_left[id] != 0) continue;
+        s_left[id] = s_tasks[id].period;
+        release(id);
+    }
+}
+
+void Sched_Init(const SchedTask *tasks, uint8_t n)
+{
+    uint8_t id;
+
+    if (n > SCHED_MAX_TASKS) n = SCHED_MAX_TASKS;
+
+    __disable_irq();
+    s_tasks   = tasks;
+    s_n       = n;
+    s_pending = 0;
+    for (id = 0; id < n; id++)
+        s_left[id] = tasks[id].period ? tasks[id].period : 1U;
+    __enable_irq();
+    Sched_ClearStats();
+
+    /* DWT cycle counter: trace enable, then the counter itself */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL  |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+/*------------------------------------------------------------
+ *  Sched_OnScan – DMA TC IRQ (highest priority, never preempted
+ *  by another release source, so no masking)
+ *------------------------------------------------------------*/
+void Sched_OnScan(void)
+{
+    tick(SCHED_SRC_SCAN);
+}
+
+/*------------------------------------------------------------
+ *  Sched_Tick1ms – SysTick (DMA may preempt: mask)
+ *------------------------------------------------------------*/
+void Sched_Tick1ms(void)
+{
+    __disable_irq();
+    tick(SCHED_SRC_MS);
+    __enable_irq();
+}
+
+void Sched_Trigger(uint8_t id)
+{
+    if (id >= s_n) return;
+    __disable_irq();
+    release(id);
+    __enable_irq();
+}
+
+/*------------------------------------------------------------
+ *  Sched_Run – Main loop, thread context
+ *
+ *  After every task the scan restarts at index 0: a scan that
+ *  lands while PUBLISH runs is filtered before WARM gets a turn.
+ *------------------------------------------------------------*/
+void Sched_Run(void)
+{
+    uint32_t pend, t0, rel, cyc;
+    uint8_t  id;
+    SchedStats *st;
+
+    for (;;)
+    {
+        pend = s_pending;
+        if (pend == 0) return;
+
+        for (id = 0; (pend & (1UL << id)) == 0; id++) { }
+
+        __disable_irq();
+        s_pending &= ~(1UL << id);
+        rel = s_rel[id];
+        __enable_irq();
+
+        t0 = SCHED_NOW();
+        s_tasks[id].fn();
+        cyc = SCHED_NOW() - t0;
+
+        st = &s_stats[id];
+        st->runs++;
+        st->last_cyc = cyc;
+        if (cyc > st->max_cyc)           st->max_cyc  = cyc;
+        if (t0 - rel > st->max_late)     st->max_late = t0 - rel;
+    }
+}
+
+/*------------------------------------------------------------
+ *  Sched_Idle – WFI with PRIMASK set
+ *
+ *  A release between Sched_Run()'s last check and __WFI would
+ *  otherwise wait for the next interrupt.  With PRIMASK set a
+ *  pending interrupt still ends WFI; it is taken on enable.
+ *------------------------------------------------------------*/
+void Sched_Idle(void)
+{
+    __disable_irq();
+    if (s_pending == 0)
+        __WFI();
+    __enable_irq();
+}
+
+const SchedStats *Sched_GetStats(uint8_t id)
+{
+    return (id < s_n) ? &s_stats[id] : 0;
+}
+
+void Sched_ClearStats(void)
+{
+    uint8_t id;
+
+    __disable_irq();
+    for (id = 0; id < SCHED_MAX_TASKS; id++)
+    {
+        s_stats[id].runs     = 0;
+        s_stats[id].overruns = 0;
+        s_stats[id].last_cyc = 0;
+        s_stats[id].max_cyc  = 0;
+        s_stats[id].max_late = 0;
+    }
+    __enable_irq();
+}
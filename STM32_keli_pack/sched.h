@@ -0,0 +1,68 @@
+#ifndef _SCHED_H_
+#define _SCHED_H_
+
+#include <stdint.h>
+#include "board.h"
+
+/*============================================================
+ *  sched – Multi-rate cooperative task scheduler
+ *
+ *  ISRs only release tasks; Sched_Run() in the main loop runs
+ *  each released task to completion, highest priority (lowest
+ *  table index) first.  Tasks never preempt each other, so
+ *  they share filter and alarm state without locking
+ *  (board.h Section 11).
+ *
+ *  Flow:
+ *    DMA TC IRQ → Sched_OnScan()    (SCHED_SRC_SCAN tasks)
+ *    SysTick    → Sched_Tick1ms()   (SCHED_SRC_MS tasks)
+ *    a task     → Sched_Trigger(id) (out of turn)
+ *    main loop  → Sched_Run(); Sched_Idle()
+ *============================================================*/
+
+/* What a task's period counts */
+#define SCHED_SRC_SCAN      0U     /* DMA TC interrupts  */
+#define SCHED_SRC_MS        1U     /* SysTick ticks      */
+#define SCHED_SRC_EVENT     2U     /* Sched_Trigger only */
+
+typedef void (*SchedFn)(void);
+
+typedef struct
+{
+    SchedFn  fn;
+    uint8_t  src;       /* SCHED_SRC_SCAN / _MS / _EVENT        */
+    uint16_t period;    /* release every `period` scans or ms   */
+} SchedTask;
+
+typedef struct
+{
+    uint32_t runs;
+    uint32_t overruns;  /* releases lost: previous one not run  */
+    uint32_t last_cyc;  /* run time of the latest run (cycles)  */
+    uint32_t max_cyc;   /* worst run time                       */
+    uint32_t max_late;  /* worst release → start                */
+} SchedStats;
+
+/* Install the task table (≤ SCHED_MAX_TASKS, kept by pointer)
+ * and start the DWT cycle counter.  Nothing is released.      */
+void Sched_Init(const SchedTask *tasks, uint8_t n);
+
+/* Release sources (interrupt context) */
+void Sched_OnScan(void);
+void Sched_Tick1ms(void);
+
+/* Release task id now, from a task or an ISR */
+void Sched_Trigger(uint8_t id);
+
+/* Run released tasks until none is left (thread context) */
+void Sched_Run(void);
+
+/* Sleep until the next interrupt unless a task is released;
+ * closes the race between the last check and __WFI          */
+void Sched_Idle(void);
+
+/* Per-task statistics since Sched_Init / Sched_ClearStats */
+const SchedStats *Sched_GetStats(uint8_t id);
+void Sched_ClearStats(void);
+
+#endif /* _SCHED_H_ */
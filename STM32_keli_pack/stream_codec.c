@@ -0,0 +1,133 @@
+#include "stream_codec.h"
+
+/*============================================================
+ *  stream_codec.c – Block encoder (board.h Section 7, BODY)
+ *
+ *  Per channel section, MSB-first:
+ *    k(4) | first(12) | NSCANS-1 Rice codes of zig-zag deltas
+ *
+ *  Rice code of z with parameter k:
+ *    q = z >> k  →  q × '1', '0', then z[k-1..0]
+ *    q ≥ STREAM_RICE_ESCAPE_Q → 16 × '1', then z as 13 bits
+ *
+ *  k is chosen per channel by exact bit count (k = 0..11);
+ *  if no k beats raw 12-bit, the section is sent raw (k = 15).
+ *============================================================*/
+
+#define ZZ_BITS     13U     /* zig-zag of a ±4095 delta fits 13 bits */
+
+/* ═══════════ MSB-first bit writer ═══════════ */
+
+static uint8_t  *s_out;
+static uint16_t  s_pos;     /* bytes completed                     */
+static uint32_t  s_acc;     /* pending bits, right-aligned         */
+static uint8_t   s_cnt;     /* number of pending bits (0..7)       */
+
+static void put_bits(uint32_t v, uint8_t n)     /* n ≤ 24 */
+{
+    s_acc  = (s_acc << n) | (v & ((1UL << n) - 1UL));
+    s_cnt += n;
+    while (s_cnt >= 8U)
+    {
+        s_cnt -= 8U;
+        s_out[s_pos++] = (uint8_t)(s_acc >> s_cnt);
+    }
+}
+
+static void flush_bits(void)
+{
+    if (s_cnt)
+        s_out[s_pos++] = (uint8_t)(s_acc << (8U - s_cnt));
+    s_cnt = 0;
+}
+
+/* ═══════════ Coding helpers ═══════════ */
+
+static uint16_t zigzag(int16_t d)
+{
+    return (d >= 0) ? (uint16_t)(2 * d) : (uint16_t)(-2 * d - 1);
+}
+
+/* Exact Rice cost in bits of z[0..n-1] with parameter k */
+static uint32_t rice_cost(const uint16_t *z, uint8_t n, uint8_t k)
+{
+    uint32_t bits = 0;
+    uint16_t q;
+    uint8_t  i;
+
+    for (i = 0; i < n; i++)
+    {
+        q = (uint16_t)(z[i] >> k);
+        bits += (q >= STREAM_RICE_ESCAPE_Q)
+              ? (STREAM_RICE_ESCAPE_Q + ZZ_BITS)
+              : (uint32_t)(q + 1U + k);
+    }
+    return bits;
+}
+
+static void put_rice(uint16_t z, uint8_t k)
+{
+    uint16_t q = (uint16_t)(z >> k);
+
+    if (q >= STREAM_RICE_ESCAPE_Q)
+    {
+        put_bits((1UL << STREAM_RICE_ESCAPE_Q) - 1UL, STREAM_RICE_ESCAPE_Q);
+        put_bits(z, ZZ_BITS);
+        return;
+    }
+    put_bits((1UL << (q + 1U)) - 2UL, (uint8_t)(q + 1U));   /* q ones + 0 */
+    if (k)
+        put_bits(z, k);
+}
+
+/*------------------------------------------------------------
+ *  StreamCodec_EncodeBlock
+ *------------------------------------------------------------*/
+uint16_t StreamCodec_EncodeBlock(const uint16_t scans[][ADC_NUM_CHANNELS],
+                                 uint8_t n_scans,
+                                 uint8_t *out)
+{
+    static uint16_t z[STREAM_BLOCK_SCANS];
+    uint8_t  ch, i, k, best_k;
+    uint8_t  n_d = (uint8_t)(n_scans - 1U);
+    uint32_t cost, best;
+
+    s_out = out;
+    s_pos = 0;
+    s_acc = 0;
+    s_cnt = 0;
+
+    for (ch = 0; ch < ADC_NUM_CHANNELS; ch++)
+    {
+        /* Zig-zag deltas between consecutive scans */
+        for (i = 0; i < n_d; i++)
+            z[i] = zigzag((int16_t)((int16_t)scans[i + 1U][ch]
+                                  - (int16_t)scans[i][ch]));
+
+        /* Cheapest k; raw 12-bit is the ceiling */
+        best   = 12UL * n_d;
+        best_k = STREAM_RICE_RAW;
+        for (k = 0; k <= STREAM_RICE_K_MAX; k++)
+        {
+            cost = rice_cost(z, n_d, k);
+            if (cost < best) { best = cost; best_k = k; }
+        }
+
+        put_bits(best_k, 4);
+        put_bits(scans[0][ch] & 0x0FFFU, 12);
+
+        if (best_k == STREAM_RICE_RAW)
+        {
+            for (i = 1; i < n_scans; i++)
+                put_bits(scans[i][ch] & 0x0FFFU, 12);
+        }
+        else
+        {
+            for (i = 0; i < n_d; i++)
+                put_rice(z[i], best_k);
+        }
+    }
+
+    flush_bits();
+    return s_pos;
+}
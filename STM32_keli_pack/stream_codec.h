@@ -0,0 +1,27 @@
+#ifndef _STREAM_CODEC_H_
+#define _STREAM_CODEC_H_
+
+#include <stdint.h>
+#include "board.h"
+
+/*============================================================
+ *  stream_codec – Zig-zag delta + Rice coding for ADC blocks
+ *
+ *  Compresses a block of raw 12-bit scans channel by channel
+ *  into the BODY of a stream packet (board.h Section 7).
+ *  Consecutive ADC readings usually differ by a few LSB, so a
+ *  typical quiet channel costs 2–4 bits per sample instead of
+ *  12.  Noisy channels fall back to raw 12-bit automatically.
+ *
+ *  Pure computation, no hardware access — runs in main-loop
+ *  (thread) context, never in the DMA ISR.
+ *============================================================*/
+
+/* Encode n_scans scans (scans[i][ch], raw 0..4095) into out[].
+ * out must hold STREAM_BODY_MAX_LEN bytes.
+ * Returns the body length in bytes.                          */
+uint16_t StreamCodec_EncodeBlock(const uint16_t scans[][ADC_NUM_CHANNELS],
+                                 uint8_t n_scans,
+                                 uint8_t *out);
+
+#endif /* _STREAM_CODEC_H_ */
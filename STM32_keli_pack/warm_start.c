@@ -0,0 +1,197 @@
+#include "warm_start.h"
+#include "adc_mgr.h"
+#include "fire_logic.h"
+#include "kalman.h"
+#include "RCC_STM32_LIB.h"
+
+/*============================================================
+ *  warm_start.c – Backup-SRAM snapshot of filter + FireState
+ *
+ *  Slot = magic | layout | seq | ring | [Kalman] | states |
+ *  Fletcher-32.  The layout word encodes N, ADC_FILTER_SAMPLES,
+ *  EST_ENABLE and the slot order (WARM_LAYOUT_REV), so a
+ *  firmware with a different filter shape ignores old data.
+ *  With EST_ENABLE the Kalman value, slope, covariance and
+ *  trend debounce are saved too, so the first frame after a
+ *  reset carries the pre-reset estimate, not 0 until the
+ *  first decimated update.
+ *  Restore picks the valid slot with the highest seq; save
+ *  always overwrites the other one.
+ *
+ *  Cost: export is an 88-byte slot copy (172 B with EST_ENABLE,
+ *  N = 4) plus the checksum, all in the WARM scheduler task.
+ *  The filters are only written by the SAMPLE task, which
+ *  cannot preempt it, so the copy needs no interrupt masking.
+ *============================================================*/
+
+typedef struct {
+    uint32_t       magic;
+    uint32_t       layout;
+    uint32_t       seq;
+    AdcMgrSnapshot adc;
+#if EST_ENABLE
+    KalmanSnapshot est;
+#endif
+    uint8_t        temp_state;
+    uint8_t        gas_state;
+    uint16_t       pad;
+    uint32_t       sum;        /* Fletcher-32 over all above */
+} WarmSlot;
+
+typedef struct {
+    WarmSlot slot[2];
+} WarmArea;
+
+#define WARM_LAYOUT_REV  3U   /* 3: + Kalman state (EST_ENABLE) */
+#define WARM_LAYOUT   (((uint32_t)WARM_LAYOUT_REV << 24)   \
+                      | ((uint32_t)ADC_NUM_CHANNELS << 16) \
+                      | ((uint32_t)EST_ENABLE << 15)       \
+                      | (uint32_t)ADC_FILTER_SAMPLES)
+#define WARM_SUM_LEN  ((uint32_t)(sizeof(WarmSlot) - sizeof(uint32_t)) / 2U)
+
+static uint8_t   s_warm  = 0;
+
+#if WARM_ENABLE
+
+static WarmArea *s_area  = 0;
+static WarmSlot  s_tmp;              /* export buffer (WARM task)    */
+static uint32_t  s_seq   = 0;
+static uint8_t   s_next  = 0;        /* slot written next            */
+
+/*------------------------------------------------------------
+ *  fletcher32 – over n 16-bit words
+ *------------------------------------------------------------*/
+static uint32_t fletcher32(const uint16_t *w, uint32_t n)
+{
+    uint32_t a = 0xFFFFU, b = 0xFFFFU;
+    uint32_t blk;
+
+    while (n)
+    {
+        blk = (n > 359U) ? 359U : n;   /* no overflow before fold */
+        n  -= blk;
+        do { a += *w++; b += a; } while (--blk);
+        a = (a & 0xFFFFU) + (a >> 16);
+        b = (b & 0xFFFFU) + (b >> 16);
+    }
+    a = (a & 0xFFFFU) + (a >> 16);
+    b = (b & 0xFFFFU) + (b >> 16);
+    return (b << 16) | a;
+}
+
+/*------------------------------------------------------------
+ *  slot_valid
+ *------------------------------------------------------------*/
+static uint8_t slot_valid(const WarmSlot *s)
+{
+    if (s->magic != WARM_MAGIC || s->layout != WARM_LAYOUT)
+        return 0;
+    if (s->temp_state > FIRE_STATE_ALARM || s->gas_state > FIRE_STATE_ALARM)
+        return 0;
+    return (uint8_t)(s->sum == fletcher32((const uint16_t *)s, WARM_SUM_LEN));
+}
+
+/*------------------------------------------------------------
+ *  WarmStart_Restore
+ *------------------------------------------------------------*/
+uint8_t WarmStart_Restore(void)
+{
+    uint32_t   rst;
+    uint8_t    v0, v1;
+    WarmSlot  *s;
+
+    s_area = (WarmArea *)RCC_Enable_BackupSRAM();
+    rst    = RCC_TakeResetFlags();
+    s_warm = 0;
+
+    /* Power-on: backup SRAM content is undefined → cold start */
+    if (rst & RCC_RST_POR)
+    {
+        s_area->slot[0].magic = 0;
+        s_area->slot[1].magic = 0;
+        return 0;
+    }
+
+    v0 = slot_valid(&s_area->slot[0]);
+    v1 = slot_valid(&s_area->slot[1]);
+    if (!v0 && !v1)
+        return 0;
+
+    if (v0 && v1)
+        s = (s_area->slot[1].seq - s_area->slot[0].seq < 0x80000000UL)
+          ? &s_area->slot[1] : &s_area->slot[0];
+    else
+        s = v0 ? &s_area->slot[0] : &s_area->slot[1];
+
+#if EST_ENABLE
+    if (!Kalman_Import(&s->est))
+        return 0;
+#endif
+    if (!ADC_Mgr_Import(&s->adc))
+    {
+#if EST_ENABLE
+        Kalman_Init();
+#endif
+        return 0;
+    }
+    FireLogic_Restore((FireState)s->temp_state, (FireState)s->gas_state);
+
+    s_seq  = s->seq + 1U;
+    s_next = (s == &s_area->slot[0]) ? 1U : 0U;
+    s_warm = 1;
+    return 1;
+}
+
+/*------------------------------------------------------------
+ *  WarmStart_Task – scheduler, every WARM_SAVE_MS
+ *------------------------------------------------------------*/
+void WarmStart_Task(void)
+{
+    volatile uint32_t *dst;
+    const uint32_t    *src = (const uint32_t *)&s_tmp;
+    uint32_t           i;
+
+    if (s_area == 0)
+        return;
+
+    ADC_Mgr_Export(&s_tmp.adc);
+#if EST_ENABLE
+    Kalman_Export(&s_tmp.est);
+#endif
+    s_tmp.temp_state = (uint8_t)FireLogic_GetTempState();
+    s_tmp.gas_state  = (uint8_t)FireLogic_GetGasState();
+
+    s_tmp.magic  = WARM_MAGIC;
+    s_tmp.layout = WARM_LAYOUT;
+    s_tmp.seq    = s_seq++;
+    s_tmp.pad    = 0;
+    s_tmp.sum    = fletcher32((const uint16_t *)&s_tmp, WARM_SUM_LEN);
+
+    /* Magic last: a reset mid-copy leaves the slot invalid */
+    dst = (volatile uint32_t *)&s_area->slot[s_next];
+    dst[0] = 0;
+    for (i = 1; i < sizeof(WarmSlot) / 4U; i++)
+        dst[i] = src[i];
+    dst[0] = src[0];
+    s_next ^= 1U;
+}
+
+#else  /* !WARM_ENABLE: every boot is cold */
+
+uint8_t WarmStart_Restore(void)
+{
+    (void)RCC_TakeResetFlags();
+    return 0;
+}
+
+void WarmStart_Task(void) { }
+
+#endif /* WARM_ENABLE */
+
+/*------------------------------------------------------------
+ *  WarmStart_WasWarm
+ *------------------------------------------------------------*/
+uint8_t WarmStart_WasWarm(void)
+{
+    return s_warm;
+}
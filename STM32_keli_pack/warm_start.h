@@ -0,0 +1,31 @@
+#ifndef _WARM_START_H_
+#define _WARM_START_H_
+
+#include <stdint.h>
+#include "board.h"
+
+/*============================================================
+ *  warm_start – Filter + alarm state kept across resets
+ *
+ *  Two checksummed slots in backup SRAM (board.h Section 9),
+ *  written alternately by a scheduler task so a reset in the
+ *  middle of a write still leaves the previous slot intact.
+ *
+ *  Flow:
+ *    main(): service Init → WarmStart_Restore() → SPI + packet
+ *    WARM task → WarmStart_Task()     (every WARM_SAVE_MS)
+ *============================================================*/
+
+/* Enable backup SRAM and, unless this boot is a power-on,
+ * load the newest valid slot into adc_mgr + fire_logic
+ * (+ kalman with EST_ENABLE).
+ * Returns 1 if state was restored.                           */
+uint8_t WarmStart_Restore(void);
+
+/* Snapshot live state into the older slot */
+void    WarmStart_Task(void);
+
+/* 1 if WarmStart_Restore() loaded a slot on this boot */
+uint8_t WarmStart_WasWarm(void);
+
+#endif /* _WARM_START_H_ */
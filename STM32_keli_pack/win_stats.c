@@ -0,0 +1,161 @@
+#include "win_stats.h"
+#include "SPI_LIB.h"        /* SPI1_Slave_GetTxCount()          */
+#include "cal_lut.h"        /* g_cal_lut[ch][raw]               */
+
+/*============================================================
+ *  win_stats.c – Windowed min/max/Σ/Σ²/crossings on raw scans
+ *
+ *  Per scan and channel: two compares, one add, one 32×32→64
+ *  multiply-accumulate and the hysteresis test, so the window
+ *  costs about as much as the moving-average update.  Nothing
+ *  is divided on the MCU; the Pi turns Σx, Σx² into mean and
+ *  variance.
+ *============================================================*/
+
+typedef struct {
+    uint16_t min;
+    uint16_t max;
+    uint32_t sum;
+    uint64_t sumsq;
+    uint8_t  xcnt;          /* rising WARN crossings, saturating */
+} WinCh;
+
+static WinCh    s_w[ADC_NUM_CHANNELS];
+static uint32_t s_n = 0;                  /* scans in Σ, Σ²       */
+static uint32_t s_tx_seen = 0;            /* SPI TX count at reset */
+
+/* Hysteresis per channel in raw counts; on > 4095 = no limit.
+ * s_hi survives window restarts: a crossing is counted once. */
+static uint16_t s_on[ADC_NUM_CHANNELS];
+static uint16_t s_off[ADC_NUM_CHANNELS];
+static uint8_t  s_hi[ADC_NUM_CHANNELS];
+
+/*------------------------------------------------------------
+ *  raw_at_least – First raw code whose calibrated value on
+ *  slot ch reaches eng (the tables are monotonic rising)
+ *------------------------------------------------------------*/
+static uint16_t raw_at_least(uint8_t ch, uint16_t eng)
+{
+    uint16_t raw;
+    for (raw = 0; raw <= ADC_RESOLUTION; raw++)
+        if (g_cal_lut[ch][raw] >= eng) return raw;
+    return 0xFFFFU;
+}
+
+static void window_reset(void)
+{
+    uint8_t ch;
+    for (ch = 0; ch < ADC_NUM_CHANNELS; ch++)
+    {
+        s_w[ch].min   = 0xFFFFU;
+        s_w[ch].max   = 0;
+        s_w[ch].sum   = 0;
+        s_w[ch].sumsq = 0;
+        s_w[ch].xcnt  = 0;
+    }
+    s_n = 0;
+}
+
+/*------------------------------------------------------------
+ *  WinStats_Init
+ *------------------------------------------------------------*/
+void WinStats_Init(void)
+{
+    uint8_t ch;
+    for (ch = 0; ch < ADC_NUM_CHANNELS; ch++)
+    {
+        s_on[ch]  = 0xFFFFU;
+        s_off[ch] = 0xFFFFU;
+        s_hi[ch]  = 0;
+    }
+    s_on[ADC_IDX_LM35]  = raw_at_least(ADC_IDX_LM35, TEMP_WARN_ON_X10);
+    s_off[ADC_IDX_LM35] = raw_at_least(ADC_IDX_LM35, TEMP_WARN_OFF_X10 + 1U);
+    s_on[ADC_IDX_GAS]   = GAS_WARN_ON_ADC;
+    s_off[ADC_IDX_GAS]  = GAS_WARN_OFF_ADC + 1U;
+
+    window_reset();
+    s_tx_seen = SPI1_Slave_GetTxCount();
+}
+
+/*------------------------------------------------------------
+ *  WinStats_Feed – SAMPLE task, every scan
+ *
+ *  A frame going out between the previous scan and this one
+ *  was built from the previous scan, so the new window starts
+ *  with this sample.
+ *------------------------------------------------------------*/
+void WinStats_Feed(const volatile uint16_t raw[ADC_NUM_CHANNELS])
+{
+    uint32_t tx = SPI1_Slave_GetTxCount();
+    uint8_t  ch;
+    uint16_t x;
+    WinCh   *w;
+
+    if (tx != s_tx_seen)
+    {
+        s_tx_seen = tx;
+        window_reset();
+    }
+
+    for (ch = 0; ch < ADC_NUM_CHANNELS; ch++)
+    {
+        x = raw[ch];
+        w = &s_w[ch];
+        if (x < w->min) w->min = x;
+        if (x > w->max) w->max = x;
+
+        if (s_hi[ch])
+        {
+            if (x < s_off[ch]) s_hi[ch] = 0;
+        }
+        else if (x >= s_on[ch])
+        {
+            s_hi[ch] = 1;
+            if (w->xcnt < 255U) w->xcnt++;
+        }
+
+        if (s_n < WSTAT_MAX_SCANS)
+        {
+            w->sum   += x;
+            w->sumsq += (uint32_t)x * x;
+        }
+    }
+    if (s_n < WSTAT_MAX_SCANS) s_n++;
+}
+
+/*------------------------------------------------------------
+ *  WinStats_Pack – WSTAT block, little-endian (board.h §7)
+ *------------------------------------------------------------*/
+uint8_t WinStats_Pack(volatile uint8_t *dst)
+{
+    uint8_t  k = 0;
+    uint8_t  ch, i;
+    uint16_t lo, hi;
+    uint64_t q;
+    const WinCh *w;
+
+    dst[k++] = (uint8_t)(s_n & 0xFFU);
+    dst[k++] = (uint8_t)(s_n >> 8);
+    dst[k++] = (uint8_t)(s_n >> 16);
+
+    for (ch = 0; ch < ADC_NUM_CHANNELS; ch++)
+    {
+        w  = &s_w[ch];
+        lo = (s_n ? w->min : 0) & 0x0FFFU;
+        hi = w->max & 0x0FFFU;
+        dst[k++] = (uint8_t)(lo & 0xFFU);
+        dst[k++] = (uint8_t)((lo >> 8) | ((hi & 0x0FU) << 4));
+        dst[k++] = (uint8_t)(hi >> 4);
+
+        for (i = 0; i < 4U; i++)
+            dst[k++] = (uint8_t)(w->sum >> (8U * i));
+        q = w->sumsq;
+        for (i = 0; i < 6U; i++)
+        {
+            dst[k++] = (uint8_t)(q & 0xFFU);
+            q >>= 8;
+        }
+        dst[k++] = w->xcnt;
+    }
+    return k;
+}
@@ -0,0 +1,32 @@
+#ifndef _WIN_STATS_H_
+#define _WIN_STATS_H_
+
+#include <stdint.h>
+#include "board.h"
+
+/*============================================================
+ *  win_stats – Per-channel statistics between two Pi reads
+ *
+ *  Every raw scan updates min, max, Σx, Σx² and the rising
+ *  WARN-crossing count of each channel (board.h Section 4).
+ *  The window restarts on the first scan after SPI starts
+ *  clocking out a frame (SPI1_Slave_GetTxCount() moved), so
+ *  the frame the Pi got covered every scan since its last one.
+ *
+ *  Flow:
+ *    SAMPLE task  → WinStats_Feed(scan)        (every scan)
+ *    PUBLISH task → WinStats_Pack(&frame[FRAME_OFF_WSTAT])
+ *============================================================*/
+
+/* Empty window; crossing thresholds from §5 (LM35 through the
+ * calibration table, gas in raw counts)                      */
+void    WinStats_Init(void);
+
+/* Add one raw scan (restarts the window after a read) */
+void    WinStats_Feed(const volatile uint16_t raw[ADC_NUM_CHANNELS]);
+
+/* Write the WSTAT block (board.h Section 7), WSTAT_LEN bytes.
+ * Returns the number of bytes written.                       */
+uint8_t WinStats_Pack(volatile uint8_t *dst);
+
+#endif /* _WIN_STATS_H_ */
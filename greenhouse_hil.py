@@ -0,0 +1,972 @@
+"""
+Greenhouse HIL — the firmware service layer compiled for the host
+═════════════════════════════════════════════════════════════════
+build_hil_library() compiles STM32_keli_pack (hil/hil.c in place of
+the BSP) into a shared library and HilSpiDev serves it through the
+spidev calls SpiReader makes.  The checks and benches behind
+--hil-bench, --adapt-bench, --check-protocol and --est-bench live
+here too; test_greenhouse.py runs them without the GUI.
+"""
+
+from __future__ import annotations
+
+import os
+import time
+import logging
+
+from greenhouse_protocol import (
+    ADC_FILTER_SAMPLES, ADC_RESOLUTION, AWD_GAS_ADC,
+    EST_GAS_TREND_LSB_S, EST_TEMP_TREND_LSB_S, FIRMWARE_DIR, FrameCodec,
+    FrameColumns, FrameSync, GAS_ALARM_ON, GAS_WARN_ON, MAINS_HZ,
+    check_codec, frame_valid, packet_len, parse_frame)
+from greenhouse_reader import (
+    ADAPT_MAX_MS, ADAPT_MIN_MS, MockDrdyLine, POLL_INTERVAL_S,
+    PollRateController, SPI_MODE, SPI_SPEED_HZ, SpiReader,
+    WaveformCapture)
+
+log = logging.getLogger("greenhouse")
+
+# ════════════════════════════════════════════════════════════
+#  HIL BACKEND (real firmware logic compiled for the host)
+# ════════════════════════════════════════════════════════════
+#
+#  STM32_keli_pack/hil/hil.c stands in for the BSP; the service
+#  layer sources are the real ones.  HilSpiDev exposes the result
+#  through the spidev.SpiDev calls SpiReader uses, so --hil runs
+#  the unchanged reader / GUI / exporter against actual firmware
+#  hysteresis, buzzer timing and g_spi_packet bytes.
+
+HIL_SOURCES   = ("hil/hil.c", "adc_mgr.c", "fire_logic.c", "actuators.c",
+                 "greenhouse.c", "stream_codec.c", "cal_lut.c", "kalman.c",
+                 "warm_start.c", "win_stats.c", "drdy.c", "sched.c", "awd.c",
+                 "capture.c", "mains.c")
+HIL_SPI_IDEAL = 0               # hil.h HIL_SPI_IDEAL
+HIL_SPI_WIRE  = 1               # hil.h HIL_SPI_WIRE
+HIL_PUBLISH_MS = 20             # board.h SCHED_PUBLISH_MS
+HIL_SCHED_TASKS = ("sample", "alarm", "publish", "warm",  # GH_TASK_* ids
+                   "capture")
+HIL_SCHED_FIELDS = ("runs", "overruns", "last_cyc", "max_cyc", "max_late")
+
+# t_s  temp_c  gas_raw  [ch2 ch3 ...] — piecewise linear, loops
+HIL_DEFAULT_SCRIPT = """
+0     25   800   2000  1000
+20    25   800
+40    40   900           # temp WARN  (TEMP_WARN_ON)
+60    55   2200          # temp ALARM, gas WARN
+80    55   2700          # gas ALARM
+100   30   900           # cool down through hysteresis
+120   25   800
+"""
+
+
+HIL_CFLAGS = ["-O2", "-Wall", "-Wextra"]
+
+
+def build_hil_library(fw_dir=FIRMWARE_DIR, cc="cc", werror=False):
+    """
+    Compile the service layer + hil.c into a host shared library.
+    The result is cached in the temp dir under a hash of every
+    source, header and flag, so editing board.h triggers a rebuild.
+    werror=True (protocol check, benches) fails the build on any
+    warning; otherwise warnings are only logged.
+    """
+    import glob
+    import hashlib
+    import subprocess
+    import tempfile
+
+    hil_dir = os.path.join(fw_dir, "hil")
+    srcs = [os.path.join(fw_dir, f) for f in HIL_SOURCES]
+    hdrs = sorted(glob.glob(os.path.join(fw_dir, "*.h"))
+                  + glob.glob(os.path.join(hil_dir, "*.h")))
+    cflags = HIL_CFLAGS + (["-Werror"] if werror else [])
+    digest = hashlib.sha1(" ".join(cflags).encode())
+    for path in srcs + hdrs:
+        with open(path, "rb") as f:
+            digest.update(f.read())
+    out = os.path.join(tempfile.gettempdir(),
+                       f"greenhouse_hil_{digest.hexdigest()[:12]}.so")
+    if os.path.exists(out):
+        return out
+
+    tmp = f"{out}.{os.getpid()}"
+    cmd = ([cc, "-shared", "-fPIC"] + cflags
+           + ["-I", hil_dir, "-I", fw_dir, "-o", tmp] + srcs + ["-lm"])
+    res = subprocess.run(cmd, capture_output=True, text=True)
+    if res.returncode != 0:
+        raise RuntimeError("HIL build failed:\n" + res.stderr)
+    if res.stderr.strip():
+        log.warning("HIL build warnings:\n%s", res.stderr.rstrip())
+    os.replace(tmp, out)
+    log.info("HIL firmware library built: %s", out)
+    return out
+
+
+def _load_hil(lib_path):
+    """
+    Load a private copy of the library: firmware statics live in
+    the image, so every virtual board needs its own mapping.
+    """
+    import ctypes as C
+    import shutil
+    import tempfile
+
+    fd, copy = tempfile.mkstemp(suffix=".so", prefix="greenhouse_hil_")
+    os.close(fd)
+    shutil.copyfile(lib_path, copy)
+    try:
+        lib = C.CDLL(copy)
+    finally:
+        os.unlink(copy)
+
+    lib.HIL_SetAdc.argtypes = [C.POINTER(C.c_uint16)]
+    lib.HIL_Advance.argtypes = [C.c_uint32]
+    lib.HIL_NowNs.restype = C.c_uint64
+    lib.HIL_ScanPeriodNs.restype = C.c_uint32
+    lib.HIL_ScanCount.restype = C.c_uint32
+    lib.HIL_SetHum.argtypes = [C.c_uint16, C.c_uint32]
+    lib.HIL_SpiXfer.argtypes = [C.POINTER(C.c_uint8), C.c_uint16,
+                                C.c_uint32, C.c_uint8]
+    for name in ("HIL_NumChannels", "HIL_StreamEnabled", "HIL_WstatEnabled",
+                 "HIL_MainsEnabled", "HIL_BuzzerOn", "HIL_MotorOn", "HIL_FireState",
+                 "HIL_WarmStarted", "HIL_DrdyLevel", "HIL_SchedTasks",
+                 "HIL_Emergency"):
+        getattr(lib, name).restype = C.c_uint8
+    lib.HIL_AwdTrips.restype = C.c_uint16
+    lib.HIL_AwdTripNs.restype = C.c_uint64
+    lib.HIL_SchedStats.argtypes = [C.c_uint8, C.POINTER(C.c_uint32)]
+    lib.HIL_Reset()
+    return lib
+
+
+def hil_firmware_info(lib_path):
+    """
+    Return (ADC_NUM_CHANNELS, STREAM_ENABLE, WSTAT_ENABLE, MAINS_ENABLE)
+    of a HIL build.
+    """
+    lib = _load_hil(lib_path)
+    return (lib.HIL_NumChannels(), bool(lib.HIL_StreamEnabled()),
+            bool(lib.HIL_WstatEnabled()), bool(lib.HIL_MainsEnabled()))
+
+
+class HilScenario:
+    """
+    Scripted analog inputs: keyframes "t_s temp_c gas_raw [ch2 ...]"
+    interpolated linearly and looped.  Missing columns keep the
+    previous keyframe's value.  Channel 0 is converted from °C
+    the way an LM35 on a 3.3 V / 12-bit ADC would read.
+    """
+
+    def __init__(self, text=HIL_DEFAULT_SCRIPT, noise_lsb=2.0):
+        import random
+        self._rng = random.Random(1)
+        self.noise_lsb = noise_lsb
+        self.keys = []
+        prev = []
+        for line in text.splitlines():
+            line = line.split("#", 1)[0].strip()
+            if not line:
+                continue
+            vals = [float(v) for v in line.split()]
+            row = vals[1:] + prev[len(vals) - 1:]
+            self.keys.append((vals[0], row))
+            prev = row
+        if not self.keys:
+            raise ValueError("empty HIL script")
+        self.period_s = self.keys[-1][0] or 1.0
+
+    @classmethod
+    def from_file(cls, path, **kw):
+        with open(path, encoding="utf-8") as f:
+            return cls(f.read(), **kw)
+
+    def values_at(self, t_s):
+        t = t_s % self.period_s
+        k0 = self.keys[0]
+        for k1 in self.keys[1:]:
+            if t < k1[0]:
+                a = (t - k0[0]) / ((k1[0] - k0[0]) or 1.0)
+                return [v0 + (v1 - v0) * a for v0, v1 in zip(k0[1], k1[1])]
+            k0 = k1
+        return list(k0[1])
+
+    def adc_at(self, t_s, n_ch):
+        vals = self.values_at(t_s)
+        out = [vals[0] * 10.0 * 4095 / 3300] + vals[1:]
+        out += [2048.0] * (n_ch - len(out))
+        noise = self._rng.gauss
+        return [min(4095, max(0, int(v + noise(0, self.noise_lsb))))
+                for v in out[:n_ch]]
+
+
+class HilSpiDev:
+    """
+    spidev.SpiDev look-alike backed by a virtual STM32.
+
+    Before each transfer the firmware is run up to wall-clock time
+    × speed, with scenario inputs applied every STEP_US.  Gaps
+    longer than MAX_CATCHUP_US (process stalled) are skipped
+    rather than replayed.
+    """
+
+    STEP_US = 1000
+    MAX_CATCHUP_US = 1_000_000
+
+    def __init__(self, lib_path, scenario=None, speed=1.0,
+                 model=HIL_SPI_IDEAL):
+        self.lib_path = lib_path
+        self.scenario = scenario or HilScenario()
+        self.speed = speed
+        self.model = model
+        self.max_speed_hz = SPI_SPEED_HZ
+        self.mode = SPI_MODE
+        self.no_cs = False
+        self.lib = None
+
+    def open(self, bus, dev):
+        import ctypes as C
+        self.lib = _load_hil(self.lib_path)
+        self.n_ch = self.lib.HIL_NumChannels()
+        self.wstat = bool(self.lib.HIL_WstatEnabled())
+        self.noise = bool(self.lib.HIL_MainsEnabled())
+        self._adc = (C.c_uint16 * self.n_ch)()
+        self._now_us = 0
+        self._t0 = time.monotonic()
+        log.info("HIL board on spi%d.%d: %d ch, scan %.1f us, %s timing",
+                 bus, dev, self.n_ch, self.lib.HIL_ScanPeriodNs() / 1000.0,
+                 "wire" if self.model == HIL_SPI_WIRE else "ideal")
+
+    def close(self):
+        self.lib = None
+
+    def advance(self, us):
+        """Run the firmware for `us` virtual microseconds."""
+        lib, adc = self.lib, self._adc
+        end = self._now_us + us
+        while self._now_us < end:
+            step = min(self.STEP_US, end - self._now_us)
+            adc[:] = self.scenario.adc_at(self._now_us / 1e6, self.n_ch)
+            lib.HIL_SetAdc(adc)
+            lib.HIL_Advance(step)
+            self._now_us += step
+
+    def sync(self):
+        target = int((time.monotonic() - self._t0) * 1e6 * self.speed)
+        lag = target - self._now_us
+        if lag > self.MAX_CATCHUP_US:
+            self._t0 += (lag - self.MAX_CATCHUP_US) / 1e6 / self.speed
+            lag = self.MAX_CATCHUP_US
+        if lag > 0:
+            self.advance(lag)
+
+    def xfer2(self, values, speed_hz=0, delay_usecs=0, bits_per_word=8):
+        import ctypes as C
+        self.sync()
+        n = len(values)
+        buf = (C.c_uint8 * n)(*values)          # MOSI in, MISO out
+        self.lib.HIL_SpiXfer(buf, n, speed_hz or self.max_speed_hz, self.model)
+        return list(buf)
+
+    def drdy_level(self):
+        """PB2 now (virtual board run up to wall-clock time first)."""
+        self.sync()
+        return self.lib.HIL_DrdyLevel()
+
+    def sched_stats(self):
+        """{task: {runs, overruns, last_cyc, max_cyc, max_late}}."""
+        import ctypes as C
+        out = (C.c_uint32 * len(HIL_SCHED_FIELDS))()
+        stats = {}
+        for tid in range(self.lib.HIL_SchedTasks()):
+            self.lib.HIL_SchedStats(tid, out)
+            name = (HIL_SCHED_TASKS[tid] if tid < len(HIL_SCHED_TASKS)
+                    else f"task{tid}")
+            stats[name] = dict(zip(HIL_SCHED_FIELDS, out))
+        return stats
+
+
+def hil_alarm_latency(lib_path, hot_c=60.0, cold_c=25.0, gas=800):
+    """
+    Step response of the real alarm chain in virtual time: inputs
+    jump cold → hot → cold and an ideal 1 kHz master reads every
+    frame.  Returns {event: ms after the step} for the STATUS bits.
+    """
+    scen_text = f"0 {cold_c} {gas}\n1000 {cold_c} {gas}"
+    dev = HilSpiDev(lib_path, HilScenario(scen_text, noise_lsb=0))
+    dev.open(0, 0)
+    n_ch = dev.n_ch
+    dev.advance(2_000_000)                       # settle filters
+
+    out = {}
+    for phase, temp in (("rise", hot_c), ("fall", cold_c)):
+        dev.scenario = HilScenario(f"0 {temp} {gas}\n1000 {temp} {gas}",
+                                   noise_lsb=0)
+        seen = {}
+        for ms in range(1, 10_001):
+            dev.advance(1000)
+            frame = parse_frame(dev.xfer2([0] * packet_len(n_ch, dev.wstat,
+                                                          dev.noise)),
+                                n_ch, dev.wstat, dev.noise)
+            if frame is None:
+                continue
+            for name, bit in (("temp_alarm", frame.temp_alarm),
+                              ("buzzer", frame.buzzer),
+                              ("motor", frame.motor)):
+                if name not in seen and bit == (phase == "rise"):
+                    seen[name] = ms
+            if len(seen) == 3:
+                break
+        for name, ms in seen.items():
+            out[f"{phase}:{name}"] = ms
+        dev.advance(2_000_000)
+    return out
+
+
+def hil_awd_latency(lib_path, trials=20, base=800, soft=GAS_ALARM_ON + 400,
+                    hard=AWD_GAS_ADC + 300):
+    """
+    Gas step → motor ON in virtual time, at random scan phases.
+    "software" steps to `soft` (over ALARM_ON, under the watchdog
+    limit): moving average, ALARM task period, SysTick pattern.
+    "watchdog" steps to `hard`: the ADC watchdog IRQ, timed at
+    the guarded conversion's end (HIL_AwdTripNs).  Returns
+    {path: {mean_us, max_us}}; no "watchdog" entry when the
+    firmware is built with AWD_ENABLE = 0.
+    """
+    import ctypes as C
+    import random
+    rng = random.Random(3)
+    out = {}
+    for path, level in (("software", soft), ("watchdog", hard)):
+        lat = []
+        for _ in range(trials):
+            lib = _load_hil(lib_path)
+            n_ch = lib.HIL_NumChannels()
+            adc = (C.c_uint16 * n_ch)(*([2048] * n_ch))
+            adc[0] = 300                         # LM35 ≈ 24 °C
+            adc[1] = base
+            lib.HIL_SetAdc(adc)
+            lib.HIL_Advance(200_000 + rng.randrange(10_000))
+            adc[1] = level
+            lib.HIL_SetAdc(adc)
+            t0 = lib.HIL_NowNs()
+            for _ in range(20_000):              # 100 ms in 5 us steps
+                lib.HIL_Advance(5)
+                if lib.HIL_MotorOn():
+                    break
+            else:
+                continue
+            if path == "watchdog":
+                if not lib.HIL_AwdTrips():
+                    break
+                t = lib.HIL_AwdTripNs()
+            else:
+                t = lib.HIL_NowNs()
+            lat.append((t - t0) / 1000.0)
+        if lat:
+            out[path] = {"mean_us": sum(lat) / len(lat), "max_us": max(lat)}
+    return out
+
+
+def hil_capture_check(lib_path, base=800, step=GAS_WARN_ON + 300, pre=512):
+    """
+    Level-triggered capture of a gas step against real firmware,
+    fetched through the HIL SPI slave.  Returns the record length,
+    PRE, the first scan at/over the level (should equal PRE), the
+    transfers and bytes of the fetch, SAMPLE / ALARM overruns
+    from arming to the end of the fetch, and the fire state the
+    alarm chain reached meanwhile.  None without CAP_ENABLE.
+    """
+    def flat(gas):
+        return HilScenario(f"0 25 {gas}\n1000 25 {gas}", noise_lsb=0)
+
+    dev = HilSpiDev(lib_path, flat(base))
+    dev.open(0, 0)
+    dev.advance(300_000)                         # settle filters
+    cap = WaveformCapture(dev, dev.n_ch,
+                          wait=lambda s: dev.advance(max(1, int(s * 1e6))))
+    before = dev.sched_stats()
+    if cap.arm(pre, ch=1, level=GAS_WARN_ON) is None:
+        return None
+    dev.advance(100_000)
+    dev.scenario = flat(step)
+    info = cap.wait_done(timeout_s=5.0, poll_s=0.01)
+    rec = cap.fetch(info) if info is not None else None
+    cap.stop()
+    after = dev.sched_stats()
+    if rec is None:
+        return {"ok": False}
+    gas = [int(r[1]) for r in rec.scans]
+    edge = next((i for i, v in enumerate(gas) if v >= GAS_WARN_ON), -1)
+    return {"ok": True, "scans": len(gas), "pre": rec.pre, "edge": edge,
+            "src": rec.src, "reads": rec.reads, "bytes": rec.nbytes,
+            "bus_ms": rec.nbytes * 8e3 / SPI_SPEED_HZ,
+            "overruns": {t: after[t]["overruns"] - before[t]["overruns"]
+                         for t in ("sample", "alarm")},
+            "fire_state": dev.lib.HIL_FireState()}
+
+
+def hil_bench(seconds=5.0, model=HIL_SPI_IDEAL, lib_path=None, resync=False,
+              speed=1.0, drdy=False):
+    """
+    End-to-end throughput and alarm latency against real firmware.
+    speed ≠ 1 runs the virtual MCU clock fast or slow, like an
+    off-trim HSI, which ClockSync should report as skew.
+    """
+    lib_path = lib_path or build_hil_library(werror=True)
+    n_ch, stream, wstat, noise = hil_firmware_info(lib_path)
+
+    devs = []
+
+    def factory():
+        devs.append(HilSpiDev(lib_path, speed=speed, model=model))
+        return devs[-1]
+
+    # DRDY: read on PB2 edges at the normal period instead of flat out
+    line = MockDrdyLine(lambda: devs[-1].drdy_level()) if drdy else None
+    reader = SpiReader(n_ch=n_ch, stream=stream,
+                       period_s=POLL_INTERVAL_S if drdy else 0.0,
+                       resync=resync, wstat=wstat, drdy=line,
+                       noise=noise, spi_factory=factory)
+    reader.start()
+    time.sleep(seconds)
+    reader.stop()
+    _, st = reader.get_snapshot()
+    j = reader.jitter
+    print(f"HIL firmware: {n_ch} ch, {'stream' if stream else 'snapshot'} "
+          f"frames{' + WSTAT' if wstat else ''}"
+          f"{' + NOISE' if noise and not stream else ''}, "
+          f"{'wire' if model == HIL_SPI_WIRE else 'ideal'} SPI")
+    print(f"throughput: {st.total_reads / seconds:.0f} reads/s, "
+          f"{st.valid_frames / seconds:.0f} valid/s, "
+          f"errors {st.error_rate_pct:.1f}%, "
+          f"mean poll {j.sum_s / max(1, j.count) * 1e6:.0f} us")
+    print(f"sample->receive: {reader.age_hist.summary()}, "
+          f"clock skew {reader.clock.skew_ppm:+.0f} ppm")
+    if not stream:
+        obj_us, col_us = frame_decode_cost(n_ch, wstat, noise)
+        print(f"decode: SensorFrame {obj_us:.1f} us/frame, FrameColumns "
+              f"{col_us:.1f} us/frame ({len(reader.frames)} rows kept)")
+    if reader.sync is not None:
+        total = max(1, st.valid_frames)
+        print(f"resync: {st.resynced} frames recovered at offset > 0; "
+              "offsets " + ", ".join(f"{off}:{100.0 * n / total:.0f}%"
+                                     for off, n in sorted(st.offsets.items())))
+    if wstat:
+        print(f"window: {st.scans_per_read:.1f} scans/read, "
+              f"{st.win_scans} scans in {st.win_frames} frames")
+    if drdy:
+        print(f"drdy: {st.drdy_edges} edges, {st.drdy_timeouts} timeouts")
+    print("tasks: " + ", ".join(
+        f"{name} {r['rate_hz']:.0f}/s ({r['overruns']} overruns)"
+        for name, r in hil_sched_rates(lib_path).items())
+        + f"; {st.seq_repeats} repeated frames read")
+
+    if stream:
+        return
+    for event, ms in sorted(hil_alarm_latency(lib_path).items()):
+        print(f"latency {event:<16} {ms:>6d} ms")
+    ok, tried = hil_abort_recovery(lib_path, model)
+    print(f"aborted reads: {ok}/{tried} following frames valid")
+    for mode, r in hil_drdy_latency(lib_path).items():
+        print(f"gas WARN seen, {mode:<13}: mean {r['mean_ms']:.2f} ms, "
+              f"max {r['max_ms']:.2f} ms, {r['reads_s']:.0f} reads/s idle")
+    for path, r in hil_awd_latency(lib_path).items():
+        print(f"gas step -> motor, {path:<8}: mean {r['mean_us']:.0f} us, "
+              f"max {r['max_us']:.0f} us")
+    r = hil_capture_check(lib_path)
+    if r is not None and not r["ok"]:
+        print("capture: FAILED (no record fetched)")
+    elif r is not None:
+        print(f"capture: {r['scans']} raw scans, {r['src']} trigger, PRE "
+              f"{r['pre']}, step seen at scan {r['edge']}; fetched in "
+              f"{r['reads']} transfers / {r['bytes']} B ({r['bus_ms']:.1f} ms "
+              f"bus); overruns sample +{r['overruns']['sample']}, alarm "
+              f"+{r['overruns']['alarm']}; fire state {r['fire_state']}")
+    if resync:
+        for rs in (False, True):
+            ok, tried = hil_abort_recovery(lib_path, model, resync=rs,
+                                           gap_us=0)
+            print(f"aborted reads, immediate retry: {ok}/{tried} valid"
+                  + (" (resync decoder)" if rs else ""))
+    if wstat:
+        r = hil_window_spike(lib_path)
+        print(f"{r['scans']}-scan gas spike to {r['peak']}: filtered "
+              f"{r['filtered']}, window max {r['max']} over {r['n']} scans, "
+              f"crossings {r['crossings']}")
+    if noise:
+        for pct, r in hil_mains_check(lib_path).items():
+            print(f"mains {MAINS_HZ * (1 + pct / 100):.1f} Hz, 40 LSB hum: "
+                  f"published error {r['err']} LSB (8-tap MA "
+                  f"{r['ma_err']:.0f}), NOISE block hum {r['hum']:.1f} LSB, "
+                  f"floor {r['floor']:.2f} LSB rms")
+    for kind in ("reset", "power"):
+        r = hil_reset_recovery(lib_path, power_cycle=(kind == "power"))
+        good = "never" if r["good_us"] is None else f"{r['good_us']:.0f} us"
+        print(f"{kind:<6} recovery: warm={r['warm']}, first frame at "
+              f"{r['first_us']:.0f} us shows {r['first_temp']:.1f} C "
+              f"alarm={r['first_alarm']}, pre-reset state at {good}")
+
+
+def frame_decode_cost(n_ch, wstat=False, noise=False, n=5000):
+    """
+    µs per accepted frame: validation + parse_frame (one SensorFrame
+    each) against validation + FrameColumns.append_raw.
+    """
+    raw = SpiReader(simulate=True, n_ch=n_ch, wstat=wstat,
+                    noise=noise)._simulate_frame()
+    cols = FrameColumns(n_ch, wstat, noise)
+    t0 = time.perf_counter()
+    for _ in range(n):
+        parse_frame(raw, n_ch, wstat, noise)
+    t1 = time.perf_counter()
+    for _ in range(n):
+        if frame_valid(raw, n_ch, wstat, noise):
+            cols.append_raw(raw, t1)
+    t2 = time.perf_counter()
+    return (t1 - t0) / n * 1e6, (t2 - t1) / n * 1e6
+
+
+def hil_sched_rates(lib_path, seconds=1.0):
+    """
+    Run the board idle for `seconds` of virtual time and return
+    per-task runs/s and overruns from the firmware scheduler —
+    scan rate, 1000/SCHED_ALARM_MS and 1000/SCHED_PUBLISH_MS
+    when nothing overruns.
+    """
+    dev = HilSpiDev(lib_path, HilScenario(noise_lsb=0))
+    dev.open(0, 0)
+    dev.advance(int(seconds * 1e6))
+    return {name: {"rate_hz": st["runs"] / seconds,
+                   "overruns": st["overruns"]}
+            for name, st in dev.sched_stats().items()}
+
+
+def hil_abort_recovery(lib_path, model=HIL_SPI_IDEAL, resync=False,
+                       gap_us=500):
+    """
+    Abort a transfer after k bytes (k = 1 .. PACKET_LEN-1), as a
+    Pi killed mid-read would, then read one full frame.  Returns
+    (valid frames, attempts).  SPI_NSS_ALIGN firmware should get
+    every one; a free-running TX index only those that happen to
+    wrap back into line — unless resync reads 2 × PACKET_LEN − 1
+    bytes and lets FrameSync find the frame at its offset.  The
+    retry follows after gap_us; 0 leaves no scan in between to
+    republish (and so rewind) the TX buffer.
+    """
+    dev = HilSpiDev(lib_path, HilScenario(noise_lsb=0), model=model)
+    dev.open(0, 0)
+    sync = FrameSync(dev.n_ch, dev.wstat, dev.noise)
+    n = sync.read_len if resync else sync.frame_len
+    dev.advance(100_000)
+    ok = 0
+    for k in range(1, sync.frame_len):
+        dev.xfer2([0] * k)
+        dev.advance(gap_us)
+        raw = dev.xfer2([0] * n)
+        if resync:
+            ok += sync.find(raw)[0] is not None
+        else:
+            ok += parse_frame(raw, dev.n_ch, dev.wstat, dev.noise) is not None
+        dev.advance(500)
+    return ok, sync.frame_len - 1
+
+
+def hil_drdy_latency(lib_path, trials=20, poll_s=POLL_INTERVAL_S,
+                     step_us=24, seed=1):
+    """
+    Gas step 800 → 2700 at a random instant, then the first read
+    whose frame shows the gas WARN bit, in virtual time.  "poll"
+    reads every poll_s at a random phase, as the Pi did; "drdy"
+    reads on each PB2 rising edge.  Reads per second are counted
+    over one idle second first (SCHED_PUBLISH_MS for "drdy").
+    """
+    import random
+    rng = random.Random(seed)
+    base = HilScenario("0 25 800\n1000 25 800", noise_lsb=0)
+    hot = HilScenario("0 25 2700\n1000 25 2700", noise_lsb=0)
+    poll_us = int(poll_s * 1e6)
+    out = {}
+    for mode in ("poll", "drdy"):
+        dev = HilSpiDev(lib_path, base)
+        dev.STEP_US = step_us
+        dev.open(0, 0)
+        lib, n = dev.lib, packet_len(dev.n_ch, dev.wstat, dev.noise)
+        level = False
+        next_poll = rng.randrange(poll_us)
+
+        def step():
+            """Advance one step; read if due.  Returns the frame or None."""
+            nonlocal level, next_poll
+            dev.advance(step_us)
+            if mode == "poll":
+                if dev._now_us < next_poll:
+                    return None
+                next_poll += poll_us
+            else:
+                high = bool(lib.HIL_DrdyLevel())
+                rising, level = high and not level, high
+                if not rising:
+                    return None
+            return (parse_frame(dev.xfer2([0] * n), dev.n_ch, dev.wstat,
+                                dev.noise) or False)
+
+        dev.advance(300_000)
+        next_poll += dev._now_us
+        idle_end, idle_reads = dev._now_us + 1_000_000, 0
+        while dev._now_us < idle_end:
+            idle_reads += step() is not None
+
+        lat = []
+        for _ in range(trials):
+            dev.scenario, t0 = hot, dev._now_us
+            while dev._now_us < t0 + 200_000:
+                frame = step()
+                if frame and frame.gas_alarm:
+                    lat.append((dev._now_us - t0) / 1000.0)
+                    break
+            # WARN clears again; the next onset lands at a random phase
+            # of both the poll schedule and the SCHED_PUBLISH_MS tick,
+            # just after a read (line low)
+            dev.scenario = base
+            dev.STEP_US = 1000
+            dev.advance(100_000 + rng.randrange(poll_us))
+            dev.STEP_US = step_us
+            dev.xfer2([0] * n)
+            dev.advance(100)
+            level = bool(lib.HIL_DrdyLevel())
+            next_poll = dev._now_us + rng.randrange(poll_us)
+        name = "drdy" if mode == "drdy" else f"poll {poll_s * 1e3:.0f} ms"
+        out[name] = {"mean_ms": sum(lat) / len(lat) if lat else float("nan"),
+                     "max_ms": max(lat) if lat else float("nan"),
+                     "reads_s": float(idle_reads)}
+    return out
+
+
+def hil_poll_rate(lib_path, speed=1.0, adapt=None, seconds=10.0,
+                  scenario=None):
+    """
+    Poll the HIL board for `seconds` of Pi time with a fixed
+    POLL_INTERVAL_S, or with a PollRateController when adapt =
+    (min_s, max_s).  The board runs `speed` × Pi time, so it
+    publishes every SCHED_PUBLISH_MS / speed.  Virtual time only:
+    the result does not depend on host load.
+    """
+    dev = HilSpiDev(lib_path, scenario or
+                    HilScenario("0 25 800\n1000 25 800", noise_lsb=0))
+    dev.open(0, 0)
+    n = packet_len(dev.n_ch, dev.wstat, dev.noise)
+    dev.advance(300_000)
+    ctrl = (PollRateController(adapt[0], adapt[1], POLL_INTERVAL_S)
+            if adapt else None)
+    t, period, last, last_scan = 0.0, POLL_INTERVAL_S, None, 0
+    reads = new = repeats = missed = lost_scans = 0
+    while t < seconds:
+        dev.advance(int(period * speed * 1e6))
+        t += period
+        reads += 1
+        frame = parse_frame(dev.xfer2([0] * n), dev.n_ch, dev.wstat,
+                            dev.noise)
+        if frame is None:
+            continue
+        if last is not None:
+            d = frame.pub_cnt - last
+            repeats += d == 0
+            new += d > 0
+            missed += max(0, d - 1)
+            if d > 1:
+                lost_scans += frame.scan_cnt - frame.fold - last_scan
+        last, last_scan = frame.pub_cnt, frame.scan_cnt
+        if ctrl is not None:
+            period = ctrl.update(t, frame.pub_cnt, frame.status)
+    dev.close()
+    return {"reads_s": reads / t, "new_s": new / t,
+            "repeat_pct": 100.0 * repeats / max(1, reads),
+            "missed": missed, "lost_scans": lost_scans,
+            "period_ms": period * 1e3,
+            "pub_ms": ctrl.pub_s * 1e3 if ctrl else 0.0,
+            "changes": ctrl.changes if ctrl else 0}
+
+
+def adapt_bench(seconds=10.0, lib_path=None,
+                adapt=(ADAPT_MIN_MS / 1e3, ADAPT_MAX_MS / 1e3)):
+    """Fixed vs adaptive poll period against 80 / 20 / 10 ms publication."""
+    lib_path = lib_path or build_hil_library(werror=True)
+    hot = HilScenario("0 60 800\n1000 60 800", noise_lsb=0)  # temp ALARM
+    print(f"poll rate, {seconds:.0f} s of Pi time per row, adaptive "
+          f"{adapt[0] * 1e3:.0f}:{adapt[1] * 1e3:.0f} ms")
+    print(f"{'publish':<9} {'mode':<16} {'reads/s':>8} {'new/s':>6} "
+          f"{'repeats':>8} {'missed':>7} {'scans lost':>11} "
+          f"{'period ms':>10}")
+    for speed, scenario, label in ((0.25, None, ""), (1.0, None, ""),
+                                   (2.0, None, ""), (0.25, hot, " ALARM")):
+        pub = f"{HIL_PUBLISH_MS / speed:.0f} ms"
+        modes = (("adaptive", adapt),) if scenario else (
+            (f"fixed {POLL_INTERVAL_S * 1e3:.0f} ms", None),
+            ("adaptive", adapt))
+        for mode, spec in modes:
+            r = hil_poll_rate(lib_path, speed, spec, seconds, scenario)
+            print(f"{pub:<9} {mode + label:<16} {r['reads_s']:>8.1f} "
+                  f"{r['new_s']:>6.1f} {r['repeat_pct']:>7.1f}% "
+                  f"{r['missed']:>7d} {r['lost_scans']:>11d} "
+                  f"{r['period_ms']:>10.1f}")
+
+
+def hil_window_spike(lib_path, base=800, peak=GAS_ALARM_ON + 200, scans=3,
+                     gap_us=100_000):
+    """
+    Hold gas at `base`, read once to open a window, drive a spike
+    of `scans` raw scans to `peak`, then read again gap_us later.
+    The moving average has long since smoothed the spike away; the
+    WSTAT window still shows it as max and one WARN crossing.
+    """
+    scen = HilScenario(f"0 25 {base}\n1000 25 {base}", noise_lsb=0)
+    dev = HilSpiDev(lib_path, scen)
+    dev.open(0, 0)
+    lib, n = dev.lib, packet_len(dev.n_ch, dev.wstat, dev.noise)
+    dev.advance(2_000_000)
+    dev.xfer2([0] * n)                           # window starts here
+
+    adc = dev._adc
+    adc[:] = scen.adc_at(0.0, dev.n_ch)
+    adc[1] = peak
+    lib.HIL_SetAdc(adc)
+    lib.HIL_Advance(scans * lib.HIL_ScanPeriodNs() // 1000)
+    dev.advance(gap_us)
+    frame = parse_frame(dev.xfer2([0] * n), dev.n_ch, dev.wstat, dev.noise)
+    w = frame.wstat[1]
+    return {"scans": scans, "peak": peak, "filtered": frame.gas_raw,
+            "max": w.max, "n": w.n, "crossings": w.crossings}
+
+
+def hil_mains_check(lib_path, base=800, amp=40, off_pct=(0.0, 1.0),
+                    reads=200):
+    """
+    Put an `amp` LSB mains sine on every input (at MAINS_HZ and
+    off_pct % above it, an off-trim HSI or a drifting grid) and read
+    one frame per ms.  Returns {off_pct: {err, ma_err, hum, floor}}:
+    worst |gas − base| the node published, the same for the 8-tap
+    moving average it replaces (gain of the MA at that frequency),
+    and the hum amplitude / noise floor from the NOISE block.
+    """
+    import cmath
+    scen = HilScenario(f"0 25 {base}\n1000 25 {base}", noise_lsb=0)
+    dev = HilSpiDev(lib_path, scen)
+    dev.open(0, 0)
+    if not dev.noise:
+        return None
+    lib, n = dev.lib, packet_len(dev.n_ch, dev.wstat, dev.noise)
+    scan_s = lib.HIL_ScanPeriodNs() * 1e-9
+
+    out = {}
+    for pct in off_pct:
+        f = MAINS_HZ * (1.0 + pct / 100.0)
+        lib.HIL_SetHum(amp, int(f * 1000 + 0.5))
+        dev.advance(500_000)                     # windows full
+        err, frame = 0, None
+        for _ in range(reads):
+            dev.advance(1000)
+            frame = parse_frame(dev.xfer2([0] * n), dev.n_ch, dev.wstat,
+                                dev.noise) or frame
+            if frame is not None:
+                err = max(err, abs(frame.gas_raw - base))
+        ma = abs(sum(cmath.exp(-2j * cmath.pi * f * k * scan_s)
+                     for k in range(ADC_FILTER_SAMPLES))) / ADC_FILTER_SAMPLES
+        out[pct] = {"err": err, "ma_err": amp * ma,
+                    "hum": frame.noise[1].hum_amp,
+                    "floor": frame.noise[1].floor}
+    return out
+
+
+def hil_reset_recovery(lib_path, power_cycle=False, hot_c=60.0, gas=800,
+                       poll_us=10, limit_us=200_000):
+    """
+    Reset the virtual board while it is in temperature ALARM and
+    poll every poll_us until a frame again shows the pre-reset
+    temperature (±0.5 °C) with the alarm bit set.  HIL_Reset is an
+    NRST/watchdog reset (backup SRAM kept → warm start),
+    HIL_PowerCycle a power-on (cold start).
+    """
+    scen = HilScenario(f"0 {hot_c} {gas}\n1000 {hot_c} {gas}", noise_lsb=0)
+    dev = HilSpiDev(lib_path, scen)
+    dev.open(0, 0)
+    n_ch = dev.n_ch
+    dev.advance(2_000_000)                       # filters full, ALARM
+    lib = dev.lib
+    (lib.HIL_PowerCycle if power_cycle else lib.HIL_Reset)()
+
+    first = good = first_frame = None
+    while lib.HIL_NowNs() < limit_us * 1000:
+        frame = parse_frame(dev.xfer2([0] * packet_len(n_ch, dev.wstat,
+                                                      dev.noise)),
+                            n_ch, dev.wstat, dev.noise)
+        t_us = lib.HIL_NowNs() / 1000.0
+        if frame is not None:
+            if first is None:
+                first, first_frame = t_us, frame
+            if abs(frame.temp_c - hot_c) <= 0.5 and frame.temp_alarm:
+                good = t_us
+                break
+        dev.advance(poll_us)
+    return {"warm": bool(lib.HIL_WarmStarted()),
+            "first_us": first if first is not None else float("nan"),
+            "first_temp": first_frame.temp_c if first_frame else float("nan"),
+            "first_alarm": bool(first_frame and first_frame.temp_alarm),
+            "good_us": good}
+
+
+def check_protocol(trials=2000, lib_path=None, seed=1):
+    """
+    Randomised round trip over FRAME_SCHEMA.
+
+    python: check_codec() — every N and block set through FrameCodec,
+            frame_valid, parse_frame and FrameColumns.
+    c     : the generated Frame_Pack (HIL build of board.h as it
+            is) on random fields, with live NOISE / WSTAT blocks;
+            decoded here, and re-packed by FrameCodec byte for byte.
+
+    Returns {"python": (ok, tried), "c": (ok, tried, n_ch, blocks)}.
+    """
+    import ctypes as C
+    import random
+    rng = random.Random(seed)
+    out = {"python": check_codec(trials, seed)}
+
+    lib_path = lib_path or build_hil_library(werror=True)
+    n_ch, stream, wstat, noise = hil_firmware_info(lib_path)
+    if stream:
+        return out
+    lib = _load_hil(lib_path)
+    lib.HIL_PackFrame.argtypes = [C.POINTER(C.c_uint8), C.c_uint8,
+                                  C.c_uint8, C.POINTER(C.c_uint16),
+                                  C.c_uint16, C.c_uint32, C.c_uint32,
+                                  C.c_uint32, C.c_uint16]
+    codec = FrameCodec.get(n_ch, wstat, noise)
+    buf = (C.c_uint8 * codec.size)()
+    lib.HIL_SetHum(40, MAINS_HZ * 1000)
+    ok = 0
+    for t in range(trials):
+        if t % 64 == 0:
+            # New inputs, and a mains window or two so the blocks change
+            lib.HIL_SetAdc((C.c_uint16 * n_ch)(*(
+                rng.randrange(200, 3800) for _ in range(n_ch))))
+            lib.HIL_Advance(25000)
+        adc = tuple(rng.randrange(ADC_RESOLUTION + 1) for _ in range(n_ch))
+        seq, status = rng.getrandbits(8), rng.getrandbits(8)
+        temp, ts = rng.getrandbits(16), rng.getrandbits(32)
+        pub, scans, fold = (rng.getrandbits(32), rng.getrandbits(32),
+                            rng.getrandbits(16))
+        lib.HIL_PackFrame(buf, seq, status, (C.c_uint16 * n_ch)(*adc),
+                          temp, ts, pub, scans, fold)
+        raw = bytes(buf)
+        frame = parse_frame(raw, n_ch, wstat, noise)
+        ok += (frame is not None
+               and (frame.seq, frame.status, frame.adc, frame.temp_x10,
+                    frame.ts_us, frame.pub_cnt, frame.scan_cnt, frame.fold)
+               == (seq, status, adc, temp, ts, pub, scans, fold)
+               and codec.pack(codec.unpack(raw)) == raw)
+    out["c"] = (ok, trials, n_ch, codec.blocks)
+    return out
+
+
+def est_bench(lib_path=None, noise_lsb=2.0, step_lsb=400, seed=1):
+    """
+    Step and ramp response of the firmware's moving average and
+    Kalman estimator (kalman.c), fed the same noisy raw scans
+    through the HIL library.  A box filter tuned to the Kalman's
+    output noise is added as the fair comparison.
+
+    Returns {"step": [(filter, noise σ, t50 ms, t90 ms)], "ramp":
+    [(filter, mean lag LSB)], "slope": (mean, σ) LSB/s, …}.
+    """
+    import ctypes as C
+    import random
+    import statistics
+
+    lib = _load_hil(lib_path or build_hil_library(werror=True))
+    lib.Kalman_Feed.argtypes = [C.POINTER(C.c_uint16)]
+    lib.Kalman_Feed.restype = C.c_uint8
+    lib.Kalman_GetValue.restype = C.c_uint16
+    lib.Kalman_GetSlope.restype = C.c_float
+    lib.Kalman_GetValueF.restype = C.c_float
+    lib.ADC_Mgr_FeedSample.argtypes = [C.POINTER(C.c_uint16)]
+    lib.ADC_Mgr_GetFiltered.restype = C.c_uint16
+    n_ch = lib.HIL_NumChannels()
+    scan_s = lib.HIL_ScanPeriodNs() / 1e9
+    rng = random.Random(seed)
+    buf = (C.c_uint16 * n_ch)()
+
+    def run(signal, n_scans):
+        lib.ADC_Mgr_Init()
+        lib.Kalman_Init()
+        raw, ma, kf, slope = [], [], [], []
+        for k in range(n_scans):
+            x = signal(k * scan_s) + rng.gauss(0, noise_lsb)
+            v = min(4095, max(0, int(round(x))))
+            buf[:] = [v] * n_ch
+            lib.ADC_Mgr_FeedSample(buf)
+            lib.Kalman_Feed(buf)
+            raw.append(v)
+            ma.append(lib.ADC_Mgr_GetFiltered(0))
+            kf.append(lib.Kalman_GetValueF(0))
+            slope.append(lib.Kalman_GetSlope(0))
+        return raw, ma, kf, slope
+
+    def box(raw, n):
+        out, acc = [], 0
+        for k, v in enumerate(raw):
+            acc += v - (raw[k - n] if k >= n else 0)
+            out.append(acc / min(k + 1, n))
+        return out
+
+    base, t_step = 1000.0, 0.5
+    k_step = int(t_step / scan_s)
+    n_scans = int(1.0 / scan_s)
+    raw, ma, kf, _ = run(lambda t: base + (step_lsb if t >= t_step else 0),
+                         n_scans)
+    quiet = slice(k_step // 2, k_step)
+    sd_kf = statistics.pstdev(kf[quiet])
+    box_n = max(1, round(noise_lsb ** 2 / max(sd_kf, 1e-3) ** 2))
+    filters = (("moving avg (firmware)", ma),
+               (f"box {box_n} (= Kalman noise)", box(raw, box_n)),
+               ("Kalman (firmware)", kf))
+
+    def cross(y, frac):
+        lvl = base + frac * step_lsb
+        for k in range(k_step, len(y)):
+            if y[k] >= lvl:
+                return (k - k_step) * scan_s * 1e3
+        return float("nan")
+
+    out = {"scan_s": scan_s, "noise_lsb": noise_lsb, "step_lsb": step_lsb,
+           "step": [(name, statistics.pstdev(y[quiet]), cross(y, 0.5),
+                     cross(y, 0.9)) for name, y in filters]}
+
+    rate = 200.0                                   # LSB/s
+    raw, ma, kf, slope = run(lambda t: base + rate * t, n_scans)
+    tail = slice(n_scans // 2, n_scans)
+    truth = [base + rate * k * scan_s for k in range(n_scans)]
+    out["ramp_lsb_s"] = rate
+    out["ramp"] = [
+        (name, statistics.fmean(t - v for t, v in zip(truth[tail], y[tail])))
+        for name, y in (("moving avg (firmware)", ma),
+                        (f"box {box_n}", box(raw, box_n)),
+                        ("Kalman (firmware)", kf))]
+    out["slope"] = (statistics.fmean(slope[tail]),
+                    statistics.pstdev(slope[tail]))
+    return out
+
+
+def print_est_bench(result):
+    r = result
+    print(f"step {r['step_lsb']} LSB, noise σ {r['noise_lsb']} LSB, "
+          f"scan {r['scan_s'] * 1e6:.1f} us")
+    print(f"{'filter':<26}{'noise σ':>9}{'t50 ms':>9}{'t90 ms':>9}")
+    for name, sd, t50, t90 in r["step"]:
+        print(f"{name:<26}{sd:>9.2f}{t50:>9.2f}{t90:>9.2f}")
+    print(f"ramp {r['ramp_lsb_s']:.0f} LSB/s: mean lag (LSB) / slope estimate")
+    for name, lag in r["ramp"]:
+        print(f"  {name:<24}{lag:>8.2f}")
+    print(f"  Kalman slope {r['slope'][0]:.1f} ± {r['slope'][1]:.1f} LSB/s "
+          f"(trend limits: temp {EST_TEMP_TREND_LSB_S:g}, "
+          f"gas {EST_GAS_TREND_LSB_S:g})")
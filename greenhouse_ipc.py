@@ -0,0 +1,974 @@
+"""
+Greenhouse IPC — shared-memory ring and frame daemon
+═════════════════════════════════════════════════════
+One process owns the SPI bus and polls; others read what it polled.
+--poller-process / --shm-serve / --shm-attach go through a shared-
+memory ring (ShmRingWriter → ShmRingClient), --serve / --connect
+through a SOCK_SEQPACKET daemon (FramePublisher → FrameClient).
+Both sides hand SpiReader look-alikes to the dashboard and exporter.
+"""
+
+from __future__ import annotations
+
+import os
+import sys
+import time
+import struct
+import threading
+import logging
+from collections import deque
+from dataclasses import dataclass
+
+from greenhouse_protocol import (
+    ADC_NUM_CHANNELS)
+from greenhouse_reader import (
+    ADAPT_JITTER_BOUNDS_S, LatencyHist, POLL_INTERVAL_S, PollJitter,
+    SpiReader)
+
+log = logging.getLogger("greenhouse")
+
+# ════════════════════════════════════════════════════════════
+#  CONFIGURATION — poller process, frame daemon
+# ════════════════════════════════════════════════════════════
+
+# Poller process (--poller-process, --shm-serve, --shm-attach)
+SHM_RING_ROWS    = 1024      # frames per node in the shared-memory ring
+SHM_FOLLOW_S     = 0.002     # reader side: ring check period when idle
+SHM_ATTACH_S     = 10.0      # --poller-process: wait for the child's ring
+
+# Frame daemon (--serve, --connect)
+SOCK_PATH        = "/tmp/greenhouse.sock"
+SOCK_QUEUE_MSGS  = 64        # per-client queue; when full the oldest goes
+SOCK_SNDBUF      = 16384     # kernel send buffer per client, bytes
+SOCK_MSG_MAX     = 4096      # largest message (hello, counters)
+
+# ════════════════════════════════════════════════════════════
+#  SHARED-MEMORY RING (poller process → dashboard / exporters)
+# ════════════════════════════════════════════════════════════
+#
+#  --poller-process runs the SPI poller in a process of its own, so
+#  Tk and matplotlib no longer hold the GIL its poll thread needs to
+#  wake up on time.  The poller copies every accepted frame into a
+#  ring in POSIX shared memory; any number of processes attach as
+#  readers (--shm-attach) and decode the raw frames themselves.
+#
+#  Segment layout (little-endian):
+#    header     magic, version, nodes, writer pid
+#    directory  per node: name, N, flags, frame length, rows,
+#               section offset, SPI clock, poll period
+#    section    per node: head / polls / counter generation,
+#               FrameStats counters, PollJitter, resync offsets,
+#               then `rows` slots of [row tag, t_rx, frame bytes]
+#
+#  One writer per segment.  A slot is tagged ~0 while it is written
+#  and with its row number once complete, and `head` moves after the
+#  tag: a reader that sees the row's tag before and after its copy
+#  has the whole frame.  The counters are guarded the same way by a
+#  generation number that is odd while they are written.  t_rx is
+#  CLOCK_MONOTONIC, which every process on the box shares.
+
+SHM_MAGIC        = 0x31524847          # "GHR1"
+SHM_VERSION      = 4
+SHM_TAG_WRITING  = (1 << 64) - 1
+
+# Node flags (ring directory, daemon hello)
+NODE_FLAG_WSTAT  = 0x01
+NODE_FLAG_NOISE  = 0x02
+NODE_FLAG_RESYNC = 0x04
+NODE_FLAG_DRDY   = 0x08
+NODE_FLAG_SIM    = 0x10
+NODE_FLAG_ADAPT  = 0x20                # poll-interval buckets are absolute
+
+# FrameStats published after every poll: counters, then NODE_STAT_FLOATS
+NODE_STAT_FIELDS = ("total_reads", "valid_frames", "magic_errors",
+                    "checksum_errors", "length_errors", "nch_errors",
+                    "last_seq",
+                    "seq_gaps", "seq_repeats", "frames_lost", "scans_lost",
+                    "scans_read", "board_resets", "deadline_misses",
+                    "resynced", "win_frames", "win_scans", "win_crossings",
+                    "drdy_edges", "drdy_timeouts")
+NODE_STAT_FLOATS = ("max_lateness_ms", "poll_period_ms", "pub_period_ms")
+
+_SHM_HDR   = struct.Struct("<IHHI4x")       # magic, version, nodes, pid
+_SHM_NODE  = struct.Struct("<16sBBHIIId")   # name … period_s
+_SHM_CTL   = struct.Struct("<QQQ")          # head, polls, counter gen
+_SHM_SLOT  = struct.Struct("<Qd")           # row tag, t_rx
+_NODE_STATS = struct.Struct("<%dq%dd" % (len(NODE_STAT_FIELDS),
+                                        len(NODE_STAT_FLOATS)))
+_NODE_JIT   = struct.Struct("<%dQQdd" % (len(PollJitter.BUCKET_PERIODS) + 1))
+
+
+def node_flags(node):
+    """NODE_FLAG_* bits describing how a SpiReader decodes its frames."""
+    return ((NODE_FLAG_WSTAT if node.wstat else 0)
+            | (NODE_FLAG_NOISE if node.noise else 0)
+            | (NODE_FLAG_RESYNC if node.sync is not None else 0)
+            | (NODE_FLAG_DRDY if node.drdy is not None else 0)
+            | (NODE_FLAG_SIM if node.simulate else 0)
+            | (NODE_FLAG_ADAPT if node.rate is not None else 0))
+
+
+def node_counters(node):
+    """
+    (counts, jitter, offsets) of a polled node: NODE_STAT_FIELDS +
+    NODE_STAT_FLOATS, PollJitter counts / count / sum / max dev, and
+    the resync offset dict.  Poll thread only (PollJitter's writer).
+    """
+    s, j = node.stats, node.jitter
+    with node._lock:
+        counts = tuple(getattr(s, f)
+                       for f in NODE_STAT_FIELDS + NODE_STAT_FLOATS)
+        offsets = dict(s.offsets)
+    return counts, (*j.counts, j.count, j.sum_s, j.max_dev_s), offsets
+
+
+@dataclass
+class ShmSection:
+    """Byte offsets inside one node section of the segment."""
+    stats:   int
+    jitter:  int
+    offsets: int
+    slots:   int
+    slot:    int                # bytes per slot
+    size:    int
+
+
+def shm_section(frame_len, rows):
+    """Layout of a node section for frame_len-byte frames."""
+    stats = _SHM_CTL.size
+    jitter = stats + _NODE_STATS.size
+    offsets = jitter + _NODE_JIT.size
+    slots = (offsets + 8 * frame_len + 7) & ~7
+    slot = (_SHM_SLOT.size + frame_len + 7) & ~7
+    return ShmSection(stats, jitter, offsets, slots, slot, slots + rows * slot)
+
+
+def _shm_attach(name):
+    """Open an existing segment without adopting it: only the writer unlinks."""
+    from multiprocessing import shared_memory
+
+    if sys.version_info >= (3, 13):
+        return shared_memory.SharedMemory(name, track=False)
+    from multiprocessing import resource_tracker
+    shm = shared_memory.SharedMemory(name)
+    resource_tracker.unregister(shm._name, "shared_memory")
+    return shm
+
+
+class ShmRingWriter:
+    """
+    Poller side of the ring: publishes the frames, FrameStats and
+    PollJitter of every node to shared memory segment `name`.  It
+    hooks the nodes through subscribe_raw() / subscribe_polls(), so
+    it serves a lone SpiReader and a MultiSpiPoller alike.
+    """
+
+    def __init__(self, name, nodes, rows=SHM_RING_ROWS):
+        from multiprocessing import shared_memory
+
+        self.name = name
+        self.nodes = list(nodes)
+        self.rows = rows
+        self._state = {}            # node name → [base, section, head, polls, gen]
+
+        off = (_SHM_HDR.size + _SHM_NODE.size * len(self.nodes) + 63) & ~63
+        for node in self.nodes:
+            if node.stream:
+                raise ValueError(f"{node.name}: stream packets are not "
+                                 "carried by the ring")
+            sec = shm_section(node.frame_len, rows)
+            self._state[node.name] = [off, sec, 0, 0, 0]
+            off = (off + sec.size + 63) & ~63
+
+        self.shm = shared_memory.SharedMemory(name, create=True, size=off)
+        self.buf = self.shm.buf
+        for i, node in enumerate(self.nodes):
+            _SHM_NODE.pack_into(self.buf, _SHM_HDR.size + i * _SHM_NODE.size,
+                                node.name.encode()[:16], node.n_ch,
+                                node_flags(node),
+                                node.frame_len, rows,
+                                self._state[node.name][0], node.hz,
+                                node.period_s)
+            node.subscribe_raw(self._on_frame)
+            node.subscribe_polls(self._on_poll)
+        # Magic last: readers wait for it before trusting the directory
+        _SHM_HDR.pack_into(self.buf, 0, SHM_MAGIC, SHM_VERSION,
+                           len(self.nodes), os.getpid())
+
+    def _on_frame(self, node, raw, t_rx):
+        """subscribe_raw() hook (poll thread, node lock held)."""
+        st = self._state[node.name]
+        base, sec, head = st[0], st[1], st[2]
+        at = base + sec.slots + (head % self.rows) * sec.slot
+        body = at + _SHM_SLOT.size
+        _SHM_SLOT.pack_into(self.buf, at, SHM_TAG_WRITING, t_rx)
+        self.buf[body:body + node.frame_len] = bytes(raw)
+        _SHM_SLOT.pack_into(self.buf, at, head, t_rx)
+        st[2] = head + 1
+        struct.pack_into("<Q", self.buf, base, head + 1)
+
+    def _on_poll(self, node):
+        """subscribe_polls() hook: publish the counters after every read."""
+        st = self._state[node.name]
+        base, sec = st[0], st[1]
+        counts, jit, offsets = node_counters(node)
+
+        buf = self.buf
+        st[4] += 1                                  # odd: being written
+        struct.pack_into("<Q", buf, base + 16, st[4])
+        _NODE_STATS.pack_into(buf, base + sec.stats, *counts)
+        _NODE_JIT.pack_into(buf, base + sec.jitter, *jit)
+        for off, n in offsets.items():
+            if off < node.frame_len:
+                struct.pack_into("<Q", buf, base + sec.offsets + 8 * off, n)
+        st[4] += 1
+        struct.pack_into("<Q", buf, base + 16, st[4])
+        st[3] += 1
+        struct.pack_into("<Q", buf, base + 8, st[3])
+
+    def close(self):
+        """Remove the segment (readers keep their mapping until they close)."""
+        self.buf = None
+        self.shm.close()
+        try:
+            self.shm.unlink()
+        except FileNotFoundError:
+            pass
+
+
+class RemoteReader(SpiReader):
+    """
+    A node polled by another process (ring or daemon).  To the
+    dashboard and the metrics exporter it is a SpiReader — frames,
+    stats, jitter, clock and latency histograms — but its rows and
+    counters are delivered by `client`.  TS_US ages are recomputed
+    here from the poller's receive times.
+    """
+
+    def __init__(self, client, name, n_ch, flags, frame_len, hz, period_s):
+        super().__init__(hz=hz, simulate=bool(flags & NODE_FLAG_SIM),
+                         n_ch=n_ch, name=name.rstrip(b"\0").decode(),
+                         period_s=period_s,
+                         resync=bool(flags & NODE_FLAG_RESYNC),
+                         wstat=bool(flags & NODE_FLAG_WSTAT),
+                         noise=bool(flags & NODE_FLAG_NOISE))
+        if self.frame_len != frame_len:
+            raise ValueError(f"{self.name}: poller frames are {frame_len} B, "
+                             f"this build decodes {self.frame_len} B")
+        # The DRDY line belongs to the poller; keep its counters shown
+        self.drdy = "poller" if flags & NODE_FLAG_DRDY else None
+        if flags & NODE_FLAG_ADAPT:
+            self.jitter = PollJitter(period_s, ADAPT_JITTER_BOUNDS_S)
+        self.client = client
+        self.dropped = 0        # frames lost between poller and this reader
+
+    def start(self):
+        return self.client.start()
+
+    def stop(self):
+        self.client.stop()
+
+    def _deliver(self, got, lost=0, counters=None):
+        """
+        Append frames [(raw, t_rx), ...] and apply counters
+        (node_counters() layout), then notify subscribers as
+        SpiReader._process() would.
+        """
+        new = []
+        with self._lock:
+            self.dropped += lost
+            for raw, t_rx in got:
+                new.append(self.frames.append_raw(raw, t_rx, self._stamp))
+            if counters is not None:
+                self._apply_counters(*counters)
+        for row in new:
+            for callback in self._subscribers:
+                callback(self, row)
+        if counters is not None:
+            for callback in self._poll_subscribers:
+                callback(self)
+
+    def _apply_counters(self, counts, jit, offsets):
+        for f, v in zip(NODE_STAT_FIELDS + NODE_STAT_FLOATS, counts):
+            setattr(self.stats, f, v)
+        self.stats.offsets = offsets
+        j, nb = self.jitter, len(self.jitter.counts)
+        j.counts = list(jit[:nb])
+        j.count, j.sum_s, j.max_dev_s = jit[nb:]
+
+
+class ShmRingReader(RemoteReader):
+    """One node of an attached ring, copied in by ShmRingClient."""
+
+    def __init__(self, client, index):
+        (name, n_ch, flags, frame_len, rows, base, hz,
+         period_s) = _SHM_NODE.unpack_from(
+            client.buf, _SHM_HDR.size + index * _SHM_NODE.size)
+        super().__init__(client, name, n_ch, flags, frame_len, hz, period_s)
+        self.rows = rows
+        self.base = base
+        self.section = shm_section(frame_len, rows)
+        self.polls = -1
+        head = struct.unpack_from("<Q", client.buf, base)[0]
+        self.next_row = max(0, head - rows + 1)
+
+    def _follow(self):
+        """Copy new rows and counters from the ring; True if there were any."""
+        buf, sec, n = self.client.buf, self.section, self.frame_len
+        head, polls, _ = _SHM_CTL.unpack_from(buf, self.base)
+        if head == self.next_row and polls == self.polls:
+            return False
+
+        # The slot after head - rows may be the one being rewritten
+        first = max(self.next_row, head - self.rows + 1)
+        got, lost = [], first - self.next_row
+        for row in range(first, head):
+            at = self.base + sec.slots + (row % self.rows) * sec.slot
+            tag, t_rx = _SHM_SLOT.unpack_from(buf, at)
+            raw = bytes(buf[at + _SHM_SLOT.size:at + _SHM_SLOT.size + n])
+            if tag != row or struct.unpack_from("<Q", buf, at)[0] != row:
+                lost += 1
+                continue
+            got.append((raw, t_rx))
+        self.next_row = head
+
+        counters = None
+        if polls != self.polls:
+            counters = self._read_counters(buf)
+            if counters is not None:
+                self.polls = polls
+        self._deliver(got, lost, counters)
+        return True
+
+    def _read_counters(self, buf):
+        """node_counters() tuple from the ring, None if it was torn."""
+        sec, gen_at = self.section, self.base + 16
+        gen = struct.unpack_from("<Q", buf, gen_at)[0]
+        if gen & 1:
+            return None
+        counts = _NODE_STATS.unpack_from(buf, self.base + sec.stats)
+        jit = _NODE_JIT.unpack_from(buf, self.base + sec.jitter)
+        offsets = (struct.unpack_from(f"<{self.frame_len}Q", buf,
+                                      self.base + sec.offsets)
+                   if self.sync is not None else ())
+        if struct.unpack_from("<Q", buf, gen_at)[0] != gen:
+            return None
+        return counts, jit, {o: v for o, v in enumerate(offsets) if v}
+
+
+class ShmRingClient:
+    """
+    Reader side of the ring: attaches segment `name` and follows
+    every node in it from one thread.  Stands in for a SpiReader or
+    MultiSpiPoller as the dashboard / run_headless() source.  `proc`
+    is the poller child of --poller-process, stopped with the client.
+    """
+
+    def __init__(self, name, timeout_s=0.0, proc=None):
+        self.name = name
+        self.remote = f"ring {name}"
+        self.proc = proc
+        self.shm = self._attach(timeout_s)
+        self.buf = self.shm.buf
+        _, _, n_nodes, self.writer_pid = _SHM_HDR.unpack_from(self.buf, 0)
+        self.nodes = [ShmRingReader(self, i) for i in range(n_nodes)]
+        self.simulate = any(node.simulate for node in self.nodes)
+        self._running = False
+        self._thread = None
+
+    def _attach(self, timeout_s):
+        """Open the segment once the writer has published its header."""
+        end = time.monotonic() + timeout_s
+        while True:
+            try:
+                shm = _shm_attach(self.name)
+            except (FileNotFoundError, ValueError):  # absent / not sized yet
+                shm = None
+            if shm is not None:
+                magic, version = struct.unpack_from("<IH", shm.buf, 0)
+                if magic == SHM_MAGIC and version == SHM_VERSION:
+                    return shm
+                shm.close()
+                if magic == SHM_MAGIC:
+                    raise ValueError(f"ring {self.name!r} is version "
+                                     f"{version}, expected {SHM_VERSION}")
+            if self.proc is not None and self.proc.poll() is not None:
+                raise RuntimeError(f"poller process exited "
+                                   f"({self.proc.returncode})")
+            if time.monotonic() >= end:
+                raise FileNotFoundError(f"no ring {self.name!r} in "
+                                        "shared memory")
+            time.sleep(0.05)
+
+    # ── lifecycle ──────────────────────────────────────────
+
+    def start(self):
+        if self._running:
+            return True
+        self._running = True
+        self._thread = threading.Thread(target=self._follow_loop,
+                                        daemon=True, name="shm-follow")
+        self._thread.start()
+        log.info("Attached to ring %r (poller pid %d, %d node(s))",
+                 self.name, self.writer_pid, len(self.nodes))
+        return True
+
+    def stop(self):
+        if self.shm is None:
+            return
+        self._running = False
+        if self._thread and self._thread.is_alive():
+            self._thread.join(timeout=0.5)
+        if self.proc is not None:
+            self.proc.terminate()
+            try:
+                self.proc.wait(timeout=2.0)
+            except Exception:
+                self.proc.kill()
+        self.buf = None
+        self.shm.close()
+        self.shm = None
+        log.info("Detached from ring %r.", self.name)
+
+    def _follow_loop(self):
+        while self._running:
+            busy = False
+            for node in self.nodes:
+                try:
+                    busy |= node._follow()
+                except Exception as exc:
+                    log.warning("%s: ring read error: %s", node.name, exc)
+            if not busy:
+                time.sleep(SHM_FOLLOW_S)
+
+
+def run_shm_poller(source, readers, name, rows=SHM_RING_ROWS):
+    """
+    --shm-serve: poll into ring `name` until SIGINT/SIGTERM, or
+    until the --poller-process parent that started us is gone.
+    """
+    import signal
+
+    try:
+        writer = ShmRingWriter(name, readers, rows)
+    except (ValueError, OSError) as exc:
+        log.error("Cannot create ring %r: %s", name, exc)
+        return 1
+    if not source.start():
+        writer.close()
+        return 1
+    log.info("Poller pid %d: %d node(s) into ring %r, %d rows each",
+             os.getpid(), len(writer.nodes), name, rows)
+
+    done = threading.Event()
+    signal.signal(signal.SIGTERM, lambda *_: done.set())
+    parent = os.getppid()
+    try:
+        while not done.wait(1.0):
+            if os.getppid() != parent:
+                break
+    except KeyboardInterrupt:
+        pass
+    source.stop()
+    writer.close()
+    return 0
+
+
+def spawn_poller(argv, name):
+    """Start gui_spi_greenhouse.py as a --shm-serve child with argv."""
+    import subprocess
+
+    script = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                          "gui_spi_greenhouse.py")
+    return subprocess.Popen([sys.executable, script]
+                            + list(argv) + ["--shm-serve", name])
+
+
+def _gil_load(stop, busy_s, period_s, chunk=20000):
+    """
+    Stand-in for chart redraws: busy_s of C-level work out of every
+    period_s, in sorted() calls that hold the GIL for their whole
+    length the way Agg path rendering does.
+    """
+    data = [((i * 7919) % chunk) / chunk for i in range(chunk)]
+    while not stop.is_set():
+        end = time.perf_counter() + busy_s
+        while time.perf_counter() < end:
+            sorted(data)
+        stop.wait(max(0.0, period_s - busy_s))
+
+
+def bench_split(seconds=5.0, n_ch=ADC_NUM_CHANNELS, busy_s=0.03,
+                period_s=0.1):
+    """
+    Poll-interval jitter of one simulated snapshot poller while this
+    process carries a UI-like GIL load: first with the poll thread in
+    this process, then with it in a --shm-serve child (its PollJitter
+    is read back through the ring).  Returns {mode: PollJitter}.
+    """
+    stop = threading.Event()
+    load = threading.Thread(target=_gil_load, args=(stop, busy_s, period_s),
+                            daemon=True, name="ui-load")
+    load.start()
+    out = {}
+    try:
+        reader = SpiReader(simulate=True, n_ch=n_ch)
+        reader.start()
+        time.sleep(seconds)
+        reader.stop()
+        out["in-process"] = reader.jitter
+
+        name = f"greenhouse-bench-{os.getpid()}"
+        proc = spawn_poller(["--simulate", "--channels", str(n_ch)], name)
+        try:
+            client = ShmRingClient(name, SHM_ATTACH_S, proc)
+        except (OSError, RuntimeError, ValueError):
+            proc.kill()
+            raise
+        client.start()
+        time.sleep(seconds)
+        out["poller process"] = client.nodes[0].jitter
+        client.stop()
+    finally:
+        stop.set()
+        load.join()
+    return out
+
+
+def print_bench_split(result, busy_s=0.03, period_s=0.1):
+    print(f"poll jitter, simulated snapshot poller at "
+          f"{1.0 / POLL_INTERVAL_S:.0f} Hz, UI load {busy_s * 1e3:.0f} ms of "
+          f"GIL-holding work every {period_s * 1e3:.0f} ms, "
+          f"{os.cpu_count()} CPU(s)")
+    print(f"{'mode':<15} {'polls':>6} {'mean ms':>8} {'±5 %':>7} "
+          f"{'>+10 %':>7} {'max dev ms':>10}")
+    for mode, j in result.items():
+        n = max(1, j.count)
+        on_time = j.counts[3]                   # (0.95, 1.05] × period
+        late = sum(j.counts[5:])                # > 1.1 × period
+        print(f"{mode:<15} {j.count:>6} {j.sum_s / n * 1e3:>8.2f} "
+              f"{on_time / n * 100:>6.1f}% {late / n * 100:>6.1f}% "
+              f"{j.max_dev_s * 1e3:>10.2f}")
+
+# ════════════════════════════════════════════════════════════
+#  FRAME DAEMON (one SPI master → many local clients)
+# ════════════════════════════════════════════════════════════
+#
+#  Only one process can own /dev/spidev0.0.  --serve makes that
+#  process a daemon: it polls as usual and publishes on a Unix
+#  SOCK_SEQPACKET socket, which keeps message boundaries and order,
+#  so messages need no length prefix.  Every client receives
+#    H  hello     version, nodes, then per node: name, N, flags,
+#                 frame length, SPI clock, poll period
+#    F  frame     node, row, t_rx, the raw frame bytes
+#    S  counters  node, FrameStats counters, PollJitter, then the
+#                 resync offsets as (offset, frames) pairs
+#  The poll thread never waits for a client.  It appends each
+#  message to every client's queue of SOCK_QUEUE_MSGS; a full queue
+#  drops its oldest message.  One I/O thread accepts clients and
+#  drains their queues while their sockets take data.  A client
+#  sees lost frames as gaps in `row`.  --connect is the client side.
+
+SOCK_VERSION     = 4
+
+_SOCK_HELLO = struct.Struct("<cBB")             # "H", version, nodes
+_SOCK_NODE  = struct.Struct("<16sBBHId")        # name … period_s
+_SOCK_HEAD  = struct.Struct("<cB")              # kind, node
+_SOCK_FRAME = struct.Struct("<cBQd")            # "F", node, row, t_rx
+_SOCK_PAIR  = struct.Struct("<HQ")              # resync offset, frames
+
+
+class FrameSubscriber:
+    """One connected client of a FramePublisher."""
+
+    def __init__(self, sock, depth):
+        self.sock = sock
+        self.queue = deque(maxlen=depth)
+        self.sent = 0
+        self.dropped = 0            # messages pushed out of a full queue
+
+
+class FramePublisher:
+    """
+    Daemon side: fans the frames and counters of `nodes` out to every
+    client of Unix socket `path`.  Hooks the nodes through
+    subscribe_raw() / subscribe_polls() like ShmRingWriter; start()
+    runs the I/O thread.
+    """
+
+    def __init__(self, path, nodes, depth=SOCK_QUEUE_MSGS):
+        import socket
+        import stat
+
+        self.path = path
+        self.nodes = list(nodes)
+        self.depth = depth
+        for node in self.nodes:
+            if node.stream:
+                raise ValueError(f"{node.name}: stream packets are not "
+                                 "published by the daemon")
+        self._index = {node.name: i for i, node in enumerate(self.nodes)}
+        self._rows = [0] * len(self.nodes)
+        self.hello = _SOCK_HELLO.pack(b"H", SOCK_VERSION, len(self.nodes)) \
+            + b"".join(_SOCK_NODE.pack(node.name.encode()[:16], node.n_ch,
+                                       node_flags(node), node.frame_len,
+                                       node.hz, node.period_s)
+                       for node in self.nodes)
+
+        self.subscribers = []
+        self._lock = threading.Lock()       # queues: poll vs I/O thread
+        self._running = False
+        self._thread = None
+        self._wake_r, self._wake_w = os.pipe()
+        os.set_blocking(self._wake_r, False)
+        os.set_blocking(self._wake_w, False)
+
+        # A socket left by a daemon that died is ours to replace
+        if os.path.exists(path) and stat.S_ISSOCK(os.stat(path).st_mode):
+            os.unlink(path)
+        self._listen = socket.socket(socket.AF_UNIX, socket.SOCK_SEQPACKET)
+        self._listen.bind(path)
+        self._listen.listen(16)
+        self._listen.setblocking(False)
+
+        for node in self.nodes:
+            node.subscribe_raw(self._on_frame)
+            node.subscribe_polls(self._on_poll)
+
+    # ── poll thread ──────────────────────────────────────
+
+    def _publish(self, msg):
+        with self._lock:
+            for sub in self.subscribers:
+                if len(sub.queue) == self.depth:
+                    sub.dropped += 1
+                sub.queue.append(msg)
+        try:
+            os.write(self._wake_w, b"\x01")
+        except BlockingIOError:
+            pass                            # I/O thread already woken
+
+    def _on_frame(self, node, raw, t_rx):
+        """subscribe_raw() hook (poll thread, node lock held)."""
+        i = self._index[node.name]
+        row, self._rows[i] = self._rows[i], self._rows[i] + 1
+        self._publish(_SOCK_FRAME.pack(b"F", i, row, t_rx) + bytes(raw))
+
+    def _on_poll(self, node):
+        """subscribe_polls() hook: the node's counters after every read."""
+        counts, jit, offsets = node_counters(node)
+        self._publish(
+            _SOCK_HEAD.pack(b"S", self._index[node.name])
+            + _NODE_STATS.pack(*counts) + _NODE_JIT.pack(*jit)
+            + b"".join(_SOCK_PAIR.pack(off, n)
+                       for off, n in sorted(offsets.items())))
+
+    # ── I/O thread ───────────────────────────────────────
+
+    def start(self):
+        self._running = True
+        self._thread = threading.Thread(target=self._serve, daemon=True,
+                                        name="frame-daemon")
+        self._thread.start()
+        log.info("Publishing %d node(s) on %s", len(self.nodes), self.path)
+
+    def stop(self):
+        self._running = False
+        try:
+            os.write(self._wake_w, b"\x01")
+        except BlockingIOError:
+            pass
+        if self._thread and self._thread.is_alive():
+            self._thread.join(timeout=1.0)
+        for sub in self.subscribers:
+            sub.sock.close()
+        self.subscribers = []
+        self._listen.close()
+        for fd in (self._wake_r, self._wake_w):
+            os.close(fd)
+        try:
+            os.unlink(self.path)
+        except FileNotFoundError:
+            pass
+
+    def _serve(self):
+        import selectors
+
+        sel = selectors.DefaultSelector()
+        sel.register(self._listen, selectors.EVENT_READ, None)
+        sel.register(self._wake_r, selectors.EVENT_READ, None)
+        while self._running:
+            for key, mask in sel.select(1.0):
+                if key.fileobj is self._listen:
+                    self._accept(sel)
+                elif key.fileobj == self._wake_r:
+                    try:
+                        os.read(self._wake_r, 4096)
+                    except BlockingIOError:
+                        pass
+                elif mask & selectors.EVENT_READ:
+                    # Clients never send: readable means hung up
+                    try:
+                        gone = not key.fileobj.recv(64)
+                    except (BlockingIOError, InterruptedError):
+                        gone = False
+                    except OSError:
+                        gone = True
+                    if gone:
+                        self._drop(sel, key.data)
+            for sub in list(self.subscribers):
+                try:
+                    self._flush(sub)
+                except OSError:             # EPIPE, ECONNRESET
+                    self._drop(sel, sub)
+                    continue
+                events = selectors.EVENT_READ | (
+                    selectors.EVENT_WRITE if sub.queue else 0)
+                if sel.get_key(sub.sock).events != events:
+                    sel.modify(sub.sock, events, sub)
+        sel.close()
+
+    def _accept(self, sel):
+        import selectors
+        import socket
+
+        try:
+            sock, _ = self._listen.accept()
+        except BlockingIOError:
+            return
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_SNDBUF, SOCK_SNDBUF)
+        sock.setblocking(False)
+        try:
+            sock.send(self.hello)           # fresh socket: always fits
+        except OSError:
+            sock.close()
+            return
+        sub = FrameSubscriber(sock, self.depth)
+        with self._lock:
+            self.subscribers.append(sub)
+        sel.register(sock, selectors.EVENT_READ, sub)
+        log.info("Client %d connected to %s", len(self.subscribers),
+                 self.path)
+
+    def _flush(self, sub):
+        """Send queued messages until the socket is full."""
+        while True:
+            with self._lock:
+                if not sub.queue:
+                    return
+                msg = sub.queue.popleft()
+            try:
+                sub.sock.send(msg)
+            except BlockingIOError:
+                with self._lock:
+                    if len(sub.queue) < self.depth:
+                        sub.queue.appendleft(msg)
+                    else:
+                        sub.dropped += 1    # it was the oldest anyway
+                return
+            sub.sent += 1
+
+    def _drop(self, sel, sub):
+        with self._lock:
+            if sub not in self.subscribers:
+                return
+            self.subscribers.remove(sub)
+        sel.unregister(sub.sock)
+        sub.sock.close()
+        log.info("Client left %s (%d sent, %d dropped)", self.path,
+                 sub.sent, sub.dropped)
+
+
+class FrameClient:
+    """
+    Client mode: connects to a --serve daemon and follows its nodes
+    as RemoteReaders.  Stands in for a SpiReader or MultiSpiPoller as
+    the dashboard / run_headless() source, like ShmRingClient, and
+    reconnects when the daemon restarts.
+    """
+
+    def __init__(self, path, timeout_s=0.0):
+        self.path = path
+        self.remote = path
+        self._sock = self._connect(timeout_s)
+        self._sock.settimeout(0.5)
+        self.hello = self._sock.recv(SOCK_MSG_MAX)
+        kind, version, n_nodes = _SOCK_HELLO.unpack_from(self.hello)
+        if kind != b"H" or version != SOCK_VERSION:
+            raise ValueError(f"{path}: not a greenhouse frame daemon "
+                             f"(version {SOCK_VERSION})")
+        self.nodes = [RemoteReader(self, *_SOCK_NODE.unpack_from(
+                          self.hello, _SOCK_HELLO.size + i * _SOCK_NODE.size))
+                      for i in range(n_nodes)]
+        self._next = [None] * n_nodes       # expected row per node
+        self.simulate = any(node.simulate for node in self.nodes)
+        self.delivery_hist = LatencyHist()  # daemon receipt → here
+        self.reconnects = 0
+        self._running = False
+        self._thread = None
+
+    def _connect(self, timeout_s):
+        import socket
+
+        end = time.monotonic() + timeout_s
+        while True:
+            sock = socket.socket(socket.AF_UNIX, socket.SOCK_SEQPACKET)
+            try:
+                sock.connect(self.path)
+                return sock
+            except (FileNotFoundError, ConnectionRefusedError):
+                sock.close()
+                if time.monotonic() >= end:
+                    raise
+            time.sleep(0.1)
+
+    # ── lifecycle ──────────────────────────────────────────
+
+    def start(self):
+        if self._running:
+            return True
+        self._running = True
+        self._thread = threading.Thread(target=self._recv_loop, daemon=True,
+                                        name="frame-client")
+        self._thread.start()
+        log.info("Client of %s: %d node(s)", self.path, len(self.nodes))
+        return True
+
+    def stop(self):
+        self._running = False
+        if self._thread and self._thread.is_alive():
+            self._thread.join(timeout=1.0)
+        if self._sock is not None:
+            self._sock.close()
+            self._sock = None
+
+    # ── receive ──────────────────────────────────────────
+
+    def _recv_loop(self):
+        while self._running:
+            if self._sock is None and not self._reconnect():
+                time.sleep(1.0)
+                continue
+            try:
+                msg = self._sock.recv(SOCK_MSG_MAX)
+            except TimeoutError:
+                continue
+            except OSError as exc:
+                log.warning("%s: %s", self.path, exc)
+                msg = b""
+            if not msg:
+                log.warning("Daemon on %s went away; reconnecting",
+                            self.path)
+                self._sock.close()
+                self._sock = None
+                continue
+            try:
+                self._dispatch(msg)
+            except (struct.error, IndexError) as exc:
+                log.warning("%s: bad message: %s", self.path, exc)
+
+    def _reconnect(self):
+        try:
+            sock = self._connect(0.0)
+            hello = sock.recv(SOCK_MSG_MAX)
+        except OSError:
+            return False
+        if hello != self.hello:
+            log.error("Daemon on %s now serves other nodes; restart "
+                      "this client", self.path)
+            sock.close()
+            return False
+        sock.settimeout(0.5)
+        self._sock = sock
+        self.reconnects += 1
+        log.info("Reconnected to %s", self.path)
+        return True
+
+    def _dispatch(self, msg):
+        kind, i = _SOCK_HEAD.unpack_from(msg)
+        node = self.nodes[i]
+        if kind == b"F":
+            _, _, row, t_rx = _SOCK_FRAME.unpack_from(msg)
+            expect = self._next[i]
+            lost = row - expect if expect is not None and row > expect else 0
+            self._next[i] = row + 1
+            self.delivery_hist.add(time.monotonic() - t_rx)
+            node._deliver([(msg[_SOCK_FRAME.size:], t_rx)], lost)
+        elif kind == b"S":
+            o = _SOCK_HEAD.size
+            counts = _NODE_STATS.unpack_from(msg, o)
+            o += _NODE_STATS.size
+            jit = _NODE_JIT.unpack_from(msg, o)
+            o += _NODE_JIT.size
+            offsets = dict(p for p in _SOCK_PAIR.iter_unpack(msg[o:]))
+            node._deliver((), 0, (counts, jit, offsets))
+
+
+def run_frame_daemon(source, readers, path):
+    """--serve: poll and publish on Unix socket `path` until SIGINT/SIGTERM."""
+    import signal
+
+    try:
+        publisher = FramePublisher(path, readers)
+    except (ValueError, OSError) as exc:
+        log.error("Cannot serve on %s: %s", path, exc)
+        return 1
+    if not source.start():
+        publisher.stop()
+        return 1
+    publisher.start()
+
+    done = threading.Event()
+    signal.signal(signal.SIGTERM, lambda *_: done.set())
+    try:
+        while not done.wait(1.0):
+            pass
+    except KeyboardInterrupt:
+        pass
+    source.stop()
+    publisher.stop()
+    return 0
+
+
+def bench_fanout(n_clients, seconds=5.0, n_ch=ADC_NUM_CHANNELS):
+    """
+    One simulated snapshot poller, a daemon and n_clients clients in
+    this process, plus one client that connects and never reads.
+    Prints what each client got and the poller's own jitter, which
+    must not depend on the stalled client.
+    """
+    import tempfile
+
+    path = os.path.join(tempfile.mkdtemp(prefix="greenhouse-"), "bench.sock")
+    reader = SpiReader(simulate=True, n_ch=n_ch)
+    publisher = FramePublisher(path, [reader])
+    publisher.start()
+    clients = [FrameClient(path) for _ in range(n_clients)]
+    stalled = FrameClient(path)             # connected, never started
+    for client in clients:
+        client.start()
+    reader.start()
+    time.sleep(seconds)
+    reader.stop()
+    time.sleep(0.1)                         # let the queues drain
+
+    _, st = reader.get_snapshot()
+    print(f"daemon: {st.valid_frames} frames polled once, "
+          f"{len(publisher.subscribers)} clients, poll jitter max "
+          f"{reader.jitter.max_dev_s * 1e3:.2f} ms")
+    print(f"{'client':<8} {'frames':>7} {'lost':>6} {'dropped':>8} "
+          f"{'p50 ms':>7} {'p99 ms':>7}")
+    for i, client in enumerate(clients):
+        node, h = client.nodes[0], client.delivery_hist
+        print(f"{i:<8} {node.frames.count:>7} {node.dropped:>6} "
+              f"{publisher.subscribers[i].dropped:>8} "
+              f"{h.percentile(50) * 1e3:>7.2f} {h.percentile(99) * 1e3:>7.2f}")
+    print(f"{'stalled':<8} {'-':>7} {'-':>6} "
+          f"{publisher.subscribers[-1].dropped:>8} "
+          f"(queue {len(publisher.subscribers[-1].queue)}/"
+          f"{SOCK_QUEUE_MSGS} msgs)")
+
+    for client in clients + [stalled]:
+        client.stop()
+    publisher.stop()
+    os.rmdir(os.path.dirname(path))
@@ -0,0 +1,1588 @@
+"""
+Greenhouse SPI protocol — frame schema, codecs, generated C tables
+═══════════════════════════════════════════════════════════════════
+The Pi half of board.h §7: FRAME_SCHEMA and the board.h constants it
+mirrors, the snapshot / stream / capture packet codecs, FrameColumns
+(the columnar frame store) and the generators for cal_lut.c and
+frame_pack.h.  Plain Python (numpy optional): gui_spi_greenhouse.py,
+the poller processes and test_greenhouse.py all import it.
+"""
+
+from __future__ import annotations
+
+import os
+import time
+import functools
+import struct
+import logging
+from array import array
+from dataclasses import dataclass, field
+
+# ── Optional: numpy for batch (many-frame) unpacking ────────
+try:
+    import numpy as np
+    HAS_NUMPY = True
+except ImportError:
+    HAS_NUMPY = False
+
+log = logging.getLogger("greenhouse")
+
+# ════════════════════════════════════════════════════════════
+#  CONFIGURATION — mirrors board.h on STM32 side
+#
+#  These constants MUST match board.h Section 7 exactly.
+#  If you change the STM32 protocol, update both files.
+# ════════════════════════════════════════════════════════════
+
+# ADC scan (board.h §3 — ADC_NUM_CHANNELS, ADC_MAX_CHANNELS)
+ADC_NUM_CHANNELS = 4
+ADC_MAX_CHANNELS = 16
+
+# Magic bytes (board.h §7 — FRAME_MAGIC_0/1, FRAME_END_MARKER)
+MAGIC_0          = 0xAA
+MAGIC_1          = 0x55
+END_MARKER       = 0x0D
+
+# Snapshot frame schema (board.h §7).  The one description of the
+# frame: the offsets below, FrameCodec's struct decoder and the C
+# packer in STM32_keli_pack/frame_pack.h (--gen-frame-pack) are all
+# derived from these rows, in order.
+#   u8/u16/u24/u32/u48 : little-endian unsigned field
+#   const  : fixed byte (arg)         nch    : N, channels in payload
+#   adc12  : N packed 12-bit samples  pair12 : two packed 12-bit values
+#   block  : optional FRAME_BLOCKS[arg], filled by its MCU module
+#   xor    : XOR of all preceding bytes
+FRAME_SCHEMA = (
+    # name       kind     arg
+    ("MAGIC0",   "const", MAGIC_0),
+    ("MAGIC1",   "const", MAGIC_1),
+    ("SEQ",      "u8",    None),
+    ("STATUS",   "u8",    None),
+    ("NCH",      "nch",   None),
+    ("ADC",      "adc12", None),
+    ("TEMP_X10", "u16",   None),
+    ("TS_US",    "u32",   None),        # MCU sample time in µs
+    ("PUB_CNT",  "u32",   None),        # frames published since reset
+    ("SCAN_CNT", "u32",   None),        # scans fed since reset
+    ("FOLD",     "u16",   None),        # scans fed since the last frame
+    ("WSTAT",    "block", "wstat"),
+    ("NOISE",    "block", "noise"),
+    ("XOR",      "xor",   None),
+    ("END",      "const", END_MARKER),
+)
+
+# Optional blocks: board.h flag, MCU packer, header fields, then the
+# fields repeated per channel.
+#   wstat (board.h §7 — WSTAT_*): scans in window, per channel MIN/MAX,
+#         Σx, Σx², rising WARN crossings
+#   noise (board.h §7 — NOISE_*, §4 MAINS_*): mains windows closed, per
+#         channel NOISE and HUM, both LSB² × 256 over one mains window
+FRAME_BLOCKS = {
+    "wstat": dict(flag="WSTAT_ENABLE", packer="WinStats_Pack",
+                  head=(("WS_N", "u24"),),
+                  chan=(("MINMAX", "pair12"), ("SUM", "u32"),
+                        ("SUMSQ", "u48"), ("XCNT", "u8"))),
+    "noise": dict(flag="MAINS_ENABLE", packer="Mains_Pack",
+                  head=(("NZ_SEQ", "u8"),),
+                  chan=(("NOISE", "u24"), ("HUM", "u24"))),
+}
+
+# Field kind → (bytes, struct code); adc12 and blocks are sized per N
+SCHEMA_KINDS = {
+    "u8": (1, "B"), "u16": (2, "H"), "u24": (3, "3s"), "u32": (4, "I"),
+    "u48": (6, "6s"), "const": (1, "B"), "nch": (1, "B"),
+    "pair12": (3, "3s"), "xor": (1, "B"),
+}
+
+NOISE_Q          = 256
+MAINS_HZ         = 50
+ADC_FILTER_SAMPLES = 8          # board.h §4 moving average it replaces
+
+
+def _fields_len(fields):
+    return sum(SCHEMA_KINDS[kind][0] for _, kind in fields)
+
+
+# Per-channel block bytes (board.h WSTAT_CH_LEN, NOISE_CH_LEN)
+WSTAT_CH_LEN     = _fields_len(FRAME_BLOCKS["wstat"]["chan"])
+NOISE_CH_LEN     = _fields_len(FRAME_BLOCKS["noise"]["chan"])
+
+
+def adc_payload_len(n_ch):
+    """Packed 12-bit payload bytes (board.h FRAME_ADC_PAYLOAD_LEN)."""
+    return (3 * n_ch + 1) // 2
+
+
+def block_len(name, n_ch):
+    """Bytes of optional block `name` for n_ch channels."""
+    b = FRAME_BLOCKS[name]
+    return _fields_len(b["head"]) + n_ch * _fields_len(b["chan"])
+
+
+def wstat_len(n_ch):
+    """WSTAT block bytes for n_ch channels (board.h WSTAT_LEN_FOR)."""
+    return block_len("wstat", n_ch)
+
+
+def noise_len(n_ch):
+    """NOISE block bytes for n_ch channels (board.h NOISE_LEN_FOR)."""
+    return block_len("noise", n_ch)
+
+
+@functools.lru_cache(maxsize=None)
+def frame_layout(n_ch, wstat=False, noise=False):
+    """FRAME_SCHEMA placed for one build: ((name, kind, arg, off, size), …)."""
+    present = {"wstat": wstat, "noise": noise}
+    out, off = [], 0
+    for name, kind, arg in FRAME_SCHEMA:
+        if kind == "block":
+            if not present[arg]:
+                continue
+            size = block_len(arg, n_ch)
+        elif kind == "adc12":
+            size = adc_payload_len(n_ch)
+        else:
+            size = SCHEMA_KINDS[kind][0]
+        out.append((name, kind, arg, off, size))
+        off += size
+    return tuple(out)
+
+
+def frame_offset(name, n_ch=ADC_NUM_CHANNELS, wstat=False, noise=False):
+    """Byte offset of schema field `name` (board.h FRAME_OFF_*)."""
+    for f in frame_layout(n_ch, wstat, noise):
+        if f[0] == name:
+            return f[3]
+    raise KeyError(name)
+
+
+def packet_len(n_ch, wstat=False, noise=False):
+    """Frame length for n_ch channels (board.h PACKET_LEN)."""
+    _, _, _, off, size = frame_layout(n_ch, wstat, noise)[-1]
+    return off + size
+
+
+# Header offsets (board.h §7 — FRAME_OFF_*), the same for every N
+OFF_MAGIC0       = frame_offset("MAGIC0")
+OFF_MAGIC1       = frame_offset("MAGIC1")
+OFF_SEQ          = frame_offset("SEQ")
+OFF_STATUS       = frame_offset("STATUS")
+OFF_NCH          = frame_offset("NCH")
+OFF_ADC          = frame_offset("ADC")
+
+# Frame geometry (board.h §7 — PACKET_LEN) for the default build
+PACKET_LEN       = packet_len(ADC_NUM_CHANNELS)
+OFF_TEMP_L       = frame_offset("TEMP_X10")
+OFF_TEMP_H       = OFF_TEMP_L + 1
+OFF_TS           = frame_offset("TS_US")
+OFF_PUB_CNT      = frame_offset("PUB_CNT")
+OFF_SCAN_CNT     = frame_offset("SCAN_CNT")
+OFF_FOLD         = frame_offset("FOLD")
+OFF_XOR          = frame_offset("XOR")
+OFF_END          = frame_offset("END")
+
+# Sample timestamps (board.h §7 — TS_CLOCK_HZ): TIM5, 32-bit, wraps
+TS_CLOCK_HZ      = 1_000_000
+TS_WRAP          = 1 << 32
+
+# Channel names for the ADC card (board.h §3 — ADC_SCAN_TABLE order)
+ADC_CHANNEL_LABELS = [
+    "CH0 - LM35 (Temperature)",
+    "CH1 - MQ-2 (Gas)",
+    "CH2 - Soil Moisture",
+    "CH3 - Light Level",
+]
+
+# Per-slot calibration (board.h §3 — cal_lut.c is generated from this
+# list by --gen-cal-lut; the Pi builds the same tables at import).
+#   linear : two-point line through (raw[0], eng[0]) and (raw[1], eng[1])
+#   mq     : MQ-series load divider → Rs/R0 → ppm = a · (Rs/R0)^b
+# Table entries are round(eng × scale) clamped to uint16.  Slots past
+# the end of the list are uncalibrated (eng = raw counts).
+CAL_CHANNELS = [
+    dict(kind="linear", unit="°C", scale=10,            # LM35, 10 mV/°C
+         raw=(0, 4095), eng=(0.0, 330.0)),
+    dict(kind="mq", unit="ppm", scale=1,                # MQ-2, LPG curve
+         rl_kohm=5.0, r0_kohm=10.0, vc_mv=5000.0,
+         a=574.25, b=-2.222, max_eng=10000.0),
+    dict(kind="linear", unit="%", scale=10,             # soil: dry → wet
+         raw=(3000, 1200), eng=(0.0, 100.0)),
+    dict(kind="linear", unit="%", scale=10,             # light
+         raw=(0, 4095), eng=(0.0, 100.0)),
+]
+ADC_VREF_MV      = 3300
+ADC_RESOLUTION   = 4095
+
+# STATUS bit positions (board.h §7 — STATUS_BIT_*)
+STATUS_BIT_BUZZER     = 0
+STATUS_BIT_MOTOR      = 1
+STATUS_BIT_GAS_ALARM  = 2
+STATUS_BIT_TEMP_ALARM = 3
+STATUS_BIT_TREND      = 4      # Kalman slope over limit (EST_ENABLE)
+STATUS_BIT_EMERG      = 5      # analog watchdog tripped (AWD_ENABLE)
+STATUS_BIT_CAPTURE    = 6      # waveform record ready (CAP_ENABLE)
+
+# Kalman trend limits, LSB/s (board.h §4 — EST_*_TREND_LSB_S)
+EST_TEMP_TREND_LSB_S  = 12.0
+EST_GAS_TREND_LSB_S   = 200.0
+
+# Compressed stream packet (board.h §7 — STREAM_*, FRAME_STREAM_MAGIC_1)
+STREAM_MAGIC_1       = 0x56
+STREAM_HDR_LEN       = 15
+STREAM_OFF_NSCANS    = 5
+STREAM_OFF_DECIM     = 6
+STREAM_OFF_TEMP_L    = 7
+STREAM_OFF_BODYLEN   = 9        # uint16 LE, bytes of Rice body
+STREAM_OFF_TS        = 11       # uint32 LE, TS_US of the last scan
+STREAM_OFF_BODY      = 15
+STREAM_BLOCK_SCANS   = 64
+STREAM_DECIMATE      = 32
+STREAM_RICE_K_MAX    = 11
+STREAM_RICE_RAW      = 15       # section carries raw 12-bit samples
+STREAM_RICE_ESCAPE_Q = 16       # q ≥ 16 → 13-bit literal
+STREAM_ZZ_BITS       = 13
+STREAM_HISTORY_SCANS = 16384    # decoded raw scans kept for consumers
+
+
+def stream_body_max_len(n_ch, n_scans):
+    """Upper bound on BODY_LEN (board.h STREAM_BODY_MAX_LEN)."""
+    return (n_ch * (16 + 12 * (n_scans - 1)) + 7) // 8
+
+# MOSI commands (board.h §7 — CMD_*): [C3 OP ARG×5 XOR]
+CMD_MAGIC            = 0xC3
+CMD_LEN              = 8
+CMD_OP_CAP_ARM       = 0x01     # PRE u16, CH u8, LEVEL u16 (bit 15 falling)
+CMD_OP_CAP_FORCE     = 0x02
+CMD_OP_CAP_READ      = 0x03     # FIRST u16 (≥ TOTAL: state only)
+CMD_OP_CAP_STOP      = 0x04
+
+# Capture reply packet (board.h §7 — CAP_OFF_*, FRAME_CAP_MAGIC_1)
+CAP_MAGIC_1          = 0x57
+CAP_HDR_LEN          = 23
+CAP_OFF_REC          = 2
+CAP_OFF_STATE        = 5
+CAP_OFF_SRC          = 6
+CAP_OFF_TOTAL        = 7        # uint16 LE, scans in the record
+CAP_OFF_PRE          = 9        # uint16 LE, trigger scan index
+CAP_OFF_FIRST        = 11       # uint16 LE
+CAP_OFF_NSCANS       = 13       # uint16 LE, 0 = state only
+CAP_OFF_TS           = 15       # uint32 LE, TS_US of the trigger scan
+CAP_OFF_SCAN_NS      = 19       # uint32 LE
+CAP_OFF_BODY         = 23
+
+# Waveform capture (board.h §13 — CAP_*)
+CAP_RAM_BYTES        = 16384
+CAP_CHUNK_SCANS      = 128
+CAP_CH_NONE          = 0xFF
+CAP_LEVEL_FALLING    = 0x8000
+CAP_STATES           = ("idle", "armed", "triggered", "done")
+CAP_SOURCES          = ("none", "command", "level")
+
+
+def cap_scans(n_ch):
+    """Record length in scans (board.h CAP_SCANS)."""
+    return CAP_RAM_BYTES // (2 * n_ch)
+
+# Alarm thresholds for GUI colour (board.h §5)
+TEMP_WARN_THRESH  = 35.0       # board.h TEMP_WARN_ON_X10 / 10
+TEMP_ALARM_THRESH = 50.0       # board.h TEMP_ALARM_ON_X10 / 10
+GAS_WARN_THRESH   = 2000       # board.h GAS_WARN_ON_ADC
+GAS_ALARM_THRESH  = 2500       # board.h GAS_ALARM_ON_ADC
+
+# Analog-watchdog emergency limits, raw (board.h §12 — AWD_*)
+AWD_GAS_ADC       = 3200
+AWD_TEMP_X10      = 700
+
+# Alarm thresholds — aliases for display colour logic
+# (primary defines are TEMP_WARN_THRESH etc. above)
+TEMP_WARN_ON     = TEMP_WARN_THRESH
+TEMP_ALARM_ON    = TEMP_ALARM_THRESH
+GAS_WARN_ON      = GAS_WARN_THRESH
+GAS_ALARM_ON     = GAS_ALARM_THRESH
+
+# Frame store (FrameColumns)
+FRAME_LOG_ROWS   = 4096      # decoded frames kept by FrameColumns (≥ chart)
+
+# Firmware tree: cal_lut.c / frame_pack.h output, HIL sources
+FIRMWARE_DIR  = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                             "STM32_keli_pack")
+
+# ════════════════════════════════════════════════════════════
+#  SPI PROTOCOL LAYER
+# ════════════════════════════════════════════════════════════
+
+@dataclass
+class SensorFrame:
+    """Parsed representation of one SPI frame (or stream block)."""
+    seq:        int = 0
+    status:     int = 0
+    adc:        tuple = (0, 0, 0, 0)
+    temp_x10:   int = 0          # 0.1 °C units
+    temp_c:     float = 0.0
+    buzzer:     bool = False
+    motor:      bool = False
+    gas_alarm:  bool = False
+    temp_alarm: bool = False
+    trend:      bool = False
+    emergency:  bool = False     # analog watchdog (STATUS bit 5)
+    capture:    bool = False     # waveform record ready (STATUS bit 6)
+    ts_us:      int = 0          # MCU sample time (TS_US, wraps 2^32)
+    pub_cnt:    int = 0          # PUB_CNT, frames published (SEQ = low byte)
+    scan_cnt:   int = 0          # SCAN_CNT, scans fed since reset
+    fold:       int = 0          # FOLD, scans folded into this frame
+    age_s:      float = 0.0      # sample → receive (ClockSync)
+    wstat:      tuple = ()       # WinStat per channel (WSTAT builds)
+    noise:      tuple = ()       # ChanNoise per channel (MAINS builds)
+    noise_seq:  int = -1         # NZ_SEQ, mains windows closed (0–255)
+    timestamp:  float = field(default_factory=time.monotonic)
+
+    @property
+    def gas_raw(self) -> int:
+        return self.adc[1] if len(self.adc) > 1 else 0
+
+    @property
+    def eng(self) -> tuple:
+        """Calibrated value per channel (same tables as the MCU)."""
+        return tuple(cal_apply(i, v) for i, v in enumerate(self.adc))
+
+    def alarm_level_temp(self) -> str:
+        """Return 'NORMAL', 'WARN', or 'ALARM' based on thresholds."""
+        if self.temp_c >= TEMP_ALARM_ON:
+            return "ALARM"
+        if self.temp_c >= TEMP_WARN_ON:
+            return "WARN"
+        return "NORMAL"
+
+    def alarm_level_gas(self) -> str:
+        if self.gas_raw >= GAS_ALARM_ON:
+            return "ALARM"
+        if self.gas_raw >= GAS_WARN_ON:
+            return "WARN"
+        return "NORMAL"
+
+
+def xor_checksum(buf, length=None):
+    """XOR checksum over bytes [0..length-1] (default: all but XOR+END)."""
+    if length is None:
+        length = len(buf) - 2
+    cs = 0
+    for i in range(min(length, len(buf))):
+        cs ^= buf[i]
+    return cs & 0xFF
+
+
+def pack_adc12(samples):
+    """
+    Pack 12-bit samples two per 3 bytes (board.h §7, pack_adc12()).
+
+    Sample k occupies bits [12k .. 12k+11] of a little-endian bit
+    stream, so the whole payload is one LE integer.
+    """
+    v = 0
+    for k, s in enumerate(samples):
+        v |= (s & 0xFFF) << (12 * k)
+    return list(v.to_bytes(adc_payload_len(len(samples)), "little"))
+
+
+def unpack_adc12(payload, n_ch):
+    """Unpack n_ch 12-bit samples from one frame's packed payload."""
+    v = int.from_bytes(bytes(payload), "little")
+    return tuple((v >> (12 * k)) & 0xFFF for k in range(n_ch))
+
+
+def unpack_adc12_many(payloads, n_ch):
+    """
+    Unpack a stack of packed payloads (rows × P bytes) into a
+    rows × n_ch array in one vectorised pass.  Used for history
+    and burst data where per-frame Python loops dominate.
+
+    Returns a numpy uint16 array if numpy is available, else a
+    list of tuples.
+    """
+    if not HAS_NUMPY:
+        return [unpack_adc12(p, n_ch) for p in payloads]
+
+    plen = adc_payload_len(n_ch)
+    b = np.asarray(payloads, dtype=np.uint8).reshape(-1, plen)
+    out = np.empty((b.shape[0], n_ch), dtype=np.uint16)
+
+    pairs = n_ch // 2
+    if pairs:
+        t = b[:, :3 * pairs].reshape(-1, pairs, 3).astype(np.uint16)
+        out[:, 0:2 * pairs:2] = t[:, :, 0] | ((t[:, :, 1] & 0x0F) << 8)
+        out[:, 1:2 * pairs:2] = (t[:, :, 1] >> 4) | (t[:, :, 2] << 4)
+    if n_ch & 1:
+        lo = b[:, 3 * pairs].astype(np.uint16)
+        hi = b[:, 3 * pairs + 1].astype(np.uint16) & 0x0F
+        out[:, n_ch - 1] = lo | (hi << 8)
+    return out
+
+
+@dataclass
+class WinStat:
+    """Raw-scan statistics of one channel since the previous read."""
+    n:         int = 0          # scans in the window (shared by channels)
+    min:       int = 0
+    max:       int = 0
+    mean:      float = 0.0
+    var:       float = 0.0      # population variance, counts²
+    crossings: int = 0          # rising WARN crossings (LM35, gas)
+
+    @property
+    def std(self) -> float:
+        return self.var ** 0.5
+
+
+def _struct_fmt(fields):
+    return "".join(SCHEMA_KINDS[kind][1] for _, kind in fields)
+
+
+_BLOCK_STRUCTS = {}
+
+
+def block_struct(name, n_ch):
+    """struct.Struct of FRAME_BLOCKS[name] for n_ch channels (cached)."""
+    s = _BLOCK_STRUCTS.get((name, n_ch))
+    if s is None:
+        b = FRAME_BLOCKS[name]
+        s = _BLOCK_STRUCTS[(name, n_ch)] = struct.Struct(
+            "<" + _struct_fmt(b["head"]) + _struct_fmt(b["chan"]) * n_ch)
+    return s
+
+
+def _u(b):
+    return int.from_bytes(b, "little")
+
+
+def _bytes(v, n):
+    return (v & ((1 << (8 * n)) - 1)).to_bytes(n, "little")
+
+
+def _pair12(b):
+    return b[0] | ((b[1] & 0x0F) << 8), (b[1] >> 4) | (b[2] << 4)
+
+
+def parse_wstat(raw, n_ch):
+    """
+    Decode a WSTAT block (board.h §7) into one WinStat per channel.
+    The MCU only sums; mean and variance are derived here so the
+    ISR never divides 64-bit numbers.
+    """
+    v = block_struct("wstat", n_ch).unpack(bytes(raw))
+    n = _u(v[0])
+    out = []
+    for k in range(n_ch):
+        mm, s1, s2, xcnt = v[1 + 4 * k:5 + 4 * k]
+        lo, hi = _pair12(mm)
+        s2 = _u(s2)
+        mean = s1 / n if n else 0.0
+        var = max(0.0, (s2 - s1 * s1 / n) / n) if n else 0.0
+        out.append(WinStat(n, lo, hi, mean, var, xcnt))
+    return tuple(out)
+
+
+def pack_wstat(n, chans):
+    """
+    Build a WSTAT block (board.h §7) — the inverse of parse_wstat.
+    chans: one (min, max, sum, sumsq, xcnt) per channel.
+    """
+    vals = [_bytes(n, 3)]
+    for lo, hi, s1, s2, xcnt in chans:
+        vals += [bytes(pack_adc12((lo, hi))), s1 & 0xFFFFFFFF,
+                 _bytes(s2, 6), xcnt & 0xFF]
+    return list(block_struct("wstat", len(chans)).pack(*vals))
+
+
+@dataclass
+class ChanNoise:
+    """Noise meters of one channel over the last mains window."""
+    power:     float = 0.0      # scan variance, LSB² (hum included)
+    hum:       float = 0.0      # power of the MAINS_HZ bin, LSB²
+
+    @property
+    def rms(self) -> float:
+        return self.power ** 0.5
+
+    @property
+    def floor(self) -> float:
+        """Broadband noise, LSB rms, with the mains bin taken out."""
+        return max(0.0, self.power - self.hum) ** 0.5
+
+    @property
+    def hum_amp(self) -> float:
+        """Peak amplitude of the mains sine, LSB."""
+        return (2.0 * self.hum) ** 0.5
+
+
+def parse_noise(raw, n_ch):
+    """Decode a NOISE block (board.h §7): (NZ_SEQ, ChanNoise per channel)."""
+    v = block_struct("noise", n_ch).unpack(bytes(raw))
+    return v[0], tuple(ChanNoise(_u(v[1 + 2 * k]) / NOISE_Q,
+                                 _u(v[2 + 2 * k]) / NOISE_Q)
+                       for k in range(n_ch))
+
+
+def pack_noise(seq, chans):
+    """
+    Build a NOISE block (board.h §7) — the inverse of parse_noise.
+    chans: one (power, hum) in LSB² per channel, saturating as the MCU.
+    """
+    vals = [seq & 0xFF]
+    for power, hum in chans:
+        for v in (power, hum):
+            vals.append(_bytes(min(0xFFFFFF, max(0, int(v * NOISE_Q + 0.5))),
+                               3))
+    return list(block_struct("noise", len(chans)).pack(*vals))
+
+
+class FrameCodec:
+    """
+    FRAME_SCHEMA compiled for one build (n_ch, wstat, noise) into
+    a single precompiled struct.Struct.
+
+    unpack() returns one flat tuple in `names` order: the header
+    fields, the ADC payload (bytes), each present block's head and
+    per-channel fields ("SUM.2" = channel 2's SUM), XOR and END;
+    `index` maps a name to its position.  u24 / u48 / pair12 stay
+    bytes (struct has no such codes).  pack() is the inverse and
+    fills the constants, NCH and XOR itself.
+    """
+
+    _cache = {}
+
+    @classmethod
+    def get(cls, n_ch, wstat=False, noise=False):
+        """Shared codec per (n_ch, wstat, noise)."""
+        key = (n_ch, bool(wstat), bool(noise))
+        codec = cls._cache.get(key)
+        if codec is None:
+            codec = cls._cache[key] = cls(*key)
+        return codec
+
+    def __init__(self, n_ch, wstat=False, noise=False):
+        self.n_ch = n_ch
+        self.layout = frame_layout(n_ch, wstat, noise)
+        fmt, names, kinds, fixed = "<", [], [], []
+        self.blocks = tuple(f[2] for f in self.layout if f[1] == "block")
+        for name, kind, arg, off, size in self.layout:
+            if kind == "block":
+                b = FRAME_BLOCKS[arg]
+                fmt += _struct_fmt(b["head"]) + _struct_fmt(b["chan"]) * n_ch
+                for f, fk in b["head"]:
+                    names.append(f)
+                    kinds.append(fk)
+                for k in range(n_ch):
+                    for f, fk in b["chan"]:
+                        names.append(f"{f}.{k}")
+                        kinds.append(fk)
+                continue
+            if kind == "adc12":
+                fmt += f"{size}s"
+            else:
+                fmt += SCHEMA_KINDS[kind][1]
+            if kind == "const":
+                fixed.append((len(names), arg))
+            elif kind == "nch":
+                fixed.append((len(names), n_ch))
+            names.append(name)
+            kinds.append(kind)
+        self.struct = struct.Struct(fmt)
+        self.names = tuple(names)
+        self.kinds = tuple(kinds)
+        self.index = {n: i for i, n in enumerate(names)}
+        self.fixed = tuple(fixed)
+        self.offsets = {f[0]: f[3] for f in self.layout}
+        self.size = self.struct.size
+
+    def unpack(self, raw):
+        """Flat field tuple of one frame (length must be `size`)."""
+        return self.struct.unpack(bytes(raw))
+
+    def pack(self, values):
+        """Frame bytes from a flat tuple; constants, NCH, XOR are set."""
+        vals = list(values)
+        for i, v in self.fixed:
+            vals[i] = v
+        vals[self.index["XOR"]] = 0
+        out = bytearray(self.struct.pack(*vals))
+        out[self.offsets["XOR"]] = xor_checksum(out)
+        return bytes(out)
+
+    def offset(self, name):
+        """Byte offset of top-level schema field `name`."""
+        return self.offsets[name]
+
+    def build(self, seq, status, adc, temp_x10, ts_us, wstat=None,
+              noise=None, scan_cnt=0, fold=0):
+        """
+        Frame bytes from field values; blocks as packed bytes.  seq
+        is PUB_CNT, SEQ its low byte, as the firmware publishes them.
+        """
+        vals = [0, 0, seq & 0xFF, status & 0xFF, 0,
+                bytes(pack_adc12(adc)), temp_x10 & 0xFFFF,
+                ts_us & 0xFFFFFFFF, seq & 0xFFFFFFFF,
+                scan_cnt & 0xFFFFFFFF, min(fold, 0xFFFF)]
+        for name in self.blocks:
+            blk = wstat if name == "wstat" else noise
+            vals += block_struct(name, self.n_ch).unpack(bytes(blk))
+        return self.pack(vals + [0, 0])
+
+
+def frame_valid(raw, n_ch=ADC_NUM_CHANNELS, wstat=False, noise=False):
+    """Length, magic, END, XOR and NCH checks of one snapshot frame."""
+    return (len(raw) == packet_len(n_ch, wstat, noise)
+            and raw[OFF_MAGIC0] == MAGIC_0 and raw[OFF_MAGIC1] == MAGIC_1
+            and raw[-1] == END_MARKER
+            and raw[-2] == xor_checksum(raw)
+            and raw[OFF_NCH] == n_ch)
+
+
+def parse_frame(raw, n_ch=ADC_NUM_CHANNELS, wstat=False, noise=False):
+    """
+    Parse one raw SPI frame into a SensorFrame.
+    Returns None if validation fails.
+
+    Byte layout matches board.h Section 7 (FRAME_OFF_* defines).
+    SpiReader does not call this per poll: it decodes into
+    FrameColumns and builds the SensorFrame only on request.
+    """
+    if not frame_valid(raw, n_ch, wstat, noise):
+        return None
+
+    codec = FrameCodec.get(n_ch, wstat, noise)
+    v, ix = codec.unpack(raw), codec.index
+    frame = make_frame(v[ix["SEQ"]], v[ix["STATUS"]],
+                       unpack_adc12(v[ix["ADC"]], n_ch),
+                       v[ix["TEMP_X10"]], v[ix["TS_US"]])
+    frame.pub_cnt, frame.scan_cnt, frame.fold = (
+        v[ix["PUB_CNT"]], v[ix["SCAN_CNT"]], v[ix["FOLD"]])
+    if wstat:
+        off = codec.offset("WSTAT")
+        frame.wstat = parse_wstat(raw[off:off + wstat_len(n_ch)], n_ch)
+    if noise:
+        off = codec.offset("NOISE")
+        frame.noise_seq, frame.noise = parse_noise(raw[off:-2], n_ch)
+    return frame
+
+
+class FrameSync:
+    """
+    Resynchronising decoder for snapshot frames.
+
+    The slave's TX index wraps at PACKET_LEN, so a transfer of
+    2 × PACKET_LEN − 1 bytes holds at least one whole frame at
+    some offset, however the index had slipped.  find() locates
+    every 0xAA 0x55 … 0x0D candidate, checks NCH and the XOR
+    checksum, and returns the last valid one (newest if the
+    frame changed mid-transfer) with its byte offset.
+    """
+
+    def __init__(self, n_ch=ADC_NUM_CHANNELS, wstat=False, noise=False):
+        self.n_ch = n_ch
+        self.wstat = wstat
+        self.noise = noise
+        self.frame_len = packet_len(n_ch, wstat, noise)
+        self.read_len = 2 * self.frame_len - 1
+
+    def locate(self, raw):
+        """Return (frame bytes, offset), or (None, -1) if none is valid."""
+        buf = bytes(raw)
+        n = self.frame_len
+        sync = bytes((MAGIC_0, MAGIC_1))
+        hit = (None, -1)
+        i = buf.find(sync)
+        while 0 <= i <= len(buf) - n:
+            if buf[i + n - 1] == END_MARKER and buf[i + OFF_NCH] == self.n_ch:
+                cand = buf[i:i + n]
+                if frame_valid(cand, self.n_ch, self.wstat, self.noise):
+                    hit = (cand, i)
+            i = buf.find(sync, i + 1)
+        return hit
+
+    def find(self, raw):
+        """Return (SensorFrame, offset), or (None, -1) if none is valid."""
+        cand, off = self.locate(raw)
+        if cand is None:
+            return None, -1
+        return parse_frame(cand, self.n_ch, self.wstat, self.noise), off
+
+
+def make_frame(seq, status, adc, temp_x10, ts_us=0):
+    """Build a SensorFrame from decoded header fields."""
+    return SensorFrame(
+        seq       = seq,
+        status    = status,
+        adc       = adc,
+        temp_x10  = temp_x10,
+        temp_c    = temp_x10 / 10.0,
+        buzzer    = bool(status & (1 << STATUS_BIT_BUZZER)),
+        motor     = bool(status & (1 << STATUS_BIT_MOTOR)),
+        gas_alarm = bool(status & (1 << STATUS_BIT_GAS_ALARM)),
+        temp_alarm= bool(status & (1 << STATUS_BIT_TEMP_ALARM)),
+        trend     = bool(status & (1 << STATUS_BIT_TREND)),
+        emergency = bool(status & (1 << STATUS_BIT_EMERG)),
+        capture   = bool(status & (1 << STATUS_BIT_CAPTURE)),
+        ts_us     = ts_us,
+    )
+
+# ════════════════════════════════════════════════════════════
+#  FRAME STORE (columnar, SpiReader history)
+# ════════════════════════════════════════════════════════════
+#
+#  At 50 Hz per node a SensorFrame per poll is ~17 attributes,
+#  a tuple and N ChanNoise objects that live only until the next
+#  poll.  FrameColumns instead decodes each accepted frame into
+#  one row of preallocated typed columns; SensorFrame becomes a
+#  view, built when a consumer asks for one (the GUI on redraw,
+#  the exporter on scrape).
+
+_COL_DTYPE = {"B": "uint8", "H": "uint16", "h": "int16", "L": "uint32",
+              "d": "float64"}
+
+
+def _column(code, n):
+    """n zeroed elements of array typecode `code` (numpy if available)."""
+    if HAS_NUMPY:
+        return np.zeros(n, dtype=_COL_DTYPE[code])
+    return array(code, bytes(array(code).itemsize * n))
+
+
+class FrameColumns:
+    """
+    Ring of the last `capacity` frames of one node, one typed
+    column per field.  Row r (0, 1, 2 … ever appended) lives at
+    index r % capacity; `count` is the number of rows appended.
+
+    Columns: seq, status, temp_x10, ts_us, pub_cnt, scan_cnt, fold,
+    timestamp (receipt, monotonic), age_s, noise_seq (−1 = none),
+    adc (n_ch per row),
+    noise_q (power, hum in NOISE_Q units, 2 × n_ch per row) and,
+    in WSTAT builds, wstat_raw (the block bytes, decoded by view()).
+
+    Not locked: SpiReader appends and reads under its own lock.
+    """
+
+    def __init__(self, n_ch=ADC_NUM_CHANNELS, wstat=False, noise=False,
+                 capacity=FRAME_LOG_ROWS):
+        self.n_ch = n_ch
+        self.wstat = wstat
+        self.noise = noise
+        self.capacity = capacity
+        self.count = 0
+        self.codec = FrameCodec.get(n_ch, wstat, noise)
+        ix = self.codec.index
+        self._ix = (ix["SEQ"], ix["STATUS"], ix["ADC"], ix["TEMP_X10"],
+                    ix["TS_US"], ix["PUB_CNT"], ix.get("NZ_SEQ", -1))
+        self.off_wstat = self.codec.offset("WSTAT") if wstat else -1
+
+        self.seq       = _column("B", capacity)
+        self.status    = _column("B", capacity)
+        self.temp_x10  = _column("H", capacity)
+        self.ts_us     = _column("L", capacity)
+        self.pub_cnt   = _column("L", capacity)
+        self.scan_cnt  = _column("L", capacity)
+        self.fold      = _column("H", capacity)
+        self.timestamp = _column("d", capacity)
+        self.age_s     = _column("d", capacity)
+        self.noise_seq = _column("h", capacity)
+        self.adc       = _column("H", capacity * n_ch)
+        self.noise_q   = _column("L", capacity * 2 * n_ch)
+        self.wstat_raw = (_column("B", capacity * wstat_len(n_ch))
+                          if wstat else None)
+        self._view = (-1, None)         # (row, SensorFrame) of last view()
+
+    def __len__(self):
+        return min(self.count, self.capacity)
+
+    def append_raw(self, raw, t_rx, stamp=None):
+        """
+        Decode one validated snapshot frame (frame_valid()) into the
+        next row and return its row number.  stamp(ts_us, t_rx) →
+        age_s, if given, fills the age column (SpiReader._stamp).
+        """
+        row = self.count
+        i = row % self.capacity
+        n = self.n_ch
+        i_seq, i_st, i_adc, i_temp, i_ts, i_pub, i_nz = self._ix
+        v = self.codec.unpack(raw)
+
+        self.seq[i] = v[i_seq]
+        self.status[i] = v[i_st]
+        a = int.from_bytes(v[i_adc], "little")
+        self._put(self.adc, i * n, [(a >> (12 * k)) & 0xFFF for k in range(n)])
+        self.temp_x10[i] = v[i_temp]
+        ts_us = v[i_ts]
+        self.ts_us[i] = ts_us
+        self.pub_cnt[i] = v[i_pub]
+        self.scan_cnt[i] = v[i_pub + 1]
+        self.fold[i] = v[i_pub + 2]
+        self.timestamp[i] = t_rx
+        self.age_s[i] = stamp(ts_us, t_rx) if stamp else 0.0
+
+        if self.wstat:
+            w = wstat_len(n)
+            self._put(self.wstat_raw, i * w,
+                      raw[self.off_wstat:self.off_wstat + w])
+        if i_nz >= 0:
+            self.noise_seq[i] = v[i_nz]
+            self._put(self.noise_q, i * 2 * n,
+                      [int.from_bytes(q, "little")
+                       for q in v[i_nz + 1:i_nz + 1 + 2 * n]])
+        else:
+            self.noise_seq[i] = -1
+        self.count = row + 1
+        return row
+
+    def append_frame(self, frame):
+        """
+        Store an already decoded SensorFrame (stream blocks: one per
+        packet, not per poll) and keep it as that row's view.
+        """
+        row = self.count
+        i = row % self.capacity
+        n = self.n_ch
+        self.seq[i] = frame.seq
+        self.status[i] = frame.status
+        self.temp_x10[i] = frame.temp_x10 & 0xFFFF
+        self.ts_us[i] = frame.ts_us & 0xFFFFFFFF
+        self.pub_cnt[i] = frame.pub_cnt & 0xFFFFFFFF
+        self.scan_cnt[i] = frame.scan_cnt & 0xFFFFFFFF
+        self.fold[i] = min(frame.fold, 0xFFFF)
+        self.timestamp[i] = frame.timestamp
+        self.age_s[i] = frame.age_s
+        self.noise_seq[i] = -1
+        self._put(self.adc, i * n,
+                  (tuple(frame.adc) + (0,) * n)[:n])
+        self.count = row + 1
+        self._view = (row, frame)
+        return row
+
+    @staticmethod
+    def _put(col, at, values):
+        """Store a sequence of ints from col[at] on, one slice write."""
+        if HAS_NUMPY:
+            if isinstance(values, (bytes, bytearray)):
+                values = np.frombuffer(values, dtype=np.uint8)
+            col[at:at + len(values)] = values
+        else:
+            col[at:at + len(values)] = array(col.typecode, values)
+
+    def view(self, row):
+        """
+        SensorFrame of row number `row`, or None once it has been
+        overwritten (or never existed).  Built on demand; the last
+        view is cached so repeated snapshots of one frame are free.
+        """
+        if row == self._view[0]:
+            return self._view[1]
+        if row < 0 or row >= self.count or row < self.count - self.capacity:
+            return None
+        i = row % self.capacity
+        n = self.n_ch
+        frame = make_frame(int(self.seq[i]), int(self.status[i]),
+                           tuple(int(v) for v in self.adc[i * n:(i + 1) * n]),
+                           int(self.temp_x10[i]), int(self.ts_us[i]))
+        frame.pub_cnt = int(self.pub_cnt[i])
+        frame.scan_cnt = int(self.scan_cnt[i])
+        frame.fold = int(self.fold[i])
+        frame.timestamp = float(self.timestamp[i])
+        frame.age_s = float(self.age_s[i])
+        if self.wstat:
+            w = wstat_len(n)
+            frame.wstat = parse_wstat(self.wstat_raw[i * w:(i + 1) * w], n)
+        if self.noise_seq[i] >= 0:
+            q = self.noise_q[i * 2 * n:(i + 1) * 2 * n]
+            frame.noise_seq = int(self.noise_seq[i])
+            frame.noise = tuple(ChanNoise(int(q[2 * k]) / NOISE_Q,
+                                          int(q[2 * k + 1]) / NOISE_Q)
+                                for k in range(n))
+        self._view = (row, frame)
+        return frame
+
+    def latest(self):
+        """View of the newest row, or None before the first frame."""
+        return self.view(self.count - 1) if self.count else None
+
+    def _tail(self, n):
+        """Ring indices of the newest min(n, len) rows, oldest first."""
+        n = min(n, len(self))
+        start = self.count - n
+        if HAS_NUMPY:
+            return (np.arange(start, self.count)) % self.capacity
+        return [(start + k) % self.capacity for k in range(n)]
+
+    def history(self, n):
+        """(timestamps, temp_c, gas_raw) lists of the newest n rows."""
+        idx = self._tail(n)
+        ch = self.n_ch
+        if HAS_NUMPY:
+            gas = (self.adc[idx * ch + 1] if ch > 1
+                   else np.zeros(len(idx), dtype=np.uint16))
+            return (self.timestamp[idx].tolist(),
+                    (self.temp_x10[idx] / 10.0).tolist(),
+                    gas.tolist())
+        return ([self.timestamp[i] for i in idx],
+                [self.temp_x10[i] / 10.0 for i in idx],
+                [self.adc[i * ch + 1] if ch > 1 else 0 for i in idx])
+
+    def tail(self, n=None):
+        """
+        Copy of the newest n rows (default: all kept) as a dict of
+        columns, oldest first — the bulk interface for loggers.
+        With numpy: 1-D arrays, and adc / noise_q as rows × n_ch
+        (× 2) arrays; without: lists and lists of tuples.
+        """
+        idx = self._tail(self.capacity if n is None else n)
+        ch = self.n_ch
+        out = {}
+        for name in ("seq", "status", "temp_x10", "ts_us", "pub_cnt",
+                     "scan_cnt", "fold", "timestamp", "age_s", "noise_seq"):
+            col = getattr(self, name)
+            out[name] = col[idx] if HAS_NUMPY else [col[i] for i in idx]
+        if HAS_NUMPY:
+            out["adc"] = self.adc.reshape(-1, ch)[idx]
+            out["noise_q"] = self.noise_q.reshape(-1, 2 * ch)[idx]
+        else:
+            out["adc"] = [tuple(self.adc[i * ch:(i + 1) * ch]) for i in idx]
+            out["noise_q"] = [tuple(self.noise_q[i * 2 * ch:(i + 1) * 2 * ch])
+                              for i in idx]
+        return out
+
+# ════════════════════════════════════════════════════════════
+#  CALIBRATION TABLES (board.h §3 — cal_lut.c / cal_lut.h)
+# ════════════════════════════════════════════════════════════
+#
+#  One 4096-entry uint16 table per ADC slot.  The MCU reads
+#  g_cal_lut[ch][raw] (one flash load); the Pi indexes the same
+#  list.  Both are produced by cal_table(), so they agree as long
+#  as cal_lut.c was regenerated after CAL_CHANNELS changed —
+#  check_cal_lut() compares CRCs at start-up.
+
+def cal_table(spec):
+    """Return the 4096 uint16 entries for one CAL_CHANNELS spec."""
+    n = ADC_RESOLUTION + 1
+    if spec is None:
+        return list(range(n))
+    scale = spec["scale"]
+    out = []
+    for raw in range(n):
+        if spec["kind"] == "linear":
+            (r0, r1), (e0, e1) = spec["raw"], spec["eng"]
+            eng = e0 + (raw - r0) * (e1 - e0) / (r1 - r0)
+        elif spec["kind"] == "mq":
+            vout = raw * ADC_VREF_MV / ADC_RESOLUTION
+            if vout <= 0:
+                eng = 0.0
+            else:
+                rs = spec["rl_kohm"] * max(spec["vc_mv"] - vout, 0.0) / vout
+                ratio = rs / spec["r0_kohm"]
+                eng = (spec["a"] * ratio ** spec["b"] if ratio > 0
+                       else spec["max_eng"])
+            eng = min(eng, spec["max_eng"])
+        else:
+            raise ValueError(f"unknown calibration kind {spec['kind']!r}")
+        out.append(min(0xFFFF, max(0, int(round(eng * scale)))))
+    return out
+
+
+def cal_spec(ch):
+    return CAL_CHANNELS[ch] if ch < len(CAL_CHANNELS) else None
+
+
+_CAL_LUT = {}
+
+
+def cal_lut(ch):
+    """Table for slot ch (built once, cached)."""
+    lut = _CAL_LUT.get(ch)
+    if lut is None:
+        lut = _CAL_LUT[ch] = cal_table(cal_spec(ch))
+    return lut
+
+
+def cal_apply(ch, raw):
+    """Engineering value of one raw sample, in CAL_CHANNELS units."""
+    spec = cal_spec(ch)
+    return cal_lut(ch)[raw] / (spec["scale"] if spec else 1)
+
+
+def cal_unit(ch):
+    spec = cal_spec(ch)
+    return spec["unit"] if spec else "raw"
+
+
+def cal_lut_crc32(n_ch):
+    """CRC-32 over the n_ch tables as uint16 LE (CAL_LUT_CRC32)."""
+    import zlib
+    crc = 0
+    for ch in range(n_ch):
+        crc = zlib.crc32(struct.pack(f"<{ADC_RESOLUTION + 1}H", *cal_lut(ch)),
+                         crc)
+    return crc
+
+
+def write_cal_lut(n_ch, fw_dir=None):
+    """Generate cal_lut.c / cal_lut.h for an n_ch firmware build."""
+    fw_dir = fw_dir or FIRMWARE_DIR
+    crc = cal_lut_crc32(n_ch)
+    banner = (
+        "/*============================================================\n"
+        " *  {name} – ADC calibration lookup tables\n"
+        " *\n"
+        " *  GENERATED by gui_spi_greenhouse.py --gen-cal-lut from\n"
+        " *  CAL_CHANNELS.  Do not edit; change the Python list and\n"
+        " *  regenerate so the Pi and the MCU keep identical tables.\n"
+        " *============================================================*/\n")
+
+    h = [
+        "#ifndef _CAL_LUT_H_",
+        "#define _CAL_LUT_H_",
+        "",
+        "#include <stdint.h>",
+        '#include "board.h"',
+        "",
+        banner.format(name="cal_lut").rstrip("\n"),
+        "",
+        "/* Engineering value = g_cal_lut[ch][raw] / scale:",
+    ]
+    for ch in range(n_ch):
+        spec = cal_spec(ch)
+        desc = (f"{spec['kind']}, {spec['unit']} × {spec['scale']}" if spec
+                else "uncalibrated, raw counts")
+        h.append(f" *   ch{ch:<2d} {desc}")
+    h[-1] += "   */"
+    h += [
+        f"#define CAL_LUT_CHANNELS      {n_ch}",
+        f"#define CAL_LUT_CRC32         0x{crc:08X}UL",
+        "",
+        "#if CAL_LUT_CHANNELS != ADC_NUM_CHANNELS",
+        '#error "cal_lut.c is stale: rerun gui_spi_greenhouse.py --gen-cal-lut '
+        '--channels N"',
+        "#endif",
+        "",
+        "extern const uint16_t g_cal_lut[CAL_LUT_CHANNELS][ADC_RESOLUTION + 1];",
+        "",
+        "#endif /* _CAL_LUT_H_ */",
+        "",
+    ]
+
+    c = ['#include "cal_lut.h"', "", banner.format(name="cal_lut.c").rstrip("\n"),
+         "", "const uint16_t g_cal_lut[CAL_LUT_CHANNELS][ADC_RESOLUTION + 1] =",
+         "{"]
+    for ch in range(n_ch):
+        lut = cal_lut(ch)
+        c.append(f"    {{   /* ch{ch} – {cal_unit(ch)} */")
+        for i in range(0, len(lut), 12):
+            row = ", ".join(f"{v:5d}" for v in lut[i:i + 12])
+            c.append(f"        {row},")
+        c[-1] = c[-1].rstrip(",")
+        c.append("    }," if ch < n_ch - 1 else "    }")
+    c += ["};", ""]
+
+    for name, lines in (("cal_lut.h", h), ("cal_lut.c", c)):
+        path = os.path.join(fw_dir, name)
+        with open(path, "w", encoding="utf-8", newline="\r\n") as f:
+            f.write("\n".join(lines))
+        log.info("wrote %s", path)
+    return crc
+
+
+def check_cal_lut(n_ch, fw_dir=None):
+    """Warn when cal_lut.h next to this script disagrees with CAL_CHANNELS."""
+    import re
+    path = os.path.join(fw_dir or FIRMWARE_DIR, "cal_lut.h")
+    try:
+        with open(path, encoding="utf-8") as f:
+            text = f.read()
+    except OSError:
+        return
+    m_n = re.search(r"CAL_LUT_CHANNELS\s+(\d+)", text)
+    m_crc = re.search(r"CAL_LUT_CRC32\s+0x([0-9A-Fa-f]+)", text)
+    if not (m_n and m_crc):
+        return
+    fw_n = int(m_n.group(1))
+    if fw_n == n_ch and int(m_crc.group(1), 16) != cal_lut_crc32(n_ch):
+        log.warning("cal_lut.h CRC differs from CAL_CHANNELS — "
+                    "regenerate with --gen-cal-lut and reflash")
+
+# ════════════════════════════════════════════════════════════
+#  FRAME PACKER (board.h §7 — frame_pack.h)
+# ════════════════════════════════════════════════════════════
+#
+#  write_frame_pack() turns FRAME_SCHEMA into the C packer the
+#  PUBLISH task calls, specialised for one N: constant offsets,
+#  every byte stored and folded into the XOR as it is produced,
+#  no loops and no per-byte branches.  board.h keeps its hand-
+#  written FRAME_OFF_* for the rest of the firmware; the header
+#  #errors when they disagree with the schema.  check_frame_pack()
+#  compares schema CRCs at start-up, like check_cal_lut().
+
+_C_PARAM = {1: "uint8_t", 2: "uint16_t", 4: "uint32_t"}
+
+
+def frame_schema_crc32():
+    """CRC-32 of FRAME_SCHEMA + FRAME_BLOCKS (FRAME_SCHEMA_CRC32)."""
+    import zlib
+    desc = repr((FRAME_SCHEMA, sorted(FRAME_BLOCKS.items())))
+    return zlib.crc32(desc.encode("utf-8"))
+
+
+def _c_store(lines, off, expr, note):
+    lines.append(f"    b = {expr};".ljust(60)
+                 + f"p[{off}] = b;".ljust(11) + f"cs ^= b;  /* {note} */")
+
+
+def write_frame_pack(n_ch, fw_dir=None):
+    """Generate frame_pack.h (snapshot frame packer) for an n_ch build."""
+    fw_dir = fw_dir or FIRMWARE_DIR
+    crc = frame_schema_crc32()
+    base = frame_layout(n_ch, wstat=False, noise=False)
+    params, body, cs0 = [], [], 0
+
+    for name, kind, arg, off, size in base:
+        if kind in ("const", "nch"):
+            v = arg if kind == "const" else n_ch
+            if kind == "const" and name != "END":
+                cs0 ^= v
+                body.append(f"    p[{off}] = 0x{v:02X}U;".ljust(80)
+                            + f"/* {name} */")
+            elif kind == "nch":
+                cs0 ^= v
+                body.append(f"    p[{off}] = {v}U;".ljust(80)
+                            + f"/* {name}, N */")
+        elif kind == "adc12":
+            params.append("const uint16_t adc[ADC_NUM_CHANNELS]")
+            for k in range(0, n_ch - 1, 2):
+                o = off + 3 * (k // 2)
+                _c_store(body, o, f"(uint8_t)adc[{k}]", f"ADC{k} 7..0")
+                _c_store(body, o + 1,
+                         f"(uint8_t)(((adc[{k}] >> 8) & 0x0FU)"
+                         f" | (adc[{k + 1}] << 4))",
+                         f"ADC{k + 1} 3..0, ADC{k} 11..8")
+                _c_store(body, o + 2, f"(uint8_t)(adc[{k + 1}] >> 4)",
+                         f"ADC{k + 1} 11..4")
+            if n_ch & 1:
+                k, o = n_ch - 1, off + 3 * (n_ch // 2)
+                _c_store(body, o, f"(uint8_t)adc[{k}]", f"ADC{k} 7..0")
+                _c_store(body, o + 1, f"(uint8_t)((adc[{k}] >> 8) & 0x0FU)",
+                         f"ADC{k} 11..8")
+        elif kind.startswith("u"):
+            var = name.lower()
+            params.append(f"{_C_PARAM[size]} {var}")
+            for j in range(size):
+                expr = var if size == 1 else (
+                    f"(uint8_t){var}" if j == 0 else f"(uint8_t)({var} >> {8 * j})")
+                _c_store(body, off + j, expr,
+                         name if size == 1 else f"{name} byte {j}")
+
+    # Optional blocks and the trailer move with the build flags
+    variants = []
+    for wstat in (True, False):
+        for noise in (True, False):
+            lay = frame_layout(n_ch, wstat, noise)
+            variants.append((wstat, noise,
+                             {f[0]: f[3] for f in lay},
+                             lay[-1][3] + lay[-1][4]))
+    flags = {"wstat": "WSTAT_ENABLE", "noise": "MAINS_ENABLE"}
+
+    h = [
+        "#ifndef _FRAME_PACK_H_",
+        "#define _FRAME_PACK_H_",
+        "",
+        "#include <stdint.h>",
+        '#include "board.h"',
+        '#include "win_stats.h"      /* WinStats_Pack (WSTAT block)      */',
+        '#include "mains.h"          /* Mains_Pack (NOISE block)         */',
+        "",
+        "/*============================================================",
+        " *  frame_pack – snapshot frame packer (board.h Section 7)",
+        " *",
+        " *  GENERATED by gui_spi_greenhouse.py --gen-frame-pack from",
+        " *  FRAME_SCHEMA.  Do not edit; change the schema and regenerate",
+        " *  so the MCU packer and the Pi decoder share one layout.",
+        " *",
+        f" *  Specialised for N = {n_ch}: constant offsets, every byte",
+        " *  stored and folded into the XOR as it is produced, with no",
+        " *  loops and no per-byte branches.  Block bytes are written",
+        " *  by their module and folded back in, unrolled.",
+        " *============================================================*/",
+        "",
+        f"#define FRAME_PACK_CHANNELS   {n_ch}",
+        f"#define FRAME_SCHEMA_CRC32    0x{crc:08X}UL",
+        "",
+        "#if FRAME_PACK_CHANNELS != ADC_NUM_CHANNELS",
+        '#error "frame_pack.h is stale: rerun gui_spi_greenhouse.py '
+        '--gen-frame-pack --channels N"',
+        "#endif",
+        "",
+        "/* Schema offsets of this build */",
+    ]
+    for i, (wstat, noise, offs, length) in enumerate(variants):
+        cond = f"{'' if wstat else '!'}WSTAT_ENABLE && " \
+               f"{'' if noise else '!'}MAINS_ENABLE"
+        h.append(("#if " if i == 0 else "#elif ") + cond)
+        if wstat:
+            h.append(f"#define FRAME_PACK_OFF_WSTAT  {offs['WSTAT']}")
+        if noise:
+            h.append(f"#define FRAME_PACK_OFF_NOISE  {offs['NOISE']}")
+        h.append(f"#define FRAME_PACK_OFF_XOR    {offs['XOR']}")
+        h.append(f"#define FRAME_PACK_LEN        {length}")
+    h.append("#endif")
+
+    fixed = [f"FRAME_OFF_{n} != {o}" for n, o in (
+        ("MAGIC0", OFF_MAGIC0), ("MAGIC1", OFF_MAGIC1), ("SEQ", OFF_SEQ),
+        ("STATUS", OFF_STATUS), ("NCH", OFF_NCH), ("ADC", OFF_ADC),
+        ("TEMP_L", frame_offset("TEMP_X10", n_ch)),
+        ("TS", frame_offset("TS_US", n_ch)),
+        ("PUB", frame_offset("PUB_CNT", n_ch)),
+        ("SCAN", frame_offset("SCAN_CNT", n_ch)),
+        ("FOLD", frame_offset("FOLD", n_ch)))]
+    fixed += ["FRAME_OFF_XOR != FRAME_PACK_OFF_XOR",
+              "PACKET_LEN != FRAME_PACK_LEN",
+              f"FRAME_ADC_PAYLOAD_LEN != {adc_payload_len(n_ch)}",
+              f"WSTAT_CH_LEN != {WSTAT_CH_LEN}",
+              f"NOISE_CH_LEN != {NOISE_CH_LEN}",
+              f"FRAME_MAGIC_0 != 0x{MAGIC_0:02X}U",
+              f"FRAME_MAGIC_1 != 0x{MAGIC_1:02X}U",
+              f"FRAME_END_MARKER != 0x{END_MARKER:02X}U",
+              ]
+    cond = [" || ".join(fixed[i:i + 2]) for i in range(0, len(fixed), 2)]
+    cond += ["(WSTAT_ENABLE && FRAME_OFF_WSTAT != FRAME_PACK_OFF_WSTAT)",
+             "(MAINS_ENABLE && FRAME_OFF_NOISE != FRAME_PACK_OFF_NOISE)"]
+    h += ["", "/* board.h Section 7 must agree with the schema */"]
+    h.append("#if " + " \\\n    || ".join(cond))
+    h += ['#error "board.h Section 7 disagrees with FRAME_SCHEMA '
+          '(frame_pack.h)"', "#endif", ""]
+
+    h += [
+        "/*------------------------------------------------------------",
+        " *  Frame_Pack – Write one snapshot frame, p[0 .. PACKET_LEN-1]",
+        " *------------------------------------------------------------*/",
+    ]
+    sig = "static void Frame_Pack(volatile uint8_t *p"
+    for prm in params:
+        sig += ", " + prm
+    sig += ")"
+    # wrap the signature at commas, aligned under the first parameter
+    indent = " " * (sig.index("(") + 1)
+    lines, cur = [], ""
+    for part in sig.split(", "):
+        if cur and len(cur) + len(part) + 2 > 74:
+            lines.append(cur + ",")
+            cur = indent + part
+        else:
+            cur = part if not cur else cur + ", " + part
+    h += lines + [cur, "{"]
+    h += [f"    uint8_t cs = 0x{cs0:02X}U;".ljust(60)
+          + "/* MAGIC0 ^ MAGIC1 ^ NCH */", "    uint8_t b;", ""]
+    h += body
+
+    for blk in ("wstat", "noise"):
+        flag, mac = flags[blk], f"FRAME_PACK_OFF_{blk.upper()}"
+        packer = FRAME_BLOCKS[blk]["packer"]
+        n = block_len(blk, n_ch)
+        h += ["", f"#if {flag}", "    {",
+              f"        volatile uint8_t *q = &p[{mac}];", "",
+              f"        (void){packer}(q);"]
+        for j in range(0, n, 8):
+            terms = " ^ ".join(f"q[{k}]" for k in range(j, min(n, j + 8)))
+            h.append(f"        cs ^= (uint8_t)({terms});" if "^" in terms
+                     else f"        cs ^= {terms};")
+        h += ["    }", "#endif"]
+
+    h += ["",
+          "    p[FRAME_PACK_OFF_XOR]      = cs;",
+          f"    p[FRAME_PACK_OFF_XOR + 1U] = 0x{END_MARKER:02X}U;".ljust(80)
+          + "/* END */",
+          "}", "", "#endif /* _FRAME_PACK_H_ */", ""]
+
+    path = os.path.join(fw_dir, "frame_pack.h")
+    with open(path, "w", encoding="utf-8", newline="\r\n") as f:
+        f.write("\n".join(h))
+    log.info("wrote %s", path)
+    return crc
+
+
+def check_frame_pack(n_ch, fw_dir=None):
+    """Warn when frame_pack.h next to this script predates FRAME_SCHEMA."""
+    import re
+    path = os.path.join(fw_dir or FIRMWARE_DIR, "frame_pack.h")
+    try:
+        with open(path, encoding="utf-8") as f:
+            text = f.read()
+    except OSError:
+        return
+    m_n = re.search(r"FRAME_PACK_CHANNELS\s+(\d+)", text)
+    m_crc = re.search(r"FRAME_SCHEMA_CRC32\s+0x([0-9A-Fa-f]+)", text)
+    if not (m_n and m_crc):
+        return
+    if int(m_crc.group(1), 16) != frame_schema_crc32():
+        log.warning("frame_pack.h predates FRAME_SCHEMA — "
+                    "regenerate with --gen-frame-pack and reflash")
+
+# ════════════════════════════════════════════════════════════
+#  STREAM CODEC (board.h §7 — compressed stream packet)
+# ════════════════════════════════════════════════════════════
+#
+#  BODY is an MSB-first bit stream.  Decoding works on a '0'/'1'
+#  string: the unary part of each Rice code is one str.find()
+#  and every fixed-width field is one int(bits, 2), so the inner
+#  loop runs in C rather than bit-by-bit in Python.
+
+_BITS8 = [format(b, "08b") for b in range(256)]
+
+
+def _zigzag(d):
+    return (d << 1) if d >= 0 else (-(d << 1) - 1)
+
+
+def rice_encode_block(scans):
+    """
+    Encode scans (n_scans rows × N samples) into a stream BODY,
+    bit-exact with StreamCodec_EncodeBlock() in stream_codec.c.
+    Used by simulation mode.
+    """
+    n = len(scans)
+    n_ch = len(scans[0])
+    esc = STREAM_RICE_ESCAPE_Q
+    parts = []
+    for ch in range(n_ch):
+        col = [s[ch] & 0xFFF for s in scans]
+        z = [_zigzag(col[i + 1] - col[i]) for i in range(n - 1)]
+
+        best, best_k = 12 * (n - 1), STREAM_RICE_RAW
+        for k in range(STREAM_RICE_K_MAX + 1):
+            cost = sum(esc + STREAM_ZZ_BITS if (v >> k) >= esc
+                       else (v >> k) + 1 + k for v in z)
+            if cost < best:
+                best, best_k = cost, k
+
+        parts.append(format(best_k, "04b"))
+        parts.append(format(col[0], "012b"))
+        if best_k == STREAM_RICE_RAW:
+            parts.extend(format(v, "012b") for v in col[1:])
+            continue
+        k = best_k
+        for v in z:
+            q = v >> k
+            if q >= esc:
+                parts.append("1" * esc + format(v, "013b"))
+            else:
+                parts.append("1" * q + "0"
+                             + (format(v & ((1 << k) - 1), f"0{k}b") if k else ""))
+
+    bits = "".join(parts)
+    bits += "0" * (-len(bits) % 8)
+    if not bits:
+        return b""
+    return int(bits, 2).to_bytes(len(bits) // 8, "big")
+
+
+def rice_decode_block(body, n_ch, n_scans):
+    """
+    Decode a stream BODY into n_ch columns of n_scans samples.
+    Raises ValueError on a malformed or truncated body.
+    """
+    bits = "".join([_BITS8[b] for b in body])
+    nbits = len(bits)
+    esc = STREAM_RICE_ESCAPE_Q
+    lit = esc + STREAM_ZZ_BITS
+    cols = []
+    pos = 0
+    for _ in range(n_ch):
+        if pos + 16 > nbits:
+            raise ValueError("truncated stream body")
+        k = int(bits[pos:pos + 4], 2)
+        x = int(bits[pos + 4:pos + 16], 2)
+        pos += 16
+        col = [x]
+
+        if k == STREAM_RICE_RAW:
+            end = pos + 12 * (n_scans - 1)
+            if end > nbits:
+                raise ValueError("truncated raw section")
+            col.extend(int(bits[i:i + 12], 2) for i in range(pos, end, 12))
+            pos = end
+        elif k <= STREAM_RICE_K_MAX:
+            append = col.append
+            for _ in range(n_scans - 1):
+                z0 = bits.find("0", pos, pos + esc)
+                if z0 < 0:
+                    z = int(bits[pos + esc:pos + lit], 2)
+                    pos += lit
+                else:
+                    q = z0 - pos
+                    pos = z0 + 1 + k
+                    z = (q << k) | int(bits[z0 + 1:pos], 2) if k else q
+                x += (z >> 1) ^ -(z & 1)
+                append(x)
+            if pos > nbits:
+                raise ValueError("truncated Rice section")
+        else:
+            raise ValueError(f"bad Rice parameter {k}")
+        cols.append(col)
+    return cols
+
+
+def build_stream_packet(seq, status, scans, temp_x10, decim=STREAM_DECIMATE,
+                        ts_us=0):
+    """Assemble a full stream packet (simulation / self-check)."""
+    body = rice_encode_block(scans)
+    buf = [MAGIC_0, STREAM_MAGIC_1, seq & 0xFF, status, len(scans[0]),
+           len(scans), decim, temp_x10 & 0xFF, (temp_x10 >> 8) & 0xFF,
+           len(body) & 0xFF, len(body) >> 8]
+    buf += list((ts_us % TS_WRAP).to_bytes(4, "little"))
+    buf += body
+    buf.append(xor_checksum(buf, len(buf)))
+    buf.append(END_MARKER)
+    return buf
+
+
+def parse_stream_packet(raw, n_ch=ADC_NUM_CHANNELS):
+    """
+    Parse one stream packet into (SensorFrame, columns).
+
+    The frame carries STATUS / TEMP_X10 from the header and the
+    block's last raw scan as `adc`; columns are the n_ch decoded
+    sample lists.  Returns None if validation or decoding fails.
+    """
+    if len(raw) < STREAM_HDR_LEN + 2:
+        return None
+    if raw[OFF_MAGIC0] != MAGIC_0 or raw[OFF_MAGIC1] != STREAM_MAGIC_1:
+        return None
+    body_len = raw[STREAM_OFF_BODYLEN] | (raw[STREAM_OFF_BODYLEN + 1] << 8)
+    if len(raw) != STREAM_HDR_LEN + body_len + 2 or raw[-1] != END_MARKER:
+        return None
+    if raw[-2] != xor_checksum(raw) or raw[OFF_NCH] != n_ch:
+        return None
+    try:
+        cols = rice_decode_block(raw[STREAM_OFF_BODY:-2], n_ch,
+                                 raw[STREAM_OFF_NSCANS])
+    except ValueError:
+        return None
+
+    temp_x10 = raw[STREAM_OFF_TEMP_L] | (raw[STREAM_OFF_TEMP_L + 1] << 8)
+    ts_us = int.from_bytes(bytes(raw[STREAM_OFF_TS:STREAM_OFF_TS + 4]),
+                           "little")
+    adc = tuple(c[-1] for c in cols)
+    return (make_frame(raw[OFF_SEQ], raw[OFF_STATUS], adc, temp_x10, ts_us),
+            cols)
+
+
+# ════════════════════════════════════════════════════════════
+#  CAPTURE PACKETS (board.h §7 — CMD_*, CAP_OFF_*)
+# ════════════════════════════════════════════════════════════
+#
+#  The Pi writes a command into the first CMD_LEN MOSI bytes of a
+#  transaction; the MCU answers on the NEXT transaction only, so
+#  every exchange is "command, then read the reply".  Chunk reads
+#  are pipelined: the transfer that clocks out chunk k carries
+#  READ(k + 1) on MOSI.
+
+def build_command(op, arg=b""):
+    """One CMD_LEN-byte command: magic, OP, 5 ARG bytes, XOR."""
+    cmd = [CMD_MAGIC, op] + list(arg)[:CMD_LEN - 3]
+    cmd += [0] * (CMD_LEN - 1 - len(cmd))
+    cmd.append(xor_checksum(cmd, len(cmd)))
+    return cmd
+
+
+@dataclass
+class CaptureReply:
+    """Header (and body rows, if any) of one capture reply packet."""
+    rec:     int = 0
+    status:  int = 0
+    state:   int = 0
+    src:     int = 0
+    total:   int = 0
+    pre:     int = 0
+    first:   int = 0
+    nscans:  int = 0
+    ts_us:   int = 0
+    scan_ns: int = 0
+    body:    bytes = b""
+
+
+def capture_reply_len(n_ch, nscans):
+    """Bytes of a reply carrying nscans rows."""
+    return CAP_HDR_LEN + nscans * adc_payload_len(n_ch) + 2
+
+
+def parse_capture_reply(raw, n_ch=ADC_NUM_CHANNELS):
+    """Parse one capture reply; None if it is not one or is corrupt."""
+    if len(raw) < CAP_HDR_LEN + 2:
+        return None
+    b = bytes(raw)
+    if b[OFF_MAGIC0] != MAGIC_0 or b[OFF_MAGIC1] != CAP_MAGIC_1:
+        return None
+
+    def u16(o):
+        return b[o] | (b[o + 1] << 8)
+
+    nscans = u16(CAP_OFF_NSCANS)
+    n = capture_reply_len(n_ch, nscans)
+    if len(b) < n or b[n - 1] != END_MARKER or b[OFF_NCH] != n_ch:
+        return None
+    if b[n - 2] != xor_checksum(b, n - 2):
+        return None
+    return CaptureReply(
+        rec=b[CAP_OFF_REC], status=b[OFF_STATUS], state=b[CAP_OFF_STATE],
+        src=b[CAP_OFF_SRC], total=u16(CAP_OFF_TOTAL), pre=u16(CAP_OFF_PRE),
+        first=u16(CAP_OFF_FIRST), nscans=nscans,
+        ts_us=int.from_bytes(b[CAP_OFF_TS:CAP_OFF_TS + 4], "little"),
+        scan_ns=int.from_bytes(b[CAP_OFF_SCAN_NS:CAP_OFF_SCAN_NS + 4],
+                               "little"),
+        body=b[CAP_OFF_BODY:n - 2])
+
+
+# ════════════════════════════════════════════════════════════
+#  SELF-CHECK (--check-protocol, test_greenhouse.py)
+# ════════════════════════════════════════════════════════════
+
+def _frame_fields(f):
+    return (f.seq, f.status, f.adc, f.temp_x10, f.ts_us, f.pub_cnt,
+            f.scan_cnt, f.fold, f.wstat, f.noise, f.noise_seq)
+
+
+def check_codec(trials=2000, seed=1):
+    """
+    Randomised round trip over FRAME_SCHEMA, every N and block set:
+    random field values → FrameCodec pack → frame_valid, unpack,
+    parse_frame and the FrameColumns view must all give the values
+    back.  Returns (ok, tried).
+    """
+    import random
+    rng = random.Random(seed)
+
+    def rand_field(kind):
+        if kind in ("u8", "u16", "u32"):
+            return rng.getrandbits(8 * SCHEMA_KINDS[kind][0])
+        return bytes(rng.getrandbits(8) for _ in range(SCHEMA_KINDS[kind][0]))
+
+    ok = tried = 0
+    combos = [(n, w, z) for n in range(1, ADC_MAX_CHANNELS + 1)
+              for w in (False, True) for z in (False, True)]
+    for n_ch, wstat, noise in combos:
+        codec = FrameCodec.get(n_ch, wstat, noise)
+        cols = FrameColumns(n_ch, wstat, noise, capacity=4)
+        skip = {i for i, _ in codec.fixed} | {codec.index["XOR"]}
+        for _ in range(max(1, trials // len(combos))):
+            adc = tuple(rng.randrange(ADC_RESOLUTION + 1) for _ in range(n_ch))
+            vals = [bytes(pack_adc12(adc)) if k == "adc12"
+                    else 0 if i in skip else rand_field(k)
+                    for i, k in enumerate(codec.kinds)]
+            raw = codec.pack(vals)
+            back = codec.unpack(raw)
+            frame = parse_frame(raw, n_ch, wstat, noise)
+            view = cols.view(cols.append_raw(raw, 0.0))
+            tried += 1
+            ok += (frame_valid(raw, n_ch, wstat, noise)
+                   and all(back[i] == v for i, v in enumerate(vals)
+                           if i not in skip)
+                   and frame is not None and frame.adc == adc
+                   and frame.seq == vals[codec.index["SEQ"]]
+                   and frame.ts_us == vals[codec.index["TS_US"]]
+                   and frame.pub_cnt == vals[codec.index["PUB_CNT"]]
+                   and frame.fold == vals[codec.index["FOLD"]]
+                   and _frame_fields(view) == _frame_fields(frame))
+    return ok, tried
@@ -0,0 +1,1533 @@
+"""
+Greenhouse SPI reader — poll thread, data-ready line, capture, nodes
+═════════════════════════════════════════════════════════════════════
+SpiReader polls one STM32 node (spidev, a HIL board or the built-in
+simulator) into FrameColumns; MultiSpiPoller serves several nodes
+from one thread.  Also the poll statistics, the adaptive poll-rate
+controller, the GPIO data-ready line and the waveform-capture client.
+No Tk: the dashboard, the metrics exporter and the poller processes
+all build on it.
+"""
+
+from __future__ import annotations
+
+import os
+import time
+import bisect
+import struct
+import threading
+import logging
+from collections import deque
+from dataclasses import dataclass, field
+
+# ── Optional: spidev (graceful fallback for dev on non-Pi) ──
+try:
+    import spidev
+    HAS_SPIDEV = True
+except ImportError:
+    HAS_SPIDEV = False
+
+# ── Optional: RPi.GPIO for user-space chip selects ─────────
+try:
+    import RPi.GPIO as GPIO
+    HAS_RPI_GPIO = True
+except ImportError:
+    HAS_RPI_GPIO = False
+
+from greenhouse_protocol import (
+    ADC_CHANNEL_LABELS, ADC_NUM_CHANNELS, ADC_RESOLUTION,
+    CAP_CHUNK_SCANS, CAP_CH_NONE, CAP_LEVEL_FALLING, CAP_SOURCES,
+    CAP_STATES, CMD_LEN, CMD_OP_CAP_ARM, CMD_OP_CAP_FORCE,
+    CMD_OP_CAP_READ, CMD_OP_CAP_STOP, END_MARKER, FrameCodec,
+    FrameColumns, FrameSync, GAS_ALARM_ON, GAS_WARN_ON, MAGIC_0,
+    MAGIC_1, MAINS_HZ, OFF_FOLD, OFF_MAGIC0, OFF_MAGIC1, OFF_NCH,
+    OFF_PUB_CNT, OFF_SCAN_CNT, OFF_SEQ, OFF_STATUS, STATUS_BIT_BUZZER,
+    STATUS_BIT_EMERG, STATUS_BIT_GAS_ALARM, STATUS_BIT_MOTOR,
+    STATUS_BIT_TEMP_ALARM, STREAM_BLOCK_SCANS, STREAM_HDR_LEN,
+    STREAM_HISTORY_SCANS, STREAM_MAGIC_1, STREAM_OFF_BODYLEN,
+    STREAM_OFF_NSCANS, TEMP_ALARM_ON, TEMP_WARN_ON, TS_CLOCK_HZ,
+    TS_WRAP, WSTAT_CH_LEN, adc_payload_len, build_command,
+    build_stream_packet, cap_scans, capture_reply_len, pack_noise,
+    pack_wstat, packet_len, parse_capture_reply, parse_frame,
+    parse_stream_packet, stream_body_max_len, unpack_adc12_many,
+    xor_checksum)
+
+log = logging.getLogger("greenhouse")
+
+# ════════════════════════════════════════════════════════════
+#  CONFIGURATION — SPI master side
+# ════════════════════════════════════════════════════════════
+
+# SPI bus parameters (board.h §7 — SPI_CLOCK_HZ, SPI_CPOL, SPI_CPHA)
+SPI_BUS          = 0
+SPI_DEV          = 0
+SPI_SPEED_HZ     = 1_000_000   # must match SPI_CLOCK_HZ in board.h
+SPI_MODE         = 0b00        # Mode 0 (CPOL=0, CPHA=0)
+SPI_NSS_ALIGN    = True        # every transaction starts at byte 0
+
+# Data-ready / alarm line (board.h §10 — PB2 → Pi GPIO25)
+DRDY_CHIP        = "/dev/gpiochip0"
+DRDY_LINE        = 25          # BCM number = line offset on the Pi 4
+DRDY_PERIOD_S    = 0.020       # SCHED_PUBLISH_MS (board.h §11)
+DRDY_TIMEOUT_S   = 0.100       # no edge this long → read anyway
+
+POLL_INTERVAL_S  = 0.02      # 50 Hz SPI poll
+
+# Adaptive poll rate (--adaptive-poll MIN_MS:MAX_MS)
+ADAPT_MIN_MS     = 5
+ADAPT_MAX_MS     = 200
+ADAPT_WINDOW     = 16        # reads per publication-period estimate
+ADAPT_REPEAT     = 0.10      # repeat reads aimed for: the margin against gaps
+# Poll-interval histogram bounds while the period adapts (seconds)
+ADAPT_JITTER_BOUNDS_S = (0.0025, 0.005, 0.01, 0.02, 0.05, 0.1, 0.2, 0.5)
+
+# ════════════════════════════════════════════════════════════
+#  DATA MODEL
+# ════════════════════════════════════════════════════════════
+
+
+@dataclass
+class FrameStats:
+    """Tracks SPI communication health."""
+    total_reads:       int = 0
+    valid_frames:      int = 0
+    magic_errors:      int = 0
+    checksum_errors:   int = 0
+    length_errors:     int = 0
+    nch_errors:        int = 0   # NCH ≠ --channels: firmware for another N
+    last_seq:          int = -1
+    seq_gaps:          int = 0
+    seq_repeats:       int = 0   # same SEQ read again before the next publish
+    last_pub:          int = -1  # PUB_CNT of the newest frame
+    last_scan:         int = -1  # SCAN_CNT of the newest frame
+    frames_lost:       int = 0   # published, overwritten before a read
+    scans_lost:        int = 0   # scans folded into those frames
+    scans_read:        int = 0   # scans folded into frames read
+    board_resets:      int = 0   # PUB_CNT went backwards
+    stream_bytes:      int = 0   # stream mode: bytes of new blocks
+    stream_samples:    int = 0   # stream mode: samples decoded
+    deadline_misses:   int = 0   # multi-node: poll slots lost
+    max_lateness_ms:   float = 0.0
+    resynced:          int = 0   # resync: frames found at offset > 0
+    offsets:           dict = field(default_factory=dict)  # offset → frames
+    win_frames:        int = 0   # WSTAT: frames carrying a window
+    win_scans:         int = 0   # WSTAT: raw scans covered by them
+    win_crossings:     int = 0   # WSTAT: WARN crossings, all channels
+    drdy_edges:        int = 0   # DRDY: reads woken by a rising edge
+    drdy_timeouts:     int = 0   # DRDY: reads after DRDY_TIMEOUT_S
+    poll_period_ms:    float = 0.0   # current poll period
+    pub_period_ms:     float = 0.0   # adaptive: estimated publication period
+
+    @property
+    def error_total(self) -> int:
+        return (self.magic_errors + self.checksum_errors + self.length_errors
+                + self.nch_errors)
+
+    @property
+    def error_rate_pct(self) -> float:
+        if self.total_reads == 0:
+            return 0.0
+        return (self.error_total / self.total_reads) * 100.0
+
+    @property
+    def bytes_per_sample(self) -> float:
+        if self.stream_samples == 0:
+            return 0.0
+        return self.stream_bytes / self.stream_samples
+
+    @property
+    def scans_per_read(self) -> float:
+        if self.win_frames == 0:
+            return 0.0
+        return self.win_scans / self.win_frames
+
+    @property
+    def scans_lost_pct(self) -> float:
+        total = self.scans_read + self.scans_lost
+        if total == 0:
+            return 0.0
+        return 100.0 * self.scans_lost / total
+
+
+class PollJitter:
+    """
+    Poll-interval statistics for one reader.  Updated only by the
+    polling thread, so it needs no lock.  Intervals are counted in
+    histogram buckets placed at multiples of the nominal period, or
+    at the fixed `bounds` given (--adaptive-poll: the period moves,
+    and a histogram's buckets must not).  max_dev_s is measured
+    against period_s, which the rate controller keeps current.
+    """
+
+    BUCKET_PERIODS = (0.5, 0.9, 0.95, 1.05, 1.1, 1.5, 2.0, 5.0)
+
+    def __init__(self, period_s, bounds=None):
+        self.period_s = period_s
+        self.bounds = (tuple(bounds) if bounds is not None else
+                       tuple(period_s * m for m in self.BUCKET_PERIODS))
+        self.counts = [0] * (len(self.bounds) + 1)   # last = +Inf
+        self.count = 0
+        self.sum_s = 0.0
+        self.max_dev_s = 0.0
+        self._last = None
+
+    def tick(self, now):
+        last, self._last = self._last, now
+        if last is None:
+            return
+        interval = now - last
+        self.counts[bisect.bisect_left(self.bounds, interval)] += 1
+        self.count += 1
+        self.sum_s += interval
+        dev = abs(interval - self.period_s)
+        if dev > self.max_dev_s:
+            self.max_dev_s = dev
+
+
+class PollRateController:
+    """
+    Adaptive poll period for one reader (--adaptive-poll).  Every
+    ADAPT_WINDOW valid reads the firmware's publication period is
+    estimated as elapsed time / SEQ advance, and the poll period is
+    set to (1 - ADAPT_REPEAT) of it: a few repeat reads are the price
+    of seeing every publication.  Repeats thus back the rate off and
+    gaps speed it up; a gap closes the window at once.  While a
+    STATUS alarm bit is set the reader polls at min_s.  Each step is
+    limited to ×0.5 … ×2.  Updated with the reader lock held.
+    `wrap` is the counter modulus: 2^32 for PUB_CNT, 256 for the
+    stream packets' SEQ.
+    """
+
+    ALARM_MASK = ((1 << STATUS_BIT_GAS_ALARM) | (1 << STATUS_BIT_TEMP_ALARM)
+                  | (1 << STATUS_BIT_EMERG))
+
+    def __init__(self, min_s, max_s, period_s, wrap=1 << 32):
+        self.min_s = min_s
+        self.wrap = wrap
+        self.max_s = max_s
+        self.base_s = self._clamp(period_s)   # from the estimate, alarms aside
+        self.period_s = self.base_s
+        self.pub_s = 0.0                      # last publication period estimate
+        self.alarm = False
+        self.changes = 0
+        self._t0 = None                       # window start
+        self._seq = 0
+        self._advance = 0
+        self._reads = 0
+
+    def _clamp(self, s):
+        return min(self.max_s, max(self.min_s, s))
+
+    def update(self, now, seq, status):
+        """One valid read, repeat or new; returns the next poll period."""
+        if self._t0 is None:
+            self._t0 = now
+        else:
+            d = (seq - self._seq) % self.wrap
+            self._advance += d
+            self._reads += 1
+            if d > 1 or self._reads >= ADAPT_WINDOW:
+                self._estimate(now)
+        self._seq = seq
+        self.alarm = bool(status & self.ALARM_MASK)
+        period = self.min_s if self.alarm else self.base_s
+        if period != self.period_s:
+            self.period_s = period
+            self.changes += 1
+        return period
+
+    def _estimate(self, now):
+        if self._advance:
+            self.pub_s = (now - self._t0) / self._advance
+            target = (1.0 - ADAPT_REPEAT) * self.pub_s
+        else:
+            target = 2.0 * self.base_s        # nothing new: back off
+        step = min(2.0 * self.base_s, max(0.5 * self.base_s, target))
+        self.base_s = self._clamp(step)
+        self._t0 = now
+        self._advance = 0
+        self._reads = 0
+
+
+def parse_adapt_spec(spec):
+    """--adaptive-poll MIN_MS:MAX_MS → (min_s, max_s)."""
+    lo, _, hi = spec.partition(":")
+    try:
+        min_s, max_s = float(lo) / 1e3, float(hi) / 1e3
+    except ValueError:
+        raise ValueError(f"bad --adaptive-poll {spec!r} (expected MIN_MS:MAX_MS)")
+    if not 0 < min_s <= max_s:
+        raise ValueError(f"bad --adaptive-poll {spec!r} (0 < MIN_MS <= MAX_MS)")
+    return min_s, max_s
+
+
+class LatencyHist:
+    """
+    Latency histogram in seconds with fixed, roughly log-spaced
+    bucket bounds.  One writer and no lock, like PollJitter.
+    percentile() interpolates inside the bucket, which is close
+    enough for choosing poll and refresh rates.
+    """
+
+    BOUNDS_S = (0.0002, 0.0005, 0.001, 0.002, 0.005, 0.01, 0.02,
+                0.05, 0.1, 0.2, 0.5, 1.0, 2.0)
+
+    def __init__(self):
+        self.bounds = self.BOUNDS_S
+        self.counts = [0] * (len(self.bounds) + 1)   # last = +Inf
+        self.count = 0
+        self.sum_s = 0.0
+        self.max_s = 0.0
+
+    def add(self, s):
+        self.counts[bisect.bisect_left(self.bounds, s)] += 1
+        self.count += 1
+        self.sum_s += s
+        if s > self.max_s:
+            self.max_s = s
+
+    def percentile(self, p):
+        """Approximate p-th percentile (0..100) in seconds."""
+        if self.count == 0:
+            return 0.0
+        rank = p / 100.0 * self.count
+        cum, lo = 0, 0.0
+        for hi, n in zip(self.bounds, self.counts):
+            if n and cum + n >= rank:
+                return min(self.max_s, lo + (hi - lo) * (rank - cum) / n)
+            cum += n
+            lo = hi
+        return self.max_s
+
+    def summary(self):
+        return (f"p50 {self.percentile(50) * 1e3:.2f} ms, "
+                f"p99 {self.percentile(99) * 1e3:.2f} ms, "
+                f"max {self.max_s * 1e3:.2f} ms (n={self.count})")
+
+
+class ClockSync:
+    """
+    Maps the MCU's TS_US clock onto this host's time.monotonic().
+
+    A frame can only arrive after it was sampled, so the smallest
+    receive − sample difference seen is the clock offset plus the
+    shortest transport time.  Minima are kept per BUCKET_S of MCU
+    time.  A least-squares line through the last WINDOW minima
+    gives the rate difference, which matters because the HSI is
+    only ±1 % (up to 10 ms/s).  The line is then lowered onto the
+    lowest minimum, so no age comes out below floor_s (the
+    transfer time of the frame).
+
+    The 32-bit counter is unwrapped.  A step backwards that is
+    not a wrap means the MCU was reset, and the estimate starts
+    again.
+    """
+
+    BUCKET_S = 1.0
+    WINDOW = 30
+
+    def __init__(self, floor_s=0.0):
+        self.floor_s = floor_s
+        self.resets = 0
+        self.reset()
+
+    def reset(self):
+        self._last = None
+        self._t_mcu = 0.0
+        self._mins = deque(maxlen=self.WINDOW)   # [bucket, t_mcu, d]
+        self._a = None                           # d ≈ a + b · t_mcu
+        self._b = 0.0
+
+    @property
+    def skew_ppm(self):
+        """MCU clock rate relative to the host's, > 0 = MCU fast."""
+        return -self._b * 1e6
+
+    @property
+    def offset_s(self):
+        """Host time − MCU time now, excluding transport."""
+        if self._a is None:
+            return 0.0
+        return self._a + self._b * self._t_mcu
+
+    def to_local(self, t_mcu):
+        """MCU seconds (unwrapped) → time.monotonic() seconds."""
+        return t_mcu + self._a + self._b * t_mcu - self.floor_s
+
+    def update(self, ts_us, t_rx):
+        """Feed one frame; returns its sample → receive age."""
+        if self._last is not None:
+            step = (ts_us - self._last) % TS_WRAP
+            if step >= TS_WRAP // 2:              # went backwards
+                self.resets += 1
+                self.reset()
+            else:
+                self._t_mcu += step / TS_CLOCK_HZ
+        if self._last is None:
+            self._t_mcu = ts_us / TS_CLOCK_HZ
+        self._last = ts_us
+
+        t, d = self._t_mcu, t_rx - self._t_mcu
+        bucket = int(t // self.BUCKET_S)
+        mins = self._mins
+        if not mins or mins[-1][0] != bucket:
+            mins.append([bucket, t, d])
+            self._fit()
+        elif d < mins[-1][2]:
+            mins[-1][1:] = [t, d]
+            self._fit()
+        return d - (self._a + self._b * t) + self.floor_s
+
+    def _fit(self):
+        pts = self._mins
+        n = len(pts)
+        mt = sum(p[1] for p in pts) / n
+        md = sum(p[2] for p in pts) / n
+        var = sum((p[1] - mt) ** 2 for p in pts)
+        b = 0.0
+        if n >= 3 and var > 0:
+            b = sum((p[1] - mt) * (p[2] - md) for p in pts) / var
+        a = md - b * mt
+        self._a = a + min(p[2] - a - b * p[1] for p in pts)
+        self._b = b
+
+
+# ════════════════════════════════════════════════════════════
+#  DATA-READY LINE (board.h §10 — PB2 → Pi GPIO25)
+# ════════════════════════════════════════════════════════════
+#
+#  GPIO character device, uAPI v1 (linux/gpio.h): one
+#  GPIO_GET_LINEEVENT_IOCTL returns an fd that select()s readable
+#  on every edge and yields 16-byte gpioevent_data records.  Only
+#  fcntl is needed — no libgpiod, no sysfs.
+
+_GPIOEVENT_REQUEST   = struct.Struct("<III32si")  # line, hflags, eflags, label, fd
+_GPIOEVENT_DATA      = struct.Struct("<QI4x")     # timestamp ns, id
+_GPIO_GET_LINEEVENT_IOCTL      = 0xC030B404       # _IOWR(0xB4, 0x04, 48)
+_GPIOHANDLE_REQUEST_INPUT      = 1 << 0
+_GPIOEVENT_REQUEST_RISING_EDGE = 1 << 0
+_GPIOEVENT_EVENT_RISING_EDGE   = 0x01
+
+
+class DrdyLine:
+    """
+    Rising edges of the DRDY line.  wait() blocks until an edge or
+    the timeout and drains every queued record, so a burst of
+    requests (data ready + alarm) costs one read.
+    """
+
+    def __init__(self, fd):
+        self.fd = fd
+        self.edges = 0
+        self.last_edge_ns = 0           # kernel timestamp of the newest
+
+    @classmethod
+    def open_chip(cls, chip=DRDY_CHIP, line=DRDY_LINE):
+        """Request rising-edge events on one line of a gpiochip."""
+        import fcntl
+        req = bytearray(_GPIOEVENT_REQUEST.pack(
+            line, _GPIOHANDLE_REQUEST_INPUT, _GPIOEVENT_REQUEST_RISING_EDGE,
+            b"greenhouse-drdy", 0))
+        chip_fd = os.open(chip, os.O_RDONLY)
+        try:
+            fcntl.ioctl(chip_fd, _GPIO_GET_LINEEVENT_IOCTL, req)
+        finally:
+            os.close(chip_fd)
+        log.info("DRDY: rising edges of %s line %d", chip, line)
+        return cls(_GPIOEVENT_REQUEST.unpack(req)[4])
+
+    def wait(self, timeout_s):
+        """True if at least one rising edge arrived within timeout_s."""
+        import select
+        ready, _, _ = select.select([self.fd], [], [], timeout_s)
+        if not ready:
+            return False
+        size = _GPIOEVENT_DATA.size
+        data = os.read(self.fd, size * 16)
+        n = len(data) // size
+        if n:
+            self.edges += n
+            self.last_edge_ns = _GPIOEVENT_DATA.unpack_from(data, (n - 1) * size)[0]
+        return n > 0
+
+    def close(self):
+        if self.fd is not None:
+            os.close(self.fd)
+            self.fd = None
+
+
+class MockDrdyLine(DrdyLine):
+    """
+    DrdyLine for a box without the wire: the same fd, select()
+    and record path, over a pipe.  Edges come from edge() (any
+    thread) or, with level_fn, from sampling a line level every
+    poll_s inside wait() — the HIL board's PB2, or a square wave
+    in simulation.
+    """
+
+    def __init__(self, level_fn=None, poll_s=0.0002):
+        r, self._w = os.pipe()
+        super().__init__(r)
+        self.level_fn = level_fn
+        self.poll_s = poll_s
+        self._level = False
+
+    def edge(self):
+        """Queue one rising-edge record, as the kernel would."""
+        os.write(self._w, _GPIOEVENT_DATA.pack(time.monotonic_ns(),
+                                               _GPIOEVENT_EVENT_RISING_EDGE))
+
+    def wait(self, timeout_s):
+        if self.level_fn is None:
+            return super().wait(timeout_s)
+        end = time.monotonic() + timeout_s
+        while True:
+            level = bool(self.level_fn())
+            rising, self._level = level and not self._level, level
+            if rising:
+                self.edge()
+            if rising or time.monotonic() >= end:
+                return super().wait(0)
+            time.sleep(self.poll_s)
+
+    def close(self):
+        super().close()
+        if self._w is not None:
+            os.close(self._w)
+            self._w = None
+
+
+def parse_drdy_spec(spec):
+    """--drdy [CHIP:]LINE → (chip path, line offset)."""
+    chip, _, line = spec.rpartition(":")
+    chip = chip or DRDY_CHIP
+    if not chip.startswith("/"):
+        chip = "/dev/" + chip
+    try:
+        return chip, int(line)
+    except ValueError:
+        raise ValueError(f"bad --drdy {spec!r} (expected [gpiochipN:]LINE)")
+
+
+# ════════════════════════════════════════════════════════════
+#  SPI READER (background thread)
+# ════════════════════════════════════════════════════════════
+
+class SpiReader:
+    """
+    Background thread that continuously polls the STM32 SPI slave.
+
+    Accepted frames are decoded into `frames` (FrameColumns); the
+    SensorFrame behind `latest` is built only when read.
+
+    Thread safety: `frames` and `stats` are protected by a lock.
+    The GUI thread calls get_snapshot() to read both atomically.
+    """
+
+    def __init__(
+        self,
+        bus=SPI_BUS,
+        dev=SPI_DEV,
+        hz=SPI_SPEED_HZ,
+        mode=SPI_MODE,
+        simulate=False,
+        n_ch=ADC_NUM_CHANNELS,
+        stream=False,
+        name="",
+        cs_gpio=None,
+        period_s=POLL_INTERVAL_S,
+        spi_factory=None,
+        resync=False,
+        wstat=False,
+        drdy=None,
+        noise=False,
+        adapt=None,
+    ):
+        self.bus = bus
+        self.dev = dev
+        self.hz = hz
+        self.mode = mode
+        self.simulate = simulate
+        self.n_ch = n_ch
+        self.stream = stream
+        self.name = name or f"spi{bus}.{dev}"
+        self.cs_gpio = cs_gpio          # BCM pin, None = hardware CE
+        self.period_s = period_s
+        self.spi_factory = spi_factory  # None = spidev.SpiDev
+        # WSTAT_ENABLE firmware: frames carry the window statistics
+        self.wstat = wstat and not stream
+        # MAINS_ENABLE firmware: frames carry the noise meters
+        self.noise = noise and not stream
+        self.frame_len = packet_len(n_ch, self.wstat, self.noise)
+        # Snapshot mode only: oversized reads scanned by FrameSync
+        self.sync = (FrameSync(n_ch, self.wstat, self.noise)
+                     if resync and not stream else None)
+        # DrdyLine: read on its rising edge instead of every period_s
+        self.drdy = drdy
+        self.drdy_timeout_s = DRDY_TIMEOUT_S
+
+        self._spi = None
+        self._lock = threading.Lock()
+        self._running = False
+        self._thread = None
+
+        self.stats = FrameStats()
+        self._nch_logged = False
+
+        # Every accepted frame, column-wise; also the chart history
+        self.frames = FrameColumns(n_ch, self.wstat, self.noise)
+
+        # Stream mode: every decoded raw scan, (timestamp, adc tuple)
+        self.stream_history = deque(maxlen=STREAM_HISTORY_SCANS)
+        self._last_block_t = None
+
+        # New-frame subscribers: callback(reader, row)
+        self._subscribers = []
+        # Per-poll subscribers: callback(reader), after every read
+        self._poll_subscribers = []
+        # Raw subscribers: callback(reader, raw, t_rx), lock held
+        self._raw_subscribers = []
+        self.jitter = PollJitter(period_s,
+                                 ADAPT_JITTER_BOUNDS_S if adapt else None)
+        # (min_s, max_s): period_s follows the publication rate
+        self.rate = (PollRateController(adapt[0], adapt[1], period_s,
+                                        wrap=256 if stream else 1 << 32)
+                     if adapt else None)
+        self.stats.poll_period_ms = period_s * 1e3
+
+        # Sample → receive age: no frame can be younger than its
+        # own transfer (a stream header at least)
+        floor_bytes = STREAM_HDR_LEN if stream else self.frame_len
+        self.clock = ClockSync(floor_s=floor_bytes * 8.0 / hz)
+        self.age_hist = LatencyHist()
+
+    # ── lifecycle ──────────────────────────────────────────
+
+    def start(self):
+        """Open SPI and start polling thread. Returns True on success."""
+        if self._running:
+            return True
+
+        if not self.simulate:
+            if self.spi_factory is None and not HAS_SPIDEV:
+                log.error("spidev module not installed. "
+                          "Install with: pip3 install spidev")
+                return False
+            try:
+                self._spi = (self.spi_factory or spidev.SpiDev)()
+                self._spi.open(self.bus, self.dev)
+                self._spi.max_speed_hz = self.hz
+                self._spi.mode = self.mode
+                log.info("SPI%d.%d opened @ %d Hz, mode %d",
+                         self.bus, self.dev, self.hz, self.mode)
+            except (FileNotFoundError, PermissionError, OSError) as exc:
+                log.error("Cannot open SPI: %s", exc)
+                return False
+        else:
+            log.info("Running in SIMULATION mode (no real SPI)")
+
+        self._running = True
+        self._thread = threading.Thread(target=self._poll_loop,
+                                        daemon=True, name="spi-poll")
+        self._thread.start()
+        return True
+
+    def stop(self):
+        """Signal thread to stop and close SPI."""
+        self._running = False
+        if self._thread and self._thread.is_alive():
+            self._thread.join(timeout=0.5)
+        if self._spi:
+            try:
+                self._spi.close()
+            except Exception:
+                pass
+            self._spi = None
+        if self.drdy is not None:
+            self.drdy.close()
+        log.info("SPI reader stopped.")
+
+    # ── public getters (thread-safe) ──────────────────────
+
+    @property
+    def latest(self):
+        """Newest frame as a SensorFrame (built on first read), or None."""
+        with self._lock:
+            return self.frames.latest()
+
+    def get_snapshot(self):
+        """Return a consistent (frame, stats) pair."""
+        with self._lock:
+            st = FrameStats(**self.stats.__dict__)
+            st.offsets = dict(self.stats.offsets)
+            return self.frames.latest(), st
+
+    def get_frame(self, row):
+        """SensorFrame of FrameColumns row `row`, None if overwritten."""
+        with self._lock:
+            return self.frames.view(row)
+
+    def get_history(self, n):
+        """Return (times, temp_c, gas_raw) lists of the newest n frames."""
+        with self._lock:
+            return self.frames.history(n)
+
+    def get_columns(self, n=None):
+        """Copy of the newest n decoded frames, FrameColumns.tail()."""
+        with self._lock:
+            return self.frames.tail(n)
+
+    def subscribe(self, callback):
+        """
+        Call callback(reader, row) for every new valid frame; row
+        is its FrameColumns row number, get_frame(row) builds the
+        SensorFrame if the subscriber needs one.  Runs on the
+        polling thread, outside the lock: callbacks must be quick
+        and must not touch Tk widgets.
+        """
+        self._subscribers.append(callback)
+
+    def subscribe_polls(self, callback):
+        """
+        Call callback(reader) after every poll, valid or not, so
+        error counters stay fresh while the link is down.  Same
+        threading rules as subscribe().
+        """
+        self._poll_subscribers.append(callback)
+
+    def subscribe_raw(self, callback):
+        """
+        Call callback(reader, raw, t_rx) with the bytes of every
+        accepted snapshot frame and its receive time.  Runs on the
+        polling thread WITH the lock held (ShmRingWriter copies the
+        frame into its ring there): callbacks must only copy.
+        """
+        self._raw_subscribers.append(callback)
+
+    def get_stream_history(self):
+        """Return a copy of decoded stream scans [(t, adc), ...]."""
+        with self._lock:
+            return list(self.stream_history)
+
+    # ── internal ─────────────────────────────────────────
+
+    def _poll_loop(self):
+        while self._running:
+            try:
+                raw = self._read_raw()
+                self._process(raw)
+            except Exception as exc:
+                log.warning("SPI read error: %s", exc)
+            if self.drdy is None:
+                time.sleep(self.period_s)
+            else:
+                self._wait_drdy()
+
+    def _wait_drdy(self):
+        """Block until the next DRDY edge or the fallback timeout."""
+        try:
+            edge = self.drdy.wait(self.drdy_timeout_s)
+        except OSError as exc:
+            log.warning("DRDY wait error: %s", exc)
+            time.sleep(self.period_s)
+            return
+        with self._lock:
+            if edge:
+                self.stats.drdy_edges += 1
+            else:
+                self.stats.drdy_timeouts += 1
+
+    def _read_raw(self):
+        if self.stream:
+            return self._read_stream()
+        if self.simulate:
+            return self._simulate_frame()
+        if self.sync is not None:
+            return self._xfer(self.sync.read_len)
+        return self._xfer(self.frame_len)
+
+    def _xfer(self, n):
+        """
+        One full-duplex transfer of n dummy bytes.  The clock is
+        passed per transfer, so nodes sharing a spidev handle can
+        run at different speeds; a GPIO chip select is driven
+        around the transfer.
+        """
+        if self.cs_gpio is None:
+            return self._spi.xfer2([0x00] * n, self.hz)
+        GPIO.output(self.cs_gpio, GPIO.LOW)
+        try:
+            return self._spi.xfer2([0x00] * n, self.hz)
+        finally:
+            GPIO.output(self.cs_gpio, GPIO.HIGH)
+
+    def _read_stream(self):
+        """
+        Two-phase read of a variable-length stream packet: the
+        STREAM_HDR_LEN-byte header (15, TS_US included), then the
+        rest.  With SPI_NSS_ALIGN every
+        transfer restarts at byte 0 of the newest packet, so the
+        second transfer re-reads the header and is kept only if it
+        matches (a new block may have been published in between).
+        Without it the slave's TX index simply continues.
+        """
+        if self.simulate:
+            return self._simulate_stream()
+        hdr = self._xfer(STREAM_HDR_LEN)
+        for _ in range(2):
+            if hdr[OFF_MAGIC0] != MAGIC_0 or hdr[OFF_MAGIC1] != STREAM_MAGIC_1:
+                return hdr
+            body_len = hdr[STREAM_OFF_BODYLEN] | (hdr[STREAM_OFF_BODYLEN + 1] << 8)
+            if body_len > stream_body_max_len(self.n_ch, hdr[STREAM_OFF_NSCANS]):
+                return hdr
+            if not SPI_NSS_ALIGN:
+                return hdr + self._xfer(body_len + 2)
+            raw = self._xfer(STREAM_HDR_LEN + body_len + 2)
+            if raw[:STREAM_HDR_LEN] == hdr:
+                return raw
+            hdr = raw[:STREAM_HDR_LEN]
+        return raw
+
+    def _process_stream(self, raw):
+        """Validate, de-duplicate and decode one stream packet."""
+        now = time.monotonic()
+        with self._lock:
+            self.stats.total_reads += 1
+            if len(raw) < STREAM_HDR_LEN + 2:
+                self.stats.length_errors += 1
+                return
+            if (raw[OFF_MAGIC0] != MAGIC_0 or raw[OFF_MAGIC1] != STREAM_MAGIC_1
+                    or raw[-1] != END_MARKER):
+                self.stats.magic_errors += 1
+                return
+            if raw[-2] != xor_checksum(raw):
+                self.stats.checksum_errors += 1
+                return
+            if raw[OFF_NCH] != self.n_ch:
+                self._nch_mismatch(raw[OFF_NCH])
+                return
+            if self.rate is not None:
+                self._adapt(raw[OFF_SEQ], raw[OFF_STATUS])
+            # The Pi polls faster than blocks fill: same SEQ = same block
+            if raw[OFF_SEQ] == self.stats.last_seq:
+                return
+
+        # Decode outside the lock so the GUI never waits on it
+        parsed = parse_stream_packet(raw, self.n_ch)
+
+        with self._lock:
+            if parsed is None:
+                self.stats.length_errors += 1
+                return
+            frame, cols = parsed
+            n_scans = len(cols[0])
+
+            self.stats.valid_frames += 1
+            if self.stats.last_seq >= 0:
+                if frame.seq != ((self.stats.last_seq + 1) & 0xFF):
+                    self.stats.seq_gaps += 1
+            self.stats.last_seq = frame.seq
+            self.stats.stream_bytes += len(raw)
+            self.stats.stream_samples += n_scans * self.n_ch
+            frame.timestamp = now               # receipt, not decode end
+            frame.age_s = self._stamp(frame.ts_us, now)
+
+            # Spread the block's scans evenly since the previous block
+            t0 = self._last_block_t
+            if t0 is None or now - t0 > 1.0:
+                t0 = now - self.period_s
+            dt = (now - t0) / n_scans
+            for i, scan in enumerate(zip(*cols)):
+                self.stream_history.append((t0 + (i + 1) * dt, scan))
+            self._last_block_t = now
+
+            # Chart keeps one point per block (latest raw scan)
+            return self.frames.append_frame(frame)
+
+    def _process(self, raw):
+        self.jitter.tick(time.monotonic())
+        if self.stream:
+            row = self._process_stream(raw)
+        else:
+            row = self._process_frame(raw)
+        if row is not None:
+            for callback in self._subscribers:
+                callback(self, row)
+        for callback in self._poll_subscribers:
+            callback(self)
+
+    def _process_frame(self, raw):
+        """Validate one snapshot read; return its row, None if rejected."""
+        if self.sync is not None:
+            return self._process_resync(raw)
+        with self._lock:
+            self.stats.total_reads += 1
+
+            if len(raw) != self.frame_len:
+                self.stats.length_errors += 1
+                return
+
+            if raw[OFF_MAGIC0] != MAGIC_0 or raw[OFF_MAGIC1] != MAGIC_1:
+                self.stats.magic_errors += 1
+                return
+
+            # NCH disagrees with --channels: firmware built for another
+            # N.  Checked before END and XOR, which then sit elsewhere.
+            if raw[OFF_NCH] != self.n_ch:
+                self._nch_mismatch(raw[OFF_NCH])
+                return
+
+            if raw[-1] != END_MARKER:
+                self.stats.magic_errors += 1
+                return
+
+            if raw[-2] != xor_checksum(raw):
+                self.stats.checksum_errors += 1
+                return
+
+            self.stats.valid_frames += 1
+            return self._accept(raw)
+
+    def _nch_mismatch(self, nch):
+        """Count a frame for another N; log it once (lock held)."""
+        self.stats.nch_errors += 1
+        if not self._nch_logged:
+            self._nch_logged = True
+            log.warning("%s: frame NCH = %d but --channels %d; the firmware "
+                        "was built for another ADC_NUM_CHANNELS",
+                        self.name, nch, self.n_ch)
+
+    def _process_resync(self, raw):
+        """
+        Resync mode: take the frame wherever it sits in the
+        transfer.  A read without any valid frame counts as a
+        magic error, the same as an offset-0 mismatch would.
+        """
+        cand, off = self.sync.locate(raw)
+        with self._lock:
+            self.stats.total_reads += 1
+            if cand is None:
+                self.stats.magic_errors += 1
+                return None
+            self.stats.offsets[off] = self.stats.offsets.get(off, 0) + 1
+            if off:
+                self.stats.resynced += 1
+            self.stats.valid_frames += 1
+            return self._accept(cand)
+
+    def _accept(self, raw):
+        """
+        Sequence check, then decode a validated frame into the
+        next FrameColumns row (lock held).  Returns the row, or
+        None for a repeat.
+
+        PUB_CNT is 32 bits, so unlike the 8-bit SEQ it cannot wrap
+        between two reads: a jump of d means d − 1 frames were
+        overwritten unread, and the SCAN_CNT − FOLD of this frame
+        against SCAN_CNT of the last one counts their scans.
+        """
+        # The Pi may poll faster than SCHED_PUBLISH_MS: same PUB_CNT
+        # = same frame, neither a gap nor a new point on the chart
+        pub = int.from_bytes(raw[OFF_PUB_CNT:OFF_PUB_CNT + 4], "little")
+        if self.rate is not None:
+            self._adapt(pub, raw[OFF_STATUS])
+        st = self.stats
+        if pub == st.last_pub:
+            st.seq_repeats += 1
+            return None
+        scan = int.from_bytes(raw[OFF_SCAN_CNT:OFF_SCAN_CNT + 4], "little")
+        fold = raw[OFF_FOLD] | (raw[OFF_FOLD + 1] << 8)
+        if st.last_pub >= 0:
+            d = (pub - st.last_pub) & 0xFFFFFFFF
+            if d >= 1 << 31:
+                st.board_resets += 1        # counters restarted at 0
+            elif d > 1:
+                st.seq_gaps += 1
+                st.frames_lost += d - 1
+                lost = (scan - fold - st.last_scan) & 0xFFFFFFFF
+                if lost < 1 << 31:
+                    st.scans_lost += lost
+        st.last_pub = pub
+        st.last_scan = scan
+        st.scans_read += fold
+        st.last_seq = raw[OFF_SEQ]
+
+        if self.wstat:
+            o = self.frames.off_wstat
+            self.stats.win_frames += 1
+            self.stats.win_scans += raw[o] | (raw[o + 1] << 8) | (raw[o + 2] << 16)
+            self.stats.win_crossings += sum(
+                raw[o + 3 + WSTAT_CH_LEN * k + 13] for k in range(self.n_ch))
+
+        t_rx = time.monotonic()
+        for callback in self._raw_subscribers:
+            callback(self, raw, t_rx)
+        return self.frames.append_raw(raw, t_rx, self._stamp)
+
+    def _adapt(self, seq, status):
+        """Let the rate controller set the next poll period (lock held)."""
+        self.period_s = self.rate.update(time.monotonic(), seq, status)
+        self.jitter.period_s = self.period_s
+        self.stats.poll_period_ms = self.period_s * 1e3
+        self.stats.pub_period_ms = self.rate.pub_s * 1e3
+
+    def _stamp(self, ts_us, t_rx):
+        """Sample → receive age from TS_US (lock held)."""
+        age = self.clock.update(ts_us, t_rx)
+        self.age_hist.add(age)
+        return age
+
+    # ── simulation (for testing without hardware) ────────
+
+    _sim_seq = 0
+    _sim_scans = 0
+    _sim_t0 = time.monotonic()
+    _sim_block = None
+    _sim_block_t = 0.0
+    SIM_BLOCK_PERIOD_S = 0.1
+    SIM_SCAN_S = 50e-6
+
+    def _simulate_frame(self):
+        """Generate a synthetic valid frame for UI development."""
+        import math
+        t = time.monotonic() - self._sim_t0
+
+        # Simulate temperature oscillating 25–55 °C
+        temp_c = 30.0 + 20.0 * math.sin(t * 0.1)
+        temp_x10 = int(temp_c * 10) & 0xFFFF
+
+        # Simulate gas oscillating 500–3000
+        gas = int(1500 + 1200 * math.sin(t * 0.07 + 1.0)) & 0xFFFF
+
+        adc = [
+            int(temp_x10 * 4095 / 3300) & 0xFFF,   # reverse LM35 calc
+            gas & 0xFFF,
+            int(2000 + 500 * math.sin(t * 0.05)) & 0xFFF,
+            int(1000 + 800 * math.cos(t * 0.03)) & 0xFFF,
+        ]
+        # Extra channels (PC0-PC5 / internal): slow independent waves
+        for k in range(4, self.n_ch):
+            adc.append(int(2048 + 1500 * math.sin(t * 0.02 * k + k)) & 0xFFF)
+        adc = adc[:self.n_ch]
+
+        # Determine alarm status (bit positions from board.h §7)
+        status = 0
+        if temp_c >= TEMP_WARN_ON:
+            status |= (1 << STATUS_BIT_TEMP_ALARM)
+        if gas >= GAS_WARN_ON:
+            status |= (1 << STATUS_BIT_GAS_ALARM)
+        if temp_c >= TEMP_ALARM_ON or gas >= GAS_ALARM_ON:
+            status |= (1 << STATUS_BIT_BUZZER)
+        if temp_c >= TEMP_ALARM_ON:
+            status |= (1 << STATUS_BIT_MOTOR)
+
+        wstat = noise = None
+        if self.wstat:
+            # One poll period of 50 µs scans, ±8 LSB around each value
+            n = max(1, int(self.period_s / self.SIM_SCAN_S))
+            wstat = pack_wstat(n, [(max(0, v - 8), min(4095, v + 8), v * n,
+                                    n * (v * v + 16), 0) for v in adc])
+        if self.noise:
+            # One window per 20 ms; 2 LSB rms floor, a little hum
+            noise = pack_noise(int(t * MAINS_HZ), [(4.5, 0.5)] * self.n_ch)
+        # A new frame per read, except under --adaptive-poll, which
+        # needs a publication clock to adapt to (SCHED_PUBLISH_MS)
+        if self.rate is None:
+            seq, scans = self._sim_seq, int(t / self.SIM_SCAN_S)
+            fold = scans - self._sim_scans
+            self._sim_scans = scans
+        else:
+            seq = int(t / DRDY_PERIOD_S)
+            fold = int(DRDY_PERIOD_S / self.SIM_SCAN_S)
+            scans = seq * fold
+        codec = FrameCodec.get(self.n_ch, self.wstat, self.noise)
+        buf = codec.build(seq, status, adc, temp_x10,
+                          int(time.monotonic() * TS_CLOCK_HZ) % TS_WRAP,
+                          wstat, noise, scans, fold)
+        self._sim_seq += 1
+        return list(buf)
+
+    def _simulate_stream(self):
+        """
+        Generate a synthetic stream packet.  A new block appears
+        every SIM_BLOCK_PERIOD_S; polls in between re-read the same
+        block, as on hardware.
+        """
+        import math
+        import random
+        now = time.monotonic()
+        if self._sim_block is not None and now - self._sim_block_t < self.SIM_BLOCK_PERIOD_S:
+            return self._sim_block
+
+        snap = parse_frame(self._simulate_frame(), self.n_ch, self.wstat,
+                           self.noise)
+        step = self.SIM_BLOCK_PERIOD_S / STREAM_BLOCK_SCANS
+        scans = []
+        for i in range(STREAM_BLOCK_SCANS):
+            ph = 2 * math.pi * 5.0 * i * step       # 5 Hz ripple + noise
+            scans.append([min(4095, max(0, int(v + 8 * math.sin(ph + ch)
+                                                + random.gauss(0, 3))))
+                          for ch, v in enumerate(snap.adc)])
+        self._sim_block = build_stream_packet(
+            snap.seq, snap.status, scans, snap.temp_x10, ts_us=snap.ts_us)
+        self._sim_block_t = now
+        return self._sim_block
+
+# ════════════════════════════════════════════════════════════
+#  WAVEFORM CAPTURE (board.h §13 recorder)
+# ════════════════════════════════════════════════════════════
+#
+#  Commands and reply packets: greenhouse_protocol.py.
+
+@dataclass
+class CaptureRecord:
+    """One fetched record: raw scans, oldest first."""
+    scans:   object              # rows × n_ch (numpy uint16 or tuples)
+    pre:     int = 0             # index of the trigger scan
+    ts_us:   int = 0             # TS_US of the trigger scan
+    scan_ns: int = 0
+    src:     str = "none"
+    rec:     int = 0
+    reads:   int = 0             # SPI transfers the fetch took
+    nbytes:  int = 0             # bytes clocked by those transfers
+
+    def t_us(self, i):
+        """Time of scan i relative to the trigger, µs."""
+        return (i - self.pre) * self.scan_ns / 1000.0
+
+    def save_csv(self, path):
+        n_ch = len(self.scans[0]) if len(self.scans) else 0
+        with open(path, "w", encoding="utf-8") as f:
+            f.write("# trigger=%s pre=%d ts_us=%d scan_ns=%d\n"
+                    % (self.src, self.pre, self.ts_us, self.scan_ns))
+            f.write("t_us," + ",".join(f"ch{k}" for k in range(n_ch)) + "\n")
+            for i, row in enumerate(self.scans):
+                f.write(f"{self.t_us(i):.1f},"
+                        + ",".join(str(int(v)) for v in row) + "\n")
+
+    def save_plot(self, path):
+        """PNG of every channel against time; False without matplotlib."""
+        try:
+            from matplotlib.figure import Figure
+            from matplotlib.backends.backend_agg import FigureCanvasAgg
+        except ImportError:
+            return False
+        fig = Figure(figsize=(10, 5))
+        FigureCanvasAgg(fig)
+        ax = fig.add_subplot(111)
+        t = [self.t_us(i) / 1000.0 for i in range(len(self.scans))]
+        n_ch = len(self.scans[0]) if len(self.scans) else 0
+        for k in range(n_ch):
+            label = (ADC_CHANNEL_LABELS[k] if k < len(ADC_CHANNEL_LABELS)
+                     else f"CH{k}")
+            ax.plot(t, [int(row[k]) for row in self.scans], lw=0.8,
+                    label=label)
+        ax.axvline(0.0, color="k", lw=0.8, ls="--")
+        ax.set_xlabel(f"ms from trigger ({self.src})")
+        ax.set_ylabel("raw ADC")
+        ax.legend(loc="upper left", fontsize=8)
+        fig.savefig(path, dpi=100)
+        return True
+
+
+class WaveformCapture:
+    """
+    Arm, trigger and fetch a raw record over one spidev-like handle.
+
+    The handle must not be polled by anyone else meanwhile: a
+    normal read would swallow a one-shot reply.  `wait(s)` pauses
+    between a command and its reply (the MCU packs a chunk in
+    well under REPLY_WAIT_S); pass a DrdyLine-style `drdy` to
+    wake on the reply's PB2 edge instead.
+    """
+
+    REPLY_WAIT_S = 0.002
+    RETRIES = 10
+
+    def __init__(self, spi, n_ch=ADC_NUM_CHANNELS, hz=SPI_SPEED_HZ,
+                 wait=time.sleep, drdy=None):
+        self.spi = spi
+        self.n_ch = n_ch
+        self.hz = hz
+        self.wait = wait
+        self.drdy = drdy
+        self.reads = 0
+        self.bytes = 0
+
+    def _xfer(self, mosi, n):
+        buf = list(mosi) + [0] * (n - len(mosi))
+        self.reads += 1
+        self.bytes += len(buf)
+        return self.spi.xfer2(buf, self.hz)
+
+    def _pause(self):
+        if self.drdy is not None:
+            self.drdy.wait(self.REPLY_WAIT_S * 10)
+        else:
+            self.wait(self.REPLY_WAIT_S)
+
+    def _reply(self, n, mosi=()):
+        """Read the pending reply (n rows expected); None on failure."""
+        for _ in range(self.RETRIES):
+            self._pause()
+            rep = parse_capture_reply(
+                self._xfer(mosi, capture_reply_len(self.n_ch, n)), self.n_ch)
+            if rep is not None:
+                return rep
+            if mosi:
+                return None          # mosi replaced the awaited reply
+        return None
+
+    def command(self, op, arg=b""):
+        """Send one command and return its (header-only) reply."""
+        self._xfer(build_command(op, arg), CMD_LEN)
+        return self._reply(0)
+
+    def arm(self, pre, ch=None, level=0, falling=False):
+        lv = (level & 0x0FFF) | (CAP_LEVEL_FALLING if falling else 0)
+        arg = struct.pack("<HBH", pre, CAP_CH_NONE if ch is None else ch, lv)
+        return self.command(CMD_OP_CAP_ARM, arg)
+
+    def force(self):
+        return self.command(CMD_OP_CAP_FORCE)
+
+    def stop(self):
+        return self.command(CMD_OP_CAP_STOP)
+
+    def state(self):
+        return self.command(CMD_OP_CAP_READ, struct.pack("<H", 0xFFFF))
+
+    def wait_done(self, timeout_s=60.0, poll_s=0.05):
+        """Poll the state until DONE; returns the last reply or None."""
+        t_end = time.monotonic() + timeout_s
+        while True:
+            rep = self.state()
+            if rep is not None and rep.state == CAP_STATES.index("done"):
+                return rep
+            if time.monotonic() >= t_end:
+                return None
+            self.wait(poll_s)
+
+    def fetch(self, info):
+        """
+        Read every chunk of a DONE record described by `info` (a
+        reply).  Returns a CaptureRecord, or None if a chunk could
+        not be read after RETRIES fresh requests.
+        """
+        plen = adc_payload_len(self.n_ch)
+        firsts = list(range(0, info.total, CAP_CHUNK_SCANS))
+        reads0, bytes0 = self.reads, self.bytes
+        body = bytearray()
+
+        def read(f):
+            return build_command(CMD_OP_CAP_READ, struct.pack("<H", f))
+
+        self._xfer(read(firsts[0]), CMD_LEN)
+        i = tries = 0
+        while i < len(firsts):
+            f = firsts[i]
+            n = min(CAP_CHUNK_SCANS, info.total - f)
+            nxt = read(firsts[i + 1]) if i + 1 < len(firsts) else ()
+            rep = self._reply(n, nxt)
+            if (rep is not None and rep.rec == info.rec and rep.first == f
+                    and rep.nscans == n):
+                body += rep.body
+                i += 1
+                continue
+            tries += 1
+            if tries > self.RETRIES:
+                return None
+            self._xfer(read(f), CMD_LEN)        # plain re-request
+
+        rows = [body[k:k + plen] for k in range(0, len(body), plen)]
+        return CaptureRecord(
+            scans=unpack_adc12_many(rows, self.n_ch), pre=info.pre,
+            ts_us=info.ts_us, scan_ns=info.scan_ns,
+            src=CAP_SOURCES[info.src] if info.src < len(CAP_SOURCES) else "?",
+            rec=info.rec, reads=self.reads - reads0,
+            nbytes=self.bytes - bytes0)
+
+    def capture(self, pre, ch=None, level=0, falling=False, timeout_s=60.0):
+        """
+        Arm, trigger (by command once `pre` scans are in, unless a
+        level is given), wait for DONE, fetch, disarm.
+        """
+        rep = self.arm(pre, ch, level, falling)
+        if rep is None:
+            raise RuntimeError("no reply to ARM (firmware without CAP_ENABLE?)")
+        if ch is None:
+            self.wait(pre * (rep.scan_ns or 1) / 1e9)
+            self.force()
+        info = self.wait_done(timeout_s)
+        if info is None:
+            self.stop()
+            raise TimeoutError("capture did not trigger")
+        record = self.fetch(info)
+        self.stop()
+        if record is None:
+            raise RuntimeError("capture fetch failed")
+        return record
+
+
+def parse_cap_level(spec):
+    """'CH:LEVEL[:fall]' → (ch, level, falling) for --cap-level."""
+    parts = spec.split(":")
+    if len(parts) not in (2, 3) or (len(parts) == 3 and parts[2] != "fall"):
+        raise ValueError(f"expected CH:LEVEL[:fall], got {spec!r}")
+    ch, level = int(parts[0]), int(parts[1])
+    if not 0 <= level <= ADC_RESOLUTION:
+        raise ValueError(f"level {level} outside 0..{ADC_RESOLUTION}")
+    return ch, level, len(parts) == 3
+
+
+def run_capture(spi, path, n_ch, hz=SPI_SPEED_HZ, pre=None, level=None,
+                timeout_s=60.0, drdy=None):
+    """--capture: one record to `path` (CSV) and a PNG beside it."""
+    cap = WaveformCapture(spi, n_ch, hz, drdy=drdy)
+    total = cap_scans(n_ch)
+    pre = total // 4 if pre is None else min(pre, total - 1)
+    ch, lv, falling = level if level else (None, 0, False)
+    if ch is not None and not 0 <= ch < n_ch:
+        log.error("--cap-level: channel %d outside 0..%d", ch, n_ch - 1)
+        return 2
+    log.info("capture: %d scans, %d pre-trigger, trigger %s", total, pre,
+             "by command" if ch is None else
+             f"CH{ch} {'falling below' if falling else 'rising to'} {lv}")
+    try:
+        rec = cap.capture(pre, ch, lv, falling, timeout_s)
+    except (RuntimeError, TimeoutError, OSError) as exc:
+        log.error("capture: %s", exc)
+        return 1
+    rec.save_csv(path)
+    png = os.path.splitext(path)[0] + ".png"
+    plotted = rec.save_plot(png)
+    log.info("capture: record %d (%s trigger) %d scans, %.1f ms at %.1f us, "
+             "fetched in %d transfers / %d bytes -> %s%s",
+             rec.rec, rec.src, len(rec.scans),
+             len(rec.scans) * rec.scan_ns / 1e6, rec.scan_ns / 1000.0,
+             rec.reads, rec.nbytes, path, f", {png}" if plotted else "")
+    return 0
+
+# ════════════════════════════════════════════════════════════
+#  MULTI-NODE POLLER (several STM32 slaves, one thread)
+# ════════════════════════════════════════════════════════════
+
+def parse_node_spec(spec):
+    """
+    Parse a --node argument:  NAME=BUS.DEV[@GPIO][,HZ]
+
+      gh1=0.0          spidev0.0, hardware CE0
+      gh2=0.1,100      spidev0.1, polled at 100 Hz
+      gh3=0.1@25       spidev0.1 with CE unused, CS on BCM 25
+
+    Returns a dict of SpiReader keyword arguments.
+    """
+    name, sep, rest = spec.partition("=")
+    if not sep or not name:
+        raise ValueError(f"bad node spec {spec!r} (NAME=BUS.DEV[@GPIO][,HZ])")
+    rest, _, hz = rest.partition(",")
+    addr, _, gpio = rest.partition("@")
+    bus, _, dev = addr.partition(".")
+    node = dict(name=name, bus=int(bus), dev=int(dev),
+                cs_gpio=int(gpio) if gpio else None)
+    if hz:
+        node["period_s"] = 1.0 / float(hz)
+    return node
+
+
+class MultiSpiPoller:
+    """
+    Polls several STM32 nodes from ONE thread.
+
+    Each node is a SpiReader that never starts its own thread: it
+    keeps its stats, history and get_snapshot() as usual, while the
+    poller owns the bus.  One spidev handle is opened per (bus, dev)
+    and shared by every node on it.
+
+    Scheduling is earliest-deadline-first.  A node is released every
+    period_s; its deadline is the next release.  A node served more
+    than one period late has lost that slot: the miss is counted and
+    its releases skip forward instead of bursting to catch up.
+    Releases start staggered so nodes on one bus do not collide.
+    """
+
+    def __init__(self, nodes, simulate=False, sim_bus_hz=None,
+                 spi_factory=None):
+        self.nodes = list(nodes)
+        self.spi_factory = spi_factory  # None = spidev.SpiDev
+        self.sim_bus_hz = sim_bus_hz    # simulate: busy-wait bus time
+        self._handles = {}
+        self._cs_pins = []
+        self._running = False
+        self._thread = None
+        self.lateness = {n.name: deque(maxlen=4096) for n in self.nodes}
+        self.simulate = simulate
+
+    @property
+    def simulate(self):
+        return self._simulate
+
+    @simulate.setter
+    def simulate(self, value):
+        self._simulate = value
+        for node in self.nodes:
+            node.simulate = value
+
+    # ── lifecycle ──────────────────────────────────────────
+
+    def start(self):
+        """Open every bus and start the polling thread."""
+        if self._running:
+            return True
+        if not self.simulate:
+            try:
+                self._open()
+            except (ImportError, ValueError, FileNotFoundError,
+                    PermissionError, OSError) as exc:
+                log.error("Cannot open SPI nodes: %s", exc)
+                self._close()
+                return False
+        else:
+            log.info("Running %d nodes in SIMULATION mode", len(self.nodes))
+
+        self._running = True
+        self._thread = threading.Thread(target=self._poll_loop,
+                                        daemon=True, name="spi-multi")
+        self._thread.start()
+        return True
+
+    def stop(self):
+        self._running = False
+        if self._thread and self._thread.is_alive():
+            self._thread.join(timeout=0.5)
+        self._close()
+        log.info("Multi-node poller stopped.")
+
+    def _open(self):
+        if self.spi_factory is None and not HAS_SPIDEV:
+            raise ImportError("spidev module not installed")
+        no_cs = {}
+        for node in self.nodes:
+            key = (node.bus, node.dev)
+            gpio_cs = node.cs_gpio is not None
+            if no_cs.setdefault(key, gpio_cs) != gpio_cs:
+                raise ValueError(f"spidev{key[0]}.{key[1]} mixes hardware "
+                                 "CE and GPIO chip selects")
+            if gpio_cs and not HAS_RPI_GPIO:
+                raise ImportError("RPi.GPIO needed for GPIO chip selects")
+
+        for key, gpio_cs in no_cs.items():
+            spi = (self.spi_factory or spidev.SpiDev)()
+            spi.open(*key)
+            spi.mode = SPI_MODE
+            spi.max_speed_hz = SPI_SPEED_HZ
+            if gpio_cs:
+                spi.no_cs = True
+            self._handles[key] = spi
+            log.info("SPI%d.%d opened%s", key[0], key[1],
+                     " (GPIO chip selects)" if gpio_cs else "")
+
+        if any(no_cs.values()):
+            GPIO.setmode(GPIO.BCM)
+        for node in self.nodes:
+            node._spi = self._handles[(node.bus, node.dev)]
+            if node.cs_gpio is not None:
+                GPIO.setup(node.cs_gpio, GPIO.OUT, initial=GPIO.HIGH)
+                self._cs_pins.append(node.cs_gpio)
+
+    def _close(self):
+        for node in self.nodes:
+            node._spi = None
+        for spi in self._handles.values():
+            try:
+                spi.close()
+            except Exception:
+                pass
+        self._handles.clear()
+        if self._cs_pins:
+            GPIO.cleanup(self._cs_pins)
+            self._cs_pins = []
+
+    # ── scheduler ────────────────────────────────────────
+
+    def _poll_loop(self):
+        import heapq
+
+        t0 = time.monotonic()
+        n = len(self.nodes)
+        heap = [(t0 + node.period_s * i / n, i)
+                for i, node in enumerate(self.nodes)]
+        heapq.heapify(heap)
+
+        while self._running:
+            release, i = heap[0]
+            now = time.monotonic()
+            if release > now:
+                time.sleep(min(release - now, 0.05))
+                continue
+
+            node = self.nodes[i]
+            late = now - release
+            missed = int(late // node.period_s)
+            heapq.heapreplace(heap, (release + (missed + 1) * node.period_s, i))
+
+            try:
+                raw = node._read_raw()
+                if self.simulate and self.sim_bus_hz:
+                    self._spin(len(raw) * 8 / self.sim_bus_hz)
+                node._process(raw)
+            except Exception as exc:
+                log.warning("%s: SPI read error: %s", node.name, exc)
+
+            self.lateness[node.name].append(late)
+            with node._lock:
+                node.stats.deadline_misses += missed
+                if late * 1000.0 > node.stats.max_lateness_ms:
+                    node.stats.max_lateness_ms = late * 1000.0
+
+    @staticmethod
+    def _spin(seconds):
+        """Hold the thread like a blocking xfer2() would."""
+        end = time.perf_counter() + seconds
+        while time.perf_counter() < end:
+            pass
+
+
+def bench_multi(n_nodes, seconds=5.0, hz=1.0 / POLL_INTERVAL_S,
+                n_ch=ADC_NUM_CHANNELS):
+    """
+    Simulated multi-node benchmark: n_nodes snapshot slaves polled
+    at hz each from one thread, with bus time modelled at
+    SPI_SPEED_HZ.  Returns {"nodes": [(name, frames, misses, p50 ms,
+    p99 ms, max ms)], "seconds", "hz"} of lateness per node.
+    """
+    nodes = [SpiReader(simulate=True, n_ch=n_ch, name=f"node{i}",
+                       period_s=1.0 / hz) for i in range(n_nodes)]
+    poller = MultiSpiPoller(nodes, simulate=True, sim_bus_hz=SPI_SPEED_HZ)
+    poller.start()
+    time.sleep(seconds)
+    poller.stop()
+
+    def pct(vals, q):
+        vals = sorted(vals)
+        return vals[min(len(vals) - 1, int(q * len(vals)))] * 1000.0 if vals else 0.0
+
+    rows = []
+    for node in nodes:
+        _, st = node.get_snapshot()
+        lat = list(poller.lateness[node.name])
+        rows.append((node.name, st.valid_frames, st.deadline_misses,
+                     pct(lat, 0.5), pct(lat, 0.99), st.max_lateness_ms))
+    return {"nodes": rows, "seconds": seconds, "hz": hz}
+
+
+def print_bench_multi(result):
+    seconds, hz = result["seconds"], result["hz"]
+    print(f"{'node':<8} {'frames':>7} {'fps':>7} {'miss':>5} "
+          f"{'p50 ms':>7} {'p99 ms':>7} {'max ms':>7}")
+    for name, frames, misses, p50, p99, worst in result["nodes"]:
+        print(f"{name:<8} {frames:>7} {frames / seconds:>7.1f} {misses:>5} "
+              f"{p50:>7.3f} {p99:>7.3f} {worst:>7.3f}")
+    total = sum(r[1] for r in result["nodes"])
+    print(f"aggregate: {total / seconds:.1f} frames/s "
+          f"(target {len(result['nodes']) * hz:.1f}), one poll thread")
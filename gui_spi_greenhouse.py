@@ -2,28 +2,36 @@
 """
 Smart Greenhouse & Fire Alarm — Raspberry Pi SPI Dashboard
 ═══════════════════════════════════════════════════════════
-Reads a 16-byte binary frame from STM32F411 (SPI slave) and
+Reads a binary frame from STM32F411 (SPI slave) and
 renders a real-time Tkinter dashboard with:
 
   • Temperature gauge (LM35) with colour-coded alarm state
   • Gas level gauge with colour-coded alarm state
-  • 4× raw ADC channel readouts
+  • N× raw ADC channel readouts (1–16, default 4)
   • Actuator indicators (buzzer, motor)
   • Rolling history chart (last 120 seconds)
   • Connection status & frame error statistics
 
-SPI Frame (16 bytes, little-endian):
-  [0]  0xAA  magic
-  [1]  0x55  magic
-  [2]  SEQ   sequence counter
-  [3]  STATUS  bit-field (buzzer|motor|gas_alarm|temp_alarm)
-  [4-5]   ADC0 (LM35 raw)
-  [6-7]   ADC1 (Gas raw)
-  [8-9]   ADC2 (Sensor 3)
-  [10-11]  ADC3 (Sensor 4)
-  [12-13]  TEMP_X10  (temperature × 10, 0.1 °C)
-  [14]  XOR checksum of [0..13]
-  [15]  0x0D  end marker
+SPI Frame: the snapshot layout is defined once, in FRAME_SCHEMA
+(greenhouse_protocol.py, mirrors board.h §7): magic AA 55, SEQ, STATUS, NCH, N × 12-bit packed
+ADC, TEMP_X10, TS_US, PUB_CNT, SCAN_CNT, FOLD, the optional WSTAT and
+NOISE blocks, XOR, 0x0D.  packet_len() gives the length per build,
+e.g. N = 4 → 29 bytes without optional blocks.
+
+Stream mode (--stream, firmware STREAM_ENABLE = 1): variable-length
+packets [AA 56 SEQ STATUS NCH NSCANS DECIM TEMP(2) BODY_LEN(2) TS(4)
+BODY XOR 0D] (board.h §7 STREAM_OFF_*) carrying NSCANS raw scans as
+Rice-coded zig-zag deltas.
+
+Waveform capture (--capture, firmware CAP_ENABLE = 1): MOSI commands
+arm a pre-triggered record of raw scans at the full ADC rate, which
+is then fetched in CAP_CHUNK_SCANS bursts and saved as CSV (+ PNG).
+
+This file is the Tk dashboard, the metrics exporter and the CLI.  The
+layers under it import without Tk: greenhouse_protocol (schema and
+codecs), greenhouse_reader (SPI polling), greenhouse_hil (firmware
+built for the host), greenhouse_ipc (poller processes).  Self-checks:
+test_greenhouse.py.
 
 Author : Thuong
 Date   : 2025
@@ -31,17 +39,26 @@ Date   : 2025
 
 from __future__ import annotations
 
+import os
 import sys
 import time
 import struct
 import threading
 import logging
-from collections import deque
-from dataclasses import dataclass, field
 from typing import Optional
 
-import tkinter as tk
-from tkinter import ttk, messagebox
+# ── Tkinter: absent on headless installs (no python3-tk) ────
+try:
+    import tkinter as tk
+    from tkinter import ttk, messagebox
+    HAS_TK = True
+except ImportError:
+    # GUI classes still define against this stand-in; only
+    # --headless can run.
+    import types
+    tk = types.SimpleNamespace(Frame=object, TclError=Exception, READABLE=1)
+    ttk = messagebox = None
+    HAS_TK = False
 
 # ── Optional: matplotlib for history chart ──────────────────
 try:
@@ -60,69 +77,42 @@ try:
 except ImportError:
     HAS_SPIDEV = False
 
+# ── Frame schema, codecs and board.h mirrors ────────────────
+from greenhouse_protocol import (
+    ADC_CHANNEL_LABELS, ADC_MAX_CHANNELS, ADC_NUM_CHANNELS,
+    GAS_ALARM_ON, GAS_WARN_ON, TEMP_ALARM_ON, TEMP_WARN_ON, cal_unit,
+    check_cal_lut, check_frame_pack, write_cal_lut, write_frame_pack)
+
+# ── SPI reader, HIL board, poller processes (no Tk) ───────
+from greenhouse_reader import (
+    ADAPT_MAX_MS, ADAPT_MIN_MS, DRDY_CHIP, DRDY_LINE, DRDY_PERIOD_S,
+    DrdyLine, LatencyHist, MockDrdyLine, MultiSpiPoller, SPI_BUS,
+    SPI_DEV, SPI_MODE, SPI_SPEED_HZ, SpiReader, bench_multi,
+    parse_adapt_spec, parse_cap_level, parse_drdy_spec, parse_node_spec,
+    print_bench_multi, run_capture)
+from greenhouse_hil import (
+    HIL_SPI_IDEAL, HIL_SPI_WIRE, HilScenario, HilSpiDev, adapt_bench,
+    build_hil_library, check_protocol, est_bench, hil_bench,
+    hil_firmware_info, print_est_bench)
+from greenhouse_ipc import (
+    FrameClient, RemoteReader, SHM_ATTACH_S, SOCK_PATH, ShmRingClient,
+    bench_fanout, bench_split, print_bench_split, run_frame_daemon,
+    run_shm_poller, spawn_poller)
+
 # ════════════════════════════════════════════════════════════
-#  CONFIGURATION — mirrors board.h on STM32 side
-#
-#  These constants MUST match board.h Section 7 exactly.
-#  If you change the STM32 protocol, update both files.
+#  CONFIGURATION — dashboard, metrics exporter
 # ════════════════════════════════════════════════════════════
 
-# Frame geometry (board.h §7 — PACKET_LEN)
-PACKET_LEN       = 16
-
-# Magic bytes (board.h §7 — FRAME_MAGIC_0/1, FRAME_END_MARKER)
-MAGIC_0          = 0xAA
-MAGIC_1          = 0x55
-END_MARKER       = 0x0D
-
-# Byte offsets (board.h §7 — FRAME_OFF_*)
-OFF_MAGIC0       = 0
-OFF_MAGIC1       = 1
-OFF_SEQ          = 2
-OFF_STATUS       = 3
-OFF_ADC0_L       = 4
-OFF_ADC0_H       = 5
-OFF_ADC1_L       = 6
-OFF_ADC1_H       = 7
-OFF_ADC2_L       = 8
-OFF_ADC2_H       = 9
-OFF_ADC3_L       = 10
-OFF_ADC3_H       = 11
-OFF_TEMP_L       = 12
-OFF_TEMP_H       = 13
-OFF_XOR          = 14
-OFF_END          = 15
-
-# STATUS bit positions (board.h §7 — STATUS_BIT_*)
-STATUS_BIT_BUZZER     = 0
-STATUS_BIT_MOTOR      = 1
-STATUS_BIT_GAS_ALARM  = 2
-STATUS_BIT_TEMP_ALARM = 3
-
-# SPI bus parameters (board.h §7 — SPI_CLOCK_HZ, SPI_CPOL, SPI_CPHA)
-SPI_BUS          = 0
-SPI_DEV          = 0
-SPI_SPEED_HZ     = 1_000_000   # must match SPI_CLOCK_HZ in board.h
-SPI_MODE         = 0b00        # Mode 0 (CPOL=0, CPHA=0)
-
-# Alarm thresholds for GUI colour (board.h §5)
-TEMP_WARN_THRESH  = 35.0       # board.h TEMP_WARN_ON_X10 / 10
-TEMP_ALARM_THRESH = 50.0       # board.h TEMP_ALARM_ON_X10 / 10
-GAS_WARN_THRESH   = 2000       # board.h GAS_WARN_ON_ADC
-GAS_ALARM_THRESH  = 2500       # board.h GAS_ALARM_ON_ADC
-
-POLL_INTERVAL_S  = 0.02      # 50 Hz SPI poll
-UI_REFRESH_MS    = 100       # 10 Hz GUI update
+UI_REFRESH_MS    = 100       # 10 Hz GUI update (tick mode, chart)
+STALE_CHECK_MS   = 1000      # no frame for this long → "NO NEW DATA"
+
+# Headless metrics exporter (--headless)
+METRICS_HOST     = "127.0.0.1"
+METRICS_PORT     = 9108
+
 CHART_HISTORY_S  = 120       # seconds of chart history
 CHART_POINTS     = int(CHART_HISTORY_S / (UI_REFRESH_MS / 1000))
 
-# Alarm thresholds — aliases for display colour logic
-# (primary defines are TEMP_WARN_THRESH etc. above)
-TEMP_WARN_ON     = TEMP_WARN_THRESH
-TEMP_ALARM_ON    = TEMP_ALARM_THRESH
-GAS_WARN_ON      = GAS_WARN_THRESH
-GAS_ALARM_ON     = GAS_ALARM_THRESH
-
 # Colour palette
 CLR_BG           = "#1e1e2e"
 CLR_CARD         = "#2a2a3c"
@@ -143,314 +133,400 @@ logging.basicConfig(
 )
 log = logging.getLogger("greenhouse")
 
-# ════════════════════════════════════════════════════════════
-#  DATA MODEL
-# ════════════════════════════════════════════════════════════
-
-@dataclass
-class SensorFrame:
-    """Parsed representation of one 16-byte SPI frame."""
-    seq:        int = 0
-    status:     int = 0
-    adc:        tuple = (0, 0, 0, 0)
-    temp_x10:   int = 0          # 0.1 °C units
-    temp_c:     float = 0.0
-    buzzer:     bool = False
-    motor:      bool = False
-    gas_alarm:  bool = False
-    temp_alarm: bool = False
-    timestamp:  float = field(default_factory=time.monotonic)
-
-    @property
-    def gas_raw(self) -> int:
-        return self.adc[1]
-
-    def alarm_level_temp(self) -> str:
-        """Return 'NORMAL', 'WARN', or 'ALARM' based on thresholds."""
-        if self.temp_c >= TEMP_ALARM_ON:
-            return "ALARM"
-        if self.temp_c >= TEMP_WARN_ON:
-            return "WARN"
-        return "NORMAL"
-
-    def alarm_level_gas(self) -> str:
-        if self.gas_raw >= GAS_ALARM_ON:
-            return "ALARM"
-        if self.gas_raw >= GAS_WARN_ON:
-            return "WARN"
-        return "NORMAL"
-
-
-@dataclass
-class FrameStats:
-    """Tracks SPI communication health."""
-    total_reads:       int = 0
-    valid_frames:      int = 0
-    magic_errors:      int = 0
-    checksum_errors:   int = 0
-    length_errors:     int = 0
-    last_seq:          int = -1
-    seq_gaps:          int = 0
-
-    @property
-    def error_total(self) -> int:
-        return self.magic_errors + self.checksum_errors + self.length_errors
-
-    @property
-    def error_rate_pct(self) -> float:
-        if self.total_reads == 0:
-            return 0.0
-        return (self.error_total / self.total_reads) * 100.0
 
 # ════════════════════════════════════════════════════════════
-#  SPI PROTOCOL LAYER
+#  HEADLESS METRICS EXPORTER (Prometheus text format)
 # ════════════════════════════════════════════════════════════
 
-def xor_checksum(buf, length=14):
-    """XOR checksum over bytes [0..length-1]."""
-    cs = 0
-    for i in range(min(length, len(buf))):
-        cs ^= buf[i]
-    return cs & 0xFF
-
+# (name, type, help) in exposition order
+_METRIC_FAMILIES = (
+    ("greenhouse_reads_total", "counter", "SPI transfers attempted"),
+    ("greenhouse_frames_valid_total", "counter", "Frames that passed validation"),
+    ("greenhouse_frame_errors_total", "counter", "Rejected frames by kind"),
+    ("greenhouse_seq_gaps_total", "counter", "SEQ discontinuities seen"),
+    ("greenhouse_seq_repeats_total", "counter",
+     "Frames read again before the next publication"),
+    ("greenhouse_frames_lost_total", "counter",
+     "Frames published but overwritten before a read (PUB_CNT)"),
+    ("greenhouse_scans_lost_total", "counter",
+     "ADC scans folded into frames never read (SCAN_CNT, FOLD)"),
+    ("greenhouse_scans_read_total", "counter",
+     "ADC scans folded into frames read (FOLD)"),
+    ("greenhouse_board_resets_total", "counter",
+     "PUB_CNT restarted (MCU reset)"),
+    ("greenhouse_deadline_misses_total", "counter", "Poll slots lost (multi-node)"),
+    ("greenhouse_frame_offset_total", "counter",
+     "Resync mode: valid frames by byte offset in the transfer"),
+    ("greenhouse_last_seq", "gauge", "SEQ of the latest valid frame"),
+    ("greenhouse_last_frame_timestamp_seconds", "gauge",
+     "Unix time the latest valid frame was received"),
+    ("greenhouse_temperature_celsius", "gauge", "LM35 temperature (filtered)"),
+    ("greenhouse_adc_raw", "gauge", "Latest 12-bit ADC sample per channel"),
+    ("greenhouse_sensor_value", "gauge",
+     "Calibrated value per channel (cal_lut tables)"),
+    ("greenhouse_status_bit", "gauge", "STATUS byte bits of the latest frame"),
+    ("greenhouse_alarm_level", "gauge", "0 = NORMAL, 1 = WARN, 2 = ALARM"),
+    ("greenhouse_poll_interval_seconds", "histogram",
+     "Time between polls; buckets at 0.5x-5x the poll period, or fixed "
+     "2.5 ms-0.5 s with --adaptive-poll"),
+    ("greenhouse_poll_jitter_max_seconds", "gauge",
+     "Largest |poll interval - poll period in force| seen"),
+    ("greenhouse_poll_period_seconds", "gauge",
+     "Current poll period (changes with --adaptive-poll)"),
+    ("greenhouse_publish_period_seconds", "gauge",
+     "Adaptive poll: estimated firmware publication period"),
+    ("greenhouse_sample_age_seconds", "histogram",
+     "MCU sample time (TS_US) to frame receipt"),
+    ("greenhouse_clock_skew_ppm", "gauge",
+     "MCU TS_US clock rate minus host clock rate"),
+    ("greenhouse_clock_resets_total", "counter",
+     "TS_US stepped backwards (MCU reset)"),
+    ("greenhouse_stream_bytes_per_sample", "gauge",
+     "Stream mode: SPI bytes per decoded sample"),
+    ("greenhouse_drdy_wakeups_total", "counter",
+     "DRDY mode: reads by cause (edge or fallback timeout)"),
+    ("greenhouse_client_dropped_total", "counter",
+     "Client / ring reader: frames lost between the poller and this process"),
+    ("greenhouse_window_scans_total", "counter",
+     "WSTAT: raw scans covered by received windows"),
+    ("greenhouse_window_crossings_total", "counter",
+     "WSTAT: rising WARN crossings seen in raw scans"),
+    ("greenhouse_window_min", "gauge", "WSTAT: lowest raw scan in the last window"),
+    ("greenhouse_window_max", "gauge", "WSTAT: highest raw scan in the last window"),
+    ("greenhouse_window_mean", "gauge", "WSTAT: mean raw scan in the last window"),
+    ("greenhouse_window_stddev", "gauge",
+     "WSTAT: raw scan standard deviation in the last window"),
+    ("greenhouse_noise_power_lsb2", "gauge",
+     "NOISE: raw scan variance over the last mains window"),
+    ("greenhouse_hum_power_lsb2", "gauge",
+     "NOISE: power of the mains-frequency bin over the last mains window"),
+)
 
-def parse_frame(raw):
+_ALARM_LEVELS = {"NORMAL": 0, "WARN": 1, "ALARM": 2}
+
+
+def _hist_lines(node, h):
+    """Prometheus _bucket/_sum/_count lines for a bounds/counts histogram."""
+    lines, cum = [], 0
+    for le, n in zip(h.bounds, h.counts):
+        cum += n
+        lines.append(f'_bucket{{{node},le="{le:.4f}"}} {cum}')
+    lines.append(f'_bucket{{{node},le="+Inf"}} {h.count}')
+    lines.append(f"_sum{{{node}}} {h.sum_s:.6f}")
+    lines.append(f"_count{{{node}}} {h.count}")
+    return lines
+
+
+def render_node_metrics(reader):
+    """Render one reader's samples as {family: [lines]}."""
+    frame, st = reader.get_snapshot()
+    j = reader.jitter
+    node = f'node="{reader.name}"'
+    out = {
+        "greenhouse_reads_total": [f"{{{node}}} {st.total_reads}"],
+        "greenhouse_frames_valid_total": [f"{{{node}}} {st.valid_frames}"],
+        "greenhouse_frame_errors_total": [
+            f'{{{node},kind="magic"}} {st.magic_errors}',
+            f'{{{node},kind="checksum"}} {st.checksum_errors}',
+            f'{{{node},kind="length"}} {st.length_errors}',
+            f'{{{node},kind="nch"}} {st.nch_errors}'],
+        "greenhouse_seq_gaps_total": [f"{{{node}}} {st.seq_gaps}"],
+        "greenhouse_seq_repeats_total": [f"{{{node}}} {st.seq_repeats}"],
+        "greenhouse_deadline_misses_total": [f"{{{node}}} {st.deadline_misses}"],
+        "greenhouse_poll_jitter_max_seconds": [f"{{{node}}} {j.max_dev_s:.6f}"],
+        "greenhouse_poll_period_seconds": [
+            f"{{{node}}} {st.poll_period_ms / 1e3:.6f}"],
+        "greenhouse_poll_interval_seconds": _hist_lines(node, j),
+        "greenhouse_sample_age_seconds": _hist_lines(node, reader.age_hist),
+        "greenhouse_clock_skew_ppm": [
+            f"{{{node}}} {reader.clock.skew_ppm:.1f}"],
+        "greenhouse_clock_resets_total": [f"{{{node}}} {reader.clock.resets}"],
+    }
+
+    if st.pub_period_ms:
+        out["greenhouse_publish_period_seconds"] = [
+            f"{{{node}}} {st.pub_period_ms / 1e3:.6f}"]
+
+    if reader.sync is not None:
+        out["greenhouse_frame_offset_total"] = [
+            f'{{{node},offset="{off}"}} {n}'
+            for off, n in sorted(st.offsets.items())]
+
+    if reader.stream:
+        out["greenhouse_stream_bytes_per_sample"] = [
+            f"{{{node}}} {st.bytes_per_sample:.4f}"]
+    else:
+        out["greenhouse_frames_lost_total"] = [f"{{{node}}} {st.frames_lost}"]
+        out["greenhouse_scans_lost_total"] = [f"{{{node}}} {st.scans_lost}"]
+        out["greenhouse_scans_read_total"] = [f"{{{node}}} {st.scans_read}"]
+        out["greenhouse_board_resets_total"] = [
+            f"{{{node}}} {st.board_resets}"]
+
+    if reader.drdy is not None:
+        out["greenhouse_drdy_wakeups_total"] = [
+            f'{{{node},cause="edge"}} {st.drdy_edges}',
+            f'{{{node},cause="timeout"}} {st.drdy_timeouts}']
+
+    if isinstance(reader, RemoteReader):
+        out["greenhouse_client_dropped_total"] = [
+            f"{{{node}}} {reader.dropped}"]
+
+    if reader.wstat:
+        out["greenhouse_window_scans_total"] = [f"{{{node}}} {st.win_scans}"]
+        out["greenhouse_window_crossings_total"] = [
+            f"{{{node}}} {st.win_crossings}"]
+
+    if frame is not None:
+        wall = time.time() - (time.monotonic() - frame.timestamp)
+        out["greenhouse_last_seq"] = [f"{{{node}}} {frame.seq}"]
+        out["greenhouse_last_frame_timestamp_seconds"] = [f"{{{node}}} {wall:.3f}"]
+        out["greenhouse_temperature_celsius"] = [f"{{{node}}} {frame.temp_c:.1f}"]
+        out["greenhouse_adc_raw"] = [f'{{{node},ch="{i}"}} {v}'
+                                     for i, v in enumerate(frame.adc)]
+        out["greenhouse_sensor_value"] = [
+            f'{{{node},ch="{i}",unit="{cal_unit(i)}"}} {v:g}'
+            for i, v in enumerate(frame.eng)]
+        out["greenhouse_status_bit"] = [
+            f'{{{node},bit="buzzer"}} {int(frame.buzzer)}',
+            f'{{{node},bit="motor"}} {int(frame.motor)}',
+            f'{{{node},bit="gas_alarm"}} {int(frame.gas_alarm)}',
+            f'{{{node},bit="temp_alarm"}} {int(frame.temp_alarm)}',
+            f'{{{node},bit="trend"}} {int(frame.trend)}',
+            f'{{{node},bit="emergency"}} {int(frame.emergency)}']
+        out["greenhouse_alarm_level"] = [
+            f'{{{node},sensor="temp"}} {_ALARM_LEVELS[frame.alarm_level_temp()]}',
+            f'{{{node},sensor="gas"}} {_ALARM_LEVELS[frame.alarm_level_gas()]}']
+        for fam, fmt in (("min", "{w.min}"), ("max", "{w.max}"),
+                         ("mean", "{w.mean:.2f}"), ("stddev", "{w.std:.3f}")):
+            if frame.wstat:
+                out[f"greenhouse_window_{fam}"] = [
+                    f'{{{node},ch="{i}"}} ' + fmt.format(w=w)
+                    for i, w in enumerate(frame.wstat)]
+        if frame.noise:
+            out["greenhouse_noise_power_lsb2"] = [
+                f'{{{node},ch="{i}"}} {z.power:.3f}'
+                for i, z in enumerate(frame.noise)]
+            out["greenhouse_hum_power_lsb2"] = [
+                f'{{{node},ch="{i}"}} {z.hum:.3f}'
+                for i, z in enumerate(frame.noise)]
+    return out
+
+
+class MetricsExporter:
     """
-    Parse a 16-byte raw SPI frame into a SensorFrame.
-    Returns None if validation fails.
+    Serves /metrics for one or more SpiReaders without a GUI.
 
-    Byte layout matches board.h Section 7 (FRAME_OFF_* defines).
+    Rendering runs on the polling thread right after each poll: the
+    polled reader's samples are re-rendered and the page is joined
+    into one immutable bytes object.  A scrape only returns that
+    reference — O(1), and it never takes a reader lock.
     """
-    if len(raw) != PACKET_LEN:
-        return None
-    if raw[OFF_MAGIC0] != MAGIC_0 or raw[OFF_MAGIC1] != MAGIC_1:
-        return None
-    if raw[OFF_END] != END_MARKER:
-        return None
-    if raw[OFF_XOR] != xor_checksum(raw):
-        return None
-
-    status = raw[OFF_STATUS]
-    # Unpack 4× uint16 LE for ADC + 1× uint16 LE for temp
-    adc0 = raw[OFF_ADC0_L] | (raw[OFF_ADC0_H] << 8)
-    adc1 = raw[OFF_ADC1_L] | (raw[OFF_ADC1_H] << 8)
-    adc2 = raw[OFF_ADC2_L] | (raw[OFF_ADC2_H] << 8)
-    adc3 = raw[OFF_ADC3_L] | (raw[OFF_ADC3_H] << 8)
-    temp_x10 = raw[OFF_TEMP_L] | (raw[OFF_TEMP_H] << 8)
-
-    return SensorFrame(
-        seq       = raw[OFF_SEQ],
-        status    = status,
-        adc       = (adc0, adc1, adc2, adc3),
-        temp_x10  = temp_x10,
-        temp_c    = temp_x10 / 10.0,
-        buzzer    = bool(status & (1 << STATUS_BIT_BUZZER)),
-        motor     = bool(status & (1 << STATUS_BIT_MOTOR)),
-        gas_alarm = bool(status & (1 << STATUS_BIT_GAS_ALARM)),
-        temp_alarm= bool(status & (1 << STATUS_BIT_TEMP_ALARM)),
-    )
+
+    def __init__(self, readers, host=METRICS_HOST, port=METRICS_PORT):
+        self.readers = list(readers)
+        self.host = host
+        self.port = port
+        self._frags = {r.name: render_node_metrics(r) for r in self.readers}
+        self.body = self._join()
+        self._server = None
+        for r in self.readers:
+            r.subscribe_polls(self._on_poll)
+
+    def _on_poll(self, reader):
+        self._frags[reader.name] = render_node_metrics(reader)
+        self.body = self._join()
+
+    def _join(self):
+        lines = []
+        frags = list(self._frags.values())
+        for name, kind, help_ in _METRIC_FAMILIES:
+            samples = [name + line for f in frags for line in f.get(name, ())]
+            if not samples:
+                continue
+            lines.append(f"# HELP {name} {help_}")
+            lines.append(f"# TYPE {name} {kind}")
+            lines.extend(samples)
+        lines.append("")
+        return "\n".join(lines).encode()
+
+    def start(self):
+        from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+        exporter = self
+
+        class Handler(BaseHTTPRequestHandler):
+            def do_GET(self):
+                if self.path.split("?", 1)[0] != "/metrics":
+                    self.send_error(404)
+                    return
+                body = exporter.body
+                self.send_response(200)
+                self.send_header("Content-Type",
+                                 "text/plain; version=0.0.4; charset=utf-8")
+                self.send_header("Content-Length", str(len(body)))
+                self.end_headers()
+                self.wfile.write(body)
+
+            def log_message(self, *args):
+                pass
+
+        self._server = ThreadingHTTPServer((self.host, self.port), Handler)
+        self._server.daemon_threads = True
+        threading.Thread(target=self._server.serve_forever, daemon=True,
+                         name="metrics-http").start()
+        log.info("Metrics on http://%s:%d/metrics", self.host, self.port)
+
+    def stop(self):
+        if self._server is not None:
+            self._server.shutdown()
+            self._server.server_close()
+            self._server = None
+
+
+def run_headless(source, readers, host=METRICS_HOST, port=METRICS_PORT):
+    """Poll without Tk and export metrics until SIGINT/SIGTERM."""
+    import signal
+
+    exporter = MetricsExporter(readers, host, port)
+    if not source.start():
+        return 1
+    try:
+        exporter.start()
+    except OSError as exc:
+        log.error("Cannot serve metrics on %s:%d: %s", host, port, exc)
+        source.stop()
+        return 1
+
+    done = threading.Event()
+    signal.signal(signal.SIGTERM, lambda *_: done.set())
+    try:
+        while not done.wait(1.0):
+            pass
+    except KeyboardInterrupt:
+        pass
+    exporter.stop()
+    source.stop()
+    return 0
 
 # ════════════════════════════════════════════════════════════
-#  SPI READER (background thread)
+#  GUI — DASHBOARD
 # ════════════════════════════════════════════════════════════
 
-class SpiReader:
+class TkWakeup:
     """
-    Background thread that continuously polls the STM32 SPI slave.
-
-    Thread safety: `latest` and `stats` are protected by a lock.
-    The GUI thread calls get_snapshot() to read both atomically.
+    Wakes the Tk main loop from another thread.
+
+    notify() may be called from any thread; handler() runs on the
+    Tk thread.  Wake-ups coalesce: however many frames arrive
+    before Tk gets round to it, handler() runs once and reads the
+    latest state.  On POSIX a pipe registered with
+    createfilehandler() wakes Tk directly; where that is missing
+    (Windows) the pending flag is polled with after().
     """
 
-    def __init__(
-        self,
-        bus=SPI_BUS,
-        dev=SPI_DEV,
-        hz=SPI_SPEED_HZ,
-        mode=SPI_MODE,
-        simulate=False,
-    ):
-        self.bus = bus
-        self.dev = dev
-        self.hz = hz
-        self.mode = mode
-        self.simulate = simulate
-
-        self._spi = None
-        self._lock = threading.Lock()
-        self._running = False
-        self._thread = None
-
-        self.latest = None
-        self.stats = FrameStats()
-
-        # History ring buffers for charting
-        self.temp_history = deque(maxlen=CHART_POINTS)
-        self.gas_history  = deque(maxlen=CHART_POINTS)
-        self.time_history = deque(maxlen=CHART_POINTS)
-
-    # ── lifecycle ──────────────────────────────────────────
-
-    def start(self):
-        """Open SPI and start polling thread. Returns True on success."""
-        if self._running:
-            return True
-
-        if not self.simulate:
-            if not HAS_SPIDEV:
-                log.error("spidev module not installed. "
-                          "Install with: pip3 install spidev")
-                return False
+    def __init__(self, root, handler, fallback_ms=10):
+        self.root = root
+        self.handler = handler
+        self.fallback_ms = fallback_ms
+        self._pending = threading.Event()
+        self._rfd = self._wfd = None
+        try:
+            self._rfd, self._wfd = os.pipe()
+            os.set_blocking(self._rfd, False)
+            os.set_blocking(self._wfd, False)
+            root.tk.createfilehandler(self._rfd, tk.READABLE, self._on_readable)
+        except (AttributeError, OSError, tk.TclError):
+            self._close_fds()
+            self.root.after(self.fallback_ms, self._poll)
+
+    def notify(self):
+        if self._pending.is_set():
+            return
+        self._pending.set()
+        if self._wfd is not None:
             try:
-                self._spi = spidev.SpiDev()
-                self._spi.open(self.bus, self.dev)
-                self._spi.max_speed_hz = self.hz
-                self._spi.mode = self.mode
-                log.info("SPI%d.%d opened @ %d Hz, mode %d",
-                         self.bus, self.dev, self.hz, self.mode)
-            except (FileNotFoundError, PermissionError, OSError) as exc:
-                log.error("Cannot open SPI: %s", exc)
-                return False
-        else:
-            log.info("Running in SIMULATION mode (no real SPI)")
-
-        self._running = True
-        self._thread = threading.Thread(target=self._poll_loop,
-                                        daemon=True, name="spi-poll")
-        self._thread.start()
-        return True
+                os.write(self._wfd, b"\0")
+            except (BlockingIOError, OSError):
+                pass
 
-    def stop(self):
-        """Signal thread to stop and close SPI."""
-        self._running = False
-        if self._thread and self._thread.is_alive():
-            self._thread.join(timeout=0.5)
-        if self._spi:
+    def close(self):
+        if self._rfd is not None:
             try:
-                self._spi.close()
-            except Exception:
+                self.root.tk.deletefilehandler(self._rfd)
+            except (AttributeError, tk.TclError):
                 pass
-            self._spi = None
-        log.info("SPI reader stopped.")
+        self._close_fds()
 
-    # ── public getters (thread-safe) ──────────────────────
+    def _close_fds(self):
+        for fd in (self._rfd, self._wfd):
+            if fd is not None:
+                os.close(fd)
+        self._rfd = self._wfd = None
 
-    def get_snapshot(self):
-        """Return a consistent (frame, stats) pair."""
-        with self._lock:
-            return self.latest, FrameStats(**self.stats.__dict__)
+    def _on_readable(self, fd, _mask):
+        try:
+            os.read(fd, 512)
+        except BlockingIOError:
+            pass
+        self._fire()
 
-    def get_history(self):
-        """Return copies of chart history deques."""
-        with self._lock:
-            return (list(self.time_history),
-                    list(self.temp_history),
-                    list(self.gas_history))
+    def _poll(self):
+        if self._pending.is_set():
+            self._fire()
+        self.root.after(self.fallback_ms, self._poll)
 
-    # ── internal ─────────────────────────────────────────
+    def _fire(self):
+        # Clear first: a frame landing during handler() wakes us again
+        self._pending.clear()
+        self.handler()
 
-    def _poll_loop(self):
-        while self._running:
-            try:
-                raw = self._read_raw()
-                self._process(raw)
-            except Exception as exc:
-                log.warning("SPI read error: %s", exc)
-            time.sleep(POLL_INTERVAL_S)
-
-    def _read_raw(self):
-        if self.simulate:
-            return self._simulate_frame()
-        return self._spi.xfer2([0x00] * PACKET_LEN)
-
-    def _process(self, raw):
-        with self._lock:
-            self.stats.total_reads += 1
-
-            if len(raw) != PACKET_LEN:
-                self.stats.length_errors += 1
-                return
-
-            if raw[OFF_MAGIC0] != MAGIC_0 or raw[OFF_MAGIC1] != MAGIC_1 or raw[OFF_END] != END_MARKER:
-                self.stats.magic_errors += 1
-                return
-
-            if raw[OFF_XOR] != xor_checksum(raw):
-                self.stats.checksum_errors += 1
-                return
-
-            frame = parse_frame(raw)
-            if frame is None:
-                return
-
-            self.stats.valid_frames += 1
-
-            # Detect sequence gaps
-            if self.stats.last_seq >= 0:
-                expected = (self.stats.last_seq + 1) & 0xFF
-                if frame.seq != expected:
-                    self.stats.seq_gaps += 1
-            self.stats.last_seq = frame.seq
-
-            self.latest = frame
-
-            # Push to chart history
-            now = time.monotonic()
-            self.temp_history.append(frame.temp_c)
-            self.gas_history.append(frame.gas_raw)
-            self.time_history.append(now)
-
-    # ── simulation (for testing without hardware) ────────
-
-    _sim_seq = 0
-    _sim_t0 = time.monotonic()
-
-    def _simulate_frame(self):
-        """Generate a synthetic valid frame for UI development."""
-        import math
-        t = time.monotonic() - self._sim_t0
-
-        # Simulate temperature oscillating 25–55 °C
-        temp_c = 30.0 + 20.0 * math.sin(t * 0.1)
-        temp_x10 = int(temp_c * 10) & 0xFFFF
-
-        # Simulate gas oscillating 500–3000
-        gas = int(1500 + 1200 * math.sin(t * 0.07 + 1.0)) & 0xFFFF
-
-        adc0 = int(temp_x10 * 4095 / 3300) & 0xFFFF  # reverse LM35 calc
-        adc1 = gas
-        adc2 = int(2000 + 500 * math.sin(t * 0.05)) & 0xFFFF
-        adc3 = int(1000 + 800 * math.cos(t * 0.03)) & 0xFFFF
-
-        # Determine alarm status (bit positions from board.h §7)
-        status = 0
-        if temp_c >= TEMP_WARN_ON:
-            status |= (1 << STATUS_BIT_TEMP_ALARM)
-        if gas >= GAS_WARN_ON:
-            status |= (1 << STATUS_BIT_GAS_ALARM)
-        if temp_c >= TEMP_ALARM_ON or gas >= GAS_ALARM_ON:
-            status |= (1 << STATUS_BIT_BUZZER)
-        if temp_c >= TEMP_ALARM_ON:
-            status |= (1 << STATUS_BIT_MOTOR)
-
-        buf = [0] * PACKET_LEN
-        buf[OFF_MAGIC0] = MAGIC_0
-        buf[OFF_MAGIC1] = MAGIC_1
-        buf[OFF_SEQ]    = self._sim_seq & 0xFF
-        self._sim_seq  += 1
-        buf[OFF_STATUS] = status
-        buf[OFF_ADC0_L] = adc0 & 0xFF;        buf[OFF_ADC0_H] = (adc0 >> 8) & 0xFF
-        buf[OFF_ADC1_L] = adc1 & 0xFF;        buf[OFF_ADC1_H] = (adc1 >> 8) & 0xFF
-        buf[OFF_ADC2_L] = adc2 & 0xFF;        buf[OFF_ADC2_H] = (adc2 >> 8) & 0xFF
-        buf[OFF_ADC3_L] = adc3 & 0xFF;        buf[OFF_ADC3_H] = (adc3 >> 8) & 0xFF
-        buf[OFF_TEMP_L] = temp_x10 & 0xFF;    buf[OFF_TEMP_H] = (temp_x10 >> 8) & 0xFF
-        buf[OFF_XOR]    = xor_checksum(buf)
-        buf[OFF_END]    = END_MARKER
-        return buf
 
-# ════════════════════════════════════════════════════════════
-#  GUI — DASHBOARD
-# ════════════════════════════════════════════════════════════
+class UiProfiler:
+    """
+    Measures the UI thread (--ui-profile), logged every period_s:
+
+      handlers/s   update callbacks run (frame events or ticks)
+      CPU/handler  thread CPU inside each callback, mean and p99
+      configs      widget reconfigurations per callback
+      Tk idle      share of wall time the Tk thread spent idle
+                   (thread CPU incl. Tk redraws vs wall clock)
+    """
+
+    def __init__(self, period_s=5.0):
+        self.period_s = period_s
+        self._reset(time.monotonic())
+
+    def _reset(self, now):
+        self._t0 = now
+        self._thread_cpu0 = time.thread_time()
+        self._cpu = []
+        self._configs = 0
+
+    def begin(self):
+        self._c0 = time.thread_time()
+
+    def end(self, configs):
+        self._cpu.append(time.thread_time() - self._c0)
+        self._configs += configs
+        now = time.monotonic()
+        if now - self._t0 >= self.period_s:
+            self.report(now)
+
+    def report(self, now=None):
+        now = now or time.monotonic()
+        wall = now - self._t0
+        n = len(self._cpu)
+        if n == 0 or wall <= 0:
+            return
+        cpu = sorted(self._cpu)
+        busy = (time.thread_time() - self._thread_cpu0) / wall
+        log.info("UI: %.1f handlers/s, CPU/handler mean %.3f ms p99 %.3f ms, "
+                 "%.1f configs/handler, Tk idle %.1f%%",
+                 n / wall, sum(cpu) / n * 1000.0,
+                 cpu[min(n - 1, int(0.99 * n))] * 1000.0,
+                 self._configs / n, max(0.0, 100.0 * (1.0 - busy)))
+        self._reset(now)
+
 
 class GaugeCard(tk.Frame):
     """
@@ -500,9 +576,23 @@ class GaugeCard(tk.Frame):
             fg=CLR_NORMAL, bg=CLR_CARD, anchor="e")
         self.lbl_state.pack(fill="x", pady=(4, 0))
 
-    def update_value(self, value, state="NORMAL", fmt="{:.1f}"):
-        """Update displayed value, bar, and alarm colour."""
-        self.lbl_value.config(text=fmt.format(value))
+        self._shown = None      # (text, state, ratio) on screen
+
+    def update_value(self, value, state="NORMAL", fmt="{:.1f}", force=False):
+        """
+        Update displayed value, bar, and alarm colour.
+        Returns the number of widgets reconfigured (0 if the text,
+        state and bar width are what is already on screen).
+        """
+        text = fmt.format(value)
+        # Bar fill (clamped 0..1), quantised to 0.5 % steps
+        ratio = max(0.0, min(1.0, value / self.max_value)) if self.max_value else 0
+        ratio = round(ratio * 200) / 200
+        shown = (text, state, ratio)
+        if shown == self._shown and not force:
+            return 0
+        changed = self._shown or (None, None, None)
+        self._shown = shown
 
         colour = {
             "NORMAL": CLR_NORMAL,
@@ -510,13 +600,19 @@ class GaugeCard(tk.Frame):
             "ALARM":  CLR_ALARM,
         }.get(state, CLR_NORMAL)
 
-        self.lbl_value.config(fg=colour)
-        self.lbl_state.config(text=state, fg=colour)
-
-        # Bar fill (clamped 0..1)
-        ratio = max(0.0, min(1.0, value / self.max_value)) if self.max_value else 0
-        self.bar_fill.config(bg=colour)
-        self.bar_fill.place(x=0, y=0, relheight=1.0, relwidth=ratio)
+        n = 0
+        if force or state != changed[1]:
+            self.lbl_value.config(text=text, fg=colour)
+            self.lbl_state.config(text=state, fg=colour)
+            self.bar_fill.config(bg=colour)
+            n = 3
+        elif text != changed[0]:
+            self.lbl_value.config(text=text)
+            n = 1
+        if force or ratio != changed[2]:
+            self.bar_fill.place(x=0, y=0, relheight=1.0, relwidth=ratio)
+            n += 1
+        return n
 
 
 class IndicatorDot(tk.Frame):
@@ -535,17 +631,36 @@ class IndicatorDot(tk.Frame):
         self.lbl = tk.Label(self, text=label, font=("Segoe UI", 11),
                             fg=CLR_TEXT, bg=CLR_CARD)
         self.lbl.pack(side="left")
-
-    def set_on(self, on):
+        self._on = False
+
+    def set_on(self, on, force=False):
+        """Returns 1 if the dot was redrawn, 0 if already in that state."""
+        on = bool(on)
+        if on == self._on and not force:
+            return 0
+        self._on = on
         colour = self.on_colour if on else CLR_OFF
         self.dot.itemconfig(self._oval, fill=colour)
+        return 1
 
 
 class DashboardApp:
     """Main application: assembles all widgets and runs the update loop."""
 
-    def __init__(self, reader):
+    def __init__(self, reader, poller=None, ui_mode="event", profile=False):
+        # With a MultiSpiPoller, `reader` is the node on screen and
+        # the poller owns the bus; otherwise the reader runs alone.
         self.reader = reader
+        self.poller = poller
+        self.source = poller if poller is not None else reader
+        self.ui_mode = ui_mode
+        self.profiler = UiProfiler() if profile else None
+        self.render_hist = LatencyHist()    # receive → widgets updated
+        self._rendered = None
+        self._wakeup = None
+        self._shown = {}            # widget → last config(**kw)
+        self._configs = 0           # widget reconfigurations (profiler)
+        self._chart_last = None
         self.root = tk.Tk()
         self.root.title("Smart Greenhouse — Fire Alarm Dashboard")
         self.root.configure(bg=CLR_BG)
@@ -570,6 +685,14 @@ class DashboardApp:
             fg=CLR_NORMAL, bg=CLR_BG)
         self.lbl_conn.pack(side="right")
 
+        if self.poller is not None:
+            self.var_node = tk.StringVar(value=self.reader.name)
+            sel = ttk.Combobox(hdr, textvariable=self.var_node, width=12,
+                               state="readonly",
+                               values=[n.name for n in self.poller.nodes])
+            sel.pack(side="right", padx=(0, 12))
+            sel.bind("<<ComboboxSelected>>", self._on_node_selected)
+
         # ── Top row: gauges ──
         row1 = tk.Frame(self.root, bg=CLR_BG)
         row1.pack(fill="x", padx=16, pady=(12, 0))
@@ -599,12 +722,9 @@ class DashboardApp:
                  fg=CLR_DIM, bg=CLR_CARD, anchor="w").pack(fill="x")
 
         self.lbl_adc = []
-        adc_labels = [
-            "CH0 - LM35 (Temperature)",
-            "CH1 - MQ-2 (Gas)",
-            "CH2 - Soil Moisture",
-            "CH3 - Light Level",
-        ]
+        adc_labels = [ADC_CHANNEL_LABELS[i] if i < len(ADC_CHANNEL_LABELS)
+                      else f"CH{i}"
+                      for i in range(self._max_channels())]
         for i, name in enumerate(adc_labels):
             frm = tk.Frame(adc_card, bg=CLR_CARD)
             frm.pack(fill="x", pady=2)
@@ -641,6 +761,14 @@ class DashboardApp:
                                             on_colour=CLR_ALARM)
         self.ind_temp_alarm.pack(fill="x", pady=3)
 
+        self.ind_trend = IndicatorDot(act_card, "Rising Trend",
+                                       on_colour=CLR_WARN)
+        self.ind_trend.pack(fill="x", pady=3)
+
+        self.ind_emerg = IndicatorDot(act_card, "Emergency (AWD)",
+                                      on_colour=CLR_ALARM)
+        self.ind_emerg.pack(fill="x", pady=3)
+
         # Sequence / overall state
         self.lbl_overall = tk.Label(
             act_card, text="STATE: NORMAL", font=("Segoe UI", 13, "bold"),
@@ -694,66 +822,208 @@ class DashboardApp:
             fg=CLR_WARN, bg=CLR_BG, anchor="e")
         self.lbl_sim.pack(side="right")
 
-    # ── periodic UI update ───────────────────────────────
+        # Multi-node: one-line health summary of every node
+        self.lbl_nodes = None
+        if self.poller is not None:
+            self.lbl_nodes = tk.Label(
+                self.root, text="", font=("Consolas", 9),
+                fg=CLR_DIM, bg=CLR_BG, anchor="w")
+            self.lbl_nodes.pack(fill="x", padx=16, pady=(0, 8))
+
+    def _max_channels(self):
+        if self.poller is None:
+            return self.reader.n_ch
+        return max(n.n_ch for n in self.poller.nodes)
+
+    def _on_node_selected(self, _event=None):
+        name = self.var_node.get()
+        for node in self.poller.nodes:
+            if node.name == name:
+                self.reader = node
+        for lbl in self.lbl_adc[self.reader.n_ch:]:
+            self._set(lbl, text="----")
+        self._render_latest(force=True)
+
+    # ── update pipeline ──────────────────────────────────
+    #
+    #  event: the reader publishes each new frame; TkWakeup wakes
+    #         the main loop once per burst and only widgets whose
+    #         value changed are reconfigured.  Slow timers cover
+    #         the stale-data check, footers and the chart.
+    #  tick : legacy fixed UI_REFRESH_MS tick that reconfigures
+    #         every widget (kept for --ui-profile comparison).
+
+    def _start_updates(self):
+        if self.ui_mode == "tick":
+            self._schedule_update()
+            return
+        self._wakeup = TkWakeup(self.root, self._on_frame_event)
+        for node in (self.poller.nodes if self.poller else [self.reader]):
+            node.subscribe(self._on_new_frame)
+        self.root.after(STALE_CHECK_MS, self._slow_tick)
+        if self.fig is not None:
+            self.root.after(UI_REFRESH_MS, self._chart_tick)
+
+    def _on_new_frame(self, node, _row):
+        # Reader thread: only wake Tk for the node on screen
+        if node is self.reader:
+            self._wakeup.notify()
+
+    def _on_frame_event(self):
+        self._profiled(self._render_latest, force=False)
+
+    def _slow_tick(self):
+        frame, stats = self.reader.get_snapshot()
+        stale = frame is None or \
+            time.monotonic() - frame.timestamp > STALE_CHECK_MS / 1000.0
+        if stale:
+            self._set(self.lbl_conn,
+                      text="WAITING FOR DATA" if frame is None else "NO NEW DATA",
+                      fg=CLR_WARN)
+        self._update_footer(frame, stats)
+        self.root.after(STALE_CHECK_MS, self._slow_tick)
+
+    def _chart_tick(self):
+        last = self.reader.frames.count
+        if last != self._chart_last:
+            self._chart_last = last
+            self._profiled(self._update_chart)
+        self.root.after(UI_REFRESH_MS, self._chart_tick)
 
     def _schedule_update(self):
         self.root.after(UI_REFRESH_MS, self._ui_tick)
 
     def _ui_tick(self):
+        self._profiled(self._render_latest, force=True)
+        if self.fig is not None:
+            self._profiled(self._update_chart)
+        self._schedule_update()
+
+    def _profiled(self, fn, **kw):
+        if self.profiler is None:
+            fn(**kw)
+            return
+        self.profiler.begin()
+        fn(**kw)
+        self.profiler.end(self._configs)
+        self._configs = 0
+
+    def _set(self, widget, force=False, **kw):
+        """widget.config(**kw) unless it already shows exactly that."""
+        if not force and self._shown.get(widget) == kw:
+            return
+        self._shown[widget] = kw
+        widget.config(**kw)
+        self._configs += 1
+
+    def _render_latest(self, force=False):
         frame, stats = self.reader.get_snapshot()
 
         if frame is None:
             # No data yet
-            self.lbl_conn.config(text="WAITING FOR DATA", fg=CLR_WARN)
-            self._schedule_update()
+            self._set(self.lbl_conn, force, text="WAITING FOR DATA", fg=CLR_WARN)
             return
 
-        self.lbl_conn.config(text="CONNECTED", fg=CLR_NORMAL)
+        self._set(self.lbl_conn, force, text="CONNECTED", fg=CLR_NORMAL)
 
         # Temperature gauge
         temp_state = frame.alarm_level_temp()
-        self.gauge_temp.update_value(frame.temp_c, temp_state, fmt="{:.1f}")
+        self._configs += self.gauge_temp.update_value(
+            frame.temp_c, temp_state, fmt="{:.1f}", force=force)
 
         # Gas gauge
         gas_state = frame.alarm_level_gas()
-        self.gauge_gas.update_value(frame.gas_raw, gas_state, fmt="{:.0f}")
-
-        # ADC raw values
-        for i in range(4):
-            self.lbl_adc[i].config(text=f"{frame.adc[i]:>5d}")
+        self._configs += self.gauge_gas.update_value(
+            frame.gas_raw, gas_state, fmt="{:.0f}", force=force)
+
+        # ADC raw values + calibrated value (+ raw window range, σ;
+        # mains hum amplitude and noise floor, LSB)
+        for i, (value, eng) in enumerate(zip(frame.adc, frame.eng)):
+            text = f"{value:>5d}  {eng:>7.1f} {cal_unit(i)}"
+            if frame.noise:
+                z = frame.noise[i]
+                text = f"hum{z.hum_amp:>5.1f} nf{z.floor:>4.1f}  " + text
+            if frame.wstat:
+                w = frame.wstat[i]
+                text = f"{w.min:>4d}–{w.max:<4d} σ{w.std:>5.1f}  " + text
+            self._set(self.lbl_adc[i], force, text=text)
 
         # Actuator indicators
-        self.ind_buzzer.set_on(frame.buzzer)
-        self.ind_motor.set_on(frame.motor)
-        self.ind_gas_alarm.set_on(frame.gas_alarm)
-        self.ind_temp_alarm.set_on(frame.temp_alarm)
+        self._configs += self.ind_buzzer.set_on(frame.buzzer, force)
+        self._configs += self.ind_motor.set_on(frame.motor, force)
+        self._configs += self.ind_gas_alarm.set_on(frame.gas_alarm, force)
+        self._configs += self.ind_temp_alarm.set_on(frame.temp_alarm, force)
+        self._configs += self.ind_trend.set_on(frame.trend, force)
+        self._configs += self.ind_emerg.set_on(frame.emergency, force)
 
         # Overall state
-        if frame.temp_alarm or frame.gas_alarm:
+        if frame.emergency:
+            self._set(self.lbl_overall, force, text="STATE: EMERGENCY",
+                      fg=CLR_ALARM)
+        elif frame.temp_alarm or frame.gas_alarm:
             # Check which is worse using thresholds
             worst = "WARN"
             if frame.temp_c >= TEMP_ALARM_ON or frame.gas_raw >= GAS_ALARM_ON:
                 worst = "ALARM"
             colour = CLR_ALARM if worst == "ALARM" else CLR_WARN
-            self.lbl_overall.config(text=f"STATE: {worst}", fg=colour)
+            self._set(self.lbl_overall, force, text=f"STATE: {worst}", fg=colour)
         else:
-            self.lbl_overall.config(text="STATE: NORMAL", fg=CLR_NORMAL)
-
-        # Stats footer
-        self.lbl_stats.config(
-            text=(f"Frames: {stats.valid_frames}  |  "
-                  f"Errors: {stats.error_total} ({stats.error_rate_pct:.1f}%)  |  "
-                  f"SEQ gaps: {stats.seq_gaps}  |  "
-                  f"SEQ: {frame.seq}"))
-
-        # Chart
-        if self.fig is not None:
-            self._update_chart()
-
-        self._schedule_update()
+            self._set(self.lbl_overall, force, text="STATE: NORMAL", fg=CLR_NORMAL)
+
+        self._update_footer(frame, stats, force)
+
+        # Receive → render, once per frame (Tk repaints when idle)
+        if frame is not self._rendered:
+            self._rendered = frame
+            self.render_hist.add(time.monotonic() - frame.timestamp)
+
+    def _update_footer(self, frame, stats, force=False):
+        text = (f"Frames: {stats.valid_frames}  |  "
+                f"Errors: {stats.error_total} ({stats.error_rate_pct:.1f}%)  |  "
+                f"SEQ gaps: {stats.seq_gaps}")
+        if frame is not None:
+            text += f"  |  SEQ: {frame.seq}"
+        if self.reader.stream:
+            text += (f"  |  Stream: {stats.stream_samples} samples, "
+                     f"{stats.bytes_per_sample:.2f} B/sample")
+        else:
+            text += (f"  |  Lost: {stats.frames_lost} frames, "
+                     f"{stats.scans_lost} scans "
+                     f"({stats.scans_lost_pct:.1f}%)")
+        if self.reader.sync is not None:
+            text += f"  |  Resynced: {stats.resynced}"
+        if stats.win_frames:
+            text += (f"  |  Window: {stats.scans_per_read:.0f} scans/read, "
+                     f"{stats.win_crossings} crossings")
+        if self.reader.drdy is not None:
+            text += (f"  |  DRDY: {stats.drdy_edges} edges, "
+                     f"{stats.drdy_timeouts} timeouts")
+        if isinstance(self.reader, RemoteReader):
+            text += f"  |  Dropped: {self.reader.dropped}"
+        if stats.pub_period_ms:
+            text += (f"  |  Poll: {stats.poll_period_ms:.1f} ms "
+                     f"(publish {stats.pub_period_ms:.1f} ms)")
+        age, ui = self.reader.age_hist, self.render_hist
+        if age.count:
+            text += (f"  |  Age p50/p99: {age.percentile(50) * 1e3:.1f}/"
+                     f"{age.percentile(99) * 1e3:.1f} ms")
+        if ui.count:
+            text += (f"  |  Render p50/p99: {ui.percentile(50) * 1e3:.1f}/"
+                     f"{ui.percentile(99) * 1e3:.1f} ms")
+        self._set(self.lbl_stats, force, text=text)
+
+        if self.lbl_nodes is not None:
+            parts = []
+            for node in self.poller.nodes:
+                _, st = node.get_snapshot()
+                parts.append(f"{node.name}: {st.valid_frames} ok "
+                             f"{st.error_total} err "
+                             f"{st.deadline_misses} miss "
+                             f"{st.frames_lost} lost")
+            self._set(self.lbl_nodes, force, text="  |  ".join(parts))
 
     def _update_chart(self):
-        times, temps, gases = self.reader.get_history()
+        times, temps, gases = self.reader.get_history(CHART_POINTS)
         if len(times) < 2:
             return
 
@@ -795,15 +1065,26 @@ class DashboardApp:
     # ── lifecycle ────────────────────────────────────────
 
     def _on_close(self):
-        self.reader.stop()
+        log.info("Latency %s: sample->receive %s; receive->render %s; "
+                 "clock skew %.0f ppm", self.reader.name,
+                 self.reader.age_hist.summary(), self.render_hist.summary(),
+                 self.reader.clock.skew_ppm)
+        self.source.stop()
+        if self._wakeup is not None:
+            self._wakeup.close()
         self.root.destroy()
 
     def run(self):
         """Start the reader and enter Tkinter mainloop."""
-        if self.reader.simulate:
+        if isinstance(self.reader, RemoteReader):
+            # Client mode: another process owns the bus
+            self.lbl_sim.config(
+                text=f"CLIENT of {self.source.remote}"
+                     + (" - simulated" if self.source.simulate else ""))
+        elif self.source.simulate:
             self.lbl_sim.config(text="SIMULATION MODE - no real SPI")
 
-        if not self.reader.start():
+        if not self.source.start():
             messagebox.showerror(
                 "SPI Error",
                 "Cannot open SPI device.\n\n"
@@ -811,11 +1092,11 @@ class DashboardApp:
                 "- Device exists?   ls /dev/spidev0.*\n"
                 "- Permission?      sudo usermod -aG spi $USER\n\n"
                 "Starting in SIMULATION mode instead.")
-            self.reader.simulate = True
-            self.reader.start()
+            self.source.simulate = True
+            self.source.start()
             self.lbl_sim.config(text="SIMULATION MODE - no real SPI")
 
-        self._schedule_update()
+        self._start_updates()
         self.root.mainloop()
 
 
@@ -836,16 +1117,353 @@ def main():
                         help=f"SPI device number (default: {SPI_DEV})")
     parser.add_argument("--speed", type=int, default=SPI_SPEED_HZ,
                         help=f"SPI clock speed Hz (default: {SPI_SPEED_HZ})")
+    parser.add_argument("--channels", type=int, default=ADC_NUM_CHANNELS,
+                        choices=range(1, ADC_MAX_CHANNELS + 1),
+                        metavar="N",
+                        help="ADC channels in the frame, must match "
+                             f"ADC_NUM_CHANNELS in board.h "
+                             f"(default: {ADC_NUM_CHANNELS})")
+    parser.add_argument("--stream", action="store_true",
+                        help="Read compressed stream blocks "
+                             "(firmware built with STREAM_ENABLE = 1)")
+    parser.add_argument("--resync", action="store_true",
+                        help="Read 2 x PACKET_LEN - 1 bytes per poll and "
+                             "recover the frame at any offset (snapshot "
+                             "frames only)")
+    parser.add_argument("--wstat", action="store_true",
+                        help="Firmware built with WSTAT_ENABLE: decode the "
+                             "per-read window statistics block")
+    parser.add_argument("--noise", action="store_true",
+                        help="Firmware built with MAINS_ENABLE = 1: decode "
+                             "the NOISE block (board.h §7)")
+    parser.add_argument("--drdy", nargs="?", metavar="[CHIP:]LINE",
+                        const=f"{DRDY_CHIP}:{DRDY_LINE}",
+                        help="Read on rising edges of the STM32 DRDY line "
+                             "(board.h §10) instead of every 20 ms; "
+                             f"default {DRDY_CHIP}:{DRDY_LINE}.  With --hil or "
+                             "--simulate a mock line is used")
+    parser.add_argument("--adaptive-poll", nargs="?", metavar="MIN_MS:MAX_MS",
+                        const=f"{ADAPT_MIN_MS}:{ADAPT_MAX_MS}",
+                        help="Adapt the poll period to the firmware's "
+                             "publication rate (SEQ repeats / gaps), poll at "
+                             "MIN_MS while a STATUS alarm bit is set; "
+                             f"default {ADAPT_MIN_MS}:{ADAPT_MAX_MS}")
+    parser.add_argument("--adapt-bench", type=float, metavar="SECONDS",
+                        help="HIL: fixed vs adaptive poll period at several "
+                             "publication rates, then exit")
+    parser.add_argument("--node", action="append", default=[],
+                        metavar="NAME=BUS.DEV[@GPIO][,HZ]",
+                        help="Poll several STM32 nodes from one thread "
+                             "(repeat per node; overrides --bus/--dev)")
+    parser.add_argument("--bench-multi", type=int, metavar="N",
+                        help="Run the simulated N-node poller benchmark "
+                             "and exit")
+    parser.add_argument("--bench-split", action="store_true",
+                        help="Poll jitter under a UI-like GIL load, poller "
+                             "in-process vs --poller-process, then exit")
+    parser.add_argument("--bench-seconds", type=float, default=5.0,
+                        help="Benchmark duration (default: 5)")
+    parser.add_argument("--ui-mode", choices=("event", "tick"),
+                        default="event",
+                        help="event: redraw changed widgets on new frames "
+                             "(default); tick: legacy fixed-rate full redraw")
+    parser.add_argument("--ui-profile", action="store_true",
+                        help="Log UI CPU per update and Tk idle time "
+                             "every 5 s")
+    parser.add_argument("--headless", action="store_true",
+                        help="No window: export Prometheus metrics over "
+                             "HTTP instead")
+    parser.add_argument("--metrics-host", default=METRICS_HOST,
+                        help=f"Metrics bind address (default: {METRICS_HOST})")
+    parser.add_argument("--metrics-port", type=int, default=METRICS_PORT,
+                        help=f"Metrics HTTP port (default: {METRICS_PORT})")
+    parser.add_argument("--poller-process", action="store_true",
+                        help="Poll SPI in a child process that writes a "
+                             "shared-memory ring; this process only "
+                             "renders / exports (snapshot frames)")
+    parser.add_argument("--shm-serve", metavar="NAME",
+                        help="Be that poller: poll with the other options "
+                             "and publish into ring NAME, no window")
+    parser.add_argument("--shm-attach", metavar="NAME",
+                        help="No SPI: show or --headless export the nodes "
+                             "of the running poller's ring NAME")
+    parser.add_argument("--serve", nargs="?", metavar="PATH",
+                        const=SOCK_PATH,
+                        help="Frame daemon: poll with the other options "
+                             "and publish to any number of clients on Unix "
+                             f"socket PATH (default {SOCK_PATH}), no window")
+    parser.add_argument("--connect", nargs="?", metavar="PATH",
+                        const=SOCK_PATH,
+                        help="Client mode: no SPI, show or --headless "
+                             "export the nodes of the daemon on PATH")
+    parser.add_argument("--bench-fanout", type=int, metavar="N",
+                        help="Simulated daemon with N clients and one "
+                             "stalled client, then exit")
+    parser.add_argument("--hil", action="store_true",
+                        help="Virtual STM32: real firmware logic compiled "
+                             "for this host instead of spidev")
+    parser.add_argument("--hil-script", metavar="FILE",
+                        help="Sensor waveform keyframes "
+                             "(t_s temp_c gas_raw [ch2 ...])")
+    parser.add_argument("--hil-speed", type=float, default=1.0,
+                        help="Virtual time per wall-clock second "
+                             "(default: 1.0)")
+    parser.add_argument("--hil-wire", action="store_true",
+                        help="Byte-accurate SPI timing (ISRs between bytes, "
+                             "DR latch lag)")
+    parser.add_argument("--hil-bench", type=float, metavar="SECONDS",
+                        help="HIL throughput + alarm latency benchmark, "
+                             "then exit")
+    parser.add_argument("--est-bench", action="store_true",
+                        help="Step/ramp response: moving average vs Kalman "
+                             "estimator (firmware code via HIL), then exit")
+    parser.add_argument("--capture", metavar="FILE.csv",
+                        help="Waveform capture (firmware CAP_ENABLE): arm, "
+                             "wait for the trigger, fetch the raw record, "
+                             "write CSV (+ PNG with matplotlib), then exit")
+    parser.add_argument("--cap-pre", type=int, metavar="SCANS",
+                        help="Pre-trigger scans (default: a quarter of the "
+                             "record)")
+    parser.add_argument("--cap-level", metavar="CH:LEVEL[:fall]",
+                        help="Trigger when raw channel CH rises to LEVEL "
+                             "(or falls to it with :fall); default: trigger "
+                             "by command once the pre-trigger is recorded")
+    parser.add_argument("--cap-timeout", type=float, default=60.0,
+                        help="Seconds to wait for the trigger (default: 60)")
+    parser.add_argument("--gen-cal-lut", action="store_true",
+                        help="Write STM32_keli_pack/cal_lut.c/.h from "
+                             "CAL_CHANNELS for --channels N, then exit")
+    parser.add_argument("--gen-frame-pack", action="store_true",
+                        help="Write STM32_keli_pack/frame_pack.h from "
+                             "FRAME_SCHEMA for --channels N, then exit")
+    parser.add_argument("--check-protocol", action="store_true",
+                        help="Randomised FRAME_SCHEMA round trip: Python "
+                             "codec for every N, generated C packer via "
+                             "HIL, then exit")
     args = parser.parse_args()
 
+    if (not args.headless and not args.bench_multi and not args.capture
+            and not args.shm_serve and not args.serve
+            and not args.bench_split and not args.bench_fanout
+            and not HAS_TK):
+        parser.error("tkinter is not installed (python3-tk); "
+                     "use --headless")
+
+    if args.est_bench:
+        print_est_bench(est_bench())
+        return
+
+    if args.gen_cal_lut:
+        crc = write_cal_lut(args.channels)
+        print(f"cal_lut: {args.channels} channels, CRC32 0x{crc:08X}")
+        return
+    if args.gen_frame_pack:
+        crc = write_frame_pack(args.channels)
+        print(f"frame_pack: {args.channels} channels, schema CRC32 "
+              f"0x{crc:08X}")
+        return
+    check_cal_lut(args.channels)
+    check_frame_pack(args.channels)
+
+    if args.check_protocol:
+        r = check_protocol()
+        ok, tried = r["python"]
+        print(f"protocol, Python codec: {ok}/{tried} random frames "
+              f"round-tripped (N = 1..{ADC_MAX_CHANNELS}, all block sets)")
+        if "c" in r:
+            ok, tried, n_ch, blocks = r["c"]
+            print(f"protocol, C Frame_Pack: {ok}/{tried} random frames "
+                  f"decoded and re-packed byte-exact (N = {n_ch}"
+                  + "".join(f", {b.upper()}" for b in blocks) + ")")
+        if any(v[0] != v[1] for v in r.values()):
+            sys.exit(1)
+        return
+
+    if args.bench_multi:
+        print_bench_multi(bench_multi(args.bench_multi, args.bench_seconds,
+                                      n_ch=args.channels))
+        return
+    if args.bench_split:
+        print_bench_split(bench_split(args.bench_seconds, args.channels))
+        return
+    if args.bench_fanout:
+        bench_fanout(args.bench_fanout, args.bench_seconds, args.channels)
+        return
+
+    adapt = None
+    if args.adaptive_poll:
+        try:
+            adapt = parse_adapt_spec(args.adaptive_poll)
+        except ValueError as exc:
+            parser.error(str(exc))
+        if args.drdy is not None:
+            parser.error("--adaptive-poll: --drdy already reads once per "
+                         "publication")
+    if args.adapt_bench:
+        adapt_bench(args.adapt_bench, adapt=adapt or (ADAPT_MIN_MS / 1e3,
+                                                      ADAPT_MAX_MS / 1e3))
+        return
+
+    model = HIL_SPI_WIRE if args.hil_wire else HIL_SPI_IDEAL
+    if args.hil_bench:
+        hil_bench(args.hil_bench, model, resync=args.resync,
+                  speed=args.hil_speed, drdy=args.drdy is not None)
+        return
+
+    if sum(map(bool, (args.poller_process, args.shm_serve,
+                      args.shm_attach, args.serve, args.connect))) > 1:
+        parser.error("--poller-process, --shm-serve, --shm-attach, "
+                     "--serve and --connect are exclusive")
+    if ((args.poller_process or args.shm_serve or args.shm_attach
+            or args.serve or args.connect)
+            and (args.stream or args.capture)):
+        parser.error("the ring and the daemon carry snapshot frames "
+                     "(not --stream or --capture)")
+    if args.connect:
+        try:
+            client = FrameClient(args.connect)
+        except (OSError, ValueError, struct.error) as exc:
+            parser.error(f"--connect {args.connect}: {exc}")
+        if args.headless:
+            sys.exit(run_headless(client, client.nodes, args.metrics_host,
+                                  args.metrics_port))
+        multi = client if len(client.nodes) > 1 else None
+        app = DashboardApp(client.nodes[0], multi, ui_mode=args.ui_mode,
+                           profile=args.ui_profile)
+        app.run()
+        return
+    if args.poller_process or args.shm_attach:
+        proc, name = None, args.shm_attach
+        if args.poller_process:
+            name = f"greenhouse-{os.getpid()}"
+            proc = spawn_poller([a for a in sys.argv[1:]
+                                 if a != "--poller-process"], name)
+        try:
+            client = ShmRingClient(name, SHM_ATTACH_S if proc else 0.0, proc)
+        except (OSError, RuntimeError, ValueError) as exc:
+            if proc is not None:
+                proc.kill()
+            parser.error(f"shared memory: {exc}")
+        if args.headless:
+            sys.exit(run_headless(client, client.nodes, args.metrics_host,
+                                  args.metrics_port))
+        multi = client if len(client.nodes) > 1 else None
+        app = DashboardApp(client.nodes[0], multi, ui_mode=args.ui_mode,
+                           profile=args.ui_profile)
+        app.run()
+        return
+
+    spi_factory = None
+    drdy = None
+    if args.drdy is not None and args.node:
+        parser.error("--drdy serves a single node (not --node)")
+    if args.hil:
+        try:
+            lib_path = build_hil_library()
+        except (RuntimeError, OSError) as exc:
+            parser.error(str(exc))
+        hil_ch, hil_stream, hil_wstat, hil_noise = hil_firmware_info(lib_path)
+        if (hil_ch, hil_stream, hil_wstat, hil_noise) != (
+                args.channels, args.stream, args.wstat, args.noise):
+            log.info("HIL firmware: %d channels, stream %s, wstat %s, "
+                     "noise %s (from board.h)", hil_ch,
+                     "on" if hil_stream else "off",
+                     "on" if hil_wstat else "off",
+                     "on" if hil_noise else "off")
+        args.channels, args.stream, args.simulate = hil_ch, hil_stream, False
+        args.wstat, args.noise = hil_wstat, hil_noise
+        scenario = (HilScenario.from_file(args.hil_script)
+                    if args.hil_script else None)
+
+        hil_devs = []
+
+        def hil_factory():
+            hil_devs.append(HilSpiDev(lib_path, scenario, args.hil_speed, model))
+            return hil_devs[-1]
+        spi_factory = hil_factory
+        if args.drdy is not None:
+            drdy = MockDrdyLine(lambda: hil_devs[-1].drdy_level())
+    elif args.drdy is not None and args.simulate:
+        # Square wave: one rising edge per DRDY_PERIOD_S
+        drdy = MockDrdyLine(
+            lambda: time.monotonic() % DRDY_PERIOD_S < DRDY_PERIOD_S / 2)
+    elif args.drdy is not None:
+        try:
+            drdy = DrdyLine.open_chip(*parse_drdy_spec(args.drdy))
+        except (ValueError, OSError) as exc:
+            parser.error(f"--drdy: {exc}")
+
+    if args.capture:
+        if args.node or args.simulate:
+            parser.error("--capture needs one real SPI node or --hil")
+        try:
+            level = parse_cap_level(args.cap_level) if args.cap_level else None
+        except ValueError as exc:
+            parser.error(f"--cap-level: {exc}")
+        if spi_factory is None:
+            if not HAS_SPIDEV:
+                parser.error("spidev module not installed")
+            spi = spidev.SpiDev()
+        else:
+            spi = spi_factory()
+        spi.open(args.bus, args.dev)
+        spi.max_speed_hz = args.speed
+        spi.mode = SPI_MODE
+        try:
+            rc = run_capture(spi, args.capture, args.channels, args.speed,
+                             args.cap_pre, level, args.cap_timeout, drdy)
+        finally:
+            spi.close()
+        sys.exit(rc)
+
+    if args.node:
+        try:
+            specs = [parse_node_spec(spec) for spec in args.node]
+        except ValueError as exc:
+            parser.error(str(exc))
+        nodes = [SpiReader(hz=args.speed, simulate=args.simulate,
+                           n_ch=args.channels, stream=args.stream,
+                           resync=args.resync, wstat=args.wstat,
+                           noise=args.noise, adapt=adapt, **spec)
+                 for spec in specs]
+        poller = MultiSpiPoller(nodes, simulate=args.simulate,
+                                spi_factory=spi_factory)
+        if args.shm_serve:
+            sys.exit(run_shm_poller(poller, nodes, args.shm_serve))
+        if args.serve:
+            sys.exit(run_frame_daemon(poller, nodes, args.serve))
+        if args.headless:
+            sys.exit(run_headless(poller, nodes, args.metrics_host,
+                                  args.metrics_port))
+        app = DashboardApp(nodes[0], poller, ui_mode=args.ui_mode,
+                           profile=args.ui_profile)
+        app.run()
+        return
+
     reader = SpiReader(
         bus=args.bus,
         dev=args.dev,
         hz=args.speed,
         simulate=args.simulate,
+        n_ch=args.channels,
+        stream=args.stream,
+        spi_factory=spi_factory,
+        resync=args.resync,
+        wstat=args.wstat,
+        drdy=drdy,
+        noise=args.noise,
+        adapt=adapt,
     )
 
-    app = DashboardApp(reader)
+    if args.shm_serve:
+        sys.exit(run_shm_poller(reader, [reader], args.shm_serve))
+    if args.serve:
+        sys.exit(run_frame_daemon(reader, [reader], args.serve))
+    if args.headless:
+        sys.exit(run_headless(reader, [reader], args.metrics_host,
+                              args.metrics_port))
+
+    app = DashboardApp(reader, ui_mode=args.ui_mode, profile=args.ui_profile)
     app.run()
 
 
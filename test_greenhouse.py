@@ -0,0 +1,185 @@
+#!/usr/bin/env python3
+"""
+Greenhouse self-checks — Pi side, no Tk, no SPI hardware
+═════════════════════════════════════════════════════════
+    python3 test_greenhouse.py           # every check
+    python3 test_greenhouse.py codec     # checks whose name contains "codec"
+
+Exit status 1 if any check fails.  Each test_* is a plain function
+that asserts, so pytest collects the same file; checks that need a
+host C compiler (HIL library) skip without one.
+"""
+
+from __future__ import annotations
+
+import os
+import sys
+import time
+import random
+import shutil
+import functools
+import filecmp
+import tempfile
+import traceback
+import unittest
+
+import greenhouse_protocol as proto
+import greenhouse_reader as reader
+import greenhouse_hil as hil
+import greenhouse_ipc as ipc
+
+
+# ════════════════════════════════════════════════════════════
+#  PROTOCOL (greenhouse_protocol.py)
+# ════════════════════════════════════════════════════════════
+
+def test_codec_round_trip():
+    """Every N and block set: pack → validate → unpack → FrameColumns."""
+    ok, tried = proto.check_codec(trials=2000)
+    assert ok == tried, f"{tried - ok} of {tried} frames did not round-trip"
+
+
+def test_stream_round_trip():
+    """Rice block: smooth scans, full-scale jumps (escapes), N = 1..16."""
+    rng = random.Random(1)
+    for n_ch in (1, 4, proto.ADC_MAX_CHANNELS):
+        v = [rng.randrange(4096) for _ in range(n_ch)]
+        scans = []
+        for k in range(proto.STREAM_BLOCK_SCANS):
+            jump = k % 17 == 0
+            v = [rng.randrange(4096) if jump
+                 else min(4095, max(0, x + rng.randint(-6, 6))) for x in v]
+            scans.append(tuple(v))
+        raw = proto.build_stream_packet(7, 0x05, scans, 251, ts_us=123456)
+        body = len(raw) - proto.STREAM_HDR_LEN - 2
+        assert body <= proto.stream_body_max_len(n_ch, len(scans)), n_ch
+        out = proto.parse_stream_packet(raw, n_ch)
+        assert out is not None, n_ch
+        frame, cols = out
+        assert [tuple(c) for c in zip(*cols)] == scans, n_ch
+        assert (frame.seq, frame.status, frame.temp_x10, frame.ts_us,
+                frame.adc) == (7, 0x05, 251, 123456, scans[-1]), n_ch
+        raw[-2] ^= 0x01
+        assert proto.parse_stream_packet(raw, n_ch) is None, n_ch
+
+
+def test_generated_sources_current():
+    """cal_lut.c/.h and frame_pack.h match what the schema generates."""
+    n_ch = proto.ADC_NUM_CHANNELS
+    with tempfile.TemporaryDirectory() as d:
+        proto.write_cal_lut(n_ch, fw_dir=d)
+        proto.write_frame_pack(n_ch, fw_dir=d)
+        for name in ("cal_lut.c", "cal_lut.h", "frame_pack.h"):
+            assert filecmp.cmp(os.path.join(d, name),
+                               os.path.join(proto.FIRMWARE_DIR, name),
+                               shallow=False), \
+                f"{name} is stale: rerun --gen-cal-lut / --gen-frame-pack"
+
+
+# ════════════════════════════════════════════════════════════
+#  HIL LIBRARY (greenhouse_hil.py, needs a host C compiler)
+# ════════════════════════════════════════════════════════════
+
+@functools.lru_cache(maxsize=None)
+def _hil_lib():
+    if shutil.which("cc") is None:
+        raise unittest.SkipTest("no host C compiler (cc)")
+    return hil.build_hil_library(werror=True)
+
+
+def test_frame_pack_round_trip():
+    """Generated C Frame_Pack: decoded and re-packed byte for byte."""
+    r = hil.check_protocol(trials=1000, lib_path=_hil_lib())
+    if "c" not in r:
+        raise unittest.SkipTest("board.h builds stream packets")
+    ok, tried, n_ch, _ = r["c"]
+    assert ok == tried, f"{tried - ok} of {tried} C frames differ (N = {n_ch})"
+
+
+def test_kalman_step_response():
+    """kalman.c against the moving average: quieter, unbiased on a ramp."""
+    r = hil.est_bench(lib_path=_hil_lib())
+    step = {name.split(" ")[0]: (sd, t50, t90)
+            for name, sd, t50, t90 in r["step"]}
+    ma_sd, _, _ = step["moving"]
+    kf_sd, kf_t50, kf_t90 = step["Kalman"]
+    assert kf_sd < ma_sd / 4, (kf_sd, ma_sd)
+    assert 0.0 < kf_t50 <= kf_t90 < 50.0, (kf_t50, kf_t90)
+    lag = {name.split(" ")[0]: v for name, v in r["ramp"]}
+    assert abs(lag["Kalman"]) < abs(lag["moving"]), lag
+    slope, sd = r["slope"]
+    assert abs(slope - r["ramp_lsb_s"]) < 0.05 * r["ramp_lsb_s"], (slope, sd)
+
+
+# ════════════════════════════════════════════════════════════
+#  POLLERS (greenhouse_reader.py, greenhouse_ipc.py)
+# ════════════════════════════════════════════════════════════
+
+def test_bench_multi():
+    """8 simulated nodes at 50 Hz from one thread: rate kept, on time."""
+    r = reader.bench_multi(8, seconds=2.0)
+    expect = r["hz"] * r["seconds"]
+    for name, frames, misses, _, p99, _ in r["nodes"]:
+        assert frames >= 0.9 * expect, (name, frames, expect)
+        assert misses <= 0.05 * frames, (name, misses, frames)
+        assert p99 < 1e3 / r["hz"], (name, p99)
+
+
+def test_frame_daemon_fanout():
+    """--serve: every client gets every polled frame, none lost."""
+    with tempfile.TemporaryDirectory(prefix="greenhouse-") as d:
+        path = os.path.join(d, "test.sock")
+        node = reader.SpiReader(simulate=True)
+        publisher = ipc.FramePublisher(path, [node])
+        publisher.start()
+        clients = [ipc.FrameClient(path) for _ in range(3)]
+        try:
+            for client in clients:
+                client.start()
+            node.start()
+            time.sleep(1.0)
+            node.stop()
+            time.sleep(0.1)                 # let the queues drain
+            _, st = node.get_snapshot()
+            assert st.valid_frames > 0
+            for i, client in enumerate(clients):
+                got = client.nodes[0]
+                assert got.frames.count == st.valid_frames, \
+                    (i, got.frames.count, st.valid_frames)
+                assert got.dropped == 0, (i, got.dropped)
+        finally:
+            for client in clients:
+                client.stop()
+            publisher.stop()
+
+
+# ════════════════════════════════════════════════════════════
+#  RUNNER
+# ════════════════════════════════════════════════════════════
+
+def main(argv):
+    tests = [(name, fn) for name, fn in globals().items()
+             if name.startswith("test_") and callable(fn)
+             and (not argv or any(a in name for a in argv))]
+    failed = skipped = 0
+    for name, fn in tests:
+        t0 = time.perf_counter()
+        try:
+            fn()
+        except unittest.SkipTest as e:
+            skipped += 1
+            print(f"SKIP  {name}: {e}")
+            continue
+        except Exception:
+            failed += 1
+            print(f"FAIL  {name}")
+            traceback.print_exc()
+            continue
+        print(f"ok    {name} ({time.perf_counter() - t0:.1f} s)")
+    print(f"{len(tests) - failed - skipped} passed, {skipped} skipped, "
+          f"{failed} failed")
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))